@@ -49,6 +49,26 @@
 # endif
 #endif
 
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for write */
+#endif
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>				/* for the work tables */
+#endif
+#if HAVE_MMAP
+# include <fcntl.h>				/* for the dumps and scan roots */
+# include <sys/stat.h>				/* for the live statistics */
+#endif
+#if HAVE_TIME
+# include <time.h>				/* for the live statistics */
+#endif
+#if LEAK_SCAN_STACK > 0 && defined(__linux__)
+# include <setjmp.h>				/* for the registers */
+# if LOCK_THREADS && defined(THREAD_INCLUDE)
+#  include THREAD_INCLUDE			/* for the mark threads */
+# endif
+#endif
+
 #include "dmalloc.h"
 
 #include "append.h"
@@ -59,9 +79,13 @@
 #include "dmalloc_loc.h"
 #include "dmalloc_rand.h"
 #include "dmalloc_tab.h"
+#include "env.h"
 #include "error.h"
 #include "error_val.h"
 #include "heap.h"
+#include "heap_dump.h"
+#include "live_stats.h"
+#include "symbol.h"
 
 /*
  * Library Copyright and URL information for ident and what programs
@@ -90,9 +114,6 @@ static char *information = "@(#) $Information: lock-threads is enabled $";
 /* limit in how much memory we are allowed to allocate */
 unsigned long		_dmalloc_memory_limit = 0;
 
-/* total number of bytes that the heap has allocated */
-unsigned long		_dmalloc_alloc_total = 0;
-
 /*
  * local variables
  */
@@ -113,6 +134,8 @@ static	skip_alloc_t	*skip_address_list = skip_address_alloc;
 
 /* update slots which we use to update the skip lists */
 static	skip_alloc_t	skip_update[MAX_SKIP_LEVEL /* read note ^^ */];
+/* update slots of the last search of a batch free to start the next */
+static	skip_alloc_t	batch_update[MAX_SKIP_LEVEL /* read note ^^ */];
 
 /* linked list of slots of various sizes */
 static	skip_alloc_t	*entry_free_list[MAX_SKIP_LEVEL];
@@ -121,17 +144,44 @@ static	entry_block_t	*entry_blocks[MAX_SKIP_LEVEL];
 /* linked list of freed blocks on hold waiting for the FREED_POINTER_DELAY */
 static	skip_alloc_t	*free_wait_list_head = NULL;
 static	skip_alloc_t	*free_wait_list_tail = NULL;
+/*
+ * Skip list of the used and freed large objects mapped outside of the
+ * heap sorted by address and the update slots for changing it.
+ */
+static	skip_alloc_t	skip_large_alloc[MAX_SKIP_LEVEL /* read note ^^ */];
+static	skip_alloc_t	*skip_large_list = skip_large_alloc;
+static	skip_alloc_t	large_update[MAX_SKIP_LEVEL /* read note ^^ */];
+static	int		large_freed_c = 0;	/* freed slots on the list */
 
 /* administrative structures */
 static	char		fence_bottom[FENCE_BOTTOM_SIZE];
 static	char		fence_top[FENCE_TOP_SIZE];
-static	int		bit_sizes[BASIC_BLOCK]; /* number bits for div-blocks*/
+
+/* size classes of the divided blocks and the class of each size */
+static	size_class_t	size_classes[MAX_SIZE_CLASSES];
+static	int		size_class_n = 0;
+static	unsigned char	size_class_index[CLASS_INDEX_N];
+static	int		size_classes_fixed_b = 0; /* blocks have been cut */
 
 /* memory tables */
 static	mem_table_t	mem_table_alloc;
 static	mem_entry_t	mem_table_alloc_entries[MEM_ALLOC_ENTRIES];
 static	mem_table_t	mem_table_changed;
 static	mem_entry_t	mem_table_changed_entries[MEM_ALLOC_ENTRIES];
+#if LOCK_PROFILE
+static	mem_table_t	mem_table_lock;
+static	mem_entry_t	mem_table_lock_entries[MEM_LOCK_ENTRIES];
+
+/* lock waits and holds of each operation */
+static	dmalloc_lock_stats_t	lock_stats[DMALLOC_LOCK_OP_N];
+#endif
+
+/* which pass of the used/free slot walks covers the large-object list */
+#if FREED_POINTER_DELAY
+#define LARGE_LIST_PASS		3
+#else
+#define LARGE_LIST_PASS		2
+#endif
 
 /* memory stats */
 static	unsigned long	alloc_current = 0;	/* current memory usage */
@@ -140,27 +190,83 @@ static	unsigned long	alloc_cur_given = 0;	/* current mem given */
 static	unsigned long	alloc_max_given = 0;	/* maximum mem given  */
 static	unsigned long	alloc_one_max = 0;	/* maximum at once */
 static	unsigned long	free_space_bytes = 0;	/* count the free bytes */
+static	unsigned long	purged_space_bytes = 0;	/* free bytes given back */
+static	unsigned long	purge_iter = 0;		/* iteration of last purge */
+
+#if PNT_CHECK_CACHE_SIZE > 0
+/*
+ * Allocations last found okay by the pointer checks.  With threads
+ * each thread has its own since the checks can run under a shared
+ * lock.
+ */
+static	THREAD_LOCAL pnt_cache_t	pnt_cache[PNT_CHECK_CACHE_SIZE];
+static	THREAD_LOCAL unsigned int	pnt_cache_next;
+/* changed by every free or realloc which may change a cached entry */
+static	unsigned long	heap_generation = 1;
+#endif
+
+#if MAX_POLICIES > 0
+/* debug policies which add flags to some of the allocations */
+static	policy_t	policies[MAX_POLICIES];
+static	int		policy_n = 0;
+#endif
+
+#if LEAK_SCAN
+/*
+ * Memory that the leak scan works in.  It is mapped for each scan
+ * and left out of the roots so that the pointers which the scan holds
+ * do not make allocations look reachable.
+ */
+static	char		*scan_mem = NULL;
+static	unsigned long	scan_mem_size = 0;
+static	scan_range_t	*scan_roots;		/* where to look for pointers */
+static	int		scan_root_n = 0;	/* number of roots */
+static	leak_scan_t	*scan_states;		/* one for each mark thread */
+static	int		scan_thread_n = 1;	/* threads marking slots */
+static	int		scan_overflow_b = 0;	/* a mark stack was full */
+/* where the stack of each mark thread is in use */
+static	char		*scan_stack_marks[LEAK_SCAN_THREADS + 1];
+#if LEAK_SCAN_WORKERS
+static	pthread_mutex_t	scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static	pthread_cond_t	scan_cond = PTHREAD_COND_INITIALIZER;
+static	pthread_t	scan_threads[LEAK_SCAN_THREADS];
+static	int		scan_running_b = 0;	/* a scan is under way */
+static	int		scan_ready_n = 0;	/* threads waiting to mark */
+static	int		scan_go_b = 0;		/* mark threads can start */
+static	int		scan_quit_b = 0;	/* mark threads should exit */
+static	int		scan_idle_n = 0;	/* threads with no work */
+static	skip_alloc_t	**scan_pool;		/* slots shared by threads */
+static	int		scan_pool_n = 0;	/* slots in the pool */
+#endif
+#endif
 
 /* pointer stats */
 static	unsigned long	alloc_cur_pnts = 0;	/* current pointers */
 static	unsigned long	alloc_max_pnts = 0;	/* maximum pointers */
-static	unsigned long	alloc_tot_pnts = 0;	/* total pointers */
 
 /* admin counts */
 static	unsigned long	heap_check_c = 0;	/* count of heap-checks */
 static	unsigned long	user_block_c = 0;	/* count of blocks */
 static	unsigned long	admin_block_c = 0;	/* count of admin blocks */
+static	unsigned long	large_object_c = 0;	/* count of large objects */
+static	unsigned long	large_space_bytes = 0;	/* bytes of large objects */
+
+/*
+ * Alloc counts and totals.  Each thread counts in the shard that it
+ * is given the first time that it comes through so that the threads
+ * do not pass the counters' cache lines around.
+ */
+static	stat_shard_t	stat_shards[STAT_SHARD_N] CACHE_ALIGNED;
+#if STAT_SHARD_N > 1
+static	THREAD_LOCAL int	stat_shard_c = 0;	/* thread's shard + 1 */
+static	unsigned int	stat_shard_next = 0;	/* next shard to give */
+#endif
 
-/* alloc counts */
-static	unsigned long	func_malloc_c = 0;	/* count the mallocs */
-static	unsigned long	func_calloc_c = 0;	/* # callocs, done in alloc */
-static	unsigned long	func_realloc_c = 0;	/* count the reallocs */
-static	unsigned long	func_recalloc_c = 0;	/* count the reallocs */
-static	unsigned long	func_memalign_c = 0;	/* count the memaligns */
-static	unsigned long	func_valloc_c = 0;	/* count the veallocs */
-static	unsigned long	func_new_c = 0;		/* count the news */
-static	unsigned long	func_free_c = 0;	/* count the frees */
-static	unsigned long	func_delete_c = 0;	/* count the deletes */
+#if LIVE_STATS
+/* live statistics mapped from LIVE_STATS_PATH */
+static	live_stats_t	*live_p = NULL;
+static	unsigned long	live_pid = 0;		/* process that opened it */
+#endif
 
 /**************************** skip list routines *****************************/
 
@@ -201,12 +307,51 @@ static	int	random_level(const int max_level)
 }
 
 /*
- * static skip_alloc_t *find_address
+ * static skip_alloc_t *start_slot
+ *
+ * Pick where a search of a level of a skip list starts.
+ *
+ * Returns the slot the search has reached or the slot where an
+ * earlier search went down the level, whichever is further on.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot that the search has reached.
+ *
+ * head_p -> Head of the skip list.
+ *
+ * start_p -> Update pointers of the earlier search or NULL if none.
+ *
+ * level_c -> Level that the search is going along.
+ */
+static	skip_alloc_t	*start_slot(skip_alloc_t *slot_p,
+				    skip_alloc_t *head_p,
+				    const skip_alloc_t *start_p,
+				    const int level_c)
+{
+  skip_alloc_t	*jump_p;
+  
+  if (start_p == NULL) {
+    return slot_p;
+  }
+  jump_p = start_p->sa_next_p[level_c];
+  if (jump_p == head_p
+      || (slot_p != head_p
+	  && (char *)jump_p->sa_mem <= (char *)slot_p->sa_mem)) {
+    return slot_p;
+  }
+  return jump_p;
+}
+
+/*
+ * static skip_alloc_t *find_address_from
  *
  * Look for a specific address in the skip list.  If it exist then a
  * pointer to the matching slot is returned otherwise NULL.  Either
  * way, the links that were traversed to get there are set in the
- * update slot which has the maximum number of levels.
+ * update slot which has the maximum number of levels.  The search can
+ * start each level where an earlier search for a lower address went
+ * down it so sorted addresses do not all go back to the head.
  *
  * RETURNS:
  *
@@ -219,29 +364,30 @@ static	int	random_level(const int max_level)
  *
  * address -> Address we are looking for.
  *
- * free_b -> Look on the free list otherwise look on the used list.
+ * head_p -> Head of the address sorted skip list we are searching.
  *
  * exact_b -> Set to 1 to find the exact pointer.  If 0 then the
  * address could be inside a block.
  *
+ * start_p -> Update pointers of an earlier search of the same list
+ * for a lower address, with no changes to the list since other than
+ * the removal of the slot it found, or NULL to start at the head.
+ *
  * update_p -> Pointer to the skip_alloc entry we are using to hold
- * the update pointers.
+ * the update pointers or NULL if none.
  */
-static	skip_alloc_t	*find_address(const void *address, const int free_b,
-				      const int exact_b,
-				      skip_alloc_t *update_p)
+static	skip_alloc_t	*find_address_from(const void *address,
+					   skip_alloc_t *head_p,
+					   const int exact_b,
+					   const skip_alloc_t *start_p,
+					   skip_alloc_t *update_p)
 {
   int		level_c;
   skip_alloc_t 	*slot_p, *found_p = NULL, *next_p;
   
   /* skip_address_max_level */
   level_c = MAX_SKIP_LEVEL - 1;
-  if (free_b) {
-    slot_p = skip_free_list;
-  }
-  else {
-    slot_p = skip_address_list;
-  }
+  slot_p = start_slot(head_p, head_p, start_p, level_c);
   
   /* traverse list to smallest entry */
   while (1) {
@@ -285,16 +431,53 @@ static	skip_alloc_t	*find_address(const void *address, const int free_b,
     
     /* we are lowering the level */
     
-    update_p->sa_next_p[level_c] = slot_p;
+    if (update_p != NULL) {
+      update_p->sa_next_p[level_c] = slot_p;
+    }
     if (level_c == 0) {
       break;
     }
     level_c--;
+    slot_p = start_slot(slot_p, head_p, start_p, level_c);
   }
   
   return found_p;
 }
 
+/*
+ * static skip_alloc_t *find_address
+ *
+ * Look for a specific address in the skip list starting at the head.
+ * See find_address_from.
+ *
+ * Returns a pointer to the slot on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Address we are looking for.
+ *
+ * free_b -> Look on the free list otherwise look on the used list.
+ *
+ * exact_b -> Set to 1 to find the exact pointer.  If 0 then the
+ * address could be inside a block.
+ *
+ * update_p -> Pointer to the skip_alloc entry we are using to hold
+ * the update pointers or NULL if none.
+ */
+static	skip_alloc_t	*find_address(const void *address, const int free_b,
+				      const int exact_b,
+				      skip_alloc_t *update_p)
+{
+  if (free_b) {
+    return find_address_from(address, skip_free_list, exact_b, NULL,
+			     update_p);
+  }
+  else {
+    return find_address_from(address, skip_address_list, exact_b, NULL,
+			     update_p);
+  }
+}
+
 /*
  * static skip_alloc_t *find_free_size
  *
@@ -313,10 +496,10 @@ static	skip_alloc_t	*find_address(const void *address, const int free_b,
  * update_p -> Pointer to the skip_alloc entry we are using to hold
  * the update pointers.
  */
-static	skip_alloc_t	*find_free_size(const unsigned int size,
+static	skip_alloc_t	*find_free_size(const unsigned long size,
 					skip_alloc_t *update_p)
 {
-  int		level_c, cmp;
+  int		level_c;
   skip_alloc_t 	*slot_p, *found_p = NULL, *next_p;
   
   /* skip_free_max_level */
@@ -335,13 +518,12 @@ static	skip_alloc_t	*find_free_size(const unsigned int size,
       /* just go down a level */
     }
     else {
-      cmp = next_p->sa_total_size - size;
-      if (cmp < 0) {
+      if (next_p->sa_total_size < size) {
 	/* next slot is less, go right */
 	slot_p = next_p;
 	continue;
       }
-      else if (cmp == 0) {
+      else if (next_p->sa_total_size == size) {
 	/*
 	 * we found a match but it may not be the first slot with this
 	 * size and we want the first match
@@ -352,7 +534,9 @@ static	skip_alloc_t	*find_free_size(const unsigned int size,
     
     /* we are lowering the level */
     
-    update_p->sa_next_p[level_c] = slot_p;
+    if (update_p != NULL) {
+      update_p->sa_next_p[level_c] = slot_p;
+    }
     if (level_c == 0) {
       break;
     }
@@ -452,7 +636,7 @@ static	void	*alloc_slots(const int level_n)
   }
   
   /* we need to allocate a new block of the slots of this level */
-  block_p = _dmalloc_heap_alloc(BLOCK_SIZE);
+  block_p = _dmalloc_heap_admin_alloc();
   if (block_p == NULL) {
     /*
      * Sanity check.  Out of heap memory.  Error code set in
@@ -650,6 +834,25 @@ static	skip_alloc_t	*get_slot(void)
   return new_p;
 }
 
+#if HEAP_LARGE_OBJECTS
+/*
+ * static void release_slot
+ *
+ * Return a slot which is no longer on any list to the entry free-list
+ * of its level so get_slot can hand it out again.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot that we are releasing.
+ */
+static	void	release_slot(skip_alloc_t *slot_p)
+{
+  slot_p->sa_flags = 0;
+  slot_p->sa_next_p[0] = entry_free_list[slot_p->sa_level_n];
+  entry_free_list[slot_p->sa_level_n] = slot_p;
+}
+#endif /* if HEAP_LARGE_OBJECTS */
+
 /*
  * static skip_alloc_t *insert_address
  *
@@ -668,7 +871,7 @@ static	skip_alloc_t	*get_slot(void)
  * list.
  */
 static	skip_alloc_t	*insert_address(void *address, const int free_b,
-					const unsigned int tot_size)
+					const unsigned long tot_size)
 {
   skip_alloc_t	*new_p;
   
@@ -776,6 +979,90 @@ static	int	expand_chars(const void *buf, const int buf_size,
   return out_p - out;
 }
 
+/*
+ * static unsigned long *thread_counts
+ *
+ * Find the counters of the current thread's shard, giving the thread
+ * a shard if it does not have one yet.  This must be called with the
+ * library locked.
+ *
+ * Returns the array of STAT_ counters of the shard.
+ */
+static	unsigned long	*thread_counts(void)
+{
+#if STAT_SHARD_N > 1
+  if (stat_shard_c == 0) {
+    stat_shard_c = stat_shard_next % STAT_SHARD_N + 1;
+    stat_shard_next++;
+  }
+  return stat_shards[stat_shard_c - 1].ss_counts;
+#else
+  return stat_shards[0].ss_counts;
+#endif
+}
+
+/*
+ * static void sum_counts
+ *
+ * Add up the counters of all of the shards for the reports.
+ *
+ * ARGUMENTS:
+ *
+ * counts <- Array of STAT_COUNTER_N sums which we fill in.
+ */
+static	void	sum_counts(unsigned long *counts)
+{
+  int	shard_c, count_c;
+  
+  for (count_c = 0; count_c < STAT_COUNTER_N; count_c++) {
+    counts[count_c] = 0;
+    for (shard_c = 0; shard_c < STAT_SHARD_N; shard_c++) {
+      counts[count_c] += stat_shards[shard_c].ss_counts[count_c];
+    }
+  }
+}
+
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+/*
+ * static unsigned long lifetime_nsec
+ *
+ * Read the monotonic clock for the lifetimes of the pointers.
+ *
+ * Returns the clock in nanoseconds.
+ */
+static	unsigned long	lifetime_nsec(void)
+{
+  struct timespec	now;
+  
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+    return 0;
+  }
+  return (unsigned long)now.tv_sec * 1000000000UL
+    + (unsigned long)now.tv_nsec;
+}
+#endif
+
+/*
+ * static void *align_up
+ *
+ * Round a pointer up to an alignment.  Slots are only block aligned
+ * so alignments above a block are found inside of a larger slot.
+ *
+ * Returns the aligned pointer.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Pointer that we are rounding up.
+ *
+ * shift -> Log2 of the alignment.
+ */
+static	void	*align_up(const void *pnt, const unsigned int shift)
+{
+  PNT_ARITH_TYPE	mask = ((PNT_ARITH_TYPE)1 << shift) - 1;
+  
+  return (void *)(((PNT_ARITH_TYPE)pnt + mask) & ~mask);
+}
+
 /*
  * static void get_pnt_info
  *
@@ -802,6 +1089,19 @@ static	void	get_pnt_info(const skip_alloc_t *slot_p, pnt_info_t *info_p)
       info_p->pi_fence_bottom = (char *)info_p->pi_user_start -
 	FENCE_BOTTOM_SIZE;
     }
+    else if (slot_p->sa_align_shift > BASIC_BLOCK) {
+      info_p->pi_user_start =
+	align_up((char *)info_p->pi_alloc_start + FENCE_BOTTOM_SIZE,
+		 slot_p->sa_align_shift);
+      info_p->pi_fence_bottom = (char *)info_p->pi_user_start -
+	FENCE_BOTTOM_SIZE;
+    }
+    else if (slot_p->sa_align_shift > 0) {
+      info_p->pi_user_start = (char *)info_p->pi_alloc_start +
+	(1UL << slot_p->sa_align_shift);
+      info_p->pi_fence_bottom = (char *)info_p->pi_user_start -
+	FENCE_BOTTOM_SIZE;
+    }
     else {
       info_p->pi_fence_bottom = info_p->pi_alloc_start;
       info_p->pi_user_start = (char *)info_p->pi_alloc_start +
@@ -810,7 +1110,13 @@ static	void	get_pnt_info(const skip_alloc_t *slot_p, pnt_info_t *info_p)
   }
   else {
     info_p->pi_fence_bottom = NULL;
-    info_p->pi_user_start = info_p->pi_alloc_start;
+    if (slot_p->sa_align_shift > BASIC_BLOCK) {
+      info_p->pi_user_start = align_up(info_p->pi_alloc_start,
+				       slot_p->sa_align_shift);
+    }
+    else {
+      info_p->pi_user_start = info_p->pi_alloc_start;
+    }
   }
   
   info_p->pi_user_bounds = (char *)info_p->pi_user_start +
@@ -939,10 +1245,12 @@ static	void	log_error_info(const char *now_file,
   const char	*prev_file;
   const void	*dump_pnt = user_pnt;
   const void	*start_user;
-  unsigned int	prev_line, user_size;
+  unsigned int	prev_line;
+  unsigned long	user_size;
   skip_alloc_t	*other_p;
   pnt_info_t	pnt_info;
-  int		out_len, dump_size, offset;
+  int		out_len, dump_size, dump_b;
+  long		offset;
   
   if (slot_p == NULL) {
     prev_file = NULL;
@@ -1046,13 +1354,24 @@ static	void	log_error_info(const char *now_file,
   }
   
   dump_pnt = (char *)start_user + offset;
-  if (IS_IN_HEAP(dump_pnt)) {
+  /* large objects live outside of the heap but are mapped while in use */
+  if (slot_p != NULL
+      && BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE)
+      && (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE))) {
+    dump_b = ((char *)dump_pnt >= (char *)slot_p->sa_mem
+	      && (char *)dump_pnt + dump_size <=
+	      (char *)slot_p->sa_mem + slot_p->sa_total_size);
+  }
+  else {
+    dump_b = IS_IN_HEAP(dump_pnt);
+  }
+  if (dump_b) {
     out_len = expand_chars(dump_pnt, dump_size, out, sizeof(out));
-    dmalloc_message("  dump of '%p'%+d: '%.*s'",
+    dmalloc_message("  dump of '%p'%+ld: '%.*s'",
 		    start_user, offset, out_len, out);
   }
   else {
-    dmalloc_message("  dump of '%p'%+d failed: not in heap", start_user, offset);
+    dmalloc_message("  dump of '%p'%+ld failed: not in heap", start_user, offset);
   }
   
   /* find the previous pointer in case it ran over */
@@ -1061,7 +1380,7 @@ static	void	log_error_info(const char *now_file,
 			   0 /* used list */, 1 /* not exact pointer */,
 			   skip_update);
     if (other_p != NULL) {
-      dmalloc_message("  prev pointer '%p' (size %u) may have run over from '%s'",
+      dmalloc_message("  prev pointer '%p' (size %lu) may have run over from '%s'",
 		      other_p->sa_mem, other_p->sa_user_size,
 		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
 					      other_p->sa_file,
@@ -1076,7 +1395,7 @@ static	void	log_error_info(const char *now_file,
 			   0 /* used list */, 1 /* not exact pointer */,
 			   skip_update);
     if (other_p != NULL) {
-      dmalloc_message("  next pointer '%p' (size %u) may have run under from '%s'",
+      dmalloc_message("  next pointer '%p' (size %lu) may have run under from '%s'",
 		      other_p->sa_mem, other_p->sa_user_size,
 		      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
 					      other_p->sa_file,
@@ -1093,7 +1412,8 @@ static	void	log_error_info(const char *now_file,
  *
  * Check a pointer for fence-post magic numbers.
  *
- * Returns 1 if the fence posts are good or 0 if they are not.
+ * Returns DMALLOC_ERROR_NONE if the fence posts are good otherwise
+ * the error code of the one that is bad.
  *
  * ARGUMENTS:
  *
@@ -1103,18 +1423,71 @@ static	int	fence_read(const pnt_info_t *info_p)
 {
   /* check magic numbers in bottom of allocation block */
   if (memcmp(fence_bottom, info_p->pi_fence_bottom, FENCE_BOTTOM_SIZE) != 0) {
-    dmalloc_errno = DMALLOC_ERROR_UNDER_FENCE;
-    return 0;
+    return DMALLOC_ERROR_UNDER_FENCE;
   }
   
   /* check numbers at top of allocation block */
   if (memcmp(fence_top, info_p->pi_fence_top, FENCE_TOP_SIZE) != 0) {
-    dmalloc_errno = DMALLOC_ERROR_OVER_FENCE;
-    return 0;
+    return DMALLOC_ERROR_OVER_FENCE;
   }
   
-  return 1;
+  return DMALLOC_ERROR_NONE;
+}
+
+#if HEAP_SHADOW_MAP
+/*
+ * static void shadow_set
+ *
+ * Update the shadow map for the memory of a slot.  All of it is
+ * marked as not addressable and then, if the slot is in use, the
+ * user part of it is marked.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot whose memory we are marking.
+ *
+ * info_p -> Pointer information of the slot if it is in use or NULL
+ * if it is being freed.
+ */
+static	void	shadow_set(const skip_alloc_t *slot_p,
+			   const pnt_info_t *info_p)
+{
+  unsigned char	*shadow_p, *user_p, fence;
+  unsigned long	size;
+  
+  shadow_p = _dmalloc_heap_shadow(slot_p->sa_mem);
+  if (shadow_p == NULL
+      || (PNT_ARITH_TYPE)slot_p->sa_mem % SHADOW_SCALE != 0) {
+    return;
+  }
+  memset(shadow_p, 0, (slot_p->sa_total_size + SHADOW_SCALE - 1)
+	 / SHADOW_SCALE);
+  
+  /* user pointers which do not start a shadow byte get the full check */
+  if (info_p == NULL
+      || slot_p->sa_user_size == 0
+      || (PNT_ARITH_TYPE)info_p->pi_user_start % SHADOW_SCALE != 0) {
+    return;
+  }
+  
+  /* fenced slots are marked so the fast check leaves them to the full one */
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FENCE)) {
+    fence = SHADOW_FENCE;
+  }
+  else {
+    fence = 0;
+  }
+  
+  user_p = shadow_p + ((char *)info_p->pi_user_start - (char *)slot_p->sa_mem)
+    / SHADOW_SCALE;
+  size = slot_p->sa_user_size;
+  memset(user_p, SHADOW_SCALE | fence, size / SHADOW_SCALE);
+  if (size % SHADOW_SCALE != 0) {
+    user_p[size / SHADOW_SCALE] = (size % SHADOW_SCALE) | fence;
+  }
+  *user_p |= SHADOW_START;
 }
+#endif /* if HEAP_SHADOW_MAP */
 
 /*
  * static void clear_alloc
@@ -1136,12 +1509,17 @@ static	int	fence_read(const pnt_info_t *info_p)
  *
  * func_id -> ID of the function which is doing the allocation.  Used
  * to determine if we should 0 memory for [re]calloc.
+ *
+ * flags -> Debug flags that we are running with.
  */
-static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
-			    const unsigned int old_size, const int func_id)
+static	HOT_PATH_INLINE	void	clear_alloc(skip_alloc_t *slot_p,
+					    pnt_info_t *info_p,
+					    const unsigned long old_size,
+					    const int func_id,
+					    const unsigned int flags)
 {
   char	*start_p;
-  int	num;
+  long	num;
   
   /*
    * NOTE: The alloc blank flag is set so we blank a slot when it is
@@ -1154,14 +1532,14 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
    * Set our slot blank flag if the flags are set now.  This will
    * carry over with a realloc.
    */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_ALLOC_BLANK)
-      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_BLANK)) {
+  if (BIT_IS_SET(flags, DMALLOC_DEBUG_ALLOC_BLANK)
+      || BIT_IS_SET(flags, DMALLOC_DEBUG_CHECK_BLANK)) {
     BIT_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK);
   }
   
   /*
-   * If we have a fence post protected valloc then there is almost a
-   * full block at the front what is "free".  Set it with blank chars.
+   * If we have a fence post protected valloc or memalign then there
+   * is space at the front what is "free".  Set it with blank chars.
    */
   if (info_p->pi_fence_b) {
     num = (char *)info_p->pi_fence_bottom - (char *)info_p->pi_alloc_start;
@@ -1180,7 +1558,10 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
   num = (char *)info_p->pi_user_bounds - start_p;
   if (num > 0) {
     if (func_id == DMALLOC_FUNC_CALLOC || func_id == DMALLOC_FUNC_RECALLOC) {
-      memset(start_p, 0, num);
+      /* freshly mapped large objects have already been zeroed */
+      if (old_size > 0 || (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE))) {
+	memset(start_p, 0, num);
+      }
     }
     else if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
       memset(start_p, ALLOC_BLANK_CHAR, num);
@@ -1217,6 +1598,130 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
 
 /************************** administration functions *************************/
 
+/*
+ * static void add_class
+ *
+ * Add a size to the size classes keeping them sorted.  Sizes are
+ * rounded up to the allocation alignment and those which are too
+ * small or too large for the divided blocks are skipped.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Size of the class we are adding.
+ */
+static	void	add_class(unsigned long size)
+{
+  int	class_c, move_c;
+  
+  size = CLASS_INDEX(size) * ALLOCATION_ALIGNMENT;
+  if (size < CHUNK_SMALLEST_BLOCK || size > BLOCK_SIZE / 2) {
+    return;
+  }
+  
+  for (class_c = 0; class_c < size_class_n; class_c++) {
+    if (size_classes[class_c].sc_size == size) {
+      return;
+    }
+    if (size_classes[class_c].sc_size > size) {
+      break;
+    }
+  }
+  if (size_class_n >= MAX_SIZE_CLASSES) {
+    return;
+  }
+  
+  for (move_c = size_class_n; move_c > class_c; move_c--) {
+    size_classes[move_c] = size_classes[move_c - 1];
+  }
+  memset(size_classes + class_c, 0, sizeof(*size_classes));
+  size_classes[class_c].sc_size = size;
+  size_class_n++;
+}
+
+/*
+ * static void build_classes
+ *
+ * Build the size classes of the divided blocks and the index which
+ * maps a size to its class.  The powers of two are always classes
+ * since the aligned allocations need slots which are aligned to their
+ * size.
+ *
+ * ARGUMENTS:
+ *
+ * classes_str -> Sizes of the classes separated by CLASS_SEP_CHAR or
+ * NULL to have SIZE_CLASSES_PER_DOUBLING classes in each doubling.
+ */
+static	void	build_classes(const char *classes_str)
+{
+  const char	*str_p;
+  unsigned long	size, step;
+  int		class_c, index_c, step_c;
+  
+  size_class_n = 0;
+  
+  /* the powers of two go in first so they are never crowded out */
+  for (size = 1; size <= BLOCK_SIZE / 2; size <<= 1) {
+    add_class(size);
+  }
+  
+  if (classes_str == NULL) {
+    for (size = 1; size <= BLOCK_SIZE / 2; size <<= 1) {
+      step = size / SIZE_CLASSES_PER_DOUBLING;
+      for (step_c = 1; step_c < SIZE_CLASSES_PER_DOUBLING; step_c++) {
+	add_class(size + step * step_c);
+      }
+    }
+  }
+  else {
+    for (str_p = classes_str; *str_p != '\0'; str_p++) {
+      if (str_p == classes_str || *(str_p - 1) == CLASS_SEP_CHAR) {
+	add_class(loc_atoul(str_p));
+      }
+    }
+  }
+  
+  /* each size goes to the smallest class that it fits in */
+  class_c = 0;
+  for (index_c = 0; index_c < CLASS_INDEX_N; index_c++) {
+    while (size_classes[class_c].sc_size
+	   < (unsigned long)index_c * ALLOCATION_ALIGNMENT) {
+      class_c++;
+    }
+    size_class_index[index_c] = class_c;
+  }
+}
+
+/*
+ * static void count_class
+ *
+ * Count the use of a divided slot in its size class.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot whose usage is changing.
+ *
+ * user_change -> Change in the user bytes of the slot.
+ *
+ * pnt_change -> 1 if the slot is being allocated, -1 if it is being
+ * freed, or 0 if it was resized in place.
+ */
+static	void	count_class(const skip_alloc_t *slot_p, const long user_change,
+			    const int pnt_change)
+{
+  size_class_t	*class_p;
+  
+  if (slot_p->sa_total_size > BLOCK_SIZE / 2) {
+    return;
+  }
+  class_p = size_classes + size_class_index[CLASS_INDEX(slot_p->sa_total_size)];
+  
+  class_p->sc_user_size += user_change;
+  class_p->sc_in_use_c += pnt_change;
+  if (pnt_change > 0) {
+    class_p->sc_alloc_c++;
+  }
+}
+
 /*
  * static int create_divided_chunks
  *
@@ -1226,11 +1731,12 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
  *
  * ARGUMENTS:
  *
- * div_size -> Size of the divided block that we are allocating.
+ * class_p -> Size class of the divided block that we are allocating.
  */
-static	int	create_divided_chunks(const unsigned int div_size)
+static	int	create_divided_chunks(size_class_t *class_p)
 {
   void		*mem, *bounds_p;
+  unsigned long	div_size = class_p->sc_size;
   
   /* allocate a 1 block chunk that we will cut up into pieces */
   mem = _dmalloc_heap_alloc(BLOCK_SIZE);
@@ -1239,6 +1745,8 @@ static	int	create_divided_chunks(const unsigned int div_size)
     return 0;
   }
   user_block_c++;
+  class_p->sc_block_c++;
+  size_classes_fixed_b = 1;
   
   /*
    * now run through the block and add the the locations to the
@@ -1275,7 +1783,7 @@ static	int	create_divided_chunks(const unsigned int div_size)
  * update_p -> Pointer to the skip_alloc entry we are using to hold
  * the update pointers.
  */
-static	skip_alloc_t	*use_free_memory(const unsigned int size,
+static	skip_alloc_t	*use_free_memory(const unsigned long size,
 					 skip_alloc_t *update_p)
 {
   skip_alloc_t	*slot_p;
@@ -1328,6 +1836,11 @@ static	skip_alloc_t	*use_free_memory(const unsigned int size,
     return NULL;
   }
   
+  /* the pages come back as zeros if we gave them to the system */
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_PURGED)) {
+    purged_space_bytes -= slot_p->sa_total_size;
+  }
+  
   /* set to user allocated space */
   slot_p->sa_flags = ALLOC_FLAG_USER;
   
@@ -1356,15 +1869,11 @@ static	skip_alloc_t	*use_free_memory(const unsigned int size,
 static	skip_alloc_t	*get_divided_memory(const unsigned int size)
 {
   skip_alloc_t	*slot_p;
+  size_class_t	*class_p;
   unsigned int	need_size;
-  int		*bits_p;
   
-  for (bits_p = bit_sizes;; bits_p++) {
-    if (*bits_p >= size) {
-      break;
-    }
-  }
-  need_size = *bits_p;
+  class_p = size_classes + size_class_index[CLASS_INDEX(size)];
+  need_size = class_p->sc_size;
   
   /* find a free block which matches the size */ 
   slot_p = use_free_memory(need_size, skip_update);
@@ -1373,7 +1882,7 @@ static	skip_alloc_t	*get_divided_memory(const unsigned int size)
   }
   
   /* need to get more slots */
-  if (! create_divided_chunks(need_size)) {
+  if (! create_divided_chunks(class_p)) {
     /* errors dumped in  create_divided_chunks */
     return NULL;
   }
@@ -1390,10 +1899,228 @@ static	skip_alloc_t	*get_divided_memory(const unsigned int size)
   return slot_p;
 }
 
+#if HEAP_LARGE_OBJECTS
+
 /*
- * static skip_alloc_t *get_memory
+ * static skip_alloc_t *find_large
  *
- * Get a block from the free list or heap allocation.
+ * Look for an address in the large-object skip list.  The last
+ * LARGE_FREED_MAX freed large objects stay on the list after they
+ * have been unmapped so we can still catch them being freed again.
+ *
+ * Returns a pointer to the slot which holds the address on success or
+ * NULL if it is not found.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Address we are looking for.
+ *
+ * exact_b -> Set to 1 to find the exact pointer.  If 0 then the
+ * address could be inside a large object.
+ *
+ * update_p -> Update slot filled in for a later list change or NULL
+ * if we are only looking.
+ */
+static	skip_alloc_t	*find_large(const void *address, const int exact_b,
+				    skip_alloc_t *update_p)
+{
+  return find_address_from(address, skip_large_list, exact_b, NULL,
+			   update_p);
+}
+
+/*
+ * static void drop_large
+ *
+ * Take a freed large-object slot off of the list and release it.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Freed slot that we are dropping.
+ */
+static	void	drop_large(skip_alloc_t *slot_p)
+{
+  if (find_large(slot_p->sa_mem, 1 /* exact */, large_update) != slot_p
+      || (! remove_slot(slot_p, large_update))) {
+    /* error set in remove_slot */
+    return;
+  }
+  release_slot(slot_p);
+  large_freed_c--;
+}
+
+/*
+ * static void purge_large
+ *
+ * Drop the freed large-object slots which overlap a region that the
+ * system has just mapped for us again.
+ *
+ * ARGUMENTS:
+ *
+ * mem -> Start of the region that was mapped.
+ *
+ * size -> Size of the region in bytes.
+ */
+static	void	purge_large(const void *mem, const unsigned long size)
+{
+  skip_alloc_t	*slot_p, *next_p;
+  
+  /* an object which holds the start of the region comes first */
+  slot_p = find_large(mem, 0 /* inside the object */, NULL);
+  if (slot_p == NULL) {
+    /* the update pointers lead to the last object below the region */
+    (void)find_large(mem, 1 /* exact */, large_update);
+    slot_p = large_update->sa_next_p[0]->sa_next_p[0];
+  }
+  
+  for (; slot_p != NULL && (char *)slot_p->sa_mem < (char *)mem + size;
+       slot_p = next_p) {
+    next_p = slot_p->sa_next_p[0];
+    if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)) {
+      drop_large(slot_p);
+    }
+  }
+}
+
+/*
+ * static void trim_large
+ *
+ * Drop the freed large-object slot which was freed the longest ago
+ * once there are more than LARGE_FREED_MAX of them.
+ */
+static	void	trim_large(void)
+{
+  skip_alloc_t	*slot_p, *oldest_p = NULL;
+  
+  if (large_freed_c <= LARGE_FREED_MAX) {
+    return;
+  }
+  
+  for (slot_p = skip_large_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)
+	&& (oldest_p == NULL || slot_p->sa_use_iter < oldest_p->sa_use_iter)) {
+      oldest_p = slot_p;
+    }
+  }
+  if (oldest_p != NULL) {
+    drop_large(oldest_p);
+  }
+}
+
+/*
+ * static skip_alloc_t *get_large_memory
+ *
+ * Map a large object directly from the system and add it to the
+ * large-object list.
+ *
+ * Returns a valid skip slot pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Size of the block that we are allocating.
+ */
+static	skip_alloc_t	*get_large_memory(const unsigned long size)
+{
+  skip_alloc_t	*slot_p, *adjust_p;
+  void		*mem;
+  unsigned long	need_size;
+  int		level_c;
+  
+  /* round up to the nearest block size */
+  need_size = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+  if (need_size < size) {
+    dmalloc_errno = DMALLOC_ERROR_TOO_BIG;
+    dmalloc_error("get_large_memory");
+    return NULL;
+  }
+  
+  /* get our slot first so a failure does not leave a mapping behind */
+  slot_p = get_slot();
+  if (slot_p == NULL) {
+    /* error set in get_slot */
+    return NULL;
+  }
+  
+  mem = _dmalloc_heap_map(need_size);
+  if (mem == HEAP_ALLOC_ERROR) {
+    /* error code set in _dmalloc_heap_map */
+    release_slot(slot_p);
+    return NULL;
+  }
+  
+  /* any freed large objects which used to live here are gone for good */
+  purge_large(mem, need_size);
+  
+  slot_p->sa_flags = ALLOC_FLAG_USER | ALLOC_FLAG_LARGE;
+  slot_p->sa_mem = mem;
+  slot_p->sa_total_size = need_size;
+  
+  /* insert it after the update slots of each of its levels */
+  if (find_large(mem, 1 /* exact */, large_update) != NULL) {
+    /* sanity check, the purge should have dropped anything here */
+    dmalloc_errno = DMALLOC_ERROR_ADDRESS_LIST;
+    dmalloc_error("get_large_memory");
+    _dmalloc_heap_unmap(mem, need_size);
+    release_slot(slot_p);
+    return NULL;
+  }
+  for (level_c = 0; level_c <= slot_p->sa_level_n; level_c++) {
+    adjust_p = large_update->sa_next_p[level_c];
+    slot_p->sa_next_p[level_c] = adjust_p->sa_next_p[level_c];
+    adjust_p->sa_next_p[level_c] = slot_p;
+  }
+  
+  large_object_c++;
+  large_space_bytes += need_size;
+  
+  return slot_p;
+}
+
+#endif /* if HEAP_LARGE_OBJECTS */
+
+/*
+ * static skip_alloc_t *find_used_address
+ *
+ * Look for an allocated address in the used skip list and then in the
+ * large-object list.
+ *
+ * Returns a pointer to the slot which holds the address on success or
+ * NULL if it is not found.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Address we are looking for.
+ *
+ * exact_b -> Set to 1 to find the exact pointer.  If 0 then the
+ * address could be inside a block.
+ *
+ * update_p -> Update slot filled in for a later list change or NULL
+ * if we are only looking.
+ */
+static	skip_alloc_t	*find_used_address(const void *address,
+					   const int exact_b,
+					   skip_alloc_t *update_p)
+{
+  skip_alloc_t	*slot_p;
+  
+  slot_p = find_address(address, 0 /* used list */, exact_b, update_p);
+#if HEAP_LARGE_OBJECTS
+  if (slot_p == NULL) {
+    slot_p = find_large(address, exact_b, NULL);
+    if (slot_p != NULL && BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)) {
+      slot_p = NULL;
+    }
+  }
+#endif
+  
+  return slot_p;
+}
+
+/*
+ * static skip_alloc_t *get_memory
+ *
+ * Get a block from the free list or heap allocation.
  *
  * Returns a valid skip slot pointer on success or NULL on failure.
  *
@@ -1401,15 +2128,15 @@ static	skip_alloc_t	*get_divided_memory(const unsigned int size)
  *
  * size -> Size of the block that we are allocating.
  */
-static	skip_alloc_t	*get_memory(const unsigned int size)
+static	skip_alloc_t	*get_memory(const unsigned long size)
 {
   skip_alloc_t	*slot_p, *update_p;
   void		*mem;
-  unsigned int	need_size, block_n;
+  unsigned long	need_size, block_n;
   
   /* do we need to print admin info? */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
-    dmalloc_message("need %d bytes", size);
+    dmalloc_message("need %lu bytes", size);
   }
   
   /* will this allocate put us over the limit? */
@@ -1420,6 +2147,13 @@ static	skip_alloc_t	*get_memory(const unsigned int size)
     return NULL;
   }
   
+#if HEAP_LARGE_OBJECTS
+  /* is this a large object which we map on its own? */
+  if (size >= LARGE_OBJECT_SIZE) {
+    return get_large_memory(size);
+  }
+#endif
+  
   /* do we have a divided block here? */
   if (size <= BLOCK_SIZE / 2) {
     return get_divided_memory(size);
@@ -1474,11 +2208,72 @@ static	skip_alloc_t	*get_memory(const unsigned int size)
 }
 
 /*
- * static int check_used_slot
+ * static int check_pnt_size
+ *
+ * Check that a pointer into a user allocation can hold the bytes
+ * that the caller asked about.
+ *
+ * Returns DMALLOC_ERROR_NONE on success or the error code on failure.
+ *
+ * ARGUMENTS:
+ *
+ * user_pnt -> User pointer inside of the allocation.
+ *
+ * user_bounds -> Pointer past the end of the user allocation.
+ *
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
+ *
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
+ */
+static	int	check_pnt_size(const void *user_pnt, const void *user_bounds,
+			       const int strlen_b, const int min_size)
+{
+  const char	*bounds_p, *mem_p;
+  
+  if (strlen_b) {
+    int	equals_okay_b = 0;
+    mem_p = (char *)user_pnt;
+    if (min_size > 0) {
+      bounds_p = mem_p + min_size;
+      /* min_size can be out of bounds as long as we find a \0 beforehand */
+      if (bounds_p > (char *)user_bounds) {
+	bounds_p = (char *)user_bounds;
+      } else {
+	/* we can equals our boundary if our min_size <= user_bounds */
+	equals_okay_b = 1;
+      }
+    } else {
+      bounds_p = (char *)user_bounds;
+    }
+    for (; mem_p < bounds_p; mem_p++) {
+      if (*mem_p == '\0') {
+	break;
+      }
+    }
+    /* mem_p can == bounds_p (if equals-ok) if we hit the min_size but can't >= user_bounds */ 
+    if (mem_p > (char *)user_bounds
+	|| ((! equals_okay_b) && mem_p == (char *)user_bounds)) {
+      return DMALLOC_ERROR_WOULD_OVERWRITE;
+    }
+  } else if (min_size > 0) {
+    if ((char *)user_pnt + min_size > (char *)user_bounds) {
+      return DMALLOC_ERROR_WOULD_OVERWRITE;
+    }
+  }
+  
+  return DMALLOC_ERROR_NONE;
+}
+
+/*
+ * static int used_slot_error
  *
  * Check out the pointer in a allocated slot to make sure it is good.
+ * This does not touch dmalloc_errno so that shared readers can call
+ * it beside each other.
  *
- * Returns 1 on success or 0 on failure.
+ * Returns DMALLOC_ERROR_NONE on success or the error code on failure.
  *
  * ARGUMENTS:
  *
@@ -1495,19 +2290,19 @@ static	skip_alloc_t	*get_memory(const unsigned int size)
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
  */
-static	int	check_used_slot(const skip_alloc_t *slot_p,
+static	int	used_slot_error(const skip_alloc_t *slot_p,
 				const void *user_pnt, const int exact_b,
 				const int strlen_b, const int min_size)
 {
   const char	*file, *name_p, *bounds_p, *mem_p;
   unsigned int	line, num;
   pnt_info_t	pnt_info;
+  int		error;
   
   if (! (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)
 	 || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_EXTERN)
 	 || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_ADMIN))) {
-    dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
-    return 0;
+    return DMALLOC_ERROR_SLOT_CORRUPT;
   }
   
   /* get pointer info */
@@ -1515,29 +2310,25 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
   
   /* the user pointer needs to be within the user space */
   if (user_pnt != NULL && (char *)user_pnt < (char *)pnt_info.pi_user_start) {
-    dmalloc_errno = DMALLOC_ERROR_WOULD_OVERWRITE;
-    return 0;
+    return DMALLOC_ERROR_WOULD_OVERWRITE;
   }
   
   /* if we need the exact pointer, make sure that the user_pnt agrees */
   if (exact_b && user_pnt != pnt_info.pi_user_start) {
-    dmalloc_errno = DMALLOC_ERROR_NOT_START_BLOCK;
-    return 0;
+    return DMALLOC_ERROR_NOT_START_BLOCK;
   }
   
 #if LARGEST_ALLOCATION
   /* have we exceeded the upper bounds */
   if (slot_p->sa_user_size > LARGEST_ALLOCATION) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    return 0;
+    return DMALLOC_ERROR_BAD_SIZE;
   }
 #endif
   
   /* check our total block size */
   if (slot_p->sa_total_size > BLOCK_SIZE / 2
       && slot_p->sa_total_size % BLOCK_SIZE != 0) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    return 0;
+    return DMALLOC_ERROR_BAD_SIZE;
   }
   
   /*
@@ -1547,34 +2338,38 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
   if (pnt_info.pi_valloc_b) {
     
     if ((PNT_ARITH_TYPE)pnt_info.pi_user_start % BLOCK_SIZE != 0) {
-      dmalloc_errno = DMALLOC_ERROR_NOT_ON_BLOCK;
-      return 0;
+      return DMALLOC_ERROR_NOT_ON_BLOCK;
     }
     if (slot_p->sa_total_size < BLOCK_SIZE) {
-      dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
-      return 0;
+      return DMALLOC_ERROR_SLOT_CORRUPT;
     }
-    
-    /* now check the below space to make sure it is still clear */
-    if (pnt_info.pi_fence_b && pnt_info.pi_blanked_b) {
-      num = (char *)pnt_info.pi_fence_bottom - (char *)pnt_info.pi_alloc_start;
-      if (num > 0) {
-	for (mem_p = pnt_info.pi_alloc_start;
-	     mem_p < (char *)pnt_info.pi_fence_bottom;
-	     mem_p++) {
-	  if (*mem_p != ALLOC_BLANK_CHAR) {
-	    dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	    return 0;
-	  }
+  }
+  else if (slot_p->sa_align_shift > 0
+	   && (PNT_ARITH_TYPE)pnt_info.pi_user_start
+	   % (1UL << slot_p->sa_align_shift) != 0) {
+    return DMALLOC_ERROR_NOT_ON_BLOCK;
+  }
+  
+  /* now check the below space of aligned pointers is still clear */
+  if (pnt_info.pi_fence_b && pnt_info.pi_blanked_b) {
+    num = (char *)pnt_info.pi_fence_bottom - (char *)pnt_info.pi_alloc_start;
+    if (num > 0) {
+      for (mem_p = pnt_info.pi_alloc_start;
+	   mem_p < (char *)pnt_info.pi_fence_bottom;
+	   mem_p++) {
+	if (*mem_p != ALLOC_BLANK_CHAR) {
+	  return DMALLOC_ERROR_FREE_OVERWRITTEN;
 	}
       }
     }
   }
   
   /* check out the fence-posts */
-  if (pnt_info.pi_fence_b && (! fence_read(&pnt_info))) {
-    /* errno set in fence_read */
-    return 0;
+  if (pnt_info.pi_fence_b) {
+    error = fence_read(&pnt_info);
+    if (error != DMALLOC_ERROR_NONE) {
+      return error;
+    }
   }
   
   /* check above the allocation to see if it's been overwritten */
@@ -1589,8 +2384,7 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     
     for (; mem_p < (char *)pnt_info.pi_alloc_bounds; mem_p++) {
       if (*mem_p != ALLOC_BLANK_CHAR) {
-	dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	return 0;
+	return DMALLOC_ERROR_FREE_OVERWRITTEN;
       }
     }
   }
@@ -1601,8 +2395,7 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
   /* check line number */
 #if MAX_LINE_NUMBER
   if (line > MAX_LINE_NUMBER) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_LINE;
-    return 0;
+    return DMALLOC_ERROR_BAD_LINE;
   }
 #endif
   
@@ -1618,8 +2411,7 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     }
     if (name_p > bounds_p
 	|| name_p < file + MIN_FILE_LENGTH) {
-      dmalloc_errno = DMALLOC_ERROR_BAD_FILE;
-      return 0;
+      return DMALLOC_ERROR_BAD_FILE;
     }
   }
 #endif
@@ -1632,42 +2424,47 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
    * iter_c * 2.
    */
   if (slot_p->sa_seen_c / 2 > _dmalloc_iter_c) {
-    dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
-    return 0;
+    return DMALLOC_ERROR_SLOT_CORRUPT;
   }
 #endif
   
-  if (strlen_b) {
-    int	equals_okay_b = 0;
-    mem_p = (char *)user_pnt;
-    if (min_size > 0) {
-      bounds_p = mem_p + min_size;
-      /* min_size can be out of bounds as long as we find a \0 beforehand */
-      if (bounds_p > (char *)pnt_info.pi_user_bounds) {
-	bounds_p = (char *)pnt_info.pi_user_bounds;
-      } else {
-	/* we can equals our boundary if our min_size <= user_bounds */
-	equals_okay_b = 1;
-      }
-    } else {
-      bounds_p = (char *)pnt_info.pi_user_bounds;
-    }
-    for (; mem_p < bounds_p; mem_p++) {
-      if (*mem_p == '\0') {
-	break;
-      }
-    }
-    /* mem_p can == bounds_p (if equals-ok) if we hit the min_size but can't >= user_bounds */ 
-    if (mem_p > (char *)pnt_info.pi_user_bounds
-	|| ((! equals_okay_b) && mem_p == (char *)pnt_info.pi_user_bounds)) {
-      dmalloc_errno = DMALLOC_ERROR_WOULD_OVERWRITE;
-      return 0;
-    }
-  } else if (min_size > 0) {
-    if ((char *)user_pnt + min_size > (char *)pnt_info.pi_user_bounds) {
-      dmalloc_errno = DMALLOC_ERROR_WOULD_OVERWRITE;
-      return 0;
-    }
+  return check_pnt_size(user_pnt, pnt_info.pi_user_bounds, strlen_b,
+			min_size);
+}
+
+/*
+ * static int check_used_slot
+ *
+ * Check out the pointer in a allocated slot to make sure it is good
+ * and set dmalloc_errno if it is not.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot that we are checking.
+ *
+ * user_pnt -> User pointer which was used to get the slot or NULL.
+ *
+ * exact_b -> Set to 1 to find the pointer specifically.  Otherwise we
+ * can find the pointer inside of an allocation.
+ *
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
+ *
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
+ */
+static	int	check_used_slot(const skip_alloc_t *slot_p,
+				const void *user_pnt, const int exact_b,
+				const int strlen_b, const int min_size)
+{
+  int	error;
+  
+  error = used_slot_error(slot_p, user_pnt, exact_b, strlen_b, min_size);
+  if (error != DMALLOC_ERROR_NONE) {
+    dmalloc_errno = error;
+    return 0;
   }
   
   return 1;
@@ -1693,7 +2490,18 @@ static	int	check_free_slot(const skip_alloc_t *slot_p)
     return 0;
   }
   
-  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_PURGED)) {
+    /* the system gave us back zeros for the purged pages */
+    for (check_p = (char *)slot_p->sa_mem;
+	 check_p < (char *)slot_p->sa_mem + slot_p->sa_total_size;
+	 check_p++) {
+      if (*check_p != '\0') {
+	dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
+	return 0;
+      }
+    }
+  }
+  else if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
     for (check_p = (char *)slot_p->sa_mem;
 	 check_p < (char *)slot_p->sa_mem + slot_p->sa_total_size;
 	 check_p++) {
@@ -1720,10 +2528,56 @@ static	int	check_free_slot(const skip_alloc_t *slot_p)
   return 1;
 }
 
-/***************************** exported routines *****************************/
-
 /*
- * int _dmalloc_chunk_startup
+ * static unsigned long purge_free
+ *
+ * Give the pages of the whole-block free slots back to the system.
+ * The slots stay on the free list so we still know about the address
+ * space but the memory reads back as zeros until it is reused.
+ *
+ * Returns the number of bytes purged.
+ *
+ * ARGUMENTS:
+ *
+ * min_age -> Number of iterations that a slot must have been free
+ * before it is purged.  Set to 0 to purge all of the free slots.
+ */
+static	unsigned long	purge_free(const unsigned long min_age)
+{
+  skip_alloc_t	*slot_p;
+  unsigned long	purge_size = 0;
+  
+  for (slot_p = skip_free_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    
+    /* divided blocks share their pages with other slots */
+    if (slot_p->sa_total_size < BLOCK_SIZE
+	|| BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_PURGED)
+	|| slot_p->sa_use_iter + min_age > _dmalloc_iter_c) {
+      continue;
+    }
+    
+    if (! _dmalloc_heap_purge(slot_p->sa_mem, slot_p->sa_total_size)) {
+      /* not supported or the system is unhappy so stop trying */
+      break;
+    }
+    BIT_SET(slot_p->sa_flags, ALLOC_FLAG_PURGED);
+    purged_space_bytes += slot_p->sa_total_size;
+    purge_size += slot_p->sa_total_size;
+  }
+  
+  if (purge_size > 0 && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("purged %lu bytes of free memory", purge_size);
+  }
+  
+  return purge_size;
+}
+
+/***************************** exported routines *****************************/
+
+/*
+ * int _dmalloc_chunk_startup
  * 
  * Startup the low level malloc routines.
  *
@@ -1733,7 +2587,6 @@ int	_dmalloc_chunk_startup(void)
 {
   unsigned int	value;
   char		*pos_p, *max_p;
-  int		bit_c, *bits_p;
   
   value = FENCE_MAGIC_BOTTOM;
   max_p = fence_bottom + FENCE_BOTTOM_SIZE;
@@ -1759,17 +2612,15 @@ int	_dmalloc_chunk_startup(void)
     }
   }
   
-  /* initialize the bits array */
-  bits_p = bit_sizes;
-  for (bit_c = 0; bit_c < BASIC_BLOCK; bit_c++) {
-    if ((1 << bit_c) >= CHUNK_SMALLEST_BLOCK) {
-      *bits_p++ = 1 << bit_c;
-    }
+  /* the classes may have been set from the environment already */
+  if (size_class_n == 0) {
+    build_classes(NULL);
   }
   
-  /* set the admin flags on the two statically allocated slots */
+  /* set the admin flags on the statically allocated slots */
   skip_free_list->sa_flags = ALLOC_FLAG_ADMIN;
   skip_address_list->sa_flags = ALLOC_FLAG_ADMIN;
+  skip_large_list->sa_flags = ALLOC_FLAG_ADMIN;
   
   _dmalloc_table_init(&mem_table_alloc, mem_table_alloc_entries,
 		      sizeof(mem_table_alloc_entries) /
@@ -1777,6 +2628,11 @@ int	_dmalloc_chunk_startup(void)
   _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
 		      sizeof(mem_table_changed_entries) /
 		      sizeof(*mem_table_changed_entries));
+#if LOCK_PROFILE
+  _dmalloc_table_init(&mem_table_lock, mem_table_lock_entries,
+		      sizeof(mem_table_lock_entries) /
+		      sizeof(*mem_table_lock_entries));
+#endif
   
   return 1;
 }
@@ -1818,6 +2674,47 @@ char	*_dmalloc_chunk_desc_pnt(char *buf, const int buf_size,
   return buf;
 }
 
+/*
+ * char *_dmalloc_chunk_desc_site
+ *
+ * Write into a buffer the description of where a pointer was
+ * allocated for the reports.  Return-addresses are followed by their
+ * module, offset, and function if they can be found.  This should not
+ * be used when logging each transaction since the first address of a
+ * module has its symbols read in.
+ *
+ * Returns a pointer to buffer 1st argument.
+ *
+ * ARGUMENTS:
+ *
+ * buf <-> Passed in buffer which will be filled with a description of
+ * the pointer.
+ *
+ * buf_size -> Size of the buffer in bytes.
+ *
+ * file -> File name, return address, or NULL.
+ *
+ * line -> Line number or 0.
+ */
+char	*_dmalloc_chunk_desc_site(char *buf, const int buf_size,
+				  const char *file, const unsigned int line)
+{
+  const char	*symbol;
+  int		len;
+  
+  (void)_dmalloc_chunk_desc_pnt(buf, buf_size, file, line);
+  
+  if (file != DMALLOC_DEFAULT_FILE && line == DMALLOC_DEFAULT_LINE) {
+    symbol = _dmalloc_symbol_desc(file);
+    if (symbol != NULL) {
+      len = strlen(buf);
+      (void)loc_snprintf(buf + len, buf_size - len, " (%s)", symbol);
+    }
+  }
+  
+  return buf;
+}
+
 /*
  * int _dmalloc_chunk_read_info
  *
@@ -1857,34 +2754,49 @@ char	*_dmalloc_chunk_desc_pnt(char *buf, const int buf_size,
  *
  * fence_bp <- Pointer to an integer which, if not NULL, will be set
  * to 1 if the pointer has the fence bit set otherwise 0.
+ *
+ * shared_b -> Set to 1 if the library lock is only held shared with
+ * other readers.  Nothing is logged so on a 0 return the caller
+ * should make the call again under the exclusive lock to report it.
  */
 int	_dmalloc_chunk_read_info(const void *user_pnt, const char *where,
-				 unsigned int *user_size_p,
-				 unsigned int *alloc_size_p, char **file_p,
+				 unsigned long *user_size_p,
+				 unsigned long *alloc_size_p, char **file_p,
 				 unsigned int *line_p, void **ret_attr_p,
 				 unsigned long **seen_cp,
 				 unsigned long *used_p, int *valloc_bp,
-				 int *fence_bp)
+				 int *fence_bp, const int shared_b)
 {
   skip_alloc_t	*slot_p;
+  int		error;
   
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+  if ((! shared_b) && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
     dmalloc_message("reading info about pointer '%p'", user_pnt);
   }
   
-  /* find the pointer with loose checking for fence */
-  slot_p = find_address(user_pnt, 0 /* used list */, 0 /* not exact pointer */,
-			skip_update);
+  /*
+   * find the pointer with loose checking for fence.  NOTE: we don't
+   * need the update slots which keeps this safe for shared readers.
+   */
+  slot_p = find_used_address(user_pnt, 0 /* not exact pointer */, NULL);
   if (slot_p == NULL) {
+    if (shared_b) {
+      return 0;
+    }
     dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
     log_error_info(NULL, 0, user_pnt, NULL, "finding address in heap", where);
     return 0;
   }
   
   /* might as well check the pointer now */
-  if (! check_used_slot(slot_p, user_pnt, 1 /* exact */, 0 /* no strlen */,
-			0 /* no min-size */)) {
-    /* errno set in check_slot */
+  error = used_slot_error(slot_p, user_pnt, 1 /* exact */, 0 /* no strlen */,
+			  0 /* no min-size */);
+  if (error != DMALLOC_ERROR_NONE) {
+    /* the shared readers leave the errno to the exclusive call */
+    if (shared_b) {
+      return 0;
+    }
+    dmalloc_errno = error;
     log_error_info(NULL, 0, user_pnt, slot_p, "checking pointer admin", where);
     return 0;
   }
@@ -1933,6 +2845,9 @@ int	_dmalloc_chunk_heap_check(void)
   entry_block_t	*block_p;
   int		ret, level_c, checking_list_c = 0;
   int		final = 1;
+#if HEAP_SOFT_DIRTY
+  int		dirty_b;
+#endif
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
     dmalloc_message("checking heap");
@@ -1940,6 +2855,11 @@ int	_dmalloc_chunk_heap_check(void)
   
   heap_check_c++;
   
+#if HEAP_SOFT_DIRTY
+  /* see if we only need to look at the pages written since last time */
+  dirty_b = _dmalloc_heap_dirty_start();
+#endif
+  
   /*
    * first, run through all of the admin structures and check for
    * validity
@@ -2071,6 +2991,15 @@ int	_dmalloc_chunk_heap_check(void)
       return 0;
     }
     
+#if HEAP_SOFT_DIRTY
+    /* skip the slot if neither it nor its memory have been written */
+    if (dirty_b
+	&& (! _dmalloc_heap_is_dirty(slot_p, SKIP_SLOT_SIZE(slot_p->sa_level_n)))
+	&& (! _dmalloc_heap_is_dirty(slot_p->sa_mem, slot_p->sa_total_size))) {
+      continue;
+    }
+#endif
+    
     /* now check the allocation */
     if (checking_list_c == 0) {
       ret = check_used_slot(slot_p, NULL /* no user pnt */,
@@ -2096,9 +3025,171 @@ int	_dmalloc_chunk_heap_check(void)
     }
   }
   
+  /*
+   * Now run through the large objects which are mapped outside of the
+   * heap.  The freed ones have been unmapped so there is nothing to
+   * check but their slot.
+   */
+  for (slot_p = skip_large_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    
+    /* the slot itself lives in one of our admin blocks */
+    if ((! IS_IN_HEAP(slot_p))
+	|| (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE))) {
+      dmalloc_errno = DMALLOC_ERROR_ADDRESS_LIST;
+      dmalloc_error("_dmalloc_chunk_heap_check");
+      return 0;
+    }
+    if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)) {
+      continue;
+    }
+    
+    ret = check_used_slot(slot_p, NULL /* no user pnt */,
+			  0 /* loose pnt checking */, 0 /* no strlen */,
+			  0 /* no min-size */);
+    if (! ret) {
+      /* error set in check_slot */
+      log_error_info(NULL, 0, NULL, slot_p, "checking large pointer",
+		     "_dmalloc_chunk_heap_check");
+      /* not a critical error */
+      final = 0;
+    }
+  }
+  
+#if HEAP_SOFT_DIRTY
+  if (final) {
+    _dmalloc_heap_dirty_done();
+  }
+#endif
+  
   return final;
 }
 
+/*
+ * int _dmalloc_chunk_shadow_check
+ *
+ * Quickly check a pointer against the shadow map without locking.
+ * This can only say that a pointer is good.  It does not look at the
+ * fence-posts or the slot itself.
+ *
+ * Returns 1 if the pointer is okay or 0 if the caller needs to make
+ * the full check with _dmalloc_chunk_pnt_check.
+ *
+ * ARGUMENTS:
+ *
+ * user_pnt -> Pointer we are checking.
+ *
+ * exact_b -> Set to 1 to find the pointer specifically.  Otherwise we
+ * can find the pointer inside of an allocation.
+ *
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
+ *
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
+ */
+int	_dmalloc_chunk_shadow_check(const void *user_pnt, const int exact_b,
+				    const int strlen_b, const int min_size)
+{
+#if HEAP_SHADOW_MAP
+  const unsigned char	*shadow_p;
+  const unsigned long	*word_p;
+  const char		*mem_p, *bounds_p;
+  unsigned long		left, full_word;
+  unsigned int		count, offset;
+  
+  shadow_p = _dmalloc_heap_shadow(user_pnt);
+  if (shadow_p == NULL) {
+    return 0;
+  }
+  offset = (PNT_ARITH_TYPE)user_pnt % SHADOW_SCALE;
+  if (exact_b && (offset != 0 || ! (*shadow_p & SHADOW_START))) {
+    return 0;
+  }
+  /* only the full check looks at the fence-posts */
+  if (*shadow_p & SHADOW_FENCE) {
+    return 0;
+  }
+  count = *shadow_p & ~SHADOW_START;
+  if (count <= offset) {
+    return 0;
+  }
+  
+  /*
+   * NOTE: we stop at the first short shadow byte or the start of the
+   * next allocation.  There is always a 0 shadow byte after the end
+   * of the committed heap to stop us.
+   */
+  
+  if (strlen_b) {
+    /* look for the \0 or min_size bytes inside of the allocation */
+    mem_p = (char *)user_pnt;
+    left = (min_size > 0 ? (unsigned long)min_size : (unsigned long)-1);
+    while (1) {
+      for (bounds_p = mem_p + count - offset; mem_p < bounds_p; mem_p++) {
+	if (left == 0 || *mem_p == '\0') {
+	  return 1;
+	}
+	left--;
+      }
+      if (left == 0) {
+	return 1;
+      }
+      if (count < SHADOW_SCALE) {
+	return 0;
+      }
+      shadow_p++;
+      count = *shadow_p;
+      if (count == 0 || count > SHADOW_SCALE) {
+	return 0;
+      }
+      offset = 0;
+    }
+  }
+  
+  if (min_size <= 0 || (unsigned int)min_size <= count - offset) {
+    return 1;
+  }
+  if (count < SHADOW_SCALE) {
+    return 0;
+  }
+  left = min_size - (count - offset);
+  shadow_p++;
+  
+  /* compare a word of full shadow bytes at a time */
+  full_word = (~0UL / 0xff) * SHADOW_SCALE;
+  while (left > SHADOW_SCALE && (PNT_ARITH_TYPE)shadow_p % sizeof(long) != 0) {
+    if (*shadow_p != SHADOW_SCALE) {
+      return 0;
+    }
+    shadow_p++;
+    left -= SHADOW_SCALE;
+  }
+  for (word_p = (unsigned long *)shadow_p;
+       left > SHADOW_SCALE * sizeof(long);
+       word_p++) {
+    if (*word_p != full_word) {
+      break;
+    }
+    left -= SHADOW_SCALE * sizeof(long);
+  }
+  shadow_p = (unsigned char *)word_p;
+  
+  for (; left > SHADOW_SCALE; shadow_p++) {
+    if (*shadow_p != SHADOW_SCALE) {
+      return 0;
+    }
+    left -= SHADOW_SCALE;
+  }
+  
+  /* the last shadow byte needs to hold the rest */
+  return (*shadow_p <= SHADOW_SCALE && *shadow_p >= left);
+#else
+  return 0;
+#endif
+}
+
 /*
  * int _dmalloc_chunk_pnt_check
  *
@@ -2120,14 +3211,23 @@ int	_dmalloc_chunk_heap_check(void)
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * shared_b -> Set to 1 if the library lock is only held shared with
+ * other readers.  Nothing is logged so on a 0 return the caller
+ * should make the call again under the exclusive lock to report it.
  */
 int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
 				 const int exact_b, const int strlen_b,
-				 const int min_size)
+				 const int min_size, const int shared_b)
 {
   skip_alloc_t	*slot_p;
+  int		error;
+#if PNT_CHECK_CACHE_SIZE > 0
+  pnt_cache_t	*cache_p;
+  pnt_info_t	pnt_info;
+#endif
   
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+  if ((! shared_b) && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
     if (func == NULL) {
       dmalloc_message("checking pointer '%p'", user_pnt);
     }
@@ -2136,11 +3236,32 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
     }
   }
   
-  /* try to find the address */
-  slot_p = find_address(user_pnt, 0 /* used list */, 0 /* not exact pointer */,
-			skip_update);
+#if PNT_CHECK_CACHE_SIZE > 0
+  /* have we checked this allocation since the last free or realloc? */
+  for (cache_p = pnt_cache;
+       cache_p < pnt_cache + PNT_CHECK_CACHE_SIZE;
+       cache_p++) {
+    if (cache_p->pc_generation == heap_generation
+	&& (char *)user_pnt >= cache_p->pc_user_start
+	&& (char *)user_pnt < cache_p->pc_user_bounds
+	&& ((! exact_b) || (char *)user_pnt == cache_p->pc_user_start)) {
+      if (check_pnt_size(user_pnt, cache_p->pc_user_bounds, strlen_b,
+			 min_size) == DMALLOC_ERROR_NONE) {
+	return 1;
+      }
+      /* go the long way around so the problem gets reported */
+      break;
+    }
+  }
+#endif
+  
+  /* try to find the address, we only look so we need no update slots */
+  slot_p = find_used_address(user_pnt, 0 /* not exact pointer */, NULL);
   if (slot_p == NULL) {
     if (exact_b) {
+      if (shared_b) {
+	return 0;
+      }
       dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
       log_error_info(NULL, 0, user_pnt, NULL, "pointer-check", func);
       return 0;
@@ -2151,26 +3272,45 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
   }
   
   /* now make sure that the user slot is valid */
-  if (! check_used_slot(slot_p, user_pnt, exact_b, strlen_b, min_size)) {
-    /* dmalloc_error set in check_used_slot */
+  error = used_slot_error(slot_p, user_pnt, exact_b, strlen_b, min_size);
+  if (error != DMALLOC_ERROR_NONE) {
+    /* the shared readers leave the errno to the exclusive call */
+    if (shared_b) {
+      return 0;
+    }
+    dmalloc_errno = error;
     log_error_info(NULL, 0, user_pnt, slot_p, "pointer-check", func);
     return 0;
   }
   
+#if PNT_CHECK_CACHE_SIZE > 0
+  /* remember the allocation in place of the oldest entry */
+  get_pnt_info(slot_p, &pnt_info);
+  cache_p = pnt_cache + pnt_cache_next;
+  cache_p->pc_user_start = pnt_info.pi_user_start;
+  cache_p->pc_user_bounds = pnt_info.pi_user_bounds;
+  cache_p->pc_generation = heap_generation;
+  pnt_cache_next = (pnt_cache_next + 1) % PNT_CHECK_CACHE_SIZE;
+#endif
+  
   return 1;
 }
 
 /************************** low-level user functions *************************/
 
 /*
- * void *_dmalloc_chunk_malloc
+ * static void *chunk_malloc
  *
- * Allocate a chunk of memory.
+ * Allocate a chunk of memory.  This is expanded for each of the
+ * hot-path flag combinations so the tests of the flags that are off
+ * can be compiled out.
  *
  * Returns a valid pointer on success or NULL on failure.
  *
  * ARGUMENTS:
  *
+ * flags -> Debug flags that we are running with.
+ *
  * file -> File-name or return-address location of the allocation.
  *
  * line -> Line-number location of the allocation.
@@ -2182,36 +3322,43 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
  * alignment -> If greater than 0 then try to align the returned
  * block.
  */
-void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
-			       const unsigned long size, const int func_id,
-			       const unsigned int alignment)
+static	HOT_PATH_INLINE	void	*chunk_malloc(const unsigned int flags,
+					      const char *file,
+					      const unsigned int line,
+					      const unsigned long size,
+					      const int func_id,
+					      const unsigned int alignment)
 {
   unsigned long	needed_size;
   int		valloc_b = 0, fence_b = 0;
+  unsigned int	align_shift = 0;
   char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
   skip_alloc_t	*slot_p;
   pnt_info_t	pnt_info;
   const char	*trans_log;
-  
-  // TOTO: is alignment used here appropriately?
+  unsigned long	*counts = thread_counts();
   
   /* counts calls to malloc */
   if (func_id == DMALLOC_FUNC_CALLOC) {
-    func_calloc_c++;
+    counts[STAT_CALLOC]++;
   }
   else if (alignment == BLOCK_SIZE) {
-    func_valloc_c++;
+    counts[STAT_VALLOC]++;
     valloc_b = 1;
   }
   else if (alignment > 0) {
-    func_memalign_c++;
+    counts[STAT_MEMALIGN]++;
+    /* the alignments are powers of two checked in dmalloc_malloc */
+    while ((1U << align_shift) < alignment) {
+      align_shift++;
+    }
   }
   else if (func_id == DMALLOC_FUNC_NEW) {
-    func_new_c++;
+    counts[STAT_NEW]++;
   }
   else if (func_id != DMALLOC_FUNC_REALLOC
 	   && func_id != DMALLOC_FUNC_RECALLOC) {
-    func_malloc_c++;
+    counts[STAT_MALLOC]++;
   }
   
 #if ALLOW_ALLOC_ZERO_SIZE == 0
@@ -2235,7 +3382,7 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   needed_size = size;
   
   /* adjust the size */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FENCE)) {
+  if (BIT_IS_SET(flags, DMALLOC_DEBUG_CHECK_FENCE)) {
     needed_size += FENCE_OVERHEAD_SIZE;
     fence_b = 1;
     
@@ -2247,6 +3394,13 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
     if (valloc_b) {
       needed_size += BLOCK_SIZE;
     }
+    /*
+     * Divided slots are aligned to their own size so we push the user
+     * pointer up a full alignment to have room for the bottom fence.
+     */
+    else if (align_shift > 0) {
+      needed_size += (1UL << align_shift) - FENCE_BOTTOM_SIZE;
+    }
   }
   else if (valloc_b && needed_size <= BLOCK_SIZE / 2) {
     /*
@@ -2256,6 +3410,30 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
      */
     needed_size = BLOCK_SIZE;
   }
+  else if (align_shift > BASIC_BLOCK) {
+    /* room to push the user pointer up from a block to the alignment */
+    needed_size += (1UL << align_shift) - BLOCK_SIZE;
+  }
+  else if (needed_size < (1UL << align_shift)) {
+    /* a slot at least as large as the alignment is aligned to it */
+    needed_size = 1UL << align_shift;
+  }
+  
+  /* the alignment space must not wrap around */
+  if (needed_size < size) {
+    dmalloc_errno = DMALLOC_ERROR_TOO_BIG;
+    log_error_info(file, line, NULL, NULL, "allocation too big", "malloc");
+    return MALLOC_ERROR;
+  }
+  
+  /* only the power-of-two size classes are aligned to their size */
+  if (align_shift > 0 && needed_size <= BLOCK_SIZE / 2) {
+    unsigned long	pow2_size;
+    
+    for (pow2_size = 1; pow2_size < needed_size; pow2_size <<= 1) {
+    }
+    needed_size = pow2_size;
+  }
   
   /* get some space for our memory */
   slot_p = get_memory(needed_size);
@@ -2269,7 +3447,9 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   if (valloc_b) {
     BIT_SET(slot_p->sa_flags, ALLOC_FLAG_VALLOC);
   }
+  slot_p->sa_align_shift = align_shift;
   slot_p->sa_user_size = size;
+  count_class(slot_p, size, 1);
   
   /* initialize the bblocks */
   alloc_cur_given += slot_p->sa_total_size;
@@ -2278,7 +3458,7 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   get_pnt_info(slot_p, &pnt_info);
   
   /* clear the allocation */
-  clear_alloc(slot_p, &pnt_info, 0 /* no old-size */, func_id);
+  clear_alloc(slot_p, &pnt_info, 0 /* no old-size */, func_id, flags);
   
   slot_p->sa_file = file;
   slot_p->sa_line = line;
@@ -2289,8 +3469,17 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
 #if LOG_PNT_ITERATION
   slot_p->sa_iteration = _dmalloc_iter_c;
 #endif
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ELAPSED_TIME)
-      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_CURRENT_TIME)) {
+#if LIFETIME_BUCKETS > 0
+  slot_p->sa_alloc_iter = _dmalloc_iter_c;
+#endif
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+  slot_p->sa_alloc_nsec = lifetime_nsec();
+#endif
+#if REALLOC_TOP_LOG > 0
+  slot_p->sa_realloc_c = 0;
+#endif
+  if (BIT_IS_SET(flags, DMALLOC_DEBUG_LOG_ELAPSED_TIME)
+      || BIT_IS_SET(flags, DMALLOC_DEBUG_LOG_CURRENT_TIME)) {
 #if LOG_PNT_TIMEVAL
     GET_TIMEVAL(slot_p->sa_timeval);
 #else
@@ -2305,7 +3494,7 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
 #endif
   
   /* do we need to print transaction info? */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+  if (BIT_IS_SET(flags, DMALLOC_DEBUG_LOG_TRANS)) {
     switch (func_id) {
     case DMALLOC_FUNC_CALLOC:
       trans_log = "calloc";
@@ -2335,26 +3524,33 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   /* monitor current allocation level */
   alloc_current += size;
   alloc_maximum = MAX(alloc_maximum, alloc_current);
-  _dmalloc_alloc_total += size;
+  counts[STAT_ALLOC_BYTES] += size;
   alloc_one_max = MAX(alloc_one_max, size);
   
   /* monitor pointer usage */
   alloc_cur_pnts++;
   alloc_max_pnts = MAX(alloc_max_pnts, alloc_cur_pnts);
-  alloc_tot_pnts++;
+  counts[STAT_ALLOC_PNTS]++;
+  
+#if HEAP_SHADOW_MAP
+  shadow_set(slot_p, &pnt_info);
+#endif
   
   return pnt_info.pi_user_start;
 }
 
 /*
- * int _dmalloc_chunk_free
+ * static int chunk_free
  *
- * Free a user pointer from the heap.
+ * Free a user pointer from the heap.  This is expanded for each of
+ * the hot-path flag combinations like chunk_malloc.
  *
  * Returns FREE_NOERROR on success or FREE_ERROR on failure
  *
  * ARGUMENTS:
  *
+ * flags -> Debug flags that we are running with.
+ *
  * file -> File-name or return-address location of the allocation.
  *
  * line -> Line-number location of the allocation.
@@ -2362,24 +3558,31 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
  * user_pnt -> Pointer we are freeing.
  *
  * func_id -> Function ID
+ *
+ * found_p -> Used slot of the pointer if the caller has already found
+ * it with skip_update filled in, or NULL to look it up here.
  */
-int	_dmalloc_chunk_free(const char *file, const unsigned int line,
-			    void *user_pnt, const int func_id)
+static	HOT_PATH_INLINE	int	chunk_free(const unsigned int flags,
+					   const char *file,
+					   const unsigned int line,
+					   void *user_pnt, const int func_id,
+					   skip_alloc_t *found_p)
 {
   char		where_buf[MAX_FILE_LENGTH + 64];
   char		where_buf2[MAX_FILE_LENGTH + 64], disp_buf[64];
   skip_alloc_t	*slot_p, *update_p;
+  int		large_b, moved_b;
   
   /* counts calls to free */
   if (func_id == DMALLOC_FUNC_DELETE) {
-    func_delete_c++;
+    thread_counts()[STAT_DELETE]++;
   }
   else if (func_id == DMALLOC_FUNC_REALLOC
 	   || func_id == DMALLOC_FUNC_RECALLOC) {
     /* ignore these because they will alredy be accounted for in realloc */
   }
   else {
-    func_free_c++;
+    thread_counts()[STAT_FREE]++;
   }
   
   if (user_pnt == NULL) {
@@ -2396,7 +3599,7 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
      * runtime token in case people want to turn it on or off at
      * runtime.
      */
-    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_ERROR_FREE_NULL)) {
+    if (BIT_IS_SET(flags, DMALLOC_DEBUG_ERROR_FREE_NULL)) {
       dmalloc_errno = DMALLOC_ERROR_IS_NULL;
       log_error_info(file, line, user_pnt, NULL, "invalid 0L pointer", "free");
       return FREE_ERROR;
@@ -2410,9 +3613,38 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
   
   update_p = skip_update;
   
-  /* try to find the address with loose match */
-  slot_p = find_address(user_pnt, 0 /* used list */, 0 /* not exact pointer */,
-			skip_update);
+  if (found_p != NULL) {
+    slot_p = found_p;
+  }
+  else {
+    /* try to find the address with loose match */
+    slot_p = find_used_address(user_pnt, 0 /* not exact pointer */,
+			       skip_update);
+  }
+#if HEAP_LARGE_OBJECTS
+  if (slot_p == NULL) {
+    /* freed large objects have been unmapped but we still know them */
+    slot_p = find_large(user_pnt, 0 /* not exact pointer */, NULL);
+    if (slot_p != NULL && _dmalloc_heap_mapped(user_pnt)) {
+      /* someone else has mapped the region so the object is gone */
+      drop_large(slot_p);
+      slot_p = NULL;
+    }
+    if (slot_p != NULL) {
+      pnt_info_t	info;
+      get_pnt_info(slot_p, &info);
+      if (info.pi_user_start == user_pnt) {
+	dmalloc_errno = DMALLOC_ERROR_ALREADY_FREE;
+      }
+      else {
+	dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
+      }
+      log_error_info(file, line, user_pnt, NULL, "finding address in heap",
+		     "free");
+      return FREE_ERROR;
+    }
+  }
+#endif
   if (slot_p == NULL) {
 #if FREED_POINTER_DELAY
     skip_alloc_t	*del_p;
@@ -2460,10 +3692,16 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
     return FREE_ERROR;
   }
   
-  if (! remove_slot(slot_p, update_p)) {
+  /* large objects stay on their list so we can see them freed again */
+  large_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE);
+  moved_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_MOVED);
+  if ((! large_b) && (! remove_slot(slot_p, update_p))) {
     /* error set and dumped in remove_slot */
     return FREE_ERROR;
   }
+#if HEAP_SHADOW_MAP
+  shadow_set(slot_p, NULL);
+#endif
   if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FENCE)) {
     /*
      * We need to preserve the fence-post flag because we may need to
@@ -2474,17 +3712,49 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
   else {
     slot_p->sa_flags = ALLOC_FLAG_FREE;
   }
+  if (large_b) {
+    BIT_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE);
+  }
   
   alloc_cur_pnts--;
   
+#if MEMORY_TABLE_TOP_LOG
+  if (moved_b) {
+    /* the allocation lives on where realloc moved it */
+    _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
+			  slot_p->sa_user_size);
+  }
+  else {
+    _dmalloc_table_free(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
+			slot_p->sa_user_size,
+#if LIFETIME_BUCKETS > 0
+			_dmalloc_iter_c - slot_p->sa_alloc_iter,
+#else
+			0,
+#endif
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+			lifetime_nsec() - slot_p->sa_alloc_nsec
+#else
+			0
+#endif
+			);
+  }
+#if REALLOC_TOP_LOG > 0
+  if (slot_p->sa_realloc_c > 0) {
+    _dmalloc_table_realloc_final(&mem_table_alloc, slot_p->sa_file,
+				 slot_p->sa_line, slot_p->sa_user_size);
+  }
+#endif
+#endif
+  
   slot_p->sa_use_iter = _dmalloc_iter_c;
 #if LOG_PNT_SEEN_COUNT
   slot_p->sa_seen_c++;
 #endif
   
   /* do we need to print transaction info? */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
-    dmalloc_message("*** free: at '%s' pnt '%s': size %u, alloced at '%s'",
+  if (BIT_IS_SET(flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    dmalloc_message("*** free: at '%s' pnt '%s': size %lu, alloced at '%s'",
 		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf), file,
 					    line),
 		    display_pnt(user_pnt, slot_p, disp_buf, sizeof(disp_buf)),
@@ -2493,23 +3763,32 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
 					    slot_p->sa_file, slot_p->sa_line));
   }
   
-#if MEMORY_TABLE_TOP_LOG
-  _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
-			slot_p->sa_user_size);
-#endif
-  
-  /* update the file/line -- must be after _dmalloc_table_delete */
+  /* update the file/line -- must be after _dmalloc_table_free */
   slot_p->sa_file = file;
   slot_p->sa_line = line;
   
   /* monitor current allocation level */
   alloc_current -= slot_p->sa_user_size;
   alloc_cur_given -= slot_p->sa_total_size;
+  count_class(slot_p, -(long)slot_p->sa_user_size, -1);
+  
+#if HEAP_LARGE_OBJECTS
+  /* large objects go straight back to the system */
+  if (large_b) {
+    _dmalloc_heap_unmap(slot_p->sa_mem, slot_p->sa_total_size);
+    large_object_c--;
+    large_space_bytes -= slot_p->sa_total_size;
+    large_freed_c++;
+    trim_large();
+    return FREE_NOERROR;
+  }
+#endif
+  
   free_space_bytes += slot_p->sa_total_size;
   
   /* clear the memory */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_FREE_BLANK)
-      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_BLANK)) {
+  if (BIT_IS_SET(flags, DMALLOC_DEBUG_FREE_BLANK)
+      || BIT_IS_SET(flags, DMALLOC_DEBUG_CHECK_BLANK)) {
     memset(slot_p->sa_mem, FREE_BLANK_CHAR, slot_p->sa_total_size);
     /* set our slot blank flag */
     BIT_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK);
@@ -2528,7 +3807,7 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
    * because we are encorporating in this newly freed block.
    */
   
-  if (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_NEVER_REUSE)) {
+  if (! BIT_IS_SET(flags, DMALLOC_DEBUG_NEVER_REUSE)) {
 #if FREED_POINTER_DELAY
     slot_p->sa_next_p[0] = NULL;
     if (free_wait_list_head == NULL) {
@@ -2547,541 +3826,3035 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
 #endif
   }
   
+#if PURGE_FREE_THRESHOLD > 0
+  /* give back the pages of old free blocks if too many are resident */
+  if (free_space_bytes - purged_space_bytes >= PURGE_FREE_THRESHOLD
+      && _dmalloc_iter_c >= purge_iter + PURGE_FREE_AGE) {
+    purge_iter = _dmalloc_iter_c;
+    (void)purge_free(PURGE_FREE_AGE);
+  }
+#endif
+  
   return FREE_NOERROR;
 }
 
 /*
- * void *_dmalloc_chunk_realloc
+ * Expand the malloc and free paths for a constant set of debug flags
+ * so the compiler can drop the tests for the flags which are off.
+ */
+#define HOT_PATH(name, hot_flags)					\
+static	void	*name ## _malloc(const char *file, const unsigned int line, \
+				 const unsigned long size,		\
+				 const int func_id,			\
+				 const unsigned int alignment)		\
+{									\
+  return chunk_malloc(hot_flags, file, line, size, func_id, alignment);	\
+}									\
+static	int	name ## _free(const char *file, const unsigned int line, \
+			      void *user_pnt, const int func_id,	\
+			      skip_alloc_t *found_p)			\
+{									\
+  return chunk_free(hot_flags, file, line, user_pnt, func_id, found_p); \
+}
+
+HOT_PATH(hot_none, 0)
+HOT_PATH(hot_runtime, HOT_RUNTIME_FLAGS)
+HOT_PATH(hot_low, HOT_LOW_FLAGS)
+HOT_PATH(hot_high, HOT_HIGH_FLAGS)
+/* any other combination tests the flags as it goes */
+HOT_PATH(hot_any, _dmalloc_flags)
+
+/* the specialized paths, ended by a NULL entry */
+static	const hot_path_t	hot_paths[] = {
+  { 0,			hot_none_malloc,	hot_none_free },
+  { HOT_RUNTIME_FLAGS,	hot_runtime_malloc,	hot_runtime_free },
+  { HOT_LOW_FLAGS,	hot_low_malloc,		hot_low_free },
+  { HOT_HIGH_FLAGS,	hot_high_malloc,	hot_high_free },
+  { 0,			NULL,			NULL }
+};
+static	const hot_path_t	hot_path_any = {
+  0, hot_any_malloc, hot_any_free
+};
+
+/* current path which is swapped when the flags change */
+static	const hot_path_t	*hot_path_p = &hot_path_any;
+
+/*
+ * static const hot_path_t *find_hot_path
  *
- * Re-allocate a chunk of memory either shrinking or expanding it.
+ * Find the specialized malloc and free paths for a set of debug
+ * flags.
  *
- * Returns a valid pointer on success of NULL on failure.
+ * Returns the paths or NULL if there are none for the flags.
  *
  * ARGUMENTS:
  *
- * file -> File-name or return-address location of the allocation.
- *
- * line -> Line-number location of the allocation.
- *
- * old_user_pnt -> Old user pointer that we are reallocating.
- *
+ * flags -> Debug flags the paths must be built for.
+ */
+static	const hot_path_t	*find_hot_path(const unsigned int flags)
+{
+  const hot_path_t	*path_p;
+  
+  for (path_p = hot_paths; path_p->hp_malloc != NULL; path_p++) {
+    if (path_p->hp_flags == (flags & HOT_PATH_FLAGS)) {
+      return path_p;
+    }
+  }
+  return NULL;
+}
+
+/* malloc and free with debug flags which are not the current ones */
+static	void	*flags_malloc(const unsigned int flags, const char *file,
+			      const unsigned int line,
+			      const unsigned long size, const int func_id,
+			      const unsigned int alignment)
+{
+  return chunk_malloc(flags, file, line, size, func_id, alignment);
+}
+
+static	int	flags_free(const unsigned int flags, const char *file,
+			   const unsigned int line, void *user_pnt,
+			   const int func_id, skip_alloc_t *found_p)
+{
+  return chunk_free(flags, file, line, user_pnt, func_id, found_p);
+}
+
+/*
+ * void _dmalloc_chunk_flags_changed
+ *
+ * Select the malloc and free paths which match the current debug
+ * flags.  This must be called whenever _dmalloc_flags is changed.
+ */
+void	_dmalloc_chunk_flags_changed(void)
+{
+  const hot_path_t	*path_p;
+  
+  path_p = find_hot_path(_dmalloc_flags);
+  if (path_p == NULL) {
+    path_p = &hot_path_any;
+  }
+  
+  /* a single pointer store so callers see either the old or new path */
+  hot_path_p = path_p;
+}
+
+#if MAX_POLICIES > 0
+/*
+ * static int policy_file_match
+ *
+ * Does the allocation FILE end in the policy's POL_FILE at a
+ * directory boundary?  Returns 1 if so else 0.
+ */
+static	int	policy_file_match(const char *file, const char *pol_file)
+{
+  int	file_len, pol_len;
+  
+  file_len = strlen(file);
+  pol_len = strlen(pol_file);
+  if (pol_len > file_len
+      || strcmp(file + file_len - pol_len, pol_file) != 0) {
+    return 0;
+  }
+  return (pol_len == file_len || file[file_len - pol_len - 1] == '/');
+}
+
+/*
+ * static unsigned int policy_flags
+ *
+ * Find the debug flags which the policies add to an allocation.
+ *
+ * Returns the flags of all of the policies which match or 0 if none.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * size -> User size of the allocation.
+ */
+static	unsigned int	policy_flags(const char *file, const unsigned int line,
+				     const unsigned long size)
+{
+  const policy_t	*pol_p, *bounds_p;
+  unsigned int		flags = 0;
+  
+  bounds_p = policies + policy_n;
+  for (pol_p = policies; pol_p < bounds_p; pol_p++) {
+    switch (pol_p->po_match) {
+      
+    case POLICY_MATCH_SIZE:
+      if (size >= pol_p->po_low && size <= pol_p->po_high) {
+	flags |= pol_p->po_flags;
+      }
+      break;
+      
+    case POLICY_MATCH_RA:
+      if (line == 0
+	  && (unsigned long)file >= pol_p->po_low
+	  && (unsigned long)file <= pol_p->po_high) {
+	flags |= pol_p->po_flags;
+      }
+      break;
+      
+    case POLICY_MATCH_FILE:
+      if (line != 0 && file != NULL
+	  && (pol_p->po_line == 0 || pol_p->po_line == line)
+	  && policy_file_match(file, pol_p->po_file)) {
+	flags |= pol_p->po_flags;
+      }
+      break;
+      
+    default:
+      break;
+    }
+  }
+  
+  return flags & POLICY_FLAGS;
+}
+#endif /* if MAX_POLICIES > 0 */
+
+/*
+ * void _dmalloc_chunk_policies
+ *
+ * Set the debug policies from the environment.  Policies which cannot
+ * be parsed are logged and skipped.
+ *
+ * ARGUMENTS:
+ *
+ * policy_str -> Policies separated by POLICY_SEP_CHAR or NULL for
+ * none.
+ */
+void	_dmalloc_chunk_policies(const char *policy_str)
+{
+#if MAX_POLICIES > 0
+  const char	*pol_p, *end_p;
+  char		buf[256];
+  int		len;
+  
+  policy_n = 0;
+  if (policy_str == NULL) {
+    return;
+  }
+  
+  for (pol_p = policy_str; *pol_p != '\0'; pol_p = end_p) {
+    for (end_p = pol_p; *end_p != '\0' && *end_p != POLICY_SEP_CHAR;
+	 end_p++) {
+    }
+    len = end_p - pol_p;
+    if (*end_p == POLICY_SEP_CHAR) {
+      end_p++;
+    }
+    if (len == 0) {
+      continue;
+    }
+    if (len >= (int)sizeof(buf)) {
+      len = sizeof(buf) - 1;
+    }
+    (void)memcpy(buf, pol_p, len);
+    buf[len] = '\0';
+    
+    if (policy_n >= MAX_POLICIES) {
+      dmalloc_message("WARNING: ignoring policy '%s', over MAX_POLICIES %d",
+		      buf, MAX_POLICIES);
+      continue;
+    }
+    if (! _dmalloc_policy_break(buf, policies + policy_n)) {
+      dmalloc_message("WARNING: ignoring bad policy '%s'", buf);
+      continue;
+    }
+    if ((policies[policy_n].po_flags & POLICY_FLAGS)
+	!= policies[policy_n].po_flags) {
+      dmalloc_message("WARNING: policy '%s' can only add flags %#x",
+		      buf, POLICY_FLAGS);
+    }
+    policy_n++;
+  }
+#endif
+}
+
+/*
+ * void _dmalloc_chunk_size_classes
+ *
+ * Set the size classes of the divided blocks from the environment.
+ * The classes cannot change once blocks have been cut into slots so
+ * a change after that is logged and ignored.
+ *
+ * ARGUMENTS:
+ *
+ * classes_str -> Sizes of the classes separated by CLASS_SEP_CHAR or
+ * NULL for the default classes.
+ */
+void	_dmalloc_chunk_size_classes(const char *classes_str)
+{
+  static char	classes_buf[1024] = "";
+  
+  /* the environment is processed again so only act on a change */
+  if (classes_str == NULL) {
+    classes_str = "";
+  }
+  if (size_class_n > 0 && strcmp(classes_buf, classes_str) == 0) {
+    return;
+  }
+  if (size_classes_fixed_b) {
+    dmalloc_message("WARNING: size classes cannot change once in use");
+    return;
+  }
+  
+  (void)loc_snprintf(classes_buf, sizeof(classes_buf), "%s", classes_str);
+  build_classes(classes_buf[0] == '\0' ? NULL : classes_buf);
+}
+
+/*
+ * void *_dmalloc_chunk_malloc
+ *
+ * Allocate a chunk of memory.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * size -> Number of bytes to allocate.
+ *
+ * func_id -> Calling function-id as defined in dmalloc.h.
+ *
+ * alignment -> If greater than 0 then try to align the returned
+ * block.
+ */
+void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
+			       const unsigned long size, const int func_id,
+			       const unsigned int alignment)
+{
+#if MAX_POLICIES > 0
+  unsigned int	pol_flags;
+  
+  if (policy_n > 0) {
+    pol_flags = policy_flags(file, line, size);
+    if (pol_flags != 0) {
+      return flags_malloc(_dmalloc_flags | pol_flags, file, line, size,
+			  func_id, alignment);
+    }
+  }
+#endif
+  return hot_path_p->hp_malloc(file, line, size, func_id, alignment);
+}
+
+/*
+ * int _dmalloc_chunk_free
+ *
+ * Free a user pointer from the heap.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * user_pnt -> Pointer we are freeing.
+ *
+ * func_id -> Function ID
+ */
+int	_dmalloc_chunk_free(const char *file, const unsigned int line,
+			    void *user_pnt, const int func_id)
+{
+#if MAX_POLICIES > 0
+  skip_alloc_t	*slot_p;
+  unsigned int	pol_flags;
+#endif
+  
+#if PNT_CHECK_CACHE_SIZE > 0
+  /* the pointer checks may have cached this allocation */
+  heap_generation++;
+#endif
+#if MAX_POLICIES > 0
+  /*
+   * Match the policies against the allocation, not the free, so the
+   * checks which the malloc set up are also done here.  The slot is
+   * handed to the free so the pointer is only looked up once.
+   */
+  if (policy_n > 0 && user_pnt != NULL) {
+    slot_p = find_used_address(user_pnt, 0 /* not exact */, skip_update);
+    if (slot_p != NULL) {
+      pol_flags = policy_flags(slot_p->sa_file, slot_p->sa_line,
+			       slot_p->sa_user_size);
+      if (pol_flags != 0) {
+	return flags_free(_dmalloc_flags | pol_flags, file, line, user_pnt,
+			  func_id, slot_p);
+      }
+      return hot_path_p->hp_free(file, line, user_pnt, func_id, slot_p);
+    }
+  }
+#endif
+  return hot_path_p->hp_free(file, line, user_pnt, func_id, NULL);
+}
+
+/*
+ * static void *batch_malloc
+ *
+ * Allocate one of the pointers of a batch.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path_p -> Paths for the batch flags or NULL if there are none.
+ *
+ * flags -> Debug flags of the batch.
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * size -> Number of bytes to allocate.
+ */
+static	void	*batch_malloc(const hot_path_t *path_p, const unsigned int flags,
+			      const char *file, const unsigned int line,
+			      const unsigned long size)
+{
+#if MAX_POLICIES > 0
+  unsigned int	pol_flags;
+  
+  if (policy_n > 0) {
+    pol_flags = policy_flags(file, line, size) & ~DMALLOC_DEBUG_LOG_TRANS;
+    if (pol_flags != 0) {
+      return flags_malloc(flags | pol_flags, file, line, size,
+			  DMALLOC_FUNC_MALLOC, 0 /* no alignment */);
+    }
+  }
+#endif
+  if (path_p == NULL) {
+    return flags_malloc(flags, file, line, size, DMALLOC_FUNC_MALLOC,
+			0 /* no alignment */);
+  }
+  return path_p->hp_malloc(file, line, size, DMALLOC_FUNC_MALLOC,
+			   0 /* no alignment */);
+}
+
+/*
+ * static int batch_free
+ *
+ * Free one of the pointers of a batch.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure
+ *
+ * ARGUMENTS:
+ *
+ * path_p -> Paths for the batch flags or NULL if there are none.
+ *
+ * flags -> Debug flags of the batch.
+ *
+ * file -> File-name or return-address location of the free.
+ *
+ * line -> Line-number location of the free.
+ *
+ * user_pnt -> Pointer we are freeing.
+ *
+ * found_p -> Used slot of the pointer that the batch has found with
+ * skip_update filled in, or NULL if it was not found.
+ */
+static	int	batch_free(const hot_path_t *path_p, const unsigned int flags,
+			   const char *file, const unsigned int line,
+			   void *user_pnt, skip_alloc_t *found_p)
+{
+#if MAX_POLICIES > 0
+  unsigned int	pol_flags;
+  
+  if (policy_n > 0 && found_p != NULL) {
+    pol_flags = policy_flags(found_p->sa_file, found_p->sa_line,
+			     found_p->sa_user_size)
+      & ~DMALLOC_DEBUG_LOG_TRANS;
+    if (pol_flags != 0) {
+      return flags_free(flags | pol_flags, file, line, user_pnt,
+			DMALLOC_FUNC_FREE, found_p);
+    }
+  }
+#endif
+  if (path_p == NULL) {
+    return flags_free(flags, file, line, user_pnt, DMALLOC_FUNC_FREE,
+		      found_p);
+  }
+  return path_p->hp_free(file, line, user_pnt, DMALLOC_FUNC_FREE, found_p);
+}
+
+/*
+ * int _dmalloc_chunk_malloc_batch
+ *
+ * Allocate a number of chunks of memory for one caller.  With the
+ * log-trans token the batch is logged as one transaction.
+ *
+ * Returns 1 on success or 0 on failure in which case the pointers
+ * which were allocated have been freed and all of PNTS are NULL.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * sizes -> Number of bytes to allocate for each pointer.
+ *
+ * pnts <- Array of PNT_N pointers that we are allocating.
+ *
+ * pnt_n -> Number of pointers to allocate.
+ */
+int	_dmalloc_chunk_malloc_batch(const char *file, const unsigned int line,
+				    const DMALLOC_SIZE *sizes, void **pnts,
+				    const int pnt_n)
+{
+  const hot_path_t	*path_p;
+  unsigned int		flags;
+  unsigned long		total = 0;
+  int			pnt_c, free_c;
+  char			where_buf[MAX_FILE_LENGTH + 64];
+  
+  /* the specialized paths are looked up once for the batch */
+  flags = _dmalloc_flags & ~DMALLOC_DEBUG_LOG_TRANS;
+  path_p = find_hot_path(flags);
+  
+  for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+    pnts[pnt_c] = batch_malloc(path_p, flags, file, line, sizes[pnt_c]);
+    if (pnts[pnt_c] == NULL) {
+      break;
+    }
+    total += sizes[pnt_c];
+  }
+  
+  /* the batch is all or nothing */
+  if (pnt_c < pnt_n) {
+    for (free_c = 0; free_c < pnt_c; free_c++) {
+      (void)batch_free(path_p, flags, file, line, pnts[free_c],
+		       find_used_address(pnts[free_c], 0 /* not exact */,
+					 skip_update));
+    }
+    for (free_c = 0; free_c < pnt_n; free_c++) {
+      pnts[free_c] = NULL;
+    }
+    return 0;
+  }
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    dmalloc_message("*** batch alloc: at '%s' for %d pointers, %lu bytes",
+		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					    file, line),
+		    pnt_n, total);
+  }
+  
+  return 1;
+}
+
+/*
+ * int _dmalloc_chunk_free_batch
+ *
+ * Free a number of user pointers from the heap.  They are freed in
+ * address order so each search of the used list starts where the one
+ * for the pointer before it went down the levels.  With the log-trans
+ * token the batch is logged as one transaction.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR if any of the
+ * pointers could not be freed.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the free.
+ *
+ * line -> Line-number location of the free.
+ *
+ * pnts -> Array of PNT_N pointers we are freeing.  NULL entries are
+ * skipped.
+ *
+ * pnt_n -> Number of pointers in PNTS.
+ *
+ * free_np <- Set to the number of pointers which were freed.
+ */
+int	_dmalloc_chunk_free_batch(const char *file, const unsigned int line,
+				  void * const *pnts, const int pnt_n,
+				  int *free_np)
+{
+  const hot_path_t	*path_p;
+  unsigned int		flags;
+  void			*sorted[FREE_BATCH_SORT], *pnt;
+  skip_alloc_t		*slot_p, *start_p;
+  int			start_c, sort_n, pnt_c, ins_c, free_n = 0;
+  int			ret = FREE_NOERROR;
+  char			where_buf[MAX_FILE_LENGTH + 64];
+  
+#if PNT_CHECK_CACHE_SIZE > 0
+  /* the pointer checks may have cached these allocations */
+  heap_generation++;
+#endif
+  
+  flags = _dmalloc_flags & ~DMALLOC_DEBUG_LOG_TRANS;
+  path_p = find_hot_path(flags);
+  
+  for (start_c = 0; start_c < pnt_n; start_c += FREE_BATCH_SORT) {
+    
+    /* insertion sort the next group of pointers by address */
+    sort_n = 0;
+    for (pnt_c = start_c; pnt_c < pnt_n && pnt_c < start_c + FREE_BATCH_SORT;
+	 pnt_c++) {
+      pnt = pnts[pnt_c];
+      if (pnt == NULL) {
+	continue;
+      }
+      for (ins_c = sort_n;
+	   ins_c > 0 && (char *)sorted[ins_c - 1] > (char *)pnt;
+	   ins_c--) {
+	sorted[ins_c] = sorted[ins_c - 1];
+      }
+      sorted[ins_c] = pnt;
+      sort_n++;
+    }
+    
+    start_p = NULL;
+    for (pnt_c = 0; pnt_c < sort_n; pnt_c++) {
+      slot_p = find_address_from(sorted[pnt_c], skip_address_list,
+				 0 /* not exact */, start_p, skip_update);
+      if (slot_p != NULL) {
+	/* the free only removes this slot so its links stay good */
+	memcpy(batch_update->sa_next_p, skip_update->sa_next_p,
+	       sizeof(skip_alloc_t *) * MAX_SKIP_LEVEL);
+	start_p = batch_update;
+      }
+      if (batch_free(path_p, flags, file, line, sorted[pnt_c], slot_p)
+	  == FREE_NOERROR) {
+	free_n++;
+      }
+      else {
+	ret = FREE_ERROR;
+      }
+    }
+  }
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    dmalloc_message("*** batch free: at '%s' for %d pointers",
+		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					    file, line),
+		    free_n);
+  }
+  
+  SET_POINTER(free_np, free_n);
+  return ret;
+}
+
+/*
+ * int _dmalloc_chunk_size_check
+ *
+ * Check that the size handed to a sized free, such as C++'s sized
+ * delete, matches the size of the allocation.  Pointers which are not
+ * found are left to the free routines to report.
+ *
+ * Returns 1 if the size matches else 0 on a mismatch.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the free.
+ *
+ * line -> Line-number location of the free.
+ *
+ * user_pnt -> Pointer we are about to free.
+ *
+ * size -> Size in bytes that the caller thinks was allocated.
+ *
+ * where -> What routine is calling the check.
+ */
+int	_dmalloc_chunk_size_check(const char *file, const unsigned int line,
+				  const void *user_pnt,
+				  const unsigned long size, const char *where)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  
+  slot_p = find_used_address(user_pnt, 0 /* not exact pointer */,
+			     NULL /* no update */);
+  if (slot_p == NULL) {
+    return 1;
+  }
+  get_pnt_info(slot_p, &pnt_info);
+  if (pnt_info.pi_user_start != user_pnt || slot_p->sa_user_size == size) {
+    return 1;
+  }
+  
+  dmalloc_errno = DMALLOC_ERROR_BAD_FREE_SIZE;
+  log_error_info(file, line, user_pnt, slot_p, "checking size of freed pointer",
+		 where);
+  return 0;
+}
+
+/*
+ * void *_dmalloc_chunk_realloc
+ *
+ * Re-allocate a chunk of memory either shrinking or expanding it.
+ *
+ * Returns a valid pointer on success of NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * old_user_pnt -> Old user pointer that we are reallocating.
+ *
  * new_size -> New-size to change the pointer.
  *
- * func_id -> Calling function-id as defined in dmalloc.h.
+ * func_id -> Calling function-id as defined in dmalloc.h.
+ */
+void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
+				void *old_user_pnt,
+				const unsigned long new_size,
+				const int func_id)
+{
+  const char	*old_file;
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  void		*new_user_pnt;
+  unsigned long	old_size, *counts;
+  unsigned int	old_line, flags;
+#if MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0
+  unsigned long	copied_size = 0;
+  unsigned int	realloc_c;
+#endif
+#if LIFETIME_BUCKETS > 0
+  unsigned long	alloc_iter;
+#endif
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+  unsigned long	alloc_nsec;
+#endif
+  
+#if PNT_CHECK_CACHE_SIZE > 0
+  /* the allocation may be resized in place */
+  heap_generation++;
+#endif
+  
+  /* counts calls to realloc */
+  counts = thread_counts();
+  if (func_id == DMALLOC_FUNC_RECALLOC) {
+    counts[STAT_RECALLOC]++;
+  }
+  else {
+    counts[STAT_REALLOC]++;
+  }
+  
+#if ALLOW_ALLOC_ZERO_SIZE == 0
+  if (new_size == 0) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    log_error_info(file, line, NULL, NULL, "bad zero byte allocation request",
+		   "realloc");
+    return REALLOC_ERROR;
+  }
+#endif
+  
+  /* by now malloc.c should have taken care of the realloc(NULL) case */
+  if (old_user_pnt == NULL) {
+    dmalloc_errno = DMALLOC_ERROR_IS_NULL;
+    log_error_info(file, line, old_user_pnt, NULL, "invalid pointer",
+		   "realloc");
+    return REALLOC_ERROR;
+  }
+  
+  /* find the old pointer with loose checking for fence post stuff */
+  slot_p = find_used_address(old_user_pnt, 0 /* not exact pointer */,
+			     skip_update);
+  if (slot_p == NULL) {
+    dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
+    log_error_info(file, line, old_user_pnt, NULL, "finding address in heap",
+		   "realloc");
+    return 0;
+  }
+  
+  /* get info about the pointer */
+  get_pnt_info(slot_p, &pnt_info);
+  old_file = slot_p->sa_file;
+  old_line = slot_p->sa_line;
+  old_size = slot_p->sa_user_size;
+  
+  /* the policies of the allocation decide how it is resized */
+  flags = _dmalloc_flags;
+#if MAX_POLICIES > 0
+  if (policy_n > 0) {
+    flags |= policy_flags(old_file, old_line, old_size);
+  }
+#endif
+#if MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0
+  /* the count carries over to where the allocation moves */
+  realloc_c = slot_p->sa_realloc_c;
+  if (realloc_c < 0xFFFF) {
+    realloc_c++;
+  }
+#endif
+  
+  /* if we are not realloc copying and the size is the same */
+  if ((char *)pnt_info.pi_user_start + new_size >
+      (char *)pnt_info.pi_upper_bounds
+      || BIT_IS_SET(flags, DMALLOC_DEBUG_REALLOC_COPY)
+      || BIT_IS_SET(flags, DMALLOC_DEBUG_NEVER_REUSE)
+      /* hand large objects which have shrunk back to the heap */
+      || (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE)
+	  && new_size < LARGE_OBJECT_SIZE)) {
+    unsigned long	min_size;
+    
+    /* allocate space for new chunk */
+    new_user_pnt = _dmalloc_chunk_malloc(file, line, new_size, func_id,
+				    0 /* no align */);
+    if (new_user_pnt == MALLOC_ERROR) {
+      return REALLOC_ERROR;
+    }
+    
+    /*
+     * NOTE: _chunk_malloc() already took care of the fence stuff and
+     * zeroing of memory.
+     */
+    
+    /* copy stuff into new section of memory */
+    min_size = MIN(new_size, old_size);
+    if (min_size > 0) {
+      memcpy(new_user_pnt, pnt_info.pi_user_start, min_size);
+    }
+    
+#if MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0
+    /* the old pointer is not freed for good so it has no final size */
+    slot_p->sa_realloc_c = 0;
+    copied_size = min_size;
+#endif
+    
+    /* the lifetime carries over so the old pointer's is not counted */
+#if LIFETIME_BUCKETS > 0
+    alloc_iter = slot_p->sa_alloc_iter;
+#endif
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+    alloc_nsec = slot_p->sa_alloc_nsec;
+#endif
+    BIT_SET(slot_p->sa_flags, ALLOC_FLAG_MOVED);
+    
+    /* free old pointer */
+    if (_dmalloc_chunk_free(file, line, old_user_pnt,
+			    func_id) != FREE_NOERROR) {
+      /*
+       * The old pointer is still in use so it has not moved.  The new
+       * one is handed back without its lifetime being counted.
+       */
+      BIT_CLEAR(slot_p->sa_flags, ALLOC_FLAG_MOVED);
+      slot_p = find_used_address(new_user_pnt, 0 /* not exact */, NULL);
+      if (slot_p != NULL) {
+	BIT_SET(slot_p->sa_flags, ALLOC_FLAG_MOVED);
+	(void)_dmalloc_chunk_free(file, line, new_user_pnt, func_id);
+      }
+      return REALLOC_ERROR;
+    }
+    
+#if (MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0) || LIFETIME_BUCKETS > 0
+    slot_p = find_used_address(new_user_pnt, 0 /* not exact */, NULL);
+    if (slot_p != NULL) {
+#if MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0
+      slot_p->sa_realloc_c = realloc_c;
+#endif
+#if LIFETIME_BUCKETS > 0
+      slot_p->sa_alloc_iter = alloc_iter;
+#endif
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+      slot_p->sa_alloc_nsec = alloc_nsec;
+#endif
+    }
+#endif
+  }
+  else {
+    /* new pointer is the same as the old one */
+    new_user_pnt = pnt_info.pi_user_start;
+    
+    /*
+     * monitor current allocation level
+     *
+     * NOTE: we do this here since the malloc/free used above take care
+     * on if in that section
+     */
+    alloc_current += new_size - old_size;
+    alloc_maximum = MAX(alloc_maximum, alloc_current);
+    counts[STAT_ALLOC_BYTES] += new_size;
+    alloc_one_max = MAX(alloc_one_max, new_size);
+    
+    /* monitor pointer usage */
+    counts[STAT_ALLOC_PNTS]++;
+    
+    /* change the slot information */
+    slot_p->sa_user_size = new_size;
+    count_class(slot_p, (long)new_size - (long)old_size, 0);
+    get_pnt_info(slot_p, &pnt_info);
+    
+    clear_alloc(slot_p, &pnt_info, old_size, func_id, flags);
+#if HEAP_SHADOW_MAP
+    shadow_set(slot_p, &pnt_info);
+#endif
+    
+    /* NOTE: the lifetime still counts from the allocation */
+    slot_p->sa_use_iter = _dmalloc_iter_c;
+#if LOG_PNT_SEEN_COUNT
+    /* we see in inbound and outbound so we need to increment by 2 */
+    slot_p->sa_seen_c += 2;
+#endif
+    
+#if MEMORY_TABLE_TOP_LOG
+    _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
+			  old_size);
+    _dmalloc_table_insert(&mem_table_alloc, file, line, new_size);
+#endif
+#if MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0
+    slot_p->sa_realloc_c = realloc_c;
+#endif
+  
+    /*
+     * finally, we update the file/line info -- must be after
+     * _dmalloc_table functions
+     */
+    slot_p->sa_file = file;
+    slot_p->sa_line = line;
+  }
+  
+#if MEMORY_TABLE_TOP_LOG && REALLOC_TOP_LOG > 0
+  /* a buffer is new to the site if it was last resized elsewhere */
+  _dmalloc_table_realloc(&mem_table_alloc, file, line, old_size, new_size,
+			 copied_size, realloc_c,
+			 (realloc_c == 1 || old_file != file
+			  || old_line != line));
+#endif
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    const char	*trans_log;
+    char	where_buf[MAX_FILE_LENGTH + 64];
+    char	where_buf2[MAX_FILE_LENGTH + 64];
+    
+    if (func_id == DMALLOC_FUNC_RECALLOC) {
+      trans_log = "recalloc";
+    }
+    else {
+      trans_log = "realloc";
+    }
+    dmalloc_message("*** %s: at '%s' from '%p' (%lu bytes) file '%s' to '%p' (%lu bytes)",
+		    trans_log,
+		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					    file, line),
+		    old_user_pnt, old_size,
+		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+					    old_file, old_line),
+		    new_user_pnt, new_size);
+  }
+  
+  return new_user_pnt;
+}
+
+/*
+ * unsigned long _dmalloc_chunk_trim
+ *
+ * Give the pages of all of the free blocks back to the system.
+ *
+ * Returns the number of bytes given back.
+ */
+unsigned long	_dmalloc_chunk_trim(void)
+{
+  return purge_free(0 /* any age */);
+}
+
+/***************************** diagnostic routines ***************************/
+
+/*
+ * static void log_classes
+ *
+ * Log the size classes which have been used and how many bytes are
+ * wasted by rounding the allocations up to them.
+ */
+static	void	log_classes(void)
+{
+  size_class_t	*class_p, *bounds_p;
+  unsigned long	waste, slot_bytes, total_slots = 0, total_waste = 0;
+  
+  dmalloc_message("size classes in use:");
+  dmalloc_message("%7s %7s %11s %11s %5s %7s %7s", "class", "in-use",
+		  "user-bytes", "waste", "waste", "blocks", "allocs");
+  bounds_p = size_classes + size_class_n;
+  for (class_p = size_classes; class_p < bounds_p; class_p++) {
+    if (class_p->sc_alloc_c == 0) {
+      continue;
+    }
+    slot_bytes = class_p->sc_in_use_c * class_p->sc_size;
+    waste = slot_bytes - class_p->sc_user_size;
+    dmalloc_message("%7lu %7lu %11lu %11lu %4lu%% %7lu %7lu",
+		    class_p->sc_size, class_p->sc_in_use_c,
+		    class_p->sc_user_size, waste,
+		    (slot_bytes == 0 ? 0 : (waste * 100) / slot_bytes),
+		    class_p->sc_block_c, class_p->sc_alloc_c);
+    total_slots += slot_bytes;
+    total_waste += waste;
+  }
+  dmalloc_message("%7s %7s %11lu %11lu %4lu%%", "total", "",
+		  total_slots - total_waste, total_waste,
+		  (total_slots == 0 ? 0 : (total_waste * 100) / total_slots));
+}
+
+#if LOCK_PROFILE
+/*
+ * static void log_lock_hist
+ *
+ * Log the buckets of a lock histogram that have counts in them.
+ *
+ * ARGUMENTS:
+ *
+ * label -> Label to start the line with.
+ *
+ * hist -> Histogram of DMALLOC_LOCK_BUCKETS counts.
+ */
+static	void	log_lock_hist(const char *label, const unsigned long *hist)
+{
+  char	line[DMALLOC_LOCK_BUCKETS * 32 + 32], *line_p, *bounds_p;
+  int	bucket_c;
+  
+  line_p = line;
+  bounds_p = line + sizeof(line);
+  line_p += loc_snprintf(line_p, bounds_p - line_p, "%s", label);
+  
+  for (bucket_c = 0; bucket_c < DMALLOC_LOCK_BUCKETS; bucket_c++) {
+    if (hist[bucket_c] == 0) {
+      continue;
+    }
+    if (bucket_c == 0) {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " <1:%lu",
+			     hist[bucket_c]);
+    }
+    else if (bucket_c == DMALLOC_LOCK_BUCKETS - 1) {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " %lu+:%lu",
+			     1UL << (bucket_c - 1), hist[bucket_c]);
+    }
+    else if (bucket_c == 1) {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " 1:%lu",
+			     hist[bucket_c]);
+    }
+    else {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " %lu-%lu:%lu",
+			     1UL << (bucket_c - 1), (1UL << bucket_c) - 1,
+			     hist[bucket_c]);
+    }
+  }
+  
+  dmalloc_message("%s", line);
+}
+
+/*
+ * static void log_locks
+ *
+ * Log how long each operation waited for and held the library lock
+ * and the call sites which held it the longest.
+ */
+static	void	log_locks(void)
+{
+  static const char		*op_labels[DMALLOC_LOCK_OP_N] = {
+    "malloc", "free", "realloc", "verify", "heap-check", "log", "other"
+  };
+  const dmalloc_lock_stats_t	*stats_p;
+  int				op_c;
+  
+  dmalloc_message("lock waits and holds in usecs:");
+  dmalloc_message("%10s %8s %7s %11s %8s %11s %8s", "op", "calls",
+		  "waited", "wait-usecs", "max-wait", "hold-usecs",
+		  "max-hold");
+  for (op_c = 0; op_c < DMALLOC_LOCK_OP_N; op_c++) {
+    stats_p = lock_stats + op_c;
+    if (stats_p->dl_lock_c == 0) {
+      continue;
+    }
+    dmalloc_message("%10s %8lu %7lu %11lu %8lu %11lu %8lu", op_labels[op_c],
+		    stats_p->dl_lock_c, stats_p->dl_wait_c,
+		    stats_p->dl_wait_nsec / 1000,
+		    stats_p->dl_wait_max_nsec / 1000,
+		    stats_p->dl_hold_nsec / 1000,
+		    stats_p->dl_hold_max_nsec / 1000);
+    if (stats_p->dl_wait_c > 0) {
+      log_lock_hist("      wait", stats_p->dl_wait_hist);
+    }
+    log_lock_hist("      hold", stats_p->dl_hold_hist);
+  }
+  
+  dmalloc_message("top %d sites by lock hold time:", LOCK_PROFILE_TOP_LOG);
+  _dmalloc_table_log_locks(&mem_table_lock, LOCK_PROFILE_TOP_LOG);
+}
+#endif
+
+/*
+ * void _dmalloc_chunk_log_stats
+ *
+ * Log general statistics from the heap to the logfile.
+ */
+void	_dmalloc_chunk_log_stats(void)
+{
+  unsigned long	overhead, user_space, tot_space;
+  unsigned long	counts[STAT_COUNTER_N];
+  
+  dmalloc_message("Dumping Chunk Statistics:");
+  
+  sum_counts(counts);
+  
+  tot_space = (user_block_c + admin_block_c) * BLOCK_SIZE + large_space_bytes;
+  user_space = alloc_current + free_space_bytes;
+  overhead = admin_block_c * BLOCK_SIZE;
+  
+  /* version information */
+  dmalloc_message("basic-block %d bytes, alignment %d bytes",
+		  BLOCK_SIZE, ALLOCATION_ALIGNMENT);
+  
+  /* general heap information with blocks */
+  unsigned long diff = (PNT_ARITH_TYPE)_dmalloc_heap_high -
+    (PNT_ARITH_TYPE)_dmalloc_heap_low;
+  dmalloc_message("heap address range: %p to %p, %lu bytes",
+		  _dmalloc_heap_low, _dmalloc_heap_high, diff);
+  dmalloc_message("    user blocks: %ld blocks, %ld bytes (%ld%%)",
+		  user_block_c, user_space,
+		  (tot_space < 100 ? 0 : user_space / (tot_space / 100)));
+  dmalloc_message("   admin blocks: %ld blocks, %ld bytes (%ld%%)",
+		  admin_block_c, overhead,
+		  (tot_space < 100 ? 0 : overhead / (tot_space / 100)));
+  dmalloc_message("  large objects: %ld objects, %ld bytes (%ld%%)",
+		  large_object_c, large_space_bytes,
+		  (tot_space < 100 ? 0 : large_space_bytes / (tot_space / 100)));
+  dmalloc_message("   total blocks: %ld blocks, %ld bytes",
+		  user_block_c + admin_block_c, tot_space);
+  dmalloc_message("   purged space: %ld free bytes given back to the system",
+		  purged_space_bytes);
+  
+  dmalloc_message("heap checked %ld", heap_check_c);
+  
+  /* log user allocation information */
+  dmalloc_message("alloc calls: malloc %lu, calloc %lu, realloc %lu, free %lu",
+		  counts[STAT_MALLOC], counts[STAT_CALLOC], counts[STAT_REALLOC],
+		  counts[STAT_FREE]);
+  dmalloc_message("alloc calls: recalloc %lu, memalign %lu, valloc %lu",
+		  counts[STAT_RECALLOC], counts[STAT_MEMALIGN],
+		  counts[STAT_VALLOC]);
+  dmalloc_message("alloc calls: new %lu, delete %lu",
+		  counts[STAT_NEW], counts[STAT_DELETE]);
+  dmalloc_message("  current memory in use: %lu bytes (%lu pnts)",
+		  alloc_current, alloc_cur_pnts);
+  dmalloc_message(" total memory allocated: %lu bytes (%lu pnts)",
+		  counts[STAT_ALLOC_BYTES], counts[STAT_ALLOC_PNTS]);
+  
+  /* maximum stats */
+  dmalloc_message(" max in use at one time: %lu bytes (%lu pnts)",
+		  alloc_maximum, alloc_max_pnts);
+  dmalloc_message("max alloced with 1 call: %lu bytes",
+		  alloc_one_max);
+  dmalloc_message("max unused memory space: %lu bytes (%lu%%)",
+		  alloc_max_given - alloc_maximum,
+		  (alloc_max_given == 0 ? 0 :
+		   ((alloc_max_given - alloc_maximum) * 100) /
+		   alloc_max_given));
+  
+  log_classes();
+  
+#if MEMORY_TABLE_TOP_LOG
+  dmalloc_message("top %d allocations:", MEMORY_TABLE_TOP_LOG);
+  _dmalloc_table_log_info(&mem_table_alloc, MEMORY_TABLE_TOP_LOG,
+			  1 /* have in-use column */);
+#if LIFETIME_BUCKETS > 0 && LIFETIME_TOP_LOG > 0
+  dmalloc_message("top %d short-lived allocation sites:", LIFETIME_TOP_LOG);
+  _dmalloc_table_log_lifetimes(&mem_table_alloc, LIFETIME_TOP_LOG);
+#endif
+#if REALLOC_TOP_LOG > 0
+  dmalloc_message("top %d realloc sites by bytes copied:", REALLOC_TOP_LOG);
+  _dmalloc_table_log_reallocs(&mem_table_alloc, REALLOC_TOP_LOG);
+#endif
+#endif
+  
+#if LOCK_PROFILE
+  log_locks();
+#endif
+}
+
+/*
+ * void _dmalloc_chunk_log_changed
+ *
+ * Log the pointers that has changed since a pointer in time.
+ *
+ * ARGUMENTS:
+ *
+ * mark -> Dmalloc counter used to mark a specific time so that
+ * servers can check on the changed pointers.
+ *
+ * log_non_free_b -> If set to 1 then log the new not-freed
+ * (i.e. used) pointers.
+ *
+ * log_free_b -> If set to 1 then log the new freed pointers.
+ *
+ * details_b -> If set to 1 then dump the individual pointer entries
+ * instead of just the summary.
+ */
+void	_dmalloc_chunk_log_changed(const unsigned long mark,
+				   const int log_not_freed_b,
+				   const int log_freed_b, const int details_b)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  int		known_b, freed_b, used_b;
+  char		out[DUMP_SPACE * 4], *which_str;
+  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
+  int		unknown_size_c = 0, unknown_block_c = 0, out_len;
+  int		size_c = 0, block_c = 0, checking_list_c = 0;
+  
+  if (log_not_freed_b && log_freed_b) {
+    which_str = "Not-Freed and Freed";
+  }
+  else if (log_not_freed_b) {
+    which_str = "Not-Freed";
+  }
+  else if (log_freed_b) {
+    which_str = "Freed";
+  }
+  else {
+    return;
+  }
+  
+  if (mark == 0) {
+    dmalloc_message("Dumping %s Pointers Changed Since Start:", which_str);
+  }
+  else {
+    dmalloc_message("Dumping %s Pointers Changed Since Mark %lu:",
+		    which_str, mark);
+  }
+  
+  /* clear out our memory table so we can fill it with pointer info */
+  _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
+		      sizeof(mem_table_changed_entries) /
+		      sizeof(*mem_table_changed_entries));
+  
+  /* run through the blocks */
+  for (slot_p = skip_address_list->sa_next_p[0];
+       ;
+       slot_p = slot_p->sa_next_p[0]) {
+    
+    /*
+     * switch to the free list in the middle after we've checked the
+     * used pointer slots and then on to the large objects
+     */
+    while (slot_p == NULL) {
+      checking_list_c++;
+      if (checking_list_c == 1) {
+	slot_p = skip_free_list->sa_next_p[0];
+      }
+#if FREED_POINTER_DELAY
+      else if (checking_list_c == 2) {
+	slot_p = free_wait_list_head;
+      }
+#endif
+      else if (checking_list_c == LARGE_LIST_PASS) {
+	slot_p = skip_large_list->sa_next_p[0];
+      }
+      else {
+	/* we are done */
+	break;
+      }
+    }
+    if (slot_p == NULL) {
+      break;
+    }
+    
+    freed_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE);
+    used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
+    
+    /*
+     * check for different types
+     */
+    if (! (freed_b || used_b)) {
+      continue;
+    }
+    
+    /* do we want to dump this one? */
+    if (! ((log_not_freed_b && used_b) || (log_freed_b && freed_b))) {
+      continue;
+    }    
+    /* is it too long ago? */
+    if (slot_p->sa_use_iter <= mark) {
+      continue;
+    }
+    
+    /* unknown pointer? */
+    if (slot_p->sa_file == DMALLOC_DEFAULT_FILE
+	|| slot_p->sa_line == DMALLOC_DEFAULT_LINE) {
+      unknown_block_c++;
+      unknown_size_c += slot_p->sa_user_size;
+      known_b = 0;
+    }
+    else {
+      known_b = 1;
+    }
+    
+    get_pnt_info(slot_p, &pnt_info);
+    
+    if (known_b || (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_KNOWN))) {
+      if (details_b) {
+	dmalloc_message(" %s freed: '%s' (%lu bytes) from '%s'",
+			(freed_b ? "   " : "not"),
+			display_pnt(pnt_info.pi_user_start, slot_p, disp_buf,
+				    sizeof(disp_buf)),
+			slot_p->sa_user_size,
+			_dmalloc_chunk_desc_site(where_buf, sizeof(where_buf),
+						 slot_p->sa_file,
+						 slot_p->sa_line));
+	
+	if ((! freed_b)
+	    && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_NONFREE_SPACE)) {
+	  out_len = expand_chars((char *)pnt_info.pi_user_start, DUMP_SPACE,
+				 out, sizeof(out));
+	  dmalloc_message("  dump of '%p': '%.*s'",
+			  pnt_info.pi_user_start, out_len, out);
+	}
+      }
+      _dmalloc_table_insert(&mem_table_changed, slot_p->sa_file,
+			    slot_p->sa_line, slot_p->sa_user_size);
+    }
+  }
+  
+  /* dump the summary from the table table */
+  _dmalloc_table_log_info(&mem_table_changed, 0 /* log all entries */,
+			  0 /* no in-use column */);
+  
+  /* copy out size of pointers */
+  if (block_c > 0) {
+    if (block_c - unknown_block_c > 0) {
+      dmalloc_message(" known memory: %d pointer%s, %d bytes",
+		      block_c - unknown_block_c,
+		      (block_c - unknown_block_c == 1 ? "" : "s"),
+		      size_c - unknown_size_c);
+    }
+    if (unknown_block_c > 0) {
+      dmalloc_message(" unknown memory: %d pointer%s, %d bytes",
+		      unknown_block_c, (unknown_block_c == 1 ? "" : "s"),
+		      unknown_size_c);
+    }
+  }
+}
+
+/*
+ * unsigned long _dmalloc_chunk_count_changed
+ *
+ * Return the pointers that has changed since a pointer in time.
+ *
+ * Returns the number of bytes changed since mark.
+ *
+ * ARGUMENTS:
+ *
+ * mark -> Dmalloc counter used to mark a specific time so that
+ * servers can check on the changed pointers.
+ *
+ * count_non_free_b -> If set to 1 then count the new not-freed
+ * (i.e. used) pointers.
+ *
+ * count_free_b -> If set to 1 then count the new freed pointers.
+ */
+unsigned long	_dmalloc_chunk_count_changed(const unsigned long mark,
+					     const int count_not_freed_b,
+					     const int count_freed_b)
+{
+  skip_alloc_t	*slot_p;
+  int		freed_b, used_b;
+  int		checking_list_c = 0;
+  unsigned long	mem_count = 0;
+  
+  /* run through the blocks */
+  for (slot_p = skip_address_list->sa_next_p[0];
+       ;
+       slot_p = slot_p->sa_next_p[0]) {
+    
+    /*
+     * switch to the free list in the middle after we've checked the
+     * used pointer slots and then on to the large objects
+     */
+    while (slot_p == NULL) {
+      checking_list_c++;
+      if (checking_list_c == 1) {
+	slot_p = skip_free_list->sa_next_p[0];
+      }
+#if FREED_POINTER_DELAY
+      else if (checking_list_c == 2) {
+	slot_p = free_wait_list_head;
+      }
+#endif
+      else if (checking_list_c == LARGE_LIST_PASS) {
+	slot_p = skip_large_list->sa_next_p[0];
+      }
+      else {
+	/* we are done */
+	break;
+      }
+    }
+    if (slot_p == NULL) {
+      break;
+    }
+    
+    freed_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE);
+    used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
+    
+    /*
+     * check for different types
+     */
+    if (! (freed_b || used_b)) {
+      continue;
+    }
+    /* is it too long ago? */
+    if (slot_p->sa_use_iter <= mark) {
+      continue;
+    }
+    
+    /* count the memory */
+    if (count_not_freed_b && used_b) {
+      mem_count += slot_p->sa_user_size;
+    }
+    else if (count_freed_b && freed_b) {
+      mem_count += slot_p->sa_user_size;
+    }
+  }
+  
+  return mem_count;
+}
+
+/*
+ * void _dmalloc_chunk_get_stats
+ *
+ * Return a number of statistics about the current heap.
+ *
+ * ARGUMENTS:
+ *
+ * heap_low_p <- Pointer to pointer which, if not 0L, will be set to
+ * the low address in the heap.
+ *
+ * heap_high_p <- Pointer to pointer which, if not 0L, will be set to
+ * the high address in the heap.
+ *
+ * total_space_p <- Pointer to an unsigned long which, if not 0L, will
+ * be set to the total space managed by the library including user
+ * space, administrative space, and overhead.
+ *
+ * user_space_p <- Pointer to an unsigned long which, if not 0L, will
+ * be set to the space given to the user process (allocated and free).
+ *
+ * current_allocated_p <- Pointer to an unsigned long which, if not
+ * 0L, will be set to the current allocated space given to the user
+ * process.
+ *
+ * current_pnt_np <- Pointer to an unsigned long which, if not 0L,
+ * will be set to the current number of pointers allocated by the user
+ * process.
+ *
+ * max_allocated_p <- Pointer to an unsigned long which, if not 0L,
+ * will be set to the maximum allocated space given to the user
+ * process.
+ *
+ * max_pnt_np <- Pointer to an unsigned long which, if not 0L, will be
+ * set to the maximum number of pointers allocated by the user
+ * process.
+ *
+ * max_one_p <- Pointer to an unsigned long which, if not 0L, will be
+ * set to the maximum allocated with 1 call by the user process.
+ */
+void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
+				 unsigned long *total_space_p,
+				 unsigned long *user_space_p,
+				 unsigned long *current_allocated_p,
+				 unsigned long *current_pnt_np,
+				 unsigned long *max_allocated_p,
+				 unsigned long *max_pnt_np,
+				 unsigned long *max_one_p)
+{
+  SET_POINTER(heap_low_p, _dmalloc_heap_low);
+  SET_POINTER(heap_high_p, _dmalloc_heap_high);
+  SET_POINTER(total_space_p,
+	      (user_block_c + admin_block_c) * BLOCK_SIZE + large_space_bytes);
+  SET_POINTER(user_space_p, alloc_current + free_space_bytes);
+  SET_POINTER(current_allocated_p, alloc_current);
+  SET_POINTER(current_pnt_np, alloc_cur_pnts);
+  SET_POINTER(max_allocated_p, alloc_maximum);
+  SET_POINTER(max_pnt_np, alloc_max_pnts);
+  SET_POINTER(max_one_p, alloc_one_max);
+}
+
+/*
+ * unsigned long _dmalloc_chunk_alloc_total
+ *
+ * Add up the bytes that the heap has allocated from all of the
+ * shards.
+ *
+ * Returns the total number of bytes that have been allocated.
+ */
+unsigned long	_dmalloc_chunk_alloc_total(void)
+{
+  unsigned long	total = 0;
+  int		shard_c;
+  
+  /* this is called on every transaction when start-size is set */
+  for (shard_c = 0; shard_c < STAT_SHARD_N; shard_c++) {
+    total += stat_shards[shard_c].ss_counts[STAT_ALLOC_BYTES];
+  }
+  return total;
+}
+
+#if LOCK_PROFILE
+/*
+ * static int lock_bucket
+ *
+ * Find the histogram bucket of a lock wait or hold.  Less than a
+ * microsecond goes in the first bucket and the others go in the
+ * bucket of the highest bit of their microseconds plus one with the
+ * last bucket taking everything longer.
+ *
+ * Returns the bucket number.
+ *
+ * ARGUMENTS:
+ *
+ * nsec -> Nanoseconds that we are counting.
+ */
+static	int	lock_bucket(const unsigned long nsec)
+{
+  unsigned long	usec;
+  int		bucket_c;
+  
+  usec = nsec / 1000;
+  for (bucket_c = 0; usec > 0 && bucket_c < DMALLOC_LOCK_BUCKETS - 1;
+       bucket_c++) {
+    usec >>= 1;
+  }
+  
+  return bucket_c;
+}
+#endif
+
+/*
+ * void _dmalloc_chunk_lock_record
+ *
+ * Count a hold of the library lock.  This is called with the lock
+ * held right before it is unlocked.
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation that held the lock.
+ *
+ * file -> File name or return address of the call or
+ * DMALLOC_DEFAULT_FILE if it is not known.
+ *
+ * line -> Line number of the call.
+ *
+ * wait_nsec -> Nanoseconds that the call waited for the lock or 0 if
+ * it was free.
+ *
+ * hold_nsec -> Nanoseconds that the call held the lock.
+ */
+void	_dmalloc_chunk_lock_record(const int op, const char *file,
+				   const unsigned int line,
+				   const unsigned long wait_nsec,
+				   const unsigned long hold_nsec)
+{
+#if LOCK_PROFILE
+  dmalloc_lock_stats_t	*stats_p;
+  
+  if (op < 0 || op >= DMALLOC_LOCK_OP_N) {
+    stats_p = lock_stats + DMALLOC_LOCK_OTHER;
+  }
+  else {
+    stats_p = lock_stats + op;
+  }
+  
+  stats_p->dl_lock_c++;
+  if (wait_nsec > 0) {
+    stats_p->dl_wait_c++;
+    stats_p->dl_wait_nsec += wait_nsec;
+    if (wait_nsec > stats_p->dl_wait_max_nsec) {
+      stats_p->dl_wait_max_nsec = wait_nsec;
+    }
+    stats_p->dl_wait_hist[lock_bucket(wait_nsec)]++;
+  }
+  stats_p->dl_hold_nsec += hold_nsec;
+  if (hold_nsec > stats_p->dl_hold_max_nsec) {
+    stats_p->dl_hold_max_nsec = hold_nsec;
+  }
+  stats_p->dl_hold_hist[lock_bucket(hold_nsec)]++;
+  
+  _dmalloc_table_lock(&mem_table_lock, file, line, wait_nsec, hold_nsec);
+#endif
+}
+
+/*
+ * int _dmalloc_chunk_get_lock_stats
+ *
+ * Get the lock waits and holds of an operation.
+ *
+ * Returns 1 if the lock is profiled or 0 if it is not or the
+ * operation is not known in which case the stats are all 0.
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation whose stats we are getting.
+ *
+ * stats_p <- Pointer to the stats which we fill in.
+ */
+int	_dmalloc_chunk_get_lock_stats(const int op,
+				      dmalloc_lock_stats_t *stats_p)
+{
+#if LOCK_PROFILE
+  if (op >= 0 && op < DMALLOC_LOCK_OP_N) {
+    *stats_p = lock_stats[op];
+    return 1;
+  }
+#endif
+  memset(stats_p, 0, sizeof(*stats_p));
+  return 0;
+}
+
+/********************************* leak scan *********************************/
+
+#if LEAK_SCAN
+
+/*
+ * static void scan_mark
+ *
+ * Look up a word of memory that the leak scan found and if it points
+ * into a user allocation that has not been reached yet then mark it
+ * and push it on our stack to be scanned.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ *
+ * pnt -> Word which might be a pointer into the heap.
+ */
+static	void	scan_mark(leak_scan_t *scan_p, const char *pnt)
+{
+  skip_alloc_t		*slot_p = NULL;
+#if HEAP_SHADOW_MAP
+  const unsigned char	*shadow_p;
+#endif
+  
+  if (IS_IN_HEAP(pnt)) {
+#if HEAP_SHADOW_MAP
+    /* most words are not pointers into user memory so skip the search */
+    shadow_p = _dmalloc_heap_shadow(pnt);
+    if (shadow_p != NULL
+	&& (unsigned int)(*shadow_p & ~(SHADOW_START | SHADOW_FENCE))
+	<= (PNT_ARITH_TYPE)pnt % SHADOW_SCALE) {
+      return;
+    }
+#endif
+    slot_p = find_address(pnt, 0 /* used list */, 0 /* inside the block */,
+			  NULL);
+  }
+#if HEAP_LARGE_OBJECTS
+  else if (pnt >= scan_p->ls_large_low && pnt < scan_p->ls_large_high) {
+    slot_p = find_large(pnt, 0 /* inside the object */, NULL);
+  }
+#endif
+  
+  if (slot_p == NULL
+      || (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER))
+      || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)) {
+    return;
+  }
+  
+  /* another thread may be reaching the same slot */
+#if LEAK_SCAN_WORKERS
+  if (__atomic_fetch_or(&slot_p->sa_flags, ALLOC_FLAG_SCAN_MARK,
+			__ATOMIC_RELAXED) & ALLOC_FLAG_SCAN_MARK) {
+    return;
+  }
+#else
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_SCAN_MARK)) {
+    return;
+  }
+  BIT_SET(slot_p->sa_flags, ALLOC_FLAG_SCAN_MARK);
+#endif
+  
+  if (scan_p->ls_stack_n < LEAK_SCAN_STACK) {
+    scan_p->ls_stack[scan_p->ls_stack_n++] = slot_p;
+  }
+  else {
+    /* the slot stays marked but not done for another pass to find */
+    scan_overflow_b = 1;
+  }
+}
+
+/*
+ * static void scan_words
+ *
+ * Look at each of the pointer-aligned words in a range of memory.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ *
+ * low -> Start of the range.
+ *
+ * high -> End of the range.
+ */
+static	void	scan_words(leak_scan_t *scan_p, const char *low,
+			   const char *high)
+{
+  char	* const *word_p;
+  
+  word_p = (char * const *)(((PNT_ARITH_TYPE)low + sizeof(char *) - 1)
+			    & ~(PNT_ARITH_TYPE)(sizeof(char *) - 1));
+  for (; (const char *)(word_p + 1) <= high; word_p++) {
+    scan_mark(scan_p, *word_p);
+  }
+}
+
+/*
+ * static void scan_slot
+ *
+ * Look through the user memory of an allocation that the scan has
+ * reached.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ *
+ * slot_p -> Slot that was reached.
+ */
+static	void	scan_slot(leak_scan_t *scan_p, skip_alloc_t *slot_p)
+{
+  pnt_info_t	pnt_info;
+  
+  get_pnt_info(slot_p, &pnt_info);
+  scan_words(scan_p, pnt_info.pi_user_start, pnt_info.pi_user_bounds);
+#if LEAK_SCAN_WORKERS
+  (void)__atomic_fetch_or(&slot_p->sa_flags, ALLOC_FLAG_SCAN_DONE,
+			  __ATOMIC_RELAXED);
+#else
+  BIT_SET(slot_p->sa_flags, ALLOC_FLAG_SCAN_DONE);
+#endif
+}
+
+#if LEAK_SCAN_WORKERS
+/*
+ * static void scan_share
+ *
+ * Move half of our stack into the pool for the idle threads.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ */
+static	void	scan_share(leak_scan_t *scan_p)
+{
+  int	give_n;
+  
+  pthread_mutex_lock(&scan_mutex);
+  give_n = scan_p->ls_stack_n / 2;
+  if (give_n > LEAK_SCAN_STACK - scan_pool_n) {
+    give_n = LEAK_SCAN_STACK - scan_pool_n;
+  }
+  scan_p->ls_stack_n -= give_n;
+  memcpy(scan_pool + scan_pool_n, scan_p->ls_stack + scan_p->ls_stack_n,
+	 give_n * sizeof(*scan_pool));
+  __atomic_store_n(&scan_pool_n, scan_pool_n + give_n, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&scan_cond);
+  pthread_mutex_unlock(&scan_mutex);
+}
+#endif
+
+/*
+ * static void scan_drain
+ *
+ * Scan the slots on our stack until it is empty.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ */
+static	void	scan_drain(leak_scan_t *scan_p)
+{
+#if LEAK_SCAN_WORKERS
+  int	iter_c = 0;
+#endif
+  
+  while (scan_p->ls_stack_n > 0) {
+    scan_p->ls_stack_n--;
+    scan_slot(scan_p, scan_p->ls_stack[scan_p->ls_stack_n]);
+    
+#if LEAK_SCAN_WORKERS
+    /* every so often see if there are threads waiting for work */
+    if (++iter_c >= LEAK_SCAN_SHARE_ITERS) {
+      iter_c = 0;
+      if (scan_p->ls_stack_n > 1
+	  && __atomic_load_n(&scan_idle_n, __ATOMIC_RELAXED) > 0
+	  && __atomic_load_n(&scan_pool_n, __ATOMIC_RELAXED) == 0) {
+	scan_share(scan_p);
+      }
+    }
+#endif
+  }
+}
+
+/*
+ * static void scan_work
+ *
+ * Mark phase of a marking thread.  Each thread scans its share of the
+ * roots and what they reach and then takes work from the pool until
+ * all of the threads are out of work.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ */
+static	void	scan_work(leak_scan_t *scan_p)
+{
+  int	root_c;
+#if LEAK_SCAN_WORKERS
+  int	take_n;
+#endif
+  
+  for (root_c = scan_p->ls_index; root_c < scan_root_n;
+       root_c += scan_thread_n) {
+    scan_words(scan_p, scan_roots[root_c].sr_low,
+	       scan_roots[root_c].sr_high);
+    scan_drain(scan_p);
+  }
+  
+#if LEAK_SCAN_WORKERS
+  if (scan_thread_n == 1) {
+    return;
+  }
+  
+  pthread_mutex_lock(&scan_mutex);
+  while (1) {
+    if (scan_pool_n > 0) {
+      take_n = (scan_pool_n + 1) / 2;
+      __atomic_store_n(&scan_pool_n, scan_pool_n - take_n, __ATOMIC_RELAXED);
+      memcpy(scan_p->ls_stack, scan_pool + scan_pool_n,
+	     take_n * sizeof(*scan_pool));
+      scan_p->ls_stack_n = take_n;
+      pthread_mutex_unlock(&scan_mutex);
+      scan_drain(scan_p);
+      pthread_mutex_lock(&scan_mutex);
+      continue;
+    }
+    
+    /* we are done when all of the threads are idle with an empty pool */
+    __atomic_store_n(&scan_idle_n, scan_idle_n + 1, __ATOMIC_RELAXED);
+    if (scan_idle_n == scan_thread_n) {
+      pthread_cond_broadcast(&scan_cond);
+      break;
+    }
+    pthread_cond_wait(&scan_cond, &scan_mutex);
+    if (scan_idle_n == scan_thread_n) {
+      break;
+    }
+    __atomic_store_n(&scan_idle_n, scan_idle_n - 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&scan_mutex);
+#endif
+}
+
+#if LEAK_SCAN_WORKERS
+/*
+ * static void *scan_thread
+ *
+ * Start routine of the extra marking threads.  They wait for the
+ * roots to be read and then help with the mark phase.
+ *
+ * Returns NULL.
+ *
+ * ARGUMENTS:
+ *
+ * arg -> Index of the thread.
  */
-void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
-				void *old_user_pnt,
-				const unsigned long new_size,
-				const int func_id)
+static	void	*scan_thread(void *arg)
 {
-  const char	*old_file;
+  int	index = (int)(PNT_ARITH_TYPE)arg, go_b;
+  char	stack_mark;
+  
+  pthread_mutex_lock(&scan_mutex);
+  /* our frames below here hold the words that we are looking at */
+  scan_stack_marks[index] = &stack_mark;
+  scan_ready_n++;
+  pthread_cond_broadcast(&scan_cond);
+  while (! (scan_go_b || scan_quit_b)) {
+    pthread_cond_wait(&scan_cond, &scan_mutex);
+  }
+  go_b = scan_go_b;
+  pthread_mutex_unlock(&scan_mutex);
+  
+  if (go_b) {
+    scan_work(&scan_states[index]);
+  }
+  
+  return NULL;
+}
+#endif
+
+/*
+ * static void scan_add_root
+ *
+ * Add a range of memory to the roots of the leak scan leaving out the
+ * parts which are not scanned unless they are reachable.
+ *
+ * ARGUMENTS:
+ *
+ * skips -> Ranges of our own memory which are left out.
+ *
+ * skip_n -> Number of skip ranges.
+ *
+ * low -> Start of the range.
+ *
+ * high -> End of the range.
+ */
+static	void	scan_add_root(const scan_range_t *skips, const int skip_n,
+			      char *low, char *high)
+{
+  int		skip_c;
+#if HEAP_LARGE_OBJECTS
   skip_alloc_t	*slot_p;
-  pnt_info_t	pnt_info;
-  void		*new_user_pnt;
-  unsigned int	old_size, old_line;
+  char		*mem;
+#endif
   
-  /* counts calls to realloc */
-  if (func_id == DMALLOC_FUNC_RECALLOC) {
-    func_recalloc_c++;
+  if (low >= high) {
+    return;
   }
-  else {
-    func_realloc_c++;
+  
+  for (skip_c = 0; skip_c < skip_n; skip_c++) {
+    if (low < skips[skip_c].sr_high && high > skips[skip_c].sr_low) {
+      scan_add_root(skips, skip_n, low, skips[skip_c].sr_low);
+      scan_add_root(skips, skip_n, skips[skip_c].sr_high, high);
+      return;
+    }
   }
   
-#if ALLOW_ALLOC_ZERO_SIZE == 0
-  if (new_size == 0) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    log_error_info(file, line, NULL, NULL, "bad zero byte allocation request",
-		   "realloc");
-    return REALLOC_ERROR;
+#if HEAP_LARGE_OBJECTS
+  /* the freed large objects still hold their old pointers */
+  for (slot_p = skip_large_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    mem = slot_p->sa_mem;
+    if (low < mem + slot_p->sa_total_size && high > mem) {
+      scan_add_root(skips, skip_n, low, mem);
+      scan_add_root(skips, skip_n, mem + slot_p->sa_total_size, high);
+      return;
+    }
   }
 #endif
   
-  /* by now malloc.c should have taken care of the realloc(NULL) case */
-  if (old_user_pnt == NULL) {
-    dmalloc_errno = DMALLOC_ERROR_IS_NULL;
-    log_error_info(file, line, old_user_pnt, NULL, "invalid pointer",
-		   "realloc");
-    return REALLOC_ERROR;
+  if (scan_root_n < LEAK_SCAN_MAX_ROOTS) {
+    scan_roots[scan_root_n].sr_low = low;
+    scan_roots[scan_root_n].sr_high = high;
+    scan_root_n++;
   }
+  else {
+    dmalloc_message("leak scan has more than %d roots, some not scanned",
+		    LEAK_SCAN_MAX_ROOTS);
+  }
+}
+
+/*
+ * static char *hex_pnt
+ *
+ * Convert the hexadecimal address at the front of a string.
+ *
+ * Returns the address.
+ *
+ * ARGUMENTS:
+ *
+ * str_p <-> Pointer to the string which is moved past the digits.
+ */
+static	char	*hex_pnt(char **str_p)
+{
+  PNT_ARITH_TYPE	val = 0;
+  char			*str = *str_p;
   
-  /* find the old pointer with loose checking for fence post stuff */
-  slot_p = find_address(old_user_pnt, 0 /* used list */,
-			0 /* not exact pointer */, skip_update);
-  if (slot_p == NULL) {
-    dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
-    log_error_info(file, line, old_user_pnt, NULL, "finding address in heap",
-		   "realloc");
-    return 0;
+  for (;; str++) {
+    if (*str >= '0' && *str <= '9') {
+      val = val * 16 + (*str - '0');
+    }
+    else if (*str >= 'a' && *str <= 'f') {
+      val = val * 16 + (*str - 'a' + 10);
+    }
+    else {
+      break;
+    }
   }
   
-  /* get info about the pointer */
-  get_pnt_info(slot_p, &pnt_info);
-  old_file = slot_p->sa_file;
-  old_line = slot_p->sa_line;
-  old_size = slot_p->sa_user_size;
+  *str_p = str;
+  return (char *)val;
+}
+
+/*
+ * static void scan_maps_line
+ *
+ * Add the memory of a line of /proc/self/maps to the roots if it
+ * could hold pointers to the heap.
+ *
+ * ARGUMENTS:
+ *
+ * skips -> Ranges of our own memory which are left out.
+ *
+ * skip_n -> Number of skip ranges.
+ *
+ * line -> Line from the maps file.
+ */
+static	void	scan_maps_line(const scan_range_t *skips, const int skip_n,
+			       char *line)
+{
+  char	*line_p = line, *low, *high;
+  int	thread_c;
   
-  /* if we are not realloc copying and the size is the same */
-  if ((char *)pnt_info.pi_user_start + new_size >
-      (char *)pnt_info.pi_upper_bounds
-      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_REALLOC_COPY)
-      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_NEVER_REUSE)) {
-    int	min_size;
-    
-    /* allocate space for new chunk */
-    new_user_pnt = _dmalloc_chunk_malloc(file, line, new_size, func_id,
-				    0 /* no align */);
-    if (new_user_pnt == MALLOC_ERROR) {
-      return REALLOC_ERROR;
+  low = hex_pnt(&line_p);
+  if (*line_p != '-') {
+    return;
+  }
+  line_p++;
+  high = hex_pnt(&line_p);
+  if (*line_p != ' ') {
+    return;
+  }
+  line_p++;
+  
+  /* only private memory that the program can write holds pointers */
+  if (line_p[0] != 'r' || line_p[1] != 'w' || line_p[3] != 'p') {
+    return;
+  }
+  /* reading device memory may have side effects */
+  if (strstr(line_p, " /dev/") != NULL) {
+    return;
+  }
+  
+  /* leave out the frames of the scan on the stacks of the mark threads */
+  for (thread_c = 0; thread_c < scan_thread_n; thread_c++) {
+    if (scan_stack_marks[thread_c] >= low
+	&& scan_stack_marks[thread_c] < high) {
+      low = scan_stack_marks[thread_c];
     }
+  }
+  
+  scan_add_root(skips, skip_n, low, high);
+}
+
+/*
+ * static int scan_read_roots
+ *
+ * Find the roots of the leak scan in /proc/self/maps.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	scan_read_roots(void)
+{
+  scan_range_t	skips[2];
+  char		buf[4096], *line_p, *end_p;
+  int		fd, len = 0, ret, skip_n = 0;
+  
+  /* our own memory with pointers to the slots and user memory */
+  skips[skip_n].sr_low = scan_mem;
+  skips[skip_n].sr_high = scan_mem + scan_mem_size;
+  skip_n++;
+  if (_dmalloc_heap_low != NULL) {
+    skips[skip_n].sr_low = _dmalloc_heap_low;
+    skips[skip_n].sr_high = _dmalloc_heap_high;
+    skip_n++;
+  }
+  
+  fd = open("/proc/self/maps", O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  
+  while (1) {
+    ret = read(fd, buf + len, sizeof(buf) - 1 - len);
+    if (ret <= 0) {
+      break;
+    }
+    len += ret;
+    buf[len] = '\0';
     
-    /*
-     * NOTE: _chunk_malloc() already took care of the fence stuff and
-     * zeroing of memory.
-     */
-    
-    /* copy stuff into new section of memory */
-    min_size = MIN(new_size, old_size);
-    if (min_size > 0) {
-      memcpy(new_user_pnt, pnt_info.pi_user_start, min_size);
+    for (line_p = buf; (end_p = strchr(line_p, '\n')) != NULL;
+	 line_p = end_p + 1) {
+      *end_p = '\0';
+      scan_maps_line(skips, skip_n, line_p);
     }
     
-    /* free old pointer */
-    if (_dmalloc_chunk_free(file, line, old_user_pnt,
-			    func_id) != FREE_NOERROR) {
-      return REALLOC_ERROR;
+    /* save the partial line for the next read unless it is too long */
+    len = buf + len - line_p;
+    if (len >= (int)sizeof(buf) - 1) {
+      len = 0;
     }
+    memmove(buf, line_p, len);
+  }
+  
+  (void)close(fd);
+  return 1;
+}
+
+/*
+ * static void scan_overflow
+ *
+ * Scan the slots which were marked while a mark stack was full.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> State of the marking thread.
+ */
+static	void	scan_overflow(leak_scan_t *scan_p)
+{
+  skip_alloc_t	*slot_p;
+  int		large_b;
+  
+  while (scan_overflow_b) {
+    scan_overflow_b = 0;
+    for (large_b = 0; large_b < 2; large_b++) {
+      if (large_b) {
+	slot_p = skip_large_list->sa_next_p[0];
+      }
+      else {
+	slot_p = skip_address_list->sa_next_p[0];
+      }
+      for (; slot_p != NULL; slot_p = slot_p->sa_next_p[0]) {
+	if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_SCAN_MARK)
+	    && (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_SCAN_DONE))) {
+	  scan_slot(scan_p, slot_p);
+	  scan_drain(scan_p);
+	}
+      }
+    }
+  }
+}
+
+/*
+ * static unsigned long scan_report
+ *
+ * Log the allocations that the mark phase did not reach and clear
+ * the marks.
+ *
+ * Returns the number of unreachable allocations.
+ */
+static	unsigned long	scan_report(void)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
+  unsigned long	block_c = 0, size_c = 0;
+  int		large_b;
+  
+  dmalloc_message("Dumping Unreachable Pointers:");
+  
+  _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
+		      sizeof(mem_table_changed_entries) /
+		      sizeof(*mem_table_changed_entries));
+  
+  for (large_b = 0; large_b < 2; large_b++) {
+    if (large_b) {
+      slot_p = skip_large_list->sa_next_p[0];
+    }
+    else {
+      slot_p = skip_address_list->sa_next_p[0];
+    }
+    for (; slot_p != NULL; slot_p = slot_p->sa_next_p[0]) {
+      if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_SCAN_MARK)) {
+	BIT_CLEAR(slot_p->sa_flags,
+		  ALLOC_FLAG_SCAN_MARK | ALLOC_FLAG_SCAN_DONE);
+	continue;
+      }
+      if ((! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER))
+	  || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)) {
+	continue;
+      }
+      
+      block_c++;
+      size_c += slot_p->sa_user_size;
+      
+      if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_KNOWN)
+	  && (slot_p->sa_file == DMALLOC_DEFAULT_FILE
+	      || slot_p->sa_line == DMALLOC_DEFAULT_LINE)) {
+	continue;
+      }
+      
+      get_pnt_info(slot_p, &pnt_info);
+      dmalloc_message(" unreachable: '%s' (%lu bytes) from '%s'",
+		      display_pnt(pnt_info.pi_user_start, slot_p, disp_buf,
+				  sizeof(disp_buf)),
+		      slot_p->sa_user_size,
+		      _dmalloc_chunk_desc_site(where_buf, sizeof(where_buf),
+					       slot_p->sa_file,
+					       slot_p->sa_line));
+      _dmalloc_table_insert(&mem_table_changed, slot_p->sa_file,
+			    slot_p->sa_line, slot_p->sa_user_size);
+    }
+  }
+  
+  /* the unreachable memory grouped by where it was allocated */
+  _dmalloc_table_log_info(&mem_table_changed, 0 /* log all entries */,
+			  0 /* no in-use column */);
+  
+  dmalloc_message(" unreachable memory: %lu pointer%s, %lu bytes",
+		  block_c, (block_c == 1 ? "" : "s"), size_c);
+  
+  return block_c;
+}
+
+#endif /* if LEAK_SCAN */
+
+/*
+ * int _dmalloc_chunk_scan_start
+ *
+ * Start the extra threads of the leak scan mark phase.  This must be
+ * called before taking the dmalloc lock since creating a thread may
+ * allocate memory.
+ *
+ * Returns 1 on success or 0 if another leak scan is running.
+ */
+int	_dmalloc_chunk_scan_start(void)
+{
+#if LEAK_SCAN_WORKERS
+  int	thread_c;
+  
+  pthread_mutex_lock(&scan_mutex);
+  if (scan_running_b) {
+    pthread_mutex_unlock(&scan_mutex);
+    return 0;
+  }
+  scan_running_b = 1;
+  scan_ready_n = 0;
+  scan_go_b = 0;
+  scan_quit_b = 0;
+  pthread_mutex_unlock(&scan_mutex);
+  
+  /* the calling thread is the first */
+  scan_thread_n = 1;
+  for (thread_c = 1; thread_c < LEAK_SCAN_THREADS; thread_c++) {
+    if (pthread_create(&scan_threads[thread_c], NULL, scan_thread,
+		       (void *)(PNT_ARITH_TYPE)thread_c) != 0) {
+      break;
+    }
+    scan_thread_n++;
   }
-  else {
-    /* new pointer is the same as the old one */
-    new_user_pnt = pnt_info.pi_user_start;
-    
-    /*
-     * monitor current allocation level
-     *
-     * NOTE: we do this here since the malloc/free used above take care
-     * on if in that section
-     */
-    alloc_current += new_size - old_size;
-    alloc_maximum = MAX(alloc_maximum, alloc_current);
-    _dmalloc_alloc_total += new_size;
-    alloc_one_max = MAX(alloc_one_max, new_size);
-    
-    /* monitor pointer usage */
-    alloc_tot_pnts++;
-    
-    /* change the slot information */
-    slot_p->sa_user_size = new_size;
-    get_pnt_info(slot_p, &pnt_info);
-    
-    clear_alloc(slot_p, &pnt_info, old_size, func_id);
-    
-    slot_p->sa_use_iter = _dmalloc_iter_c;
-#if LOG_PNT_SEEN_COUNT
-    /* we see in inbound and outbound so we need to increment by 2 */
-    slot_p->sa_seen_c += 2;
 #endif
-    
-#if MEMORY_TABLE_TOP_LOG
-    _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
-			  old_size);
-    _dmalloc_table_insert(&mem_table_alloc, file, line, new_size);
+  
+  return 1;
+}
+
+/*
+ * unsigned long _dmalloc_chunk_scan_leaks
+ *
+ * Conservatively mark the allocations reachable from the stacks, the
+ * registers of the calling thread, the data and bss segments and the
+ * other memory mapped by the program and log the user allocations
+ * which were not reached.
+ *
+ * Returns the number of unreachable allocations.
+ */
+unsigned long	_dmalloc_chunk_scan_leaks(void)
+{
+#if LEAK_SCAN
+  jmp_buf	regs;
+  unsigned long	unreached_n = 0;
+  int		thread_c, ret_b;
+#if HEAP_LARGE_OBJECTS
+  skip_alloc_t	*slot_p;
 #endif
   
-    /*
-     * finally, we update the file/line info -- must be after
-     * _dmalloc_table functions
-     */
-    slot_p->sa_file = file;
-    slot_p->sa_line = line;
+  /* save the callee-saved registers on the stack above our frames */
+  (void)setjmp(regs);
+  scan_stack_marks[0] = (char *)&regs;
+  
+#if LEAK_SCAN_WORKERS
+  /* wait for the threads to say where their stacks are */
+  if (scan_thread_n > 1) {
+    pthread_mutex_lock(&scan_mutex);
+    while (scan_ready_n < scan_thread_n - 1) {
+      pthread_cond_wait(&scan_cond, &scan_mutex);
+    }
+    pthread_mutex_unlock(&scan_mutex);
+  }
+#endif
+  
+  scan_mem_size = sizeof(leak_scan_t) * scan_thread_n
+    + sizeof(scan_range_t) * LEAK_SCAN_MAX_ROOTS
+    + sizeof(skip_alloc_t *) * LEAK_SCAN_STACK * (scan_thread_n + 1);
+  scan_mem = mmap(NULL, scan_mem_size, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANON, -1 /* no fd */, 0 /* no offset */);
+  if (scan_mem == MAP_FAILED) {
+    dmalloc_message("could not map %lu bytes for the leak scan",
+		    scan_mem_size);
+    scan_mem = NULL;
+    return 0;
   }
+  scan_states = (leak_scan_t *)scan_mem;
+  scan_roots = (scan_range_t *)(scan_states + scan_thread_n);
+  for (thread_c = 0; thread_c < scan_thread_n; thread_c++) {
+    scan_states[thread_c].ls_stack = (skip_alloc_t **)
+      (scan_roots + LEAK_SCAN_MAX_ROOTS) + LEAK_SCAN_STACK * thread_c;
+    scan_states[thread_c].ls_stack_n = 0;
+    scan_states[thread_c].ls_index = thread_c;
+    scan_states[thread_c].ls_large_low = NULL;
+    scan_states[thread_c].ls_large_high = NULL;
+  }
+#if LEAK_SCAN_WORKERS
+  scan_pool = (skip_alloc_t **)(scan_roots + LEAK_SCAN_MAX_ROOTS)
+    + LEAK_SCAN_STACK * scan_thread_n;
+  scan_pool_n = 0;
+  scan_idle_n = 0;
+#endif
+  scan_root_n = 0;
+  scan_overflow_b = 0;
   
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
-    const char	*trans_log;
-    char	where_buf[MAX_FILE_LENGTH + 64];
-    char	where_buf2[MAX_FILE_LENGTH + 64];
-    
-    if (func_id == DMALLOC_FUNC_RECALLOC) {
-      trans_log = "recalloc";
+  ret_b = scan_read_roots();
+  if (! ret_b) {
+    dmalloc_message("could not read the leak scan roots");
+  }
+  else {
+#if HEAP_LARGE_OBJECTS
+    /* bound the large objects so most words need no list search */
+    for (slot_p = skip_large_list->sa_next_p[0];
+         slot_p != NULL;
+         slot_p = slot_p->sa_next_p[0]) {
+      for (thread_c = 0; thread_c < scan_thread_n; thread_c++) {
+	if (scan_states[thread_c].ls_large_low == NULL
+	    || (char *)slot_p->sa_mem < scan_states[thread_c].ls_large_low) {
+	  scan_states[thread_c].ls_large_low = slot_p->sa_mem;
+	}
+	if ((char *)slot_p->sa_mem + slot_p->sa_total_size
+	    > scan_states[thread_c].ls_large_high) {
+	  scan_states[thread_c].ls_large_high =
+	    (char *)slot_p->sa_mem + slot_p->sa_total_size;
+	}
+      }
     }
-    else {
-      trans_log = "realloc";
+#endif
+    
+#if LEAK_SCAN_WORKERS
+    if (scan_thread_n > 1) {
+      pthread_mutex_lock(&scan_mutex);
+      scan_go_b = 1;
+      pthread_cond_broadcast(&scan_cond);
+      pthread_mutex_unlock(&scan_mutex);
     }
-    dmalloc_message("*** %s: at '%s' from '%p' (%u bytes) file '%s' to '%p' (%lu bytes)",
-		    trans_log,
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    file, line),
-		    old_user_pnt, old_size,
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    old_file, old_line),
-		    new_user_pnt, new_size);
+#endif
+    
+    scan_work(&scan_states[0]);
+    scan_overflow(&scan_states[0]);
+    unreached_n = scan_report();
   }
   
-  return new_user_pnt;
+  (void)munmap(scan_mem, scan_mem_size);
+  scan_mem = NULL;
+  
+  return unreached_n;
+#else
+  dmalloc_message("leak scan not supported");
+  return 0;
+#endif
 }
 
-/***************************** diagnostic routines ***************************/
-
 /*
- * void _dmalloc_chunk_log_stats
+ * void _dmalloc_chunk_scan_finish
  *
- * Log general statistics from the heap to the logfile.
+ * Wait for the extra threads of the leak scan to finish.  This must
+ * be called after the dmalloc lock is released since the exiting
+ * threads may free memory.
  */
-void	_dmalloc_chunk_log_stats(void)
+void	_dmalloc_chunk_scan_finish(void)
 {
-  unsigned long	overhead, user_space, tot_space;
-  
-  dmalloc_message("Dumping Chunk Statistics:");
-  
-  tot_space = (user_block_c + admin_block_c) * BLOCK_SIZE;
-  user_space = alloc_current + free_space_bytes;
-  overhead = admin_block_c * BLOCK_SIZE;
-  
-  /* version information */
-  dmalloc_message("basic-block %d bytes, alignment %d bytes",
-		  BLOCK_SIZE, ALLOCATION_ALIGNMENT);
+#if LEAK_SCAN_WORKERS
+  int	thread_c;
   
-  /* general heap information with blocks */
-  unsigned long diff = (PNT_ARITH_TYPE)_dmalloc_heap_high -
-    (PNT_ARITH_TYPE)_dmalloc_heap_low;
-  dmalloc_message("heap address range: %p to %p, %lu bytes",
-		  _dmalloc_heap_low, _dmalloc_heap_high, diff);
-  dmalloc_message("    user blocks: %ld blocks, %ld bytes (%ld%%)",
-		  user_block_c, user_space,
-		  (tot_space < 100 ? 0 : user_space / (tot_space / 100)));
-  dmalloc_message("   admin blocks: %ld blocks, %ld bytes (%ld%%)",
-		  admin_block_c, overhead,
-		  (tot_space < 100 ? 0 : overhead / (tot_space / 100)));
-  dmalloc_message("   total blocks: %ld blocks, %ld bytes",
-		  user_block_c + admin_block_c, tot_space);
+  pthread_mutex_lock(&scan_mutex);
+  scan_quit_b = 1;
+  pthread_cond_broadcast(&scan_cond);
+  pthread_mutex_unlock(&scan_mutex);
   
-  dmalloc_message("heap checked %ld", heap_check_c);
+  for (thread_c = 1; thread_c < scan_thread_n; thread_c++) {
+    (void)pthread_join(scan_threads[thread_c], NULL);
+  }
+  scan_thread_n = 1;
   
-  /* log user allocation information */
-  dmalloc_message("alloc calls: malloc %lu, calloc %lu, realloc %lu, free %lu",
-		  func_malloc_c, func_calloc_c, func_realloc_c, func_free_c);
-  dmalloc_message("alloc calls: recalloc %lu, memalign %lu, valloc %lu",
-		  func_recalloc_c, func_memalign_c, func_valloc_c);
-  dmalloc_message("alloc calls: new %lu, delete %lu",
-		  func_new_c, func_delete_c);
-  dmalloc_message("  current memory in use: %lu bytes (%lu pnts)",
-		  alloc_current, alloc_cur_pnts);
-  dmalloc_message(" total memory allocated: %lu bytes (%lu pnts)",
-		  _dmalloc_alloc_total, alloc_tot_pnts);
+  pthread_mutex_lock(&scan_mutex);
+  scan_running_b = 0;
+  pthread_mutex_unlock(&scan_mutex);
+#endif
+}
+
+/*
+ * void _dmalloc_chunk_snapshot
+ *
+ * Check the heap and log the statistics, the not-freed memory, and
+ * the unreachable memory.  This is run by the child process of
+ * dmalloc_snapshot_async on its copy of the heap so it can take as
+ * long as it needs without stalling the program.
+ */
+void	_dmalloc_chunk_snapshot(void)
+{
+  if (! _dmalloc_chunk_heap_check()) {
+    dmalloc_message("heap snapshot failed its heap check");
+  }
   
-  /* maximum stats */
-  dmalloc_message(" max in use at one time: %lu bytes (%lu pnts)",
-		  alloc_maximum, alloc_max_pnts);
-  dmalloc_message("max alloced with 1 call: %lu bytes",
-		  alloc_one_max);
-  dmalloc_message("max unused memory space: %lu bytes (%lu%%)",
-		  alloc_max_given - alloc_maximum,
-		  (alloc_max_given == 0 ? 0 :
-		   ((alloc_max_given - alloc_maximum) * 100) /
-		   alloc_max_given));
+  _dmalloc_chunk_log_stats();
+  _dmalloc_chunk_log_changed(0, 1, 0,
+#if DUMP_UNFREED_SUMMARY_ONLY
+			     0
+#else
+			     1
+#endif
+			     );
   
-#if MEMORY_TABLE_TOP_LOG
-  dmalloc_message("top %d allocations:", MEMORY_TABLE_TOP_LOG);
-  _dmalloc_table_log_info(&mem_table_alloc, MEMORY_TABLE_TOP_LOG,
-			  1 /* have in-use column */);
+#if LEAK_SCAN
+  /* only the forking thread made it into the child so mark alone */
+  scan_thread_n = 1;
+  (void)_dmalloc_chunk_scan_leaks();
 #endif
 }
 
+/********************************* heap dump *********************************/
+
+#if HEAP_DUMP
+
+/*
+ * static void *dump_map
+ *
+ * Map some zeroed memory for the heap dump to work in.
+ *
+ * Returns the memory or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes to map.
+ */
+static	void	*dump_map(const unsigned long size)
+{
+  void	*mem;
+  
+  mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+	     -1 /* no fd */, 0 /* no offset */);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+  return mem;
+}
+
 /*
- * void _dmalloc_chunk_log_changed
+ * static dump_entry_t *dump_find
  *
- * Log the pointers that has changed since a pointer in time.
+ * Find the entry of a file and line in one of the heap dump tables
+ * adding it if it is not there.  The table is doubled when it gets
+ * half full.
+ *
+ * Returns the entry or NULL if the table could not grow.
  *
  * ARGUMENTS:
  *
- * mark -> Dmalloc counter used to mark a specific time so that
- * servers can check on the changed pointers.
+ * table_p -> Table we are looking in.
  *
- * log_non_free_b -> If set to 1 then log the new not-freed
- * (i.e. used) pointers.
+ * file -> File-name or return-address of the entry.
  *
- * log_free_b -> If set to 1 then log the new freed pointers.
+ * line -> Line number of the entry.
  *
- * details_b -> If set to 1 then dump the individual pointer entries
- * instead of just the summary.
+ * new_bp <- Set to 1 if the entry was added otherwise 0.
  */
-void	_dmalloc_chunk_log_changed(const unsigned long mark,
-				   const int log_not_freed_b,
-				   const int log_freed_b, const int details_b)
+static	dump_entry_t	*dump_find(dump_table_t *table_p, const char *file,
+				   const unsigned int line, int *new_bp)
 {
-  skip_alloc_t	*slot_p;
-  pnt_info_t	pnt_info;
-  int		known_b, freed_b, used_b;
-  char		out[DUMP_SPACE * 4], *which_str;
-  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
-  int		unknown_size_c = 0, unknown_block_c = 0, out_len;
-  int		size_c = 0, block_c = 0, checking_list_c = 0;
-  
-  if (log_not_freed_b && log_freed_b) {
-    which_str = "Not-Freed and Freed";
-  }
-  else if (log_not_freed_b) {
-    which_str = "Not-Freed";
-  }
-  else if (log_freed_b) {
-    which_str = "Freed";
-  }
-  else {
-    return;
-  }
-  
-  if (mark == 0) {
-    dmalloc_message("Dumping %s Pointers Changed Since Start:", which_str);
-  }
-  else {
-    dmalloc_message("Dumping %s Pointers Changed Since Mark %lu:",
-		    which_str, mark);
-  }
-  
-  /* clear out our memory table so we can fill it with pointer info */
-  _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
-		      sizeof(mem_table_changed_entries) /
-		      sizeof(*mem_table_changed_entries));
-  
-  /* run through the blocks */
-  for (slot_p = skip_address_list->sa_next_p[0];
-       ;
-       slot_p = slot_p->sa_next_p[0]) {
-    
-    /*
-     * switch to the free list in the middle after we've checked the
-     * used pointer slots
-     */
-    if (slot_p == NULL) {
-      checking_list_c++;
-      if (checking_list_c == 1) {
-	slot_p = skip_free_list->sa_next_p[0];
-      }
-#if FREED_POINTER_DELAY
-      else if (checking_list_c == 2) {
-	slot_p = free_wait_list_head;
-      }
-#endif
-      else {
-	/* we are done */
-	break;
-      }
-      if (slot_p == NULL) {
-	break;
+  dump_entry_t	*entry_p, *old_entries, *old_p;
+  unsigned long	hash, old_size;
+  
+  if (table_p->dt_entry_n * 2 >= table_p->dt_size) {
+    old_entries = table_p->dt_entries;
+    old_size = table_p->dt_size;
+    if (old_size == 0) {
+      table_p->dt_size = DUMP_TABLE_START;
+    }
+    else {
+      table_p->dt_size = old_size * 2;
+    }
+    table_p->dt_entries = dump_map(table_p->dt_size * sizeof(dump_entry_t));
+    if (table_p->dt_entries == NULL) {
+      table_p->dt_entries = old_entries;
+      table_p->dt_size = old_size;
+      return NULL;
+    }
+    table_p->dt_entry_n = 0;
+    for (old_p = old_entries; old_p < old_entries + old_size; old_p++) {
+      if (old_p->de_used_b) {
+	entry_p = dump_find(table_p, old_p->de_file, old_p->de_line, new_bp);
+	entry_p->de_value = old_p->de_value;
       }
     }
-    
-    freed_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE);
-    used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
-    
-    /*
-     * check for different types
-     */
-    if (! (freed_b || used_b)) {
-      continue;
+    if (old_entries != NULL) {
+      (void)munmap(old_entries, old_size * sizeof(dump_entry_t));
     }
-    
-    /* do we want to dump this one? */
-    if (! ((log_not_freed_b && used_b) || (log_freed_b && freed_b))) {
-      continue;
-    }    
-    /* is it too long ago? */
-    if (slot_p->sa_use_iter <= mark) {
-      continue;
+  }
+  
+  hash = ((PNT_ARITH_TYPE)file >> 3) * 31 + line;
+  hash ^= hash >> 16;
+  for (entry_p = table_p->dt_entries + (hash & (table_p->dt_size - 1));
+       entry_p->de_used_b;) {
+    if (entry_p->de_file == file && entry_p->de_line == line) {
+      *new_bp = 0;
+      return entry_p;
     }
-    
-    /* unknown pointer? */
-    if (slot_p->sa_file == DMALLOC_DEFAULT_FILE
-	|| slot_p->sa_line == DMALLOC_DEFAULT_LINE) {
-      unknown_block_c++;
-      unknown_size_c += slot_p->sa_user_size;
-      known_b = 0;
+    entry_p++;
+    if (entry_p == table_p->dt_entries + table_p->dt_size) {
+      entry_p = table_p->dt_entries;
     }
-    else {
-      known_b = 1;
+  }
+  
+  entry_p->de_file = file;
+  entry_p->de_line = line;
+  entry_p->de_used_b = 1;
+  table_p->dt_entry_n++;
+  *new_bp = 1;
+  return entry_p;
+}
+
+/*
+ * static void dump_flush
+ *
+ * Write the buffered bytes of a heap dump to its file.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are writing.
+ */
+static	void	dump_flush(heap_dump_t *dump_p)
+{
+  char	*buf_p = dump_p->hd_buf;
+  int	ret;
+  
+  while (dump_p->hd_buf_n > 0 && ! dump_p->hd_error_b) {
+    ret = write(dump_p->hd_fd, buf_p, dump_p->hd_buf_n);
+    if (ret <= 0) {
+      dump_p->hd_error_b = 1;
+      break;
     }
-    
-    get_pnt_info(slot_p, &pnt_info);
-    
-    if (known_b || (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_KNOWN))) {
-      if (details_b) {
-	dmalloc_message(" %s freed: '%s' (%u bytes) from '%s'",
-			(freed_b ? "   " : "not"),
-			display_pnt(pnt_info.pi_user_start, slot_p, disp_buf,
-				    sizeof(disp_buf)),
-			slot_p->sa_user_size,
-			_dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-						slot_p->sa_file,
-						slot_p->sa_line));
-	
-	if ((! freed_b)
-	    && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_NONFREE_SPACE)) {
-	  out_len = expand_chars((char *)pnt_info.pi_user_start, DUMP_SPACE,
-				 out, sizeof(out));
-	  dmalloc_message("  dump of '%p': '%.*s'",
-			  pnt_info.pi_user_start, out_len, out);
-	}
-      }
-      _dmalloc_table_insert(&mem_table_changed, slot_p->sa_file,
-			    slot_p->sa_line, slot_p->sa_user_size);
+    buf_p += ret;
+    dump_p->hd_buf_n -= ret;
+  }
+  dump_p->hd_buf_n = 0;
+}
+
+/*
+ * static void dump_write
+ *
+ * Add some bytes to a heap dump.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are writing.
+ *
+ * buf -> Bytes to write or NULL for zeros.
+ *
+ * size -> Number of bytes.
+ */
+static	void	dump_write(heap_dump_t *dump_p, const void *buf,
+			   const unsigned long size)
+{
+  const char	*buf_p = buf;
+  unsigned long	left = size, len;
+  
+  while (left > 0) {
+    if (dump_p->hd_buf_n == DUMP_BUF_SIZE) {
+      dump_flush(dump_p);
+    }
+    len = DUMP_BUF_SIZE - dump_p->hd_buf_n;
+    if (len > left) {
+      len = left;
+    }
+    if (buf_p == NULL) {
+      memset(dump_p->hd_buf + dump_p->hd_buf_n, 0, len);
+    }
+    else {
+      memcpy(dump_p->hd_buf + dump_p->hd_buf_n, buf_p, len);
+      buf_p += len;
     }
+    dump_p->hd_buf_n += len;
+    left -= len;
+  }
+  dump_p->hd_off += size;
+}
+
+/*
+ * static void dump_align
+ *
+ * Pad a heap dump out to the start of the next section.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are writing.
+ */
+static	void	dump_align(heap_dump_t *dump_p)
+{
+  if (dump_p->hd_off % DUMP_ALIGN != 0) {
+    dump_write(dump_p, NULL, DUMP_ALIGN - dump_p->hd_off % DUMP_ALIGN);
   }
+}
+
+/*
+ * static unsigned long dump_site
+ *
+ * Find the index of the site of an allocation in the heap dump and
+ * the offset of its file-name.
+ *
+ * Returns the site index or DUMP_NO_NAME if the tables are full.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are writing.
+ *
+ * file -> File-name or return-address of the allocation.
+ *
+ * line -> Line number of the allocation.
+ */
+static	unsigned long	dump_site(heap_dump_t *dump_p, const char *file,
+				  const unsigned int line)
+{
+  dump_entry_t	*site_p, *name_p;
+  int		new_b;
   
-  /* dump the summary from the table table */
-  _dmalloc_table_log_info(&mem_table_changed, 0 /* log all entries */,
-			  0 /* no in-use column */);
+  site_p = dump_find(&dump_p->hd_sites, file, line, &new_b);
+  if (site_p == NULL) {
+    return DUMP_NO_NAME;
+  }
+  if (! new_b) {
+    return site_p->de_value;
+  }
+  site_p->de_value = dump_p->hd_sites.dt_entry_n - 1;
   
-  /* copy out size of pointers */
-  if (block_c > 0) {
-    if (block_c - unknown_block_c > 0) {
-      dmalloc_message(" known memory: %d pointer%s, %d bytes",
-		      block_c - unknown_block_c,
-		      (block_c - unknown_block_c == 1 ? "" : "s"),
-		      size_c - unknown_size_c);
+  /* each file-name is written out once for all of its lines */
+  if (file != DMALLOC_DEFAULT_FILE && line != DMALLOC_DEFAULT_LINE) {
+    name_p = dump_find(&dump_p->hd_names, file, 0, &new_b);
+    if (name_p == NULL) {
+      return DUMP_NO_NAME;
     }
-    if (unknown_block_c > 0) {
-      dmalloc_message(" unknown memory: %d pointer%s, %d bytes",
-		      unknown_block_c, (unknown_block_c == 1 ? "" : "s"),
-		      unknown_size_c);
+    if (new_b) {
+      name_p->de_value = dump_p->hd_name_size;
+      dump_p->hd_name_size += strlen(file) + 1;
     }
   }
+  
+  return site_p->de_value;
 }
 
 /*
- * unsigned long _dmalloc_chunk_count_changed
+ * static long dump_slots
  *
- * Return the pointers that has changed since a pointer in time.
+ * Write the records of the used and free slots or the user bytes of
+ * the used ones to a heap dump.  Both passes go through the slots in
+ * the same order.
  *
- * Returns the number of bytes changed since mark.
+ * Returns the number of slots written or -1 if the tables are full.
  *
  * ARGUMENTS:
  *
- * mark -> Dmalloc counter used to mark a specific time so that
- * servers can check on the changed pointers.
+ * dump_p -> Heap dump we are writing.
  *
- * count_non_free_b -> If set to 1 then count the new not-freed
- * (i.e. used) pointers.
+ * data_b -> Set to 1 to write the user bytes instead of the records.
  *
- * count_free_b -> If set to 1 then count the new freed pointers.
+ * has_data_b -> Set to 1 if the user bytes will be written.
  */
-unsigned long	_dmalloc_chunk_count_changed(const unsigned long mark,
-					     const int count_not_freed_b,
-					     const int count_freed_b)
+static	long	dump_slots(heap_dump_t *dump_p, const int data_b,
+			   const int has_data_b)
 {
   skip_alloc_t	*slot_p;
-  int		freed_b, used_b;
-  int		checking_list_c = 0;
-  unsigned int	mem_count = 0;
-  
-  /* run through the blocks */
-  for (slot_p = skip_address_list->sa_next_p[0];
-       ;
-       slot_p = slot_p->sa_next_p[0]) {
+  pnt_info_t	pnt_info;
+  dump_rec_t	rec;
+  unsigned long	data_off = 0;
+  long		rec_c = 0;
+  int		list_c, used_b;
+  
+  for (list_c = 0; list_c <= LARGE_LIST_PASS; list_c++) {
+    /* the used slots, then the free lists, then the large objects */
+    if (list_c == 0) {
+      slot_p = skip_address_list->sa_next_p[0];
+    }
+    else if (list_c == 1) {
+      slot_p = skip_free_list->sa_next_p[0];
+    }
+#if FREED_POINTER_DELAY
+    else if (list_c == 2) {
+      slot_p = free_wait_list_head;
+    }
+#endif
+    else {
+      slot_p = skip_large_list->sa_next_p[0];
+    }
     
-    /*
-     * switch to the free list in the middle after we've checked the
-     * used pointer slots
-     */
-    if (slot_p == NULL) {
-      checking_list_c++;
-      if (checking_list_c == 1) {
-	slot_p = skip_free_list->sa_next_p[0];
+    for (; slot_p != NULL; slot_p = slot_p->sa_next_p[0]) {
+      used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
+      if (! (used_b || BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE))) {
+	continue;
       }
-#if FREED_POINTER_DELAY
-      else if (checking_list_c == 2) {
-	slot_p = free_wait_list_head;
+      get_pnt_info(slot_p, &pnt_info);
+      rec_c++;
+      
+      if (data_b) {
+	if (used_b) {
+	  dump_write(dump_p, pnt_info.pi_user_start, slot_p->sa_user_size);
+	}
+	continue;
+      }
+      
+      memset(&rec, 0, sizeof(rec));
+      if (used_b) {
+	rec.dr_addr = (PNT_ARITH_TYPE)pnt_info.pi_user_start;
+	rec.dr_user_size = slot_p->sa_user_size;
+	rec.dr_flags = DUMP_REC_USED;
+	if (has_data_b) {
+	  rec.dr_data = data_off;
+	  data_off += slot_p->sa_user_size;
+	}
+	rec.dr_site = dump_site(dump_p, slot_p->sa_file, slot_p->sa_line);
+	if (rec.dr_site == (unsigned int)DUMP_NO_NAME) {
+	  return -1;
+	}
       }
-#endif
       else {
-	/* we are done */
-	break;
+	rec.dr_addr = (PNT_ARITH_TYPE)slot_p->sa_mem;
+	rec.dr_flags = DUMP_REC_FREE;
+	rec.dr_site = (unsigned int)DUMP_NO_NAME;
       }
-      if (slot_p == NULL) {
-	break;
+      rec.dr_total_size = slot_p->sa_total_size;
+      rec.dr_use_iter = slot_p->sa_use_iter;
+      if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_LARGE)) {
+	rec.dr_flags |= DUMP_REC_LARGE;
       }
-    }
-    
-    freed_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE);
-    used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
-    
-    /*
-     * check for different types
-     */
-    if (! (freed_b || used_b)) {
-      continue;
-    }
-    /* is it too long ago? */
-    if (slot_p->sa_use_iter <= mark) {
-      continue;
-    }
-    
-    /* count the memory */
-    if (count_not_freed_b && used_b) {
-      mem_count += slot_p->sa_user_size;
-    }
-    else if (count_freed_b && freed_b) {
-      mem_count += slot_p->sa_user_size;
+      if (pnt_info.pi_fence_b) {
+	rec.dr_flags |= DUMP_REC_FENCE;
+      }
+      if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_PURGED)) {
+	rec.dr_flags |= DUMP_REC_PURGED;
+      }
+      dump_write(dump_p, &rec, sizeof(rec));
     }
   }
   
-  return mem_count;
+  return rec_c;
 }
 
 /*
- * void _dmalloc_chunk_get_stats
+ * static int dump_names
  *
- * Return a number of statistics about the current heap.
+ * Write the sites and then the file-names of a heap dump.
+ *
+ * Returns 1 on success or 0 if there was no memory for them.
  *
  * ARGUMENTS:
  *
- * heap_low_p <- Pointer to pointer which, if not 0L, will be set to
- * the low address in the heap.
+ * dump_p -> Heap dump we are writing.
  *
- * heap_high_p <- Pointer to pointer which, if not 0L, will be set to
- * the high address in the heap.
+ * header_p -> Header whose offsets we fill in.
+ */
+static	int	dump_names(heap_dump_t *dump_p, dump_header_t *header_p)
+{
+  dump_site_t	*sites = NULL;
+  char		*names = NULL;
+  dump_entry_t	*entry_p, *name_p, *bounds_p;
+  unsigned long	sites_size, names_size;
+  int		new_b, ret = 1;
+  
+  sites_size = dump_p->hd_sites.dt_entry_n * sizeof(dump_site_t);
+  names_size = dump_p->hd_name_size;
+  if (sites_size > 0) {
+    sites = dump_map(sites_size);
+  }
+  if (names_size > 0) {
+    names = dump_map(names_size);
+  }
+  if ((sites_size > 0 && sites == NULL) || (names_size > 0 && names == NULL)) {
+    ret = 0;
+  }
+  else {
+    /* put the entries in the order of their indexes and offsets */
+    bounds_p = dump_p->hd_sites.dt_entries + dump_p->hd_sites.dt_size;
+    for (entry_p = dump_p->hd_sites.dt_entries;
+	 entry_p < bounds_p;
+	 entry_p++) {
+      if (! entry_p->de_used_b) {
+	continue;
+      }
+      sites[entry_p->de_value].ds_line = entry_p->de_line;
+      if (entry_p->de_file == DMALLOC_DEFAULT_FILE
+	  || entry_p->de_line == DMALLOC_DEFAULT_LINE) {
+	sites[entry_p->de_value].ds_name = DUMP_NO_NAME;
+	sites[entry_p->de_value].ds_ra = (PNT_ARITH_TYPE)entry_p->de_file;
+	continue;
+      }
+      name_p = dump_find(&dump_p->hd_names, entry_p->de_file, 0, &new_b);
+      sites[entry_p->de_value].ds_name = name_p->de_value;
+      strcpy(names + name_p->de_value, entry_p->de_file);
+    }
+    
+    dump_align(dump_p);
+    header_p->dh_site_n = dump_p->hd_sites.dt_entry_n;
+    header_p->dh_site_off = dump_p->hd_off;
+    dump_write(dump_p, sites, sites_size);
+    
+    header_p->dh_str_size = names_size;
+    header_p->dh_str_off = dump_p->hd_off;
+    dump_write(dump_p, names, names_size);
+  }
+  
+  if (sites != NULL) {
+    (void)munmap(sites, sites_size);
+  }
+  if (names != NULL) {
+    (void)munmap(names, names_size);
+  }
+  return ret;
+}
+
+#endif /* if HEAP_DUMP */
+
+/*
+ * int _dmalloc_chunk_dump_heap
  *
- * total_space_p <- Pointer to an unsigned long which, if not 0L, will
- * be set to the total space managed by the library including user
- * space, administrative space, and overhead.
+ * Write the used and free slots of the heap to a dump file which the
+ * dmalloc utility can analyze.  See heap_dump.h for the format.
  *
- * user_space_p <- Pointer to an unsigned long which, if not 0L, will
- * be set to the space given to the user process (allocated and free).
+ * Returns 1 on success or 0 on failure.
  *
- * current_allocated_p <- Pointer to an unsigned long which, if not
- * 0L, will be set to the current allocated space given to the user
- * process.
+ * ARGUMENTS:
  *
- * current_pnt_np <- Pointer to an unsigned long which, if not 0L,
- * will be set to the current number of pointers allocated by the user
- * process.
+ * path -> Path of the dump file.
  *
- * max_allocated_p <- Pointer to an unsigned long which, if not 0L,
- * will be set to the maximum allocated space given to the user
- * process.
+ * data_b -> Set to 1 to also write the user bytes of the allocations.
+ */
+int	_dmalloc_chunk_dump_heap(const char *path, const int data_b)
+{
+#if HEAP_DUMP
+  heap_dump_t	dump;
+  dump_header_t	header;
+  dump_range_t	range;
+  long		rec_n;
+  int		ret = 1;
+  
+  memset(&dump, 0, sizeof(dump));
+  memset(&header, 0, sizeof(header));
+  
+  dump.hd_buf = dump_map(DUMP_BUF_SIZE);
+  if (dump.hd_buf == NULL) {
+    dmalloc_message("could not map the heap dump buffer");
+    return 0;
+  }
+  dump.hd_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (dump.hd_fd < 0) {
+    dmalloc_message("could not open heap dump '%s'", path);
+    (void)munmap(dump.hd_buf, DUMP_BUF_SIZE);
+    return 0;
+  }
+  
+  /* the header is written again at the end with the offsets */
+  dump_write(&dump, &header, sizeof(header));
+  
+  header.dh_rec_off = dump.hd_off;
+  rec_n = dump_slots(&dump, 0 /* records */, data_b);
+  if (rec_n < 0) {
+    dmalloc_message("could not map the heap dump tables");
+    ret = 0;
+  }
+  else {
+    header.dh_rec_n = rec_n;
+    if (data_b) {
+      header.dh_flags |= DUMP_HAS_DATA;
+      header.dh_data_off = dump.hd_off;
+      (void)dump_slots(&dump, 1 /* user bytes */, data_b);
+    }
+    if (! dump_names(&dump, &header)) {
+      dmalloc_message("could not map the heap dump names");
+      ret = 0;
+    }
+  }
+  
+  if (ret) {
+    dump_align(&dump);
+    range.dg_low = (PNT_ARITH_TYPE)_dmalloc_heap_low;
+    range.dg_high = (PNT_ARITH_TYPE)_dmalloc_heap_high;
+    header.dh_range_n = 1;
+    header.dh_range_off = dump.hd_off;
+    dump_write(&dump, &range, sizeof(range));
+    dump_flush(&dump);
+    
+    memcpy(header.dh_magic, DUMP_MAGIC, sizeof(header.dh_magic));
+    header.dh_version = DUMP_VERSION;
+    header.dh_long_size = sizeof(unsigned long);
+#if HAVE_GETPID
+    header.dh_pid = getpid();
+#endif
+    header.dh_iter = _dmalloc_iter_c;
+    if (lseek(dump.hd_fd, 0, SEEK_SET) != 0) {
+      dump.hd_error_b = 1;
+    }
+    dump.hd_off = 0;
+    dump_write(&dump, &header, sizeof(header));
+    dump_flush(&dump);
+    
+    if (dump.hd_error_b) {
+      dmalloc_message("could not write heap dump '%s'", path);
+      ret = 0;
+    }
+  }
+  
+  (void)close(dump.hd_fd);
+  (void)munmap(dump.hd_buf, DUMP_BUF_SIZE);
+  if (dump.hd_sites.dt_entries != NULL) {
+    (void)munmap(dump.hd_sites.dt_entries,
+		 dump.hd_sites.dt_size * sizeof(dump_entry_t));
+  }
+  if (dump.hd_names.dt_entries != NULL) {
+    (void)munmap(dump.hd_names.dt_entries,
+		 dump.hd_names.dt_size * sizeof(dump_entry_t));
+  }
+  
+  if (ret && ! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    dmalloc_message("dumped %ld heap records to '%s'", rec_n, path);
+  }
+  return ret;
+#else
+  dmalloc_message("heap dumps not supported without mmap");
+  return 0;
+#endif
+}
+
+#if LIVE_STATS
+/*
+ * static int live_open
  *
- * max_pnt_np <- Pointer to an unsigned long which, if not 0L, will be
- * set to the maximum number of pointers allocated by the user
- * process.
+ * Create and map the live statistics file of the process.  A child of
+ * fork comes through here again so that it leaves its parent's file
+ * alone.  The path is easy to guess so the file is always created
+ * new and never through a symbolic link.  A file left by an earlier
+ * process with the same id is only removed if it is a regular file
+ * of ours.
  *
- * max_one_p <- Pointer to an unsigned long which, if not 0L, will be
- * set to the maximum allocated with 1 call by the user process.
+ * Returns 1 on success or 0 on failure.
  */
-void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
-				 unsigned long *total_space_p,
-				 unsigned long *user_space_p,
-				 unsigned long *current_allocated_p,
-				 unsigned long *current_pnt_np,
-				 unsigned long *max_allocated_p,
-				 unsigned long *max_pnt_np,
-				 unsigned long *max_one_p)
+static	int	live_open(void)
 {
-  SET_POINTER(heap_low_p, _dmalloc_heap_low);
-  SET_POINTER(heap_high_p, _dmalloc_heap_high);
-  SET_POINTER(total_space_p, (user_block_c + admin_block_c) * BLOCK_SIZE);
-  SET_POINTER(user_space_p, alloc_current + free_space_bytes);
-  SET_POINTER(current_allocated_p, alloc_current);
-  SET_POINTER(current_pnt_np, alloc_cur_pnts);
-  SET_POINTER(max_allocated_p, alloc_maximum);
-  SET_POINTER(max_pnt_np, alloc_max_pnts);
-  SET_POINTER(max_one_p, alloc_one_max);
+  char		path[512];
+  struct stat	st;
+  void		*mem;
+  int		fd;
+  
+  if (live_p != NULL) {
+    (void)munmap(live_p, sizeof(live_stats_t));
+    live_p = NULL;
+  }
+  /* we only try once in each process */
+  live_pid = getpid();
+  
+  (void)loc_snprintf(path, sizeof(path), LIVE_STATS_PATH, (long)live_pid);
+  if (lstat(path, &st) == 0) {
+    if ((! S_ISREG(st.st_mode)) || st.st_uid != getuid()) {
+      dmalloc_message("live stats '%s' is not a file of ours", path);
+      return 0;
+    }
+    (void)unlink(path);
+  }
+  fd = open(path, LIVE_OPEN_FLAGS, 0600);
+  if (fd < 0) {
+    dmalloc_message("could not open live stats '%s'", path);
+    return 0;
+  }
+  if (ftruncate(fd, sizeof(live_stats_t)) != 0) {
+    dmalloc_message("could not size live stats '%s'", path);
+    (void)close(fd);
+    return 0;
+  }
+  mem = mmap(NULL, sizeof(live_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+	     fd, 0);
+  (void)close(fd);
+  if (mem == MAP_FAILED) {
+    dmalloc_message("could not map live stats '%s'", path);
+    return 0;
+  }
+  
+  live_p = mem;
+  return 1;
+}
+#endif /* if LIVE_STATS */
+
+/*
+ * void _dmalloc_chunk_live_stats
+ *
+ * Write the statistics into the live statistics file, creating it
+ * the first time.  See live_stats.h for the format.  This must be
+ * called with the library locked.
+ *
+ * ARGUMENTS:
+ *
+ * exit_b -> Set to 1 if the program is shutting down.
+ */
+void	_dmalloc_chunk_live_stats(const int exit_b)
+{
+#if LIVE_STATS
+  mem_entry_t	*top[LIVE_SITE_N];
+  unsigned long	counts[STAT_COUNTER_N];
+  live_site_t	*site_p;
+  int		top_n, top_c, count_c;
+  
+  if (live_pid != (unsigned long)getpid() && ! live_open()) {
+    return;
+  }
+  if (live_p == NULL) {
+    return;
+  }
+  
+  sum_counts(counts);
+  top_n = _dmalloc_table_top(&mem_table_alloc, top, LIVE_SITE_N);
+  
+  /* the readers retry while the sequence is odd or if it changes */
+  live_p->ls_seq++;
+  LIVE_BARRIER();
+  
+  memcpy(live_p->ls_magic, LIVE_MAGIC, sizeof(live_p->ls_magic));
+  live_p->ls_version = LIVE_VERSION;
+  live_p->ls_long_size = sizeof(unsigned long);
+  live_p->ls_size = sizeof(live_stats_t);
+  live_p->ls_pid = live_pid;
+  if (exit_b) {
+    live_p->ls_flags |= LIVE_EXITED;
+  }
+  live_p->ls_update_c++;
+#if HAVE_TIME
+  live_p->ls_time = time(NULL);
+#endif
+  live_p->ls_iter = _dmalloc_iter_c;
+  
+  live_p->ls_cur_size = alloc_current;
+  live_p->ls_cur_pnts = alloc_cur_pnts;
+  live_p->ls_max_size = alloc_maximum;
+  live_p->ls_max_pnts = alloc_max_pnts;
+  live_p->ls_max_one = alloc_one_max;
+  live_p->ls_total_size = counts[STAT_ALLOC_BYTES];
+  live_p->ls_total_pnts = counts[STAT_ALLOC_PNTS];
+  /* the calls are the first of the counters */
+  for (count_c = 0; count_c < LIVE_COUNT_N; count_c++) {
+    live_p->ls_counts[count_c] = counts[count_c];
+  }
+  
+  live_p->ls_user_block_c = user_block_c;
+  live_p->ls_admin_block_c = admin_block_c;
+  live_p->ls_large_c = large_object_c;
+  live_p->ls_large_size = large_space_bytes;
+  live_p->ls_user_space = alloc_current + free_space_bytes;
+  live_p->ls_admin_space = admin_block_c * BLOCK_SIZE;
+  live_p->ls_total_space =
+    (user_block_c + admin_block_c) * BLOCK_SIZE + large_space_bytes;
+  live_p->ls_purged_size = purged_space_bytes;
+  live_p->ls_heap_check_c = heap_check_c;
+  
+  for (top_c = 0; top_c < top_n; top_c++) {
+    site_p = live_p->ls_sites + top_c;
+    site_p->lt_in_use_size = top[top_c]->me_in_use_size;
+    site_p->lt_in_use_c = top[top_c]->me_in_use_c;
+    site_p->lt_total_size = top[top_c]->me_total_size;
+    site_p->lt_total_c = top[top_c]->me_total_c;
+    /* the symbols are not looked up here since this is often */
+    (void)_dmalloc_chunk_desc_pnt(site_p->lt_desc, sizeof(site_p->lt_desc),
+				  top[top_c]->me_file, top[top_c]->me_line);
+  }
+  live_p->ls_site_n = top_n;
+  
+  LIVE_BARRIER();
+  live_p->ls_seq++;
+#endif
 }
@@ -28,10 +28,6 @@
 extern
 unsigned long		_dmalloc_memory_limit;
 
-/* total number of bytes that the heap has allocated */
-extern
-unsigned long		_dmalloc_alloc_total;
-
 /*
  * int _dmalloc_chunk_startup
  * 
@@ -64,6 +60,32 @@ extern
 char	*_dmalloc_chunk_desc_pnt(char *buf, const int buf_size,
 				 const char *file, const unsigned int line);
 
+/*
+ * char *_dmalloc_chunk_desc_site
+ *
+ * Write into a buffer the description of where a pointer was
+ * allocated for the reports.  Return-addresses are followed by their
+ * module, offset, and function if they can be found.  This should not
+ * be used when logging each transaction since the first address of a
+ * module has its symbols read in.
+ *
+ * Returns a pointer to buffer 1st argument.
+ *
+ * ARGUMENTS:
+ *
+ * buf <-> Passed in buffer which will be filled with a description of
+ * the pointer.
+ *
+ * buf_size -> Size of the buffer in bytes.
+ *
+ * file -> File name, return address, or NULL.
+ *
+ * line -> Line number or 0.
+ */
+extern
+char	*_dmalloc_chunk_desc_site(char *buf, const int buf_size,
+				  const char *file, const unsigned int line);
+
 /*
  * int _dmalloc_chunk_read_info
  *
@@ -103,15 +125,19 @@ char	*_dmalloc_chunk_desc_pnt(char *buf, const int buf_size,
  *
  * fence_bp <- Pointer to an integer which, if not NULL, will be set
  * to 1 if the pointer has the fence bit set otherwise 0.
+ *
+ * shared_b -> Set to 1 if the library lock is only held shared with
+ * other readers.  Nothing is logged so on a 0 return the caller
+ * should make the call again under the exclusive lock to report it.
  */
 extern
 int	_dmalloc_chunk_read_info(const void *user_pnt, const char *where,
-				 unsigned int *user_size_p,
-				 unsigned int *alloc_size_p, char **file_p,
+				 unsigned long *user_size_p,
+				 unsigned long *alloc_size_p, char **file_p,
 				 unsigned int *line_p, void **ret_attr_p,
 				 unsigned long **seen_cp,
 				 unsigned long *used_p, int *valloc_bp,
-				 int *fence_bp);
+				 int *fence_bp, const int shared_b);
 
 /*
  * int _dmalloc_chunk_heap_check
@@ -123,6 +149,33 @@ int	_dmalloc_chunk_read_info(const void *user_pnt, const char *where,
 extern
 int	_dmalloc_chunk_heap_check(void);
 
+/*
+ * int _dmalloc_chunk_shadow_check
+ *
+ * Quickly check a pointer against the shadow map without locking.
+ * This can only say that a pointer is good.  It does not look at the
+ * fence-posts or the slot itself.
+ *
+ * Returns 1 if the pointer is okay or 0 if the caller needs to make
+ * the full check with _dmalloc_chunk_pnt_check.
+ *
+ * ARGUMENTS:
+ *
+ * user_pnt -> Pointer we are checking.
+ *
+ * exact_b -> Set to 1 to find the pointer specifically.  Otherwise we
+ * can find the pointer inside of an allocation.
+ *
+ * strlen_b -> Make sure that pnt can hold at least a strlen + 1
+ * bytes.  If 0 then ignore.
+ *
+ * min_size -> Make sure that pnt can hold at least that many bytes.
+ * If 0 then ignore.
+ */
+extern
+int	_dmalloc_chunk_shadow_check(const void *user_pnt, const int exact_b,
+				    const int strlen_b, const int min_size);
+
 /*
  * int _dmalloc_chunk_pnt_check
  *
@@ -144,11 +197,53 @@ int	_dmalloc_chunk_heap_check(void);
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * shared_b -> Set to 1 if the library lock is only held shared with
+ * other readers.  Nothing is logged so on a 0 return the caller
+ * should make the call again under the exclusive lock to report it.
  */
 extern
 int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
 				 const int exact_b, const int strlen_b,
-				 const int min_size);
+				 const int min_size, const int shared_b);
+
+/*
+ * void _dmalloc_chunk_flags_changed
+ *
+ * Select the malloc and free paths which match the current debug
+ * flags.  This must be called whenever _dmalloc_flags is changed.
+ */
+extern
+void	_dmalloc_chunk_flags_changed(void);
+
+/*
+ * void _dmalloc_chunk_policies
+ *
+ * Set the debug policies from the environment.  Policies which cannot
+ * be parsed are logged and skipped.
+ *
+ * ARGUMENTS:
+ *
+ * policy_str -> Policies separated by POLICY_SEP_CHAR or NULL for
+ * none.
+ */
+extern
+void	_dmalloc_chunk_policies(const char *policy_str);
+
+/*
+ * void _dmalloc_chunk_size_classes
+ *
+ * Set the size classes of the divided blocks from the environment.
+ * The classes cannot change once blocks have been cut into slots so
+ * a change after that is logged and ignored.
+ *
+ * ARGUMENTS:
+ *
+ * classes_str -> Sizes of the classes separated by CLASS_SEP_CHAR or
+ * NULL for the default classes.
+ */
+extern
+void	_dmalloc_chunk_size_classes(const char *classes_str);
 
 /*
  * void *_dmalloc_chunk_malloc
@@ -196,6 +291,87 @@ extern
 int	_dmalloc_chunk_free(const char *file, const unsigned int line,
 			    void *user_pnt, const int func_id);
 
+/*
+ * int _dmalloc_chunk_malloc_batch
+ *
+ * Allocate a number of chunks of memory for one caller.  With the
+ * log-trans token the batch is logged as one transaction.
+ *
+ * Returns 1 on success or 0 on failure in which case the pointers
+ * which were allocated have been freed and all of PNTS are NULL.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * sizes -> Number of bytes to allocate for each pointer.
+ *
+ * pnts <- Array of PNT_N pointers that we are allocating.
+ *
+ * pnt_n -> Number of pointers to allocate.
+ */
+extern
+int	_dmalloc_chunk_malloc_batch(const char *file, const unsigned int line,
+				    const DMALLOC_SIZE *sizes, void **pnts,
+				    const int pnt_n);
+
+/*
+ * int _dmalloc_chunk_free_batch
+ *
+ * Free a number of user pointers from the heap.  They are freed in
+ * address order to make better use of the cache as the skip lists
+ * are searched.  With the log-trans token the batch is logged as one
+ * transaction.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR if any of the
+ * pointers could not be freed.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the free.
+ *
+ * line -> Line-number location of the free.
+ *
+ * pnts -> Array of PNT_N pointers we are freeing.  NULL entries are
+ * skipped.
+ *
+ * pnt_n -> Number of pointers in PNTS.
+ *
+ * free_np <- Set to the number of pointers which were freed.
+ */
+extern
+int	_dmalloc_chunk_free_batch(const char *file, const unsigned int line,
+				  void * const *pnts, const int pnt_n,
+				  int *free_np);
+
+/*
+ * int _dmalloc_chunk_size_check
+ *
+ * Check that the size handed to a sized free, such as C++'s sized
+ * delete, matches the size of the allocation.  Pointers which are not
+ * found are left to the free routines to report.
+ *
+ * Returns 1 if the size matches else 0 on a mismatch.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the free.
+ *
+ * line -> Line-number location of the free.
+ *
+ * user_pnt -> Pointer we are about to free.
+ *
+ * size -> Size in bytes that the caller thinks was allocated.
+ *
+ * where -> What routine is calling the check.
+ */
+extern
+int	_dmalloc_chunk_size_check(const char *file, const unsigned int line,
+				  const void *user_pnt,
+				  const unsigned long size, const char *where);
+
 /*
  * void *_dmalloc_chunk_realloc
  *
@@ -221,6 +397,16 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
 				const unsigned long new_size,
 				const int func_id);
 
+/*
+ * unsigned long _dmalloc_chunk_trim
+ *
+ * Give the pages of all of the free blocks back to the system.
+ *
+ * Returns the number of bytes given back.
+ */
+extern
+unsigned long	_dmalloc_chunk_trim(void);
+
 /*
  * void _dmalloc_chunk_log_stats
  *
@@ -323,6 +509,138 @@ void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
 				 unsigned long *max_pnt_np,
 				 unsigned long *max_one_p);
 
+/*
+ * unsigned long _dmalloc_chunk_alloc_total
+ *
+ * Add up the bytes that the heap has allocated from all of the
+ * shards.
+ *
+ * Returns the total number of bytes that have been allocated.
+ */
+extern
+unsigned long	_dmalloc_chunk_alloc_total(void);
+
+/*
+ * void _dmalloc_chunk_lock_record
+ *
+ * Count a hold of the library lock.  This is called with the lock
+ * held right before it is unlocked.
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation that held the lock.
+ *
+ * file -> File name or return address of the call or
+ * DMALLOC_DEFAULT_FILE if it is not known.
+ *
+ * line -> Line number of the call.
+ *
+ * wait_nsec -> Nanoseconds that the call waited for the lock or 0 if
+ * it was free.
+ *
+ * hold_nsec -> Nanoseconds that the call held the lock.
+ */
+extern
+void	_dmalloc_chunk_lock_record(const int op, const char *file,
+				   const unsigned int line,
+				   const unsigned long wait_nsec,
+				   const unsigned long hold_nsec);
+
+/*
+ * int _dmalloc_chunk_get_lock_stats
+ *
+ * Get the lock waits and holds of an operation.
+ *
+ * Returns 1 if the lock is profiled or 0 if it is not or the
+ * operation is not known in which case the stats are all 0.
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation whose stats we are getting.
+ *
+ * stats_p <- Pointer to the stats which we fill in.
+ */
+extern
+int	_dmalloc_chunk_get_lock_stats(const int op,
+				      dmalloc_lock_stats_t *stats_p);
+
+/*
+ * int _dmalloc_chunk_scan_start
+ *
+ * Start the extra threads of the leak scan mark phase.  This must be
+ * called before taking the dmalloc lock since creating a thread may
+ * allocate memory.
+ *
+ * Returns 1 on success or 0 if another leak scan is running.
+ */
+extern
+int	_dmalloc_chunk_scan_start(void);
+
+/*
+ * unsigned long _dmalloc_chunk_scan_leaks
+ *
+ * Conservatively mark the allocations reachable from the stacks, the
+ * registers of the calling thread, the data and bss segments and the
+ * other memory mapped by the program and log the user allocations
+ * which were not reached.
+ *
+ * Returns the number of unreachable allocations.
+ */
+extern
+unsigned long	_dmalloc_chunk_scan_leaks(void);
+
+/*
+ * void _dmalloc_chunk_scan_finish
+ *
+ * Wait for the extra threads of the leak scan to finish.  This must
+ * be called after the dmalloc lock is released since the exiting
+ * threads may free memory.
+ */
+extern
+void	_dmalloc_chunk_scan_finish(void);
+
+/*
+ * void _dmalloc_chunk_snapshot
+ *
+ * Check the heap and log the statistics, the not-freed memory, and
+ * the unreachable memory.  This is run by the child process of
+ * dmalloc_snapshot_async on its copy of the heap so it can take as
+ * long as it needs without stalling the program.
+ */
+extern
+void	_dmalloc_chunk_snapshot(void);
+
+/*
+ * int _dmalloc_chunk_dump_heap
+ *
+ * Write the used and free slots of the heap to a dump file which the
+ * dmalloc utility can analyze.  See heap_dump.h for the format.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the dump file.
+ *
+ * data_b -> Set to 1 to also write the user bytes of the allocations.
+ */
+extern
+int	_dmalloc_chunk_dump_heap(const char *path, const int data_b);
+
+/*
+ * void _dmalloc_chunk_live_stats
+ *
+ * Write the statistics into the live statistics file, creating it
+ * the first time.  See live_stats.h for the format.  This must be
+ * called with the library locked.
+ *
+ * ARGUMENTS:
+ *
+ * exit_b -> Set to 1 if the program is shutting down.
+ */
+extern
+void	_dmalloc_chunk_live_stats(const int exit_b);
+
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
 #endif /* ! __CHUNK_H__ */
@@ -45,6 +45,11 @@
 # endif
 #endif
 
+/* for the lifetime clock */
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+# include <time.h>
+#endif
+
 /* log-bad-space info */
 #define SPECIAL_CHARS		"\"\"''\\\\n\nr\rt\tb\bf\fa\007"
 
@@ -57,6 +62,53 @@
 /* memory table settings */
 #define MEM_ALLOC_ENTRIES	(MEMORY_TABLE_SIZE * 2)
 #define MEM_CHANGED_ENTRIES	(MEMORY_TABLE_SIZE * 2)
+#define MEM_LOCK_ENTRIES	MEMORY_TABLE_SIZE
+
+/*
+ * Freed large objects kept on the large-object list to catch them
+ * being freed again.  Past this the ones freed the longest ago are
+ * dropped so the list does not grow without bound.
+ */
+#define LARGE_FREED_MAX		64
+
+/* the live statistics file must be new and not reached by a link */
+#ifdef O_NOFOLLOW
+#define LIVE_OPEN_FLAGS		(O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW)
+#else
+#define LIVE_OPEN_FLAGS		(O_RDWR | O_CREAT | O_EXCL)
+#endif
+
+/* the counters are only sharded when there are threads */
+#if LOCK_THREADS
+#define STAT_SHARD_N		STAT_SHARDS
+#else
+#define STAT_SHARD_N		1
+#endif
+
+/* counters in the statistics shards */
+#define STAT_MALLOC		0	/* malloc calls */
+#define STAT_CALLOC		1	/* calloc calls */
+#define STAT_REALLOC		2	/* realloc calls */
+#define STAT_RECALLOC		3	/* recalloc calls */
+#define STAT_MEMALIGN		4	/* memalign calls */
+#define STAT_VALLOC		5	/* valloc calls */
+#define STAT_NEW		6	/* new calls */
+#define STAT_FREE		7	/* free calls */
+#define STAT_DELETE		8	/* delete calls */
+#define STAT_ALLOC_PNTS		9	/* pointers allocated */
+#define STAT_ALLOC_BYTES	10	/* bytes allocated */
+#define STAT_COUNTER_N		11
+
+/* most processors have 64 byte cache lines */
+#define CACHE_LINE_SIZE		64
+#define STAT_SHARD_SIZE	\
+	(((STAT_COUNTER_N * sizeof(unsigned long) + CACHE_LINE_SIZE - 1) \
+	  / CACHE_LINE_SIZE) * CACHE_LINE_SIZE)
+#ifdef __GNUC__
+#define CACHE_ALIGNED		__attribute__((aligned(CACHE_LINE_SIZE)))
+#else
+#define CACHE_ALIGNED
+#endif
 
 /* NOTE: FENCE_BOTTOM_SIZE and FENCE_TOP_SIZE defined in settings.h */
 #define FENCE_OVERHEAD_SIZE	(FENCE_BOTTOM_SIZE + FENCE_TOP_SIZE)
@@ -66,6 +118,11 @@
 #define CHUNK_SMALLEST_BLOCK	\
 	(FENCE_BOTTOM_SIZE + DEFAULT_SMALLEST_ALLOCATION)
 
+/* index of the size class of a divided block size */
+#define CLASS_INDEX_N		(BLOCK_SIZE / 2 / ALLOCATION_ALIGNMENT + 1)
+#define CLASS_INDEX(size)	\
+	(((size) + ALLOCATION_ALIGNMENT - 1) / ALLOCATION_ALIGNMENT)
+
 /* flags associated with the skip_alloc_t type's sa_flags field */
 #define ALLOC_FLAG_USER		BIT_FLAG(0)	/* slot is user allocated */
 #define ALLOC_FLAG_FREE		BIT_FLAG(1)	/* slot is free */
@@ -74,6 +131,101 @@
 #define ALLOC_FLAG_BLANK	BIT_FLAG(4)	/* slot has been blanked */
 #define ALLOC_FLAG_FENCE	BIT_FLAG(5)	/* slot is fence posted */
 #define ALLOC_FLAG_VALLOC	BIT_FLAG(6)	/* slot is block aligned */
+#define ALLOC_FLAG_LARGE	BIT_FLAG(7)	/* slot is a mapped large object */
+#define ALLOC_FLAG_PURGED	BIT_FLAG(8)	/* free pages given back to os */
+#define ALLOC_FLAG_SCAN_MARK	BIT_FLAG(9)	/* reached by the leak scan */
+#define ALLOC_FLAG_SCAN_DONE	BIT_FLAG(10)	/* leak scan looked inside */
+#define ALLOC_FLAG_MOVED	BIT_FLAG(11)	/* freed by a realloc move */
+
+/*
+ * Debug flags which are tested in the malloc and free paths.  Each
+ * specialized hot path is built for one combination of them.
+ */
+#define HOT_PATH_FLAGS	(DMALLOC_DEBUG_LOG_TRANS \
+			 | DMALLOC_DEBUG_LOG_ELAPSED_TIME \
+			 | DMALLOC_DEBUG_LOG_CURRENT_TIME \
+			 | DMALLOC_DEBUG_CHECK_FENCE \
+			 | DMALLOC_DEBUG_CHECK_BLANK \
+			 | DMALLOC_DEBUG_FREE_BLANK \
+			 | DMALLOC_DEBUG_ALLOC_BLANK \
+			 | DMALLOC_DEBUG_NEVER_REUSE \
+			 | DMALLOC_DEBUG_ERROR_FREE_NULL)
+
+/* debug flags which a policy can turn on for some of the allocations */
+#define POLICY_FLAGS		(DMALLOC_DEBUG_LOG_TRANS \
+				 | DMALLOC_DEBUG_CHECK_FENCE \
+				 | DMALLOC_DEBUG_CHECK_BLANK \
+				 | DMALLOC_DEBUG_FREE_BLANK \
+				 | DMALLOC_DEBUG_ALLOC_BLANK \
+				 | DMALLOC_DEBUG_NEVER_REUSE)
+
+/* hot-path flags of the runtime, low/medium, and high utility settings */
+#define HOT_RUNTIME_FLAGS	DMALLOC_DEBUG_CHECK_FENCE
+#define HOT_LOW_FLAGS		(HOT_RUNTIME_FLAGS \
+				 | DMALLOC_DEBUG_LOG_ELAPSED_TIME \
+				 | DMALLOC_DEBUG_FREE_BLANK \
+				 | DMALLOC_DEBUG_ALLOC_BLANK)
+#define HOT_HIGH_FLAGS		(HOT_LOW_FLAGS | DMALLOC_DEBUG_CHECK_BLANK)
+
+/* number of pointers that a batch free puts in address order at once */
+#define FREE_BATCH_SORT		64
+
+/* can the leak scan find its roots in /proc/self/maps? */
+#if LEAK_SCAN_STACK > 0 && defined(__linux__) && HAVE_MMAP
+#define LEAK_SCAN		1
+#else
+#define LEAK_SCAN		0
+#endif
+
+/* do more than one thread mark the reachable allocations? */
+#if LEAK_SCAN && LOCK_THREADS && LEAK_SCAN_THREADS > 1 && defined(__GNUC__)
+#define LEAK_SCAN_WORKERS	1
+#else
+#define LEAK_SCAN_WORKERS	0
+#endif
+
+/* maximum number of memory ranges that the leak scan looks for roots in */
+#define LEAK_SCAN_MAX_ROOTS	4096
+
+/* the mark phase hands work to idle threads after this many slots */
+#define LEAK_SCAN_SHARE_ITERS	256
+
+/* can the heap dump map the tables that it builds? */
+#if HAVE_MMAP
+#define HEAP_DUMP		1
+#else
+#define HEAP_DUMP		0
+#endif
+
+/* bytes that the heap dump writes at once */
+#define DUMP_BUF_SIZE		65536
+
+/* starting number of entries in the heap dump tables */
+#define DUMP_TABLE_START	1024
+
+/* have the compiler expand the hot-path templates in each path */
+#ifdef __GNUC__
+#define HOT_PATH_INLINE	__inline__ __attribute__((always_inline))
+#else
+#define HOT_PATH_INLINE
+#endif
+
+/* range of memory which the leak scan looks through for pointers */
+typedef struct {
+  char		*sr_low;		/* start of the range */
+  char		*sr_high;		/* end of the range */
+} scan_range_t;
+
+/*
+ * Size class of the divided blocks and the usage of its slots.
+ */
+typedef struct {
+  unsigned long		sc_size;		/* size of the slots */
+  unsigned long		sc_block_c;		/* blocks cut into slots */
+  unsigned long		sc_alloc_c;		/* total slots allocated */
+  unsigned long		sc_in_use_c;		/* slots in use */
+  unsigned long		sc_user_size;		/* user bytes in use */
+} size_class_t;
 
 /*
  * Below defines an allocation structure either on the free or used
@@ -83,14 +235,17 @@
  */
 typedef struct skip_alloc_st {
   
-  unsigned char		sa_flags;	/* what it is */
-  
   /* some small data types up front to save on space */
+  unsigned short	sa_flags;	/* what it is */
   unsigned char		sa_level_n;	/* how tall our node is */
+  unsigned char		sa_align_shift;	/* log2 of the alignment */
   unsigned short	sa_line;	/* line where it was allocated */
+#if REALLOC_TOP_LOG > 0
+  unsigned short	sa_realloc_c;	/* times it has been realloced */
+#endif
   
-  unsigned int		sa_user_size;	/* size requested by user (wo fence) */
-  unsigned int		sa_total_size;	/* total size of the block */
+  unsigned long		sa_user_size;	/* size requested by user (wo fence) */
+  unsigned long		sa_total_size;	/* total size of the block */
   
   void			*sa_mem;	/* pointer to the memory in question */
   const char		*sa_file;	/* .c filename where allocated */
@@ -112,6 +267,12 @@ typedef struct skip_alloc_st {
 #if LOG_PNT_THREAD_ID
   THREAD_TYPE		sa_thread_id;	/* thread id which allocaed pnt */
 #endif
+#if LIFETIME_BUCKETS > 0
+  unsigned long		sa_alloc_iter;	/* iteration when pointer alloced */
+#endif
+#if LIFETIME_BUCKETS > 0 && LIFETIME_NSEC
+  unsigned long		sa_alloc_nsec;	/* clock when pointer alloced */
+#endif
   
   /*
    * Array of next pointers.  This may extend past the end of the
@@ -130,6 +291,56 @@ typedef struct skip_alloc_st {
 #define SKIP_SLOT_SIZE(next_n)	\
 	(sizeof(skip_alloc_t) + sizeof(skip_alloc_t *) * (next_n))
 
+/*
+ * Malloc and free paths which have been specialized for one
+ * combination of the hot-path flags.
+ */
+typedef struct {
+  unsigned int	hp_flags;		/* hot-path flags it was built for */
+  void		*(*hp_malloc)(const char *file, const unsigned int line,
+			      const unsigned long size, const int func_id,
+			      const unsigned int alignment);
+  int		(*hp_free)(const char *file, const unsigned int line,
+			   void *user_pnt, const int func_id,
+			   skip_alloc_t *found_p);
+} hot_path_t;
+
+/* state of one of the threads marking the allocations in a leak scan */
+typedef struct {
+  skip_alloc_t	**ls_stack;		/* slots waiting to be scanned */
+  int		ls_stack_n;		/* number of slots on the stack */
+  int		ls_index;		/* which thread this is */
+  char		*ls_large_low;		/* lowest large object */
+  char		*ls_large_high;		/* end of the highest one */
+} leak_scan_t;
+
+/* entry in one of the tables of sites or names of a heap dump */
+typedef struct {
+  const char	*de_file;		/* file-name or return-address */
+  unsigned int	de_line;		/* line number */
+  unsigned int	de_used_b;		/* the entry is in use */
+  unsigned long	de_value;		/* site index or name offset */
+} dump_entry_t;
+
+/* open hash table of a heap dump which grows as needed */
+typedef struct {
+  dump_entry_t	*dt_entries;		/* the entries */
+  unsigned long	dt_size;		/* number of entries, a power of 2 */
+  unsigned long	dt_entry_n;		/* number in use */
+} dump_table_t;
+
+/* state of a heap dump being written */
+typedef struct {
+  int		hd_fd;			/* file we are writing to */
+  int		hd_error_b;		/* a write has failed */
+  char		*hd_buf;		/* bytes waiting to be written */
+  unsigned long	hd_buf_n;		/* number of waiting bytes */
+  unsigned long	hd_off;			/* offset of the next byte */
+  dump_table_t	hd_sites;		/* site index by file and line */
+  dump_table_t	hd_names;		/* name offset by file */
+  unsigned long	hd_name_size;		/* bytes of the names */
+} heap_dump_t;
+
 /* entry block magic numbers */
 #define ENTRY_BLOCK_MAGIC1	0xEBEB1111	/* for the eb_magic1 field */
 #define ENTRY_BLOCK_MAGIC2	0xEBEB2222	/* for the eb_magic2 field */
@@ -175,4 +386,23 @@ typedef struct {
   void		*pi_alloc_bounds;	/* pnt past end of total allocation */
 } pnt_info_t;
 
+/*
+ * Entry in the cache of user allocations which were last found to be
+ * okay by the pointer checks.
+ */
+typedef struct {
+  char		*pc_user_start;		/* pnt to start of user allocation */
+  char		*pc_user_bounds;	/* pnt past end of user allocation */
+  unsigned long	pc_generation;		/* heap generation when checked */
+} pnt_cache_t;
+
+/*
+ * Counters of the calls and allocations that the threads of a shard
+ * have made.  The union pads each shard out to whole cache lines.
+ */
+typedef union {
+  unsigned long	ss_counts[STAT_COUNTER_N];	/* STAT_ counters */
+  char		ss_pad[STAT_SHARD_SIZE];	/* pad to the cache line */
+} stat_shard_t;
+
 #endif /* ! __CHUNK_LOC_H__ */
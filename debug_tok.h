@@ -35,7 +35,7 @@
 #define DMALLOC_DEBUG_LOG_NONFREE	BIT_FLAG(1)	/* report non-freed pointers */
 #define DMALLOC_DEBUG_LOG_KNOWN		BIT_FLAG(2)	/* report only known nonfreed*/
 #define DMALLOC_DEBUG_LOG_TRANS		BIT_FLAG(3)	/* log memory transactions */
-/* 4 available - 20001107 */
+#define DMALLOC_DEBUG_LIVE_STATS	BIT_FLAG(4)	/* publish live statistics */
 #define DMALLOC_DEBUG_LOG_ADMIN		BIT_FLAG(5)	/* log background admin info */
 /* 6 available 20030508 */
 /* 7 available - 20001107 */
@@ -91,6 +91,7 @@ __attribute__ ((unused))
   { "log-known",	DMALLOC_DEBUG_LOG_KNOWN,	"log only known non-freed" },
   { "log-trans",	DMALLOC_DEBUG_LOG_TRANS,	"log memory transactions" },
   { "log-admin",	DMALLOC_DEBUG_LOG_ADMIN,	"log administrative info" },
+  { "live-stats",	DMALLOC_DEBUG_LIVE_STATS,	"publish live statistics" },
   { "log-bad-space",	DMALLOC_DEBUG_LOG_BAD_SPACE,	"dump space from bad pnt" },
   { "log-nonfree-space", DMALLOC_DEBUG_LOG_NONFREE_SPACE,
     "dump space from non-freed pointers" },
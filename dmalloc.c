@@ -49,6 +49,7 @@
 #include "append.h"
 #include "compat.h"
 #include "debug_tok.h"
+#include "dmalloc_dump.h"
 #include "env.h"
 #include "error_val.h"
 #include "dmalloc_loc.h"
@@ -116,8 +117,16 @@ static	int	gdb_b = 0;			/* set gdb output */
 static	int	rcshell_b = 0;			/* set rc shell output */
 
 static	char	*address = NULL;		/* for ADDRESS */
+static	long	attach_pid = 0;			/* process to show stats of */
 static	int	clear_b = 0;			/* clear variables */
+static	char	*control_path = NULL;		/* live control file */
 static	int	debug = 0;			/* for DEBUG */
+static	char	*dump_classes = NULL;		/* heap dump to fit classes */
+static	int	dump_count = DUMP_TOP_DEFAULT;	/* sites to show from dumps */
+static	argv_array_t	dump_diff;		/* heap dumps to compare */
+static	char	*dump_map = NULL;		/* heap dump to map */
+static	char	*dump_sizes = NULL;		/* heap dump size histogram */
+static	char	*dump_top = NULL;		/* heap dump top sites */
 static	int	errno_to_print = 0;		/* to print the error string */
 static	int	help_b = 0;			/* print help message */
 static	char	*inpath = NULL;			/* for config-file path */
@@ -132,7 +141,10 @@ static	argv_array_t	minus;			/* tokens to remove */
 static	unsigned long limit_arg = 0;		/* memory limit */
 static	int	make_changes_b = 1;		/* make no changes to env */
 static	argv_array_t	plus;			/* tokens to add */
+static	argv_array_t	policy_args;		/* debug policies */
+static	int	refresh_secs = 0;		/* seconds between screens */
 static	int	remove_auto_b = 0;		/* auto-remove settings */
+static	char	*size_classes = NULL;		/* small allocation classes */
 static	char	*start_file = NULL;		/* for START settings */
 static	unsigned long start_iter = 0;		/* for START settings */
 static	unsigned long start_size = 0;		/* for START settings */
@@ -157,12 +169,28 @@ static	argv_t	args[] = {
   
   { 'a',	"address",	ARGV_CHAR_P,	&address,
     "address:#",		"stop when malloc sees address" },
+  { '\0',	"attach",	ARGV_LONG,	&attach_pid,
+    "pid",			"show live stats of process" },
   { 'c',	"clear",	ARGV_BOOL_INT,	&clear_b,
     NULL,			"clear all variables not set" },
+  { 'w',	"control-file",	ARGV_CHAR_P,	&control_path,
+    "path",			"write settings to control file" },
   { DEBUG_ARG,	"debug-mask",	ARGV_HEX,	&debug,
     "value",			"hex flag to set debug mask" },
   { 'D',	"debug-tokens",	ARGV_BOOL_INT,	&debug_tokens_b,
     NULL,			"list debug tokens" },
+  { '\0',	"dump-classes",	ARGV_CHAR_P,	&dump_classes,
+    "path",			"fit size classes to heap dump" },
+  { '\0',	"dump-count",	ARGV_INT,	&dump_count,
+    "number",			"sites or classes from heap dumps" },
+  { '\0',	"dump-diff",	ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&dump_diff,
+    "path",			"old then new dump to compare sites" },
+  { '\0',	"dump-map",	ARGV_CHAR_P,	&dump_map,
+    "path",			"show fragmentation of heap dump" },
+  { '\0',	"dump-sizes",	ARGV_CHAR_P,	&dump_sizes,
+    "path",			"show allocation sizes in dump" },
+  { '\0',	"dump-top",	ARGV_CHAR_P,	&dump_top,
+    "path",			"show top allocation sites in dump" },
   { 'e',	"errno",	ARGV_INT,	&errno_to_print,
     "errno",			"print error string for errno" },
   { 'f',	"file",		ARGV_CHAR_P,	&inpath,
@@ -187,8 +215,14 @@ static	argv_t	args[] = {
     "number",			"number of times to not lock" },
   { 'p',	"plus",		ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&plus,
     "token(s)",			"add tokens to current debug" },
+  { 'P',	"policy",	ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&policy_args,
+    "match@token(s)",		"debug only matching allocations" },
+  { '\0',	"refresh",	ARGV_INT,	&refresh_secs,
+    "seconds",			"repeat --attach every seconds" },
   { 'r',	"remove",	ARGV_BOOL_INT,	&remove_auto_b,
     NULL,			"remove other settings if tag" },
+  { '\0',	"size-classes",	ARGV_CHAR_P,	&size_classes,
+    "size:size...",		"classes of the small allocations" },
   
   { 's',	"start-file",	ARGV_CHAR_P,	&start_file,
     "file:line",		"check heap after this location" },
@@ -696,7 +730,8 @@ static	void	list_tags(void)
  */
 static	void	dump_current(void)
 {
-  char		*log_path, *loc_start_file, token[64];
+  char		*log_path, *loc_start_file, *policy_str, *classes_str;
+  char		token[64];
   const char	*env_str;
   DMALLOC_PNT	addr;
   unsigned long	inter, limit_val, loc_start_size, loc_start_iter;
@@ -713,7 +748,8 @@ static	void	dump_current(void)
   _dmalloc_environ_process(env_str, &addr, &addr_count, &flags,
 			   &inter, &lock_on, &log_path,
 			   &loc_start_file, &loc_start_line, &loc_start_iter,
-			   &loc_start_size, &limit_val);
+			   &loc_start_size, &limit_val, &policy_str,
+			   &classes_str);
   
   if (flags == 0) {
     loc_fprintf(stderr, "Debug-Flags  not-set\n");
@@ -779,6 +815,20 @@ static	void	dump_current(void)
     loc_fprintf(stderr, "Start        not-set\n");
   }
   
+  if (policy_str == NULL) {
+    loc_fprintf(stderr, "Policy       not-set\n");
+  }
+  else {
+    loc_fprintf(stderr, "Policy       '%s'\n", policy_str);
+  }
+  
+  if (classes_str == NULL) {
+    loc_fprintf(stderr, "Classes      not-set\n");
+  }
+  else {
+    loc_fprintf(stderr, "Classes      %s\n", classes_str);
+  }
+  
   loc_fprintf(stderr, "\n");
   loc_fprintf(stderr, "Debug Malloc Utility: http://dmalloc.com/\n");
   loc_fprintf(stderr, "  For a list of the command-line options enter: %s --usage\n",
@@ -818,6 +868,39 @@ static	void    set_variable(const char *var, const char *value)
   }
 }
 
+/*
+ * Write VALUE into the control file at PATH which running programs
+ * with DMALLOC_CONTROL set to PATH will pick up.  We write a new file
+ * and rename it into place so the library never sees half of it.
+ */
+static	void	write_control(const char *path, const char *value)
+{
+  char	tmp_path[1024];
+  FILE	*outfile;
+  
+  if ((! make_changes_b) || verbose_b) {
+    loc_fprintf(stderr, "Writing '%s' to control file '%s'\n", value, path);
+  }
+  if (! make_changes_b) {
+    return;
+  }
+  
+  (void)loc_snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  outfile = fopen(tmp_path, "w");
+  if (outfile == NULL) {
+    loc_fprintf(stderr, "%s: could not write control file '%s'\n",
+		argv_program, tmp_path);
+    exit(1);
+  }
+  (void)fprintf(outfile, "%s\n", value);
+  if (fclose(outfile) != 0 || rename(tmp_path, path) != 0) {
+    loc_fprintf(stderr, "%s: could not write control file '%s'\n",
+		argv_program, path);
+    (void)remove(tmp_path);
+    exit(1);
+  }
+}
+
 /*
  * Returns the string for ERROR_NUM.
  */
@@ -848,9 +931,9 @@ static	void	header(void)
 
 int	main(int argc, char **argv)
 {
-  char		buf[1024];
+  char		buf[1024], policy_buf[1024];
   int		set_b = 0;
-  char		*log_path, *loc_start_file;
+  char		*log_path, *loc_start_file, *policy_str, *classes_str;
   const char	*env_str;
   DMALLOC_PNT	addr;
   unsigned long	inter, limit_val, loc_start_size, loc_start_iter;
@@ -887,6 +970,41 @@ int	main(int argc, char **argv)
     exit(0);
   }
   
+  /* attaching to a program does not touch the environment */
+  if (attach_pid > 0) {
+    exit(_dmalloc_dump_live(attach_pid, refresh_secs) ? 0 : 1);
+  }
+  
+  /* the heap dumps are analyzed without touching the environment */
+  if (dump_top != NULL || dump_sizes != NULL || dump_map != NULL
+      || dump_classes != NULL || dump_diff.aa_entry_n > 0) {
+    if (dump_diff.aa_entry_n != 0 && dump_diff.aa_entry_n != 2) {
+      loc_fprintf(stderr, "%s: --dump-diff needs an old and a new dump\n",
+		  argv_program);
+      exit(1);
+    }
+    if (dump_top != NULL && ! _dmalloc_dump_top(dump_top, dump_count)) {
+      exit(1);
+    }
+    if (dump_sizes != NULL && ! _dmalloc_dump_sizes(dump_sizes)) {
+      exit(1);
+    }
+    if (dump_map != NULL && ! _dmalloc_dump_map(dump_map)) {
+      exit(1);
+    }
+    if (dump_classes != NULL
+	&& ! _dmalloc_dump_classes(dump_classes, dump_count)) {
+      exit(1);
+    }
+    if (dump_diff.aa_entry_n == 2
+	&& ! _dmalloc_dump_diff(ARGV_ARRAY_ENTRY(dump_diff, char *, 0),
+				ARGV_ARRAY_ENTRY(dump_diff, char *, 1),
+				dump_count)) {
+      exit(1);
+    }
+    exit(0);
+  }
+  
   if (very_verbose_b) {
     verbose_b = 1;
   }
@@ -904,7 +1022,7 @@ int	main(int argc, char **argv)
   _dmalloc_environ_process(env_str, &addr, &addr_count, &flags, &inter,
 			   &lock_on, &log_path, &loc_start_file,
 			   &loc_start_line, &loc_start_iter, &loc_start_size,
-			   &limit_val);
+			   &limit_val, &policy_str, &classes_str);
   
   /*
    * So, if a tag was specified on the command line then we set the
@@ -981,6 +1099,15 @@ int	main(int argc, char **argv)
     lock_on = 0;
   }
   
+  /* running programs only read lock-on at startup so leave it out */
+  if (control_path != NULL && lock_on != 0) {
+    if (argv_was_used(args, THREAD_LOCK_ON_ARG)) {
+      loc_fprintf(stderr, "%s: lock-on is not written to control files\n",
+		  argv_program);
+    }
+    lock_on = 0;
+  }
+  
   if (logpath != NULL) {
     log_path = logpath;
     set_b = 1;
@@ -1020,6 +1147,42 @@ int	main(int argc, char **argv)
     set_b = 1;
   }
   
+  if (policy_args.aa_entry_n > 0) {
+    policy_t	policy;
+    char	*pol_p, *buf_p = policy_buf;
+    char	*bounds_p = policy_buf + sizeof(policy_buf);
+    int		pol_c;
+    
+    for (pol_c = 0; pol_c < policy_args.aa_entry_n; pol_c++) {
+      pol_p = ARGV_ARRAY_ENTRY(policy_args, char *, pol_c);
+      if (! _dmalloc_policy_break(pol_p, &policy)) {
+	loc_fprintf(stderr, "%s: bad policy '%s'\n", argv_program, pol_p);
+	loc_fprintf(stderr,
+		    "  expecting file[:line], ra:low-high or size:min-max"
+		    " then @token(s)\n");
+	exit(1);
+      }
+      if (buf_p > policy_buf) {
+	buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%c",
+			      POLICY_SEP_CHAR);
+      }
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s", pol_p);
+    }
+    policy_str = policy_buf;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    policy_str = NULL;
+  }
+  
+  if (size_classes != NULL) {
+    classes_str = size_classes;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    classes_str = NULL;
+  }
+  
   if (errno_to_print > 0) {
     loc_fprintf(stderr, "%s: dmalloc_errno value '%d' = \n", argv_program, errno_to_print);
     loc_fprintf(stderr, "   '%s'\n", local_strerror(errno_to_print));
@@ -1061,8 +1224,13 @@ int	main(int argc, char **argv)
     _dmalloc_environ_set(buf, sizeof(buf), long_tokens_b, addr, addr_count,
 			 debug, inter, lock_on, log_path, loc_start_file,
 			 loc_start_line, loc_start_iter, loc_start_size,
-			 limit_val);
-    set_variable(OPTIONS_ENVIRON, buf);
+			 limit_val, policy_str, classes_str);
+    if (control_path != NULL) {
+      write_control(control_path, buf);
+    }
+    else {
+      set_variable(OPTIONS_ENVIRON, buf);
+    }
   }
   else if (errno_to_print == 0
 	   && (! list_tags_b)
@@ -0,0 +1,269 @@
+/*
+ * C++ allocator and allocation budgets for the dmalloc library
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+/*
+ * Memory that the standard containers get through operator new is
+ * all charged to the one line in dmallocc.cc.  Handing a container a
+ * dmalloc::allocator records where the allocator was built instead so
+ * the memory table and the leak logs show which container owns it:
+ *
+ *   std::vector<int, dmalloc::allocator<int> >
+ *     ids(10, 0, dmalloc::allocator<int>());
+ *
+ * An optional tag replaces the file-name and the line so that the
+ * allocations of a data structure share one entry in the memory table
+ * however many places build its allocators:
+ *
+ *   std::map<int, int, std::less<int>,
+ *            dmalloc::allocator<std::pair<const int, int> > >
+ *     cache(std::less<int>(), dmalloc::allocator<int>("cache"));
+ *
+ * The tag is not copied so it must be a string constant.  Allocators
+ * that a container makes for itself get the location inside of the
+ * container's header so pass one in explicitly.
+ *
+ * A dmalloc::budget_guard checks the allocations that the current
+ * thread makes in a scope against a budget when it goes out of scope:
+ *
+ *   {
+ *     dmalloc::budget_guard guard(3);
+ *     handle_request(req);
+ *   }
+ */
+
+#ifndef __DMALLOC_ALLOCATOR_H__
+#define __DMALLOC_ALLOCATOR_H__
+
+#include <cstddef>
+#include <new>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<source_location>)
+#include <source_location>
+#endif
+#endif
+
+#include "dmalloc.h"
+
+/* where to get the location of the code building the allocator */
+#ifdef __cpp_lib_source_location
+#define DMALLOC_ALLOC_SOURCE_LOCATION	1
+#else
+#define DMALLOC_ALLOC_SOURCE_LOCATION	0
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#define DMALLOC_ALLOC_FILE	__builtin_FILE()
+#define DMALLOC_ALLOC_LINE	__builtin_LINE()
+#else
+#define DMALLOC_ALLOC_FILE	0
+#define DMALLOC_ALLOC_LINE	0
+#endif
+#endif
+
+/* line recorded with a tag since a 0 line marks a return-address */
+#define DMALLOC_ALLOC_TAG_LINE	1
+
+namespace dmalloc {
+
+template <class T>
+class allocator {
+
+ public:
+
+  typedef T			value_type;
+  typedef T			*pointer;
+  typedef const T		*const_pointer;
+  typedef T			&reference;
+  typedef const T		&const_reference;
+  typedef std::size_t		size_type;
+  typedef std::ptrdiff_t	difference_type;
+
+  template <class U>
+  struct rebind {
+    typedef allocator<U>	other;
+  };
+
+  /*
+   * Record the location of the caller, or the tag and
+   * DMALLOC_ALLOC_TAG_LINE if the tag is not 0L.
+   */
+#if DMALLOC_ALLOC_SOURCE_LOCATION
+  explicit allocator(const char *tag = 0,
+		     const std::source_location &loc
+		     = std::source_location::current()) throw()
+    : al_file(tag != 0 ? tag : loc.file_name()),
+      al_line(tag != 0 ? DMALLOC_ALLOC_TAG_LINE : loc.line())
+  {
+  }
+#else
+  explicit allocator(const char *tag = 0,
+		     const char *file = DMALLOC_ALLOC_FILE,
+		     const unsigned int line = DMALLOC_ALLOC_LINE) throw()
+    : al_file(tag != 0 ? tag : file),
+      al_line(tag != 0 ? DMALLOC_ALLOC_TAG_LINE : line)
+  {
+  }
+#endif
+
+  /* containers rebind us to their node types so keep the location */
+  template <class U>
+  allocator(const allocator<U> &other) throw()
+    : al_file(other.file()), al_line(other.line())
+  {
+  }
+
+  const char	*file() const throw() { return al_file; }
+  unsigned int	line() const throw() { return al_line; }
+
+  T *allocate(const size_type num, const void * = 0)
+  {
+    void	*pnt;
+
+    if (num > max_size()) {
+      throw std::bad_alloc();
+    }
+    pnt = dmalloc_malloc(al_file, al_line, num * sizeof(T),
+			 DMALLOC_FUNC_NEW, alignment(),
+			 0 /* no xalloc messages */);
+    if (pnt == 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(pnt);
+  }
+
+  /* the containers know the size so have the library check it */
+  void deallocate(T *pnt, const size_type num) throw()
+  {
+    (void)dmalloc_free_size(al_file, al_line, pnt, num * sizeof(T),
+			    DMALLOC_FUNC_DELETE);
+  }
+
+  size_type max_size() const throw()
+  {
+    return static_cast<size_type>(-1) / sizeof(T);
+  }
+
+#if __cplusplus < 201103L
+  pointer address(reference val) const { return &val; }
+  const_pointer address(const_reference val) const { return &val; }
+  void construct(pointer pnt, const T &val) { new (pnt) T(val); }
+  void destroy(pointer pnt) { pnt->~T(); }
+#endif
+
+ private:
+
+  /* over-aligned types are handed to the library's memalign support */
+  static size_type alignment() throw()
+  {
+#if __cplusplus >= 201103L
+    return (alignof(T) > alignof(std::max_align_t) ? alignof(T) : 0);
+#else
+    return 0;
+#endif
+  }
+
+  const char	*al_file;
+  unsigned int	al_line;
+};
+
+/* all of the allocators share the one heap so any can free the memory */
+template <class T, class U>
+inline bool operator==(const allocator<T> &, const allocator<U> &) throw()
+{
+  return true;
+}
+
+template <class T, class U>
+inline bool operator!=(const allocator<T> &, const allocator<U> &) throw()
+{
+  return false;
+}
+
+/*
+ * Guard which raises the over-budget error when it is destroyed if the
+ * thread has allocated more than its budget since it was built.
+ */
+class budget_guard {
+
+ public:
+
+#if DMALLOC_ALLOC_SOURCE_LOCATION
+  explicit budget_guard(const unsigned long max_allocs,
+			const unsigned long max_bytes = DMALLOC_BUDGET_UNLIMITED,
+			const unsigned long max_frees = DMALLOC_BUDGET_UNLIMITED,
+			const std::source_location &loc
+			= std::source_location::current()) throw()
+    : bg_file(loc.file_name()), bg_line(loc.line())
+  {
+    dmalloc_budget_start(&bg_budget, max_allocs, max_bytes, max_frees);
+  }
+#else
+  explicit budget_guard(const unsigned long max_allocs,
+			const unsigned long max_bytes = DMALLOC_BUDGET_UNLIMITED,
+			const unsigned long max_frees = DMALLOC_BUDGET_UNLIMITED,
+			const char *file = DMALLOC_ALLOC_FILE,
+			const unsigned int line = DMALLOC_ALLOC_LINE) throw()
+    : bg_file(file), bg_line(line)
+  {
+    dmalloc_budget_start(&bg_budget, max_allocs, max_bytes, max_frees);
+  }
+#endif
+
+  ~budget_guard()
+  {
+    (void)dmalloc_budget_end(bg_file, bg_line, &bg_budget);
+  }
+
+  /* usage of the scope so far */
+  unsigned long allocs() const throw()
+  {
+    unsigned long	num;
+    dmalloc_budget_used(&bg_budget, &num, 0, 0);
+    return num;
+  }
+
+  unsigned long bytes() const throw()
+  {
+    unsigned long	num;
+    dmalloc_budget_used(&bg_budget, 0, &num, 0);
+    return num;
+  }
+
+  unsigned long frees() const throw()
+  {
+    unsigned long	num;
+    dmalloc_budget_used(&bg_budget, 0, 0, &num);
+    return num;
+  }
+
+ private:
+
+  /* not copyable */
+  budget_guard(const budget_guard &);
+  budget_guard &operator=(const budget_guard &);
+
+  dmalloc_budget_t	bg_budget;
+  const char		*bg_file;
+  unsigned int		bg_line;
+};
+
+} /* namespace dmalloc */
+
+#endif /* ! __DMALLOC_ALLOCATOR_H__ */
@@ -0,0 +1,369 @@
+/*
+ * Test program for the C++ allocator and budget guard of dmalloc
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+extern "C" {
+#include <stdio.h>				/* for printf */
+#include <stdlib.h>				/* for exit */
+#include <string.h>				/* for strcmp, strstr */
+
+#include "conf.h"
+}
+
+#include <map>
+#include <new>
+#include <vector>
+
+#include "dmalloc_allocator.h"
+
+/* argument variables which are not parsed with the C argv library */
+static	int		silent_b = 0;			/* silent flag */
+static	int		verbose_b = 0;			/* verbose flag */
+
+typedef std::vector<int, dmalloc::allocator<int> >	int_vector_t;
+
+#ifdef __cpp_aligned_new
+/* more aligned than a block so the library has to look inside a slot */
+#define OVER_ALIGNMENT		65536
+
+struct over_aligned_t {
+  alignas(OVER_ALIGNMENT) char	oa_buf[100];
+};
+#endif
+
+/*
+ * Make sure that the library recorded the location of an allocator
+ * with the allocation of a pointer.
+ */
+static	int	check_location(const char *label, const void *pnt,
+			       const char *file, const unsigned int line)
+{
+  char		*pnt_file;
+  unsigned int	pnt_line;
+  
+  if (dmalloc_examine(pnt, NULL, NULL, &pnt_file, &pnt_line, NULL, NULL,
+		      NULL) != DMALLOC_NOERROR) {
+    if (! silent_b) {
+      (void)printf("   ERROR: could not examine %s pointer\n", label);
+    }
+    return 0;
+  }
+  if (pnt_file != file || pnt_line != line) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %s pointer recorded at %p:%u not %p:%u\n",
+		   label, (void *)pnt_file, pnt_line, (const void *)file,
+		   line);
+    }
+    return 0;
+  }
+  
+  return 1;
+}
+
+/*
+ * Run the tests of the header.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	do_tests(void)
+{
+  int	final = 1;
+  
+  /********************/
+  
+  /*
+   * Check that an allocator passes where it was built to the library.
+   */
+  {
+    dmalloc::allocator<int> alloc; const unsigned int alloc_line = __LINE__;
+    int_vector_t	ids(10, 0, alloc);
+    
+    if (verbose_b) {
+      (void)printf("  Checking the allocator location\n");
+    }
+    
+    /* compilers without the built-ins do not give a location */
+    if (alloc.file() != NULL) {
+      if (strstr(alloc.file(), "dmalloc_cxx_t") == NULL
+	  || alloc.line() != alloc_line) {
+	if (! silent_b) {
+	  (void)printf("   ERROR: allocator built at %s:%u not line %u\n",
+		       alloc.file(), alloc.line(), alloc_line);
+	}
+	final = 0;
+      }
+    }
+    if (! check_location("vector", &ids[0], alloc.file(), alloc.line())) {
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check that a tag groups the allocators built in different places.
+   */
+  {
+    static const char	*tag = "cache";
+    int_vector_t	one(4, 1, dmalloc::allocator<int>(tag));
+    int_vector_t	two(8, 2, dmalloc::allocator<int>(tag));
+    dmalloc::allocator<long>	rebound(one.get_allocator());
+    
+    if (verbose_b) {
+      (void)printf("  Checking the allocator tag\n");
+    }
+    
+    if (! check_location("first tagged", &one[0], tag,
+			 DMALLOC_ALLOC_TAG_LINE)) {
+      final = 0;
+    }
+    if (! check_location("second tagged", &two[0], tag,
+			 DMALLOC_ALLOC_TAG_LINE)) {
+      final = 0;
+    }
+    if (rebound.file() != tag || rebound.line() != DMALLOC_ALLOC_TAG_LINE) {
+      if (! silent_b) {
+	(void)printf("   ERROR: rebound allocator lost the tag\n");
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check that the node containers can rebind the allocator.
+   */
+  {
+    std::map<int, int, std::less<int>,
+	     dmalloc::allocator<std::pair<const int, int> > >
+      cache(std::less<int>(), dmalloc::allocator<int>("cache"));
+    int	num;
+    
+    if (verbose_b) {
+      (void)printf("  Checking a map with the allocator\n");
+    }
+    
+    for (num = 0; num < 100; num++) {
+      cache[num] = num * 2;
+    }
+    for (num = 0; num < 100; num += 10) {
+      cache.erase(num);
+    }
+    if (cache.size() != 90 || cache.find(55)->second != 110
+	|| cache.find(50) != cache.end()) {
+      if (! silent_b) {
+	(void)printf("   ERROR: map with the allocator has bad contents\n");
+      }
+      final = 0;
+    }
+    if (dmalloc_verify(NULL) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	(void)printf("   ERROR: heap is bad after the map: %s (err %d)\n",
+		     dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check the usage that the budget guard sees and that it raises the
+   * error when it goes out of scope over its budget.  NOTE: the error
+   * codes are internal so 0 marks that none was raised.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    dmalloc::allocator<int>	alloc;
+    int			*pnt;
+    
+    if (verbose_b) {
+      (void)printf("  Checking the budget guard\n");
+    }
+    
+    dmalloc_errno = 0;
+    
+    {
+      dmalloc::budget_guard	guard(2);
+      
+      pnt = alloc.allocate(5);
+      alloc.deallocate(pnt, 5);
+      if (guard.allocs() != 1 || guard.bytes() != 5 * sizeof(int)
+	  || guard.frees() != 1) {
+	if (! silent_b) {
+	  (void)printf("   ERROR: guard used %lu allocs, %lu bytes, "
+		       "%lu frees\n", guard.allocs(), guard.bytes(),
+		       guard.frees());
+	}
+	final = 0;
+      }
+    }
+    if (dmalloc_errno != 0) {
+      if (! silent_b) {
+	(void)printf("   ERROR: guard within its budget was reported\n");
+      }
+      final = 0;
+    }
+    
+    {
+      dmalloc::budget_guard	guard(1);
+      
+      alloc.deallocate(alloc.allocate(1), 1);
+      alloc.deallocate(alloc.allocate(1), 1);
+    }
+    if (dmalloc_errno == 0
+	|| strstr(dmalloc_strerror(dmalloc_errno), "budget") == NULL) {
+      if (! silent_b) {
+	(void)printf("   ERROR: over budget guard not reported: %s (err %d)\n",
+		     dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+#ifdef __cpp_aligned_new
+  /*
+   * Check that aligned new gives the alignment even when it is more
+   * than a block and refuses the alignments that it cannot give.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    over_aligned_t	*one, *many;
+    std::align_val_t	huge;
+    void		*pnt;
+    int			threw_b = 0;
+    
+    if (verbose_b) {
+      (void)printf("  Checking over-aligned new\n");
+    }
+    
+    one = new over_aligned_t;
+    many = new over_aligned_t[4];
+    if ((unsigned long)one % OVER_ALIGNMENT != 0
+	|| (unsigned long)many % OVER_ALIGNMENT != 0) {
+      if (! silent_b) {
+	(void)printf("   ERROR: over-aligned new gave %p and %p\n",
+		     (void *)one, (void *)many);
+      }
+      final = 0;
+    }
+    memset(one, 'x', sizeof(*one));
+    memset(many, 'x', sizeof(*many) * 4);
+    if (dmalloc_verify(NULL) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	(void)printf("   ERROR: heap is bad after over-aligned new: %s\n",
+		     dmalloc_strerror(dmalloc_errno));
+      }
+      final = 0;
+    }
+    delete one;
+    delete [] many;
+    
+    /* the library cannot give an alignment this large */
+    huge = std::align_val_t(static_cast<size_t>(1)
+			    << (sizeof(size_t) * 8 - 1));
+    pnt = operator new(10, huge, std::nothrow);
+    if (pnt != NULL) {
+      if (! silent_b) {
+	(void)printf("   ERROR: nothrow new gave %p for a huge alignment\n",
+		     pnt);
+      }
+      final = 0;
+    }
+    try {
+      pnt = operator new(10, huge);
+    }
+    catch (std::bad_alloc &) {
+      threw_b = 1;
+    }
+    if (! threw_b) {
+      if (! silent_b) {
+	(void)printf("   ERROR: new did not throw for a huge alignment\n");
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+#endif
+  
+  return final;
+}
+
+int	main(int argc, char **argv)
+{
+  int	final = 0, ret, arg_c;
+  
+  for (arg_c = 1; arg_c < argc; arg_c++) {
+    if (strcmp(argv[arg_c], "-s") == 0) {
+      silent_b = 1;
+    }
+    else if (strcmp(argv[arg_c], "-v") == 0) {
+      verbose_b = 1;
+    }
+    else {
+      (void)printf("Usage: %s [-s] [-v]\n", argv[0]);
+      exit(1);
+    }
+  }
+  
+  if (silent_b && verbose_b) {
+    silent_b = 0;
+  }
+  
+  if (! silent_b) {
+    (void)printf("Running C++ tests...\n");
+  }
+  (void)fflush(stdout);
+  
+  if (do_tests()) {
+    if (! silent_b) {
+      (void)printf("  Succeeded.\n");
+    }
+  }
+  else {
+    (void)printf("ERROR: C++ tests failed.  Last dmalloc error: %s (err %d)\n",
+		 dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    final = 1;
+  }
+  
+  /* last thing is to verify the heap */
+  ret = dmalloc_verify(NULL /* check all heap */);
+  if (ret != DMALLOC_NOERROR) {
+    (void)printf("Final dmalloc_verify returned failure: %s (err %d)\n",
+		 dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    final = 1;
+  }
+  
+  /* you will need this if you can't auto-shutdown */
+#if HAVE_ATEXIT == 0 && HAVE_ON_EXIT == 0 && FINI_DMALLOC == 0
+  /* shutdown the alloc routines */
+  dmalloc_shutdown();
+#endif
+  
+  exit(final);
+}
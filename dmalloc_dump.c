@@ -0,0 +1,1192 @@
+/*
+ * Heap dump analysis of the dmalloc utility
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+/*
+ * These routines read the dump files written by dmalloc_dump_heap.
+ * The files are mapped and the records are used in place so a dump
+ * of tens of millions of blocks is read in one pass without copying.
+ * The live statistics of a running program are mapped the same way.
+ * NOTE: like the rest of the utility, all output goes to stderr.
+ */
+
+#define DMALLOC_DISABLE
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_STDIO_H
+# include <stdio.h>
+#endif
+#if HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "conf.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#include "dmalloc.h"
+
+#include "append.h"
+#include "compat.h"
+#include "dmalloc_argv.h"
+#include "dmalloc_dump.h"
+#include "dmalloc_loc.h"
+
+/*
+ * static int section_ok
+ *
+ * See if a section of a heap dump is inside of the file.
+ *
+ * Returns 1 if it is otherwise 0.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are checking.
+ *
+ * off -> Offset of the section.
+ *
+ * num -> Number of elements in the section.
+ *
+ * size -> Size of each element.
+ */
+static	int	section_ok(const dump_file_t *dump_p, const unsigned long off,
+			   const unsigned long num, const unsigned long size)
+{
+  if (num == 0) {
+    return 1;
+  }
+  if (off > dump_p->df_size || off % DUMP_ALIGN != 0) {
+    return 0;
+  }
+  return (num <= (dump_p->df_size - off) / size);
+}
+
+/*
+ * static void dump_close
+ *
+ * Release the contents of a heap dump.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are closing.
+ */
+static	void	dump_close(dump_file_t *dump_p)
+{
+  if (dump_p->df_mem == NULL) {
+    return;
+  }
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+  if (dump_p->df_mapped_b) {
+    (void)munmap(dump_p->df_mem, dump_p->df_size);
+  }
+  else
+#endif
+    {
+      free(dump_p->df_mem);
+    }
+  dump_p->df_mem = NULL;
+}
+
+/*
+ * static int dump_open
+ *
+ * Map in a heap dump and check that its header and sections are
+ * sane.  Complaints are printed for the user.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ *
+ * dump_p <- Heap dump that we fill in.
+ */
+static	int	dump_open(const char *path, dump_file_t *dump_p)
+{
+  const dump_header_t	*header_p;
+  struct stat		statbuf;
+  unsigned long		done;
+  int			fd, ret;
+  
+  memset(dump_p, 0, sizeof(*dump_p));
+  dump_p->df_path = path;
+  
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    loc_fprintf(stderr, "%s: could not open heap dump '%s'\n",
+		argv_program, path);
+    return 0;
+  }
+  if (fstat(fd, &statbuf) != 0 || statbuf.st_size < sizeof(dump_header_t)) {
+    loc_fprintf(stderr, "%s: heap dump '%s' is too short\n",
+		argv_program, path);
+    (void)close(fd);
+    return 0;
+  }
+  dump_p->df_size = statbuf.st_size;
+  
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+  dump_p->df_mem = mmap(NULL, dump_p->df_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (dump_p->df_mem == MAP_FAILED) {
+    dump_p->df_mem = NULL;
+  }
+  else {
+    dump_p->df_mapped_b = 1;
+  }
+#endif
+  
+  /* read it in if it could not be mapped */
+  if (dump_p->df_mem == NULL) {
+    dump_p->df_mem = malloc(dump_p->df_size);
+    if (dump_p->df_mem == NULL) {
+      loc_fprintf(stderr, "%s: no memory to read heap dump '%s'\n",
+		  argv_program, path);
+      (void)close(fd);
+      return 0;
+    }
+    for (done = 0; done < dump_p->df_size; done += ret) {
+      ret = read(fd, dump_p->df_mem + done, dump_p->df_size - done);
+      if (ret <= 0) {
+	loc_fprintf(stderr, "%s: could not read heap dump '%s'\n",
+		    argv_program, path);
+	(void)close(fd);
+	dump_close(dump_p);
+	return 0;
+      }
+    }
+  }
+  (void)close(fd);
+  
+  header_p = (dump_header_t *)dump_p->df_mem;
+  if (memcmp(header_p->dh_magic, DUMP_MAGIC, sizeof(header_p->dh_magic)) != 0) {
+    loc_fprintf(stderr, "%s: '%s' is not a heap dump\n", argv_program, path);
+    dump_close(dump_p);
+    return 0;
+  }
+  if (header_p->dh_version != DUMP_VERSION
+      || header_p->dh_long_size != sizeof(unsigned long)) {
+    loc_fprintf(stderr,
+		"%s: heap dump '%s' is version %u with %u byte longs not %u with %u\n",
+		argv_program, path, header_p->dh_version,
+		header_p->dh_long_size, DUMP_VERSION,
+		(unsigned int)sizeof(unsigned long));
+    dump_close(dump_p);
+    return 0;
+  }
+  if ((! section_ok(dump_p, header_p->dh_rec_off, header_p->dh_rec_n,
+		    sizeof(dump_rec_t)))
+      || (! section_ok(dump_p, header_p->dh_site_off, header_p->dh_site_n,
+		       sizeof(dump_site_t)))
+      || (! section_ok(dump_p, header_p->dh_str_off, header_p->dh_str_size,
+		       1))
+      || (! section_ok(dump_p, header_p->dh_range_off, header_p->dh_range_n,
+		       sizeof(dump_range_t)))
+      || (header_p->dh_str_size > 0
+	  && dump_p->df_mem[header_p->dh_str_off + header_p->dh_str_size - 1]
+	  != '\0')) {
+    loc_fprintf(stderr, "%s: heap dump '%s' is truncated or corrupt\n",
+		argv_program, path);
+    dump_close(dump_p);
+    return 0;
+  }
+  
+  dump_p->df_header_p = header_p;
+  dump_p->df_recs = (dump_rec_t *)(dump_p->df_mem + header_p->dh_rec_off);
+  dump_p->df_sites = (dump_site_t *)(dump_p->df_mem + header_p->dh_site_off);
+  dump_p->df_strs = dump_p->df_mem + header_p->dh_str_off;
+  dump_p->df_ranges = (dump_range_t *)(dump_p->df_mem + header_p->dh_range_off);
+  return 1;
+}
+
+/*
+ * static void site_name
+ *
+ * Write the name of an allocation site into a buffer.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump the site is in.
+ *
+ * site -> Index of the site or the site count if it is not known.
+ *
+ * buf -> Buffer we write the name into.
+ *
+ * buf_size -> Size of the buffer.
+ */
+static	void	site_name(const dump_file_t *dump_p, const unsigned long site,
+			  char *buf, const int buf_size)
+{
+  const dump_site_t	*site_p;
+  
+  if (site >= dump_p->df_header_p->dh_site_n) {
+    loc_snprintf(buf, buf_size, "unknown");
+    return;
+  }
+  
+  site_p = dump_p->df_sites + site;
+  if (site_p->ds_name < dump_p->df_header_p->dh_str_size) {
+    loc_snprintf(buf, buf_size, "%s:%u", dump_p->df_strs + site_p->ds_name,
+		 site_p->ds_line);
+  }
+  else if (site_p->ds_ra != 0) {
+    loc_snprintf(buf, buf_size, "ra=%p", (DMALLOC_PNT)site_p->ds_ra);
+  }
+  else {
+    loc_snprintf(buf, buf_size, "unknown");
+  }
+}
+
+/*
+ * static dump_stat_t *site_stats
+ *
+ * Add up the memory in use from each of the allocation sites of a
+ * heap dump.  The extra entry at the end of the array is for the
+ * allocations with no site.
+ *
+ * Returns the array of site statistics or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are adding up.
+ *
+ * free_p <- Set to the free bytes in the dump if not NULL.
+ *
+ * free_n_p <- Set to the number of free blocks if not NULL.
+ */
+static	dump_stat_t	*site_stats(const dump_file_t *dump_p,
+				    unsigned long *free_p,
+				    unsigned long *free_n_p)
+{
+  const dump_rec_t	*rec_p, *bounds_p;
+  dump_stat_t		*stats;
+  unsigned long		site_n, site, free_size = 0, free_n = 0;
+  
+  site_n = dump_p->df_header_p->dh_site_n;
+  stats = calloc(site_n + 1, sizeof(dump_stat_t));
+  if (stats == NULL) {
+    loc_fprintf(stderr, "%s: no memory for the sites of '%s'\n",
+		argv_program, dump_p->df_path);
+    return NULL;
+  }
+  for (site = 0; site <= site_n; site++) {
+    stats[site].st_site = site;
+  }
+  
+  bounds_p = dump_p->df_recs + dump_p->df_header_p->dh_rec_n;
+  for (rec_p = dump_p->df_recs; rec_p < bounds_p; rec_p++) {
+    if (! (rec_p->dr_flags & DUMP_REC_USED)) {
+      free_size += rec_p->dr_total_size;
+      free_n++;
+      continue;
+    }
+    site = rec_p->dr_site;
+    if (site >= site_n) {
+      site = site_n;
+    }
+    stats[site].st_bytes += rec_p->dr_user_size;
+    stats[site].st_count++;
+  }
+  
+  if (free_p != NULL) {
+    *free_p = free_size;
+  }
+  if (free_n_p != NULL) {
+    *free_n_p = free_n;
+  }
+  return stats;
+}
+
+/*
+ * static int bytes_compare
+ *
+ * Sort the site statistics with the most bytes first.
+ */
+static	int	bytes_compare(const void *one_p, const void *two_p)
+{
+  const dump_stat_t	*one = one_p, *two = two_p;
+  
+  if (one->st_bytes != two->st_bytes) {
+    return (one->st_bytes < two->st_bytes ? 1 : -1);
+  }
+  if (one->st_count != two->st_count) {
+    return (one->st_count < two->st_count ? 1 : -1);
+  }
+  return (one->st_site < two->st_site ? -1 : 1);
+}
+
+/*
+ * static int key_compare
+ *
+ * Sort the site statistics by their names.
+ */
+static	int	key_compare(const void *one_p, const void *two_p)
+{
+  const dump_stat_t	*one = one_p, *two = two_p;
+  
+  return strcmp(one->st_key, two->st_key);
+}
+
+/*
+ * static int delta_compare
+ *
+ * Sort the site statistics with the biggest change in bytes first.
+ */
+static	int	delta_compare(const void *one_p, const void *two_p)
+{
+  const dump_stat_t	*one = one_p, *two = two_p;
+  unsigned long		one_abs, two_abs;
+  
+  one_abs = (one->st_bytes_delta < 0 ? -one->st_bytes_delta
+	     : one->st_bytes_delta);
+  two_abs = (two->st_bytes_delta < 0 ? -two->st_bytes_delta
+	     : two->st_bytes_delta);
+  if (one_abs != two_abs) {
+    return (one_abs < two_abs ? 1 : -1);
+  }
+  return strcmp(one->st_key, two->st_key);
+}
+
+/*
+ * static void dump_title
+ *
+ * Print the line which says which dump we are looking at.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are printing.
+ */
+static	void	dump_title(const dump_file_t *dump_p)
+{
+  loc_fprintf(stderr, "Heap dump '%s' of process %lu at iter %lu:\n",
+	      dump_p->df_path, dump_p->df_header_p->dh_pid,
+	      dump_p->df_header_p->dh_iter);
+}
+
+/*
+ * int _dmalloc_dump_top
+ *
+ * Print the allocation sites of a heap dump with the most memory in
+ * use.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ *
+ * top_n -> Number of sites to print.
+ */
+int	_dmalloc_dump_top(const char *path, const int top_n)
+{
+  dump_file_t	dump;
+  dump_stat_t	*stats, *stat_p;
+  unsigned long	site_n, total_size = 0, total_n = 0, free_size, free_n;
+  char		name[DUMP_NAME_SIZE];
+  int		print_c;
+  
+  if (! dump_open(path, &dump)) {
+    return 0;
+  }
+  stats = site_stats(&dump, &free_size, &free_n);
+  if (stats == NULL) {
+    dump_close(&dump);
+    return 0;
+  }
+  
+  site_n = dump.df_header_p->dh_site_n + 1;
+  for (stat_p = stats; stat_p < stats + site_n; stat_p++) {
+    total_size += stat_p->st_bytes;
+    total_n += stat_p->st_count;
+  }
+  qsort(stats, site_n, sizeof(dump_stat_t), bytes_compare);
+  
+  dump_title(&dump);
+  loc_fprintf(stderr, "  %lu bytes in %lu allocations, %lu bytes in %lu free blocks\n",
+	      total_size, total_n, free_size, free_n);
+  loc_fprintf(stderr, "  %12s %10s  %s\n", "bytes", "count", "site");
+  for (print_c = 0; print_c < top_n && print_c < site_n; print_c++) {
+    stat_p = stats + print_c;
+    if (stat_p->st_count == 0) {
+      break;
+    }
+    site_name(&dump, stat_p->st_site, name, sizeof(name));
+    loc_fprintf(stderr, "  %12lu %10lu  %s\n",
+		stat_p->st_bytes, stat_p->st_count, name);
+  }
+  
+  free(stats);
+  dump_close(&dump);
+  return 1;
+}
+
+/*
+ * int _dmalloc_dump_sizes
+ *
+ * Print a histogram of the sizes of the allocations in a heap dump in
+ * powers of two.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ */
+int	_dmalloc_dump_sizes(const char *path)
+{
+  dump_file_t		dump;
+  const dump_rec_t	*rec_p, *bounds_p;
+  unsigned long		counts[sizeof(unsigned long) * 8 + 1];
+  unsigned long		bytes[sizeof(unsigned long) * 8 + 1];
+  unsigned long		size, low;
+  int			bucket, bucket_n = sizeof(counts) / sizeof(*counts);
+  
+  if (! dump_open(path, &dump)) {
+    return 0;
+  }
+  memset(counts, 0, sizeof(counts));
+  memset(bytes, 0, sizeof(bytes));
+  
+  /* bucket 0 is for 0 bytes, bucket N for [2^(N-1), 2^N) */
+  bounds_p = dump.df_recs + dump.df_header_p->dh_rec_n;
+  for (rec_p = dump.df_recs; rec_p < bounds_p; rec_p++) {
+    if (! (rec_p->dr_flags & DUMP_REC_USED)) {
+      continue;
+    }
+    bucket = 0;
+    for (size = rec_p->dr_user_size; size > 0; size >>= 1) {
+      bucket++;
+    }
+    counts[bucket]++;
+    bytes[bucket] += rec_p->dr_user_size;
+  }
+  
+  dump_title(&dump);
+  loc_fprintf(stderr, "  %24s %10s %12s\n", "size", "count", "bytes");
+  for (bucket = 0; bucket < bucket_n; bucket++) {
+    if (counts[bucket] == 0) {
+      continue;
+    }
+    if (bucket == 0) {
+      loc_fprintf(stderr, "  %24s %10lu %12lu\n", "0", counts[bucket],
+		  bytes[bucket]);
+      continue;
+    }
+    low = 1UL << (bucket - 1);
+    loc_fprintf(stderr, "  %10lu - %11lu %10lu %12lu\n",
+		low, low + (low - 1), counts[bucket], bytes[bucket]);
+  }
+  
+  dump_close(&dump);
+  return 1;
+}
+
+/*
+ * int _dmalloc_dump_classes
+ *
+ * Fit size classes for the small allocations to the sizes in a heap
+ * dump.  The classes are chosen to waste the fewest bytes when the
+ * allocations are rounded up to them and are printed in the form
+ * that the classes option takes.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ *
+ * class_n -> Number of classes to add to the powers of two.
+ */
+int	_dmalloc_dump_classes(const char *path, const int class_n)
+{
+  dump_file_t		dump;
+  const dump_rec_t	*rec_p, *bounds_p;
+  unsigned long		*mem, *counts, *sizes, *forced, *pre_c, *pre_b;
+  unsigned long		*waste;
+  long			*prev;
+  unsigned long		size, cost, best, old_waste = 0, user_total = 0;
+  int			point_n, point_c, start_c, add_n, add_c, best_add;
+  char			classes[1024], *buf_p, *buf_bounds_p;
+  
+  if (! dump_open(path, &dump)) {
+    return 0;
+  }
+  
+  /* the tables of the fit are cut out of one allocation */
+  add_n = MAX(class_n, 0);
+  mem = calloc((5 + 2 * (add_n + 1)) * DUMP_CLASS_N + 2, sizeof(*mem));
+  if (mem == NULL) {
+    loc_fprintf(stderr, "%s: out of memory fitting classes to '%s'\n",
+		argv_program, path);
+    dump_close(&dump);
+    return 0;
+  }
+  counts = mem;
+  sizes = counts + DUMP_CLASS_N;
+  forced = sizes + DUMP_CLASS_N;
+  pre_c = forced + DUMP_CLASS_N;
+  pre_b = pre_c + DUMP_CLASS_N + 1;
+  waste = pre_b + DUMP_CLASS_N + 1;
+  prev = (long *)(waste + (add_n + 1) * DUMP_CLASS_N);
+  
+  /* count the slot sizes that the small allocations need */
+  bounds_p = dump.df_recs + dump.df_header_p->dh_rec_n;
+  for (rec_p = dump.df_recs; rec_p < bounds_p; rec_p++) {
+    if ((! (rec_p->dr_flags & DUMP_REC_USED))
+	|| rec_p->dr_total_size > DUMP_CLASS_LARGEST) {
+      continue;
+    }
+    size = rec_p->dr_user_size;
+    if (rec_p->dr_flags & DUMP_REC_FENCE) {
+      size += FENCE_BOTTOM_SIZE + FENCE_TOP_SIZE;
+    }
+    size = MAX(size, DUMP_CLASS_SMALLEST);
+    size = (size + ALLOCATION_ALIGNMENT - 1) / ALLOCATION_ALIGNMENT;
+    if (size >= DUMP_CLASS_N) {
+      continue;
+    }
+    counts[size]++;
+    old_waste += rec_p->dr_total_size - size * ALLOCATION_ALIGNMENT;
+    user_total += size * ALLOCATION_ALIGNMENT;
+  }
+  
+  /*
+   * The points that classes can be at are the sizes that were seen
+   * and the powers of two which the library always has.
+   */
+  point_n = 0;
+  for (size = 1; size < DUMP_CLASS_N; size++) {
+    unsigned long	bytes = size * ALLOCATION_ALIGNMENT;
+    int			pow2_b;
+    
+    pow2_b = (bytes >= DUMP_CLASS_SMALLEST && (bytes & (bytes - 1)) == 0);
+    if (counts[size] == 0 && (! pow2_b)) {
+      continue;
+    }
+    sizes[point_n] = bytes;
+    forced[point_n] = pow2_b;
+    pre_c[point_n + 1] = pre_c[point_n] + counts[size];
+    pre_b[point_n + 1] = pre_b[point_n] + counts[size] * bytes;
+    point_n++;
+  }
+  
+  /*
+   * waste[add * N + point] is the least waste of the allocations up
+   * to the point with a class there and add classes beyond the powers
+   * of two.  A class can only take the sizes back to the class before
+   * it and the powers of two cannot be skipped.
+   */
+  for (add_c = 0; add_c <= add_n; add_c++) {
+    for (point_c = 0; point_c < point_n; point_c++) {
+      int	used_n = add_c - (forced[point_c] ? 0 : 1);
+      
+      waste[add_c * DUMP_CLASS_N + point_c] = (unsigned long)-1;
+      prev[add_c * DUMP_CLASS_N + point_c] = -2;
+      if (used_n < 0) {
+	continue;
+      }
+      for (start_c = point_c - 1; start_c >= -1; start_c--) {
+	cost = sizes[point_c] * (pre_c[point_c + 1] - pre_c[start_c + 1])
+	  - (pre_b[point_c + 1] - pre_b[start_c + 1]);
+	if (start_c == -1) {
+	  if (used_n == 0) {
+	    best = cost;
+	  }
+	  else {
+	    break;
+	  }
+	}
+	else if (waste[used_n * DUMP_CLASS_N + start_c] == (unsigned long)-1) {
+	  if (forced[start_c]) {
+	    break;
+	  }
+	  continue;
+	}
+	else {
+	  best = waste[used_n * DUMP_CLASS_N + start_c] + cost;
+	}
+	if (best < waste[add_c * DUMP_CLASS_N + point_c]) {
+	  waste[add_c * DUMP_CLASS_N + point_c] = best;
+	  prev[add_c * DUMP_CLASS_N + point_c] = start_c;
+	}
+	if (start_c >= 0 && forced[start_c]) {
+	  break;
+	}
+      }
+    }
+  }
+  
+  /* the largest size is a power of two so it is always a class */
+  best_add = 0;
+  for (add_c = 1; add_c <= add_n; add_c++) {
+    if (waste[add_c * DUMP_CLASS_N + point_n - 1]
+	< waste[best_add * DUMP_CLASS_N + point_n - 1]) {
+      best_add = add_c;
+    }
+  }
+  
+  /* walk back through the classes marking the ones that were added */
+  memset(counts, 0, DUMP_CLASS_N * sizeof(*counts));
+  add_c = best_add;
+  for (point_c = point_n - 1; point_c >= 0;) {
+    start_c = prev[add_c * DUMP_CLASS_N + point_c];
+    if (! forced[point_c]) {
+      counts[point_c] = 1;
+      add_c--;
+    }
+    point_c = start_c;
+  }
+  
+  buf_p = classes;
+  buf_bounds_p = classes + sizeof(classes);
+  *buf_p = '\0';
+  for (point_c = 0; point_c < point_n; point_c++) {
+    if (counts[point_c]) {
+      buf_p += loc_snprintf(buf_p, buf_bounds_p - buf_p, "%s%lu",
+			    (buf_p == classes ? "" : ":"), sizes[point_c]);
+    }
+  }
+  
+  dump_title(&dump);
+  loc_fprintf(stderr, "  small allocation bytes: %lu\n", user_total);
+  loc_fprintf(stderr, "  waste in the dump:      %lu bytes\n", old_waste);
+  loc_fprintf(stderr, "  waste with %d classes:  %lu bytes\n", best_add,
+	      (point_n == 0 ? 0 :
+	       waste[best_add * DUMP_CLASS_N + point_n - 1]));
+  if (best_add > 0) {
+    loc_fprintf(stderr, "  classes=%s\n", classes);
+  }
+  
+  free(mem);
+  dump_close(&dump);
+  return 1;
+}
+
+/*
+ * static void add_cells
+ *
+ * Add a block of memory to the cells of a fragmentation map.
+ *
+ * ARGUMENTS:
+ *
+ * cells -> Bytes in each of the cells of the map.
+ *
+ * range_p -> Heap range of the map.
+ *
+ * cell_size -> Bytes covered by each cell.
+ *
+ * addr -> Start of the block.
+ *
+ * size -> Size of the block.
+ */
+static	void	add_cells(unsigned long *cells, const dump_range_t *range_p,
+			  const unsigned long cell_size, unsigned long addr,
+			  unsigned long size)
+{
+  unsigned long	end, cell, cell_end;
+  
+  if (addr < range_p->dg_low || addr >= range_p->dg_high) {
+    return;
+  }
+  end = addr + size;
+  if (end > range_p->dg_high || end < addr) {
+    end = range_p->dg_high;
+  }
+  
+  while (addr < end) {
+    cell = (addr - range_p->dg_low) / cell_size;
+    cell_end = range_p->dg_low + (cell + 1) * cell_size;
+    if (cell_end > end) {
+      cell_end = end;
+    }
+    cells[cell] += cell_end - addr;
+    addr = cell_end;
+  }
+}
+
+/*
+ * int _dmalloc_dump_map
+ *
+ * Print a map of the used and free memory across the heap ranges of a
+ * heap dump and how fragmented the free memory is.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ */
+int	_dmalloc_dump_map(const char *path)
+{
+  dump_file_t		dump;
+  const dump_rec_t	*rec_p, *bounds_p;
+  const dump_range_t	*range_p;
+  unsigned long		used[DUMP_MAP_WIDTH * DUMP_MAP_LINES];
+  unsigned long		freed[DUMP_MAP_WIDTH * DUMP_MAP_LINES];
+  unsigned long		cell_size, largest, free_size, range_size;
+  char			line[DUMP_MAP_WIDTH + 1], ch;
+  int			cell_c, line_c;
+  
+  if (! dump_open(path, &dump)) {
+    return 0;
+  }
+  
+  dump_title(&dump);
+  loc_fprintf(stderr, "  '#' used, 'o' mostly used, ':' mostly free, '.' free, ' ' admin or unused\n");
+  bounds_p = dump.df_recs + dump.df_header_p->dh_rec_n;
+  
+  for (range_p = dump.df_ranges;
+       range_p < dump.df_ranges + dump.df_header_p->dh_range_n;
+       range_p++) {
+    if (range_p->dg_high <= range_p->dg_low) {
+      continue;
+    }
+    range_size = range_p->dg_high - range_p->dg_low;
+    cell_size = (range_size + DUMP_MAP_WIDTH * DUMP_MAP_LINES - 1)
+      / (DUMP_MAP_WIDTH * DUMP_MAP_LINES);
+    memset(used, 0, sizeof(used));
+    memset(freed, 0, sizeof(freed));
+    largest = 0;
+    free_size = 0;
+  
+    for (rec_p = dump.df_recs; rec_p < bounds_p; rec_p++) {
+      /* large objects are mapped outside of the heap */
+      if (rec_p->dr_flags & DUMP_REC_LARGE) {
+	continue;
+      }
+      if (rec_p->dr_flags & DUMP_REC_USED) {
+	add_cells(used, range_p, cell_size, rec_p->dr_addr,
+		  rec_p->dr_user_size);
+	continue;
+      }
+      if (rec_p->dr_addr < range_p->dg_low
+	  || rec_p->dr_addr >= range_p->dg_high) {
+	continue;
+      }
+      add_cells(freed, range_p, cell_size, rec_p->dr_addr,
+		rec_p->dr_total_size);
+      free_size += rec_p->dr_total_size;
+      if (rec_p->dr_total_size > largest) {
+	largest = rec_p->dr_total_size;
+      }
+    }
+  
+    loc_fprintf(stderr, "  heap %p to %p, %lu bytes per cell:\n",
+		(DMALLOC_PNT)range_p->dg_low, (DMALLOC_PNT)range_p->dg_high,
+		cell_size);
+    for (line_c = 0; line_c < DUMP_MAP_LINES; line_c++) {
+      for (cell_c = 0; cell_c < DUMP_MAP_WIDTH; cell_c++) {
+	unsigned long	cell = line_c * DUMP_MAP_WIDTH + cell_c;
+	if (used[cell] == 0 && freed[cell] == 0) {
+	  ch = ' ';
+	}
+	else if (used[cell] == 0) {
+	  ch = '.';
+	}
+	else if (freed[cell] == 0) {
+	  ch = '#';
+	}
+	else if (used[cell] >= freed[cell]) {
+	  ch = 'o';
+	}
+	else {
+	  ch = ':';
+	}
+	line[cell_c] = ch;
+      }
+      line[DUMP_MAP_WIDTH] = '\0';
+      loc_fprintf(stderr, "  |%s|\n", line);
+    }
+  
+    /* how much of the free memory is not in the largest block */
+    loc_fprintf(stderr, "  %lu bytes free, largest free block %lu bytes, fragmentation %lu%%\n",
+		free_size, largest,
+		(free_size == 0 ? 0UL
+		 : (unsigned long)(100.0 - (double)largest * 100.0 / free_size)));
+  }
+  
+  dump_close(&dump);
+  return 1;
+}
+
+/*
+ * static dump_stat_t *keyed_stats
+ *
+ * Add up the memory in use from each site of a heap dump and name the
+ * sites so they can be matched with those of another dump.
+ *
+ * Returns the sorted array of site statistics or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * dump_p -> Heap dump we are adding up.
+ *
+ * stat_n_p <- Set to the number of entries in the array.
+ */
+static	dump_stat_t	*keyed_stats(const dump_file_t *dump_p,
+				     unsigned long *stat_n_p)
+{
+  dump_stat_t	*stats, *stat_p;
+  unsigned long	stat_n;
+  char		name[DUMP_NAME_SIZE];
+  
+  stats = site_stats(dump_p, NULL, NULL);
+  if (stats == NULL) {
+    return NULL;
+  }
+  stat_n = dump_p->df_header_p->dh_site_n + 1;
+  for (stat_p = stats; stat_p < stats + stat_n; stat_p++) {
+    site_name(dump_p, stat_p->st_site, name, sizeof(name));
+    stat_p->st_key = strdup(name);
+    if (stat_p->st_key == NULL) {
+      loc_fprintf(stderr, "%s: no memory for the sites of '%s'\n",
+		  argv_program, dump_p->df_path);
+      for (stat_p--; stat_p >= stats; stat_p--) {
+	free((char *)stat_p->st_key);
+      }
+      free(stats);
+      return NULL;
+    }
+  }
+  
+  qsort(stats, stat_n, sizeof(dump_stat_t), key_compare);
+  *stat_n_p = stat_n;
+  return stats;
+}
+
+/*
+ * int _dmalloc_dump_diff
+ *
+ * Print the allocation sites whose memory in use changed the most
+ * between two heap dumps.  The sites are matched by their file and
+ * line or return-address so the dumps can come from different runs.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * old_path -> Path of the earlier heap dump.
+ *
+ * new_path -> Path of the later heap dump.
+ *
+ * top_n -> Number of sites to print.
+ */
+int	_dmalloc_dump_diff(const char *old_path, const char *new_path,
+			   const int top_n)
+{
+  dump_file_t	old_dump, new_dump;
+  dump_stat_t	*old_stats = NULL, *new_stats = NULL, *diffs = NULL;
+  dump_stat_t	*old_p, *new_p, *diff_p;
+  unsigned long	old_n = 0, new_n = 0, diff_n = 0;
+  int		cmp, print_c, ret = 0;
+  
+  if (! dump_open(old_path, &old_dump)) {
+    return 0;
+  }
+  if (! dump_open(new_path, &new_dump)) {
+    dump_close(&old_dump);
+    return 0;
+  }
+  
+  old_stats = keyed_stats(&old_dump, &old_n);
+  new_stats = keyed_stats(&new_dump, &new_n);
+  if (old_stats != NULL && new_stats != NULL) {
+    diffs = malloc((old_n + new_n) * sizeof(dump_stat_t));
+    if (diffs == NULL) {
+      loc_fprintf(stderr, "%s: no memory to diff the heap dumps\n",
+		  argv_program);
+    }
+  }
+  
+  if (diffs != NULL) {
+    /* merge the two sorted lists matching the sites by name */
+    old_p = old_stats;
+    new_p = new_stats;
+    while (old_p < old_stats + old_n || new_p < new_stats + new_n) {
+      if (old_p == old_stats + old_n) {
+	cmp = 1;
+      }
+      else if (new_p == new_stats + new_n) {
+	cmp = -1;
+      }
+      else {
+	cmp = strcmp(old_p->st_key, new_p->st_key);
+      }
+  
+      diff_p = diffs + diff_n;
+      memset(diff_p, 0, sizeof(*diff_p));
+      if (cmp <= 0) {
+	diff_p->st_key = old_p->st_key;
+	diff_p->st_bytes_delta -= old_p->st_bytes;
+	diff_p->st_count_delta -= old_p->st_count;
+	old_p++;
+      }
+      if (cmp >= 0) {
+	diff_p->st_key = new_p->st_key;
+	diff_p->st_bytes = new_p->st_bytes;
+	diff_p->st_count = new_p->st_count;
+	diff_p->st_bytes_delta += new_p->st_bytes;
+	diff_p->st_count_delta += new_p->st_count;
+	new_p++;
+      }
+      if (diff_p->st_bytes_delta != 0 || diff_p->st_count_delta != 0) {
+	diff_n++;
+      }
+    }
+    qsort(diffs, diff_n, sizeof(dump_stat_t), delta_compare);
+  
+    loc_fprintf(stderr, "Changes from heap dump '%s' to '%s':\n",
+		old_path, new_path);
+    loc_fprintf(stderr, "  %12s %10s %12s %10s  %s\n",
+		"bytes", "count", "now bytes", "now count", "site");
+    for (print_c = 0; print_c < top_n && print_c < diff_n; print_c++) {
+      diff_p = diffs + print_c;
+      loc_fprintf(stderr, "  %12ld %10ld %12lu %10lu  %s\n",
+		  diff_p->st_bytes_delta, diff_p->st_count_delta,
+		  diff_p->st_bytes, diff_p->st_count, diff_p->st_key);
+    }
+    free(diffs);
+    ret = 1;
+  }
+  
+  if (old_stats != NULL) {
+    for (old_p = old_stats; old_p < old_stats + old_n; old_p++) {
+      free((char *)old_p->st_key);
+    }
+    free(old_stats);
+  }
+  if (new_stats != NULL) {
+    for (new_p = new_stats; new_p < new_stats + new_n; new_p++) {
+      free((char *)new_p->st_key);
+    }
+    free(new_stats);
+  }
+  dump_close(&old_dump);
+  dump_close(&new_dump);
+  return ret;
+}
+
+#if LIVE_STATS
+/*
+ * static int live_copy
+ *
+ * Copy the live statistics out of the file while the program may be
+ * writing them.  The copy is made again if the program was in the
+ * middle of writing.
+ *
+ * Returns 1 on success or 0 if the statistics never settled.
+ *
+ * ARGUMENTS:
+ *
+ * live_p -> Statistics mapped from the file.
+ *
+ * copy_p <- Copy of the statistics which we fill in.
+ */
+static	int	live_copy(const live_stats_t *live_p, live_stats_t *copy_p)
+{
+  unsigned long	seq;
+  int		try_c;
+  
+  for (try_c = 0; try_c < LIVE_COPY_TRIES; try_c++) {
+    seq = live_p->ls_seq;
+    if (seq % 2 != 0) {
+      continue;
+    }
+    LIVE_BARRIER();
+    memcpy(copy_p, (const void *)live_p, sizeof(*copy_p));
+    LIVE_BARRIER();
+    if (live_p->ls_seq == seq) {
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+/*
+ * static void live_print
+ *
+ * Print a screen of the live statistics.
+ *
+ * ARGUMENTS:
+ *
+ * live_p -> Statistics that we are printing.
+ *
+ * last_p -> Statistics from the last screen for the rates or NULL if
+ * this is the first.
+ *
+ * secs -> Seconds since the last screen.
+ */
+static	void	live_print(const live_stats_t *live_p,
+			   const live_stats_t *last_p, const int secs)
+{
+  const live_site_t	*site_p;
+  unsigned long		count_c, calls = 0, last_calls = 0;
+  
+  for (count_c = 0; count_c < LIVE_COUNT_N; count_c++) {
+    calls += live_p->ls_counts[count_c];
+    if (last_p != NULL) {
+      last_calls += last_p->ls_counts[count_c];
+    }
+  }
+  
+  loc_fprintf(stderr, "Live stats of process %lu at iter %lu%s:\n",
+	      live_p->ls_pid, live_p->ls_iter,
+	      ((live_p->ls_flags & LIVE_EXITED) ? " (exited)" : ""));
+  loc_fprintf(stderr, "  in use: %lu bytes (%lu pnts), max %lu bytes (%lu pnts)\n",
+	      live_p->ls_cur_size, live_p->ls_cur_pnts, live_p->ls_max_size,
+	      live_p->ls_max_pnts);
+  loc_fprintf(stderr, "  allocated: %lu bytes (%lu pnts), max one %lu bytes\n",
+	      live_p->ls_total_size, live_p->ls_total_pnts,
+	      live_p->ls_max_one);
+  loc_fprintf(stderr, "  calls: malloc %lu, calloc %lu, realloc %lu, free %lu\n",
+	      live_p->ls_counts[LIVE_MALLOC], live_p->ls_counts[LIVE_CALLOC],
+	      live_p->ls_counts[LIVE_REALLOC], live_p->ls_counts[LIVE_FREE]);
+  loc_fprintf(stderr, "  calls: recalloc %lu, memalign %lu, valloc %lu, new %lu, delete %lu\n",
+	      live_p->ls_counts[LIVE_RECALLOC],
+	      live_p->ls_counts[LIVE_MEMALIGN],
+	      live_p->ls_counts[LIVE_VALLOC], live_p->ls_counts[LIVE_NEW],
+	      live_p->ls_counts[LIVE_DELETE]);
+  if (last_p != NULL && secs > 0) {
+    loc_fprintf(stderr, "  rates: %lu calls/sec, %ld bytes/sec in use\n",
+		(calls - last_calls) / secs,
+		((long)live_p->ls_cur_size - (long)last_p->ls_cur_size) / secs);
+  }
+  loc_fprintf(stderr, "  heap: %lu bytes, user %lu blocks, admin %lu blocks (%lu bytes)\n",
+	      live_p->ls_total_space, live_p->ls_user_block_c,
+	      live_p->ls_admin_block_c, live_p->ls_admin_space);
+  loc_fprintf(stderr, "  heap: %lu large objects (%lu bytes), %lu bytes given back, checked %lu\n",
+	      live_p->ls_large_c, live_p->ls_large_size,
+	      live_p->ls_purged_size, live_p->ls_heap_check_c);
+  
+  if (live_p->ls_site_n == 0) {
+    return;
+  }
+  loc_fprintf(stderr, "  %12s %10s %12s %10s  %s\n",
+	      "bytes", "count", "total bytes", "total", "site");
+  for (site_p = live_p->ls_sites;
+       site_p < live_p->ls_sites + MIN(live_p->ls_site_n, LIVE_SITE_N);
+       site_p++) {
+    loc_fprintf(stderr, "  %12lu %10lu %12lu %10lu  %.*s\n",
+		site_p->lt_in_use_size, site_p->lt_in_use_c,
+		site_p->lt_total_size, site_p->lt_total_c,
+		(int)sizeof(site_p->lt_desc), site_p->lt_desc);
+  }
+}
+#endif /* if LIVE_STATS */
+
+/*
+ * int _dmalloc_dump_live
+ *
+ * Print the live statistics that a program running with the
+ * live-stats token publishes.  The file is mapped and read in place
+ * so the program is not stopped or signaled.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * pid -> Process id of the program.
+ *
+ * every_secs -> Print the statistics again every this many seconds
+ * until the program exits or 0 to print them once.
+ */
+int	_dmalloc_dump_live(const long pid, const int every_secs)
+{
+#if LIVE_STATS
+  live_stats_t	*live_p, copy, last;
+  struct stat	statbuf;
+  char		path[512];
+  int		fd, screen_c, ret = 1;
+  
+  (void)loc_snprintf(path, sizeof(path), LIVE_STATS_PATH, pid);
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    loc_fprintf(stderr, "%s: could not open live stats '%s'\n",
+		argv_program, path);
+    return 0;
+  }
+  if (fstat(fd, &statbuf) != 0 || statbuf.st_size < sizeof(live_stats_t)) {
+    loc_fprintf(stderr, "%s: live stats '%s' are too short\n",
+		argv_program, path);
+    (void)close(fd);
+    return 0;
+  }
+  live_p = mmap(NULL, sizeof(live_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+  (void)close(fd);
+  if (live_p == MAP_FAILED) {
+    loc_fprintf(stderr, "%s: could not map live stats '%s'\n",
+		argv_program, path);
+    return 0;
+  }
+  
+  for (screen_c = 0;; screen_c++) {
+    if (! live_copy(live_p, &copy)) {
+      loc_fprintf(stderr, "%s: live stats '%s' are always being written\n",
+		  argv_program, path);
+      ret = 0;
+      break;
+    }
+    if (memcmp(copy.ls_magic, LIVE_MAGIC, sizeof(copy.ls_magic)) != 0) {
+      loc_fprintf(stderr, "%s: '%s' are not live stats\n", argv_program,
+		  path);
+      ret = 0;
+      break;
+    }
+    if (copy.ls_version != LIVE_VERSION
+	|| copy.ls_long_size != sizeof(unsigned long)
+	|| copy.ls_size != sizeof(live_stats_t)) {
+      loc_fprintf(stderr,
+		  "%s: live stats '%s' are version %u with %u byte longs not %u with %u\n",
+		  argv_program, path, copy.ls_version, copy.ls_long_size,
+		  LIVE_VERSION, (unsigned int)sizeof(unsigned long));
+      ret = 0;
+      break;
+    }
+    
+    /* clear the terminal between the screens like top */
+    if (every_secs > 0 && isatty(STDERR)) {
+      loc_fprintf(stderr, "\033[H\033[2J");
+    }
+    live_print(&copy, (screen_c == 0 ? NULL : &last), every_secs);
+    
+    if (every_secs <= 0 || (copy.ls_flags & LIVE_EXITED)) {
+      break;
+    }
+    last = copy;
+    (void)sleep(every_secs);
+  }
+  
+  (void)munmap(live_p, sizeof(live_stats_t));
+  return ret;
+#else
+  loc_fprintf(stderr, "%s: live stats not supported without mmap\n",
+	      argv_program);
+  return 0;
+#endif
+}
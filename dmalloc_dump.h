@@ -0,0 +1,183 @@
+/*
+ * Defines for the heap dump analysis of the dmalloc utility
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __DMALLOC_DUMP_H__
+#define __DMALLOC_DUMP_H__
+
+#include "heap_dump.h"
+#include "live_stats.h"
+
+/* number of sites that are shown by default */
+#define DUMP_TOP_DEFAULT	10
+
+/* size of the fragmentation map of each heap range */
+#define DUMP_MAP_WIDTH		64		/* cells per line */
+#define DUMP_MAP_LINES		16		/* lines per range */
+
+/* sizes of the divided blocks that the size classes are fitted to */
+#define DUMP_CLASS_SMALLEST	(FENCE_BOTTOM_SIZE + DEFAULT_SMALLEST_ALLOCATION)
+#define DUMP_CLASS_LARGEST	(BLOCK_SIZE / 2)
+#define DUMP_CLASS_N		(DUMP_CLASS_LARGEST / ALLOCATION_ALIGNMENT + 1)
+
+/* times we try to copy the live statistics while they are written */
+#define LIVE_COPY_TRIES		1000000
+
+/* size of the site names that we print */
+#define DUMP_NAME_SIZE		256
+
+/*
+ * Heap dump file which has been read in.
+ */
+typedef struct {
+  const char		*df_path;		/* path of the file */
+  char			*df_mem;		/* contents of the file */
+  unsigned long		df_size;		/* size of the file */
+  int			df_mapped_b;		/* contents are mapped */
+  const dump_header_t	*df_header_p;		/* header of the dump */
+  const dump_rec_t	*df_recs;		/* records of the blocks */
+  const dump_site_t	*df_sites;		/* allocation sites */
+  const char		*df_strs;		/* file-name strings */
+  const dump_range_t	*df_ranges;		/* heap ranges */
+} dump_file_t;
+
+/*
+ * Memory in use from one allocation site.
+ */
+typedef struct {
+  const char		*st_key;		/* name of the site for diffs */
+  unsigned long		st_site;		/* index of the site */
+  unsigned long		st_bytes;		/* bytes in use */
+  unsigned long		st_count;		/* number of allocations */
+  long			st_bytes_delta;		/* bytes change in a diff */
+  long			st_count_delta;		/* count change in a diff */
+} dump_stat_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int _dmalloc_dump_top
+ *
+ * Print the allocation sites of a heap dump with the most memory in
+ * use.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ *
+ * top_n -> Number of sites to print.
+ */
+extern
+int	_dmalloc_dump_top(const char *path, const int top_n);
+
+/*
+ * int _dmalloc_dump_sizes
+ *
+ * Print a histogram of the sizes of the allocations in a heap dump in
+ * powers of two.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ */
+extern
+int	_dmalloc_dump_sizes(const char *path);
+
+/*
+ * int _dmalloc_dump_classes
+ *
+ * Fit size classes for the small allocations to the sizes in a heap
+ * dump.  The classes are chosen to waste the fewest bytes when the
+ * allocations are rounded up to them and are printed in the form
+ * that the classes option takes.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ *
+ * class_n -> Number of classes to add to the powers of two.
+ */
+extern
+int	_dmalloc_dump_classes(const char *path, const int class_n);
+
+/*
+ * int _dmalloc_dump_map
+ *
+ * Print a map of the used and free memory across the heap ranges of a
+ * heap dump and how fragmented the free memory is.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the heap dump.
+ */
+extern
+int	_dmalloc_dump_map(const char *path);
+
+/*
+ * int _dmalloc_dump_diff
+ *
+ * Print the allocation sites whose memory in use changed the most
+ * between two heap dumps.  The sites are matched by their file and
+ * line or return-address so the dumps can come from different runs.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * old_path -> Path of the earlier heap dump.
+ *
+ * new_path -> Path of the later heap dump.
+ *
+ * top_n -> Number of sites to print.
+ */
+extern
+int	_dmalloc_dump_diff(const char *old_path, const char *new_path,
+			   const int top_n);
+
+/*
+ * int _dmalloc_dump_live
+ *
+ * Print the live statistics that a program running with the
+ * live-stats token publishes.  The file is mapped and read in place
+ * so the program is not stopped or signaled.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * pid -> Process id of the program.
+ *
+ * every_secs -> Print the statistics again every this many seconds
+ * until the program exits or 0 to print them once.
+ */
+extern
+int	_dmalloc_dump_live(const long pid, const int every_secs);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __DMALLOC_DUMP_H__ */
@@ -1033,6 +1033,35 @@ static	int	do_strtok(void) {
 }
 #endif
 
+#if HAVE_MEMSET
+/*
+ * Make sure that a checked function still finds a fence-post which
+ * has been overwritten.
+ */
+static	int	do_fence(void) {
+  char		*pnt;
+  char		*func_name = "memset fence";
+  char		save;
+  int		size = 20, ret;
+  unsigned int	old_flags;
+  
+  old_flags = dmalloc_debug_current();
+  dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
+  
+  pnt = malloc(size);
+  save = pnt[size];
+  pnt[size] = 'x';
+  
+  memset(pnt, 0, size);
+  ret = check_fail(func_name, DMALLOC_ERROR_OVER_FENCE);
+  
+  pnt[size] = save;
+  free(pnt);
+  dmalloc_debug(old_flags);
+  return ret;
+}
+#endif
+
 static	int	(*test_funcs[])() = {
 #if HAVE_ATOI
   do_atoi,
@@ -1069,6 +1098,7 @@ static	int	(*test_funcs[])() = {
 #endif
 #if HAVE_MEMSET
   do_memset,
+  do_fence,
 #endif
 #if HAVE_RINDEX
   do_rindex,
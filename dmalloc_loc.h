@@ -28,6 +28,7 @@
  * env variable(s)
  */
 #define OPTIONS_ENVIRON		"DMALLOC_OPTIONS"
+#define CONTROL_ENVIRON		"DMALLOC_CONTROL"
 
 /*
  * web home directory
@@ -97,4 +98,29 @@
  */
 #define BLOCK_SIZE		(int)(1 << BASIC_BLOCK)	/* size of a block */
 
+/*
+ * Per-thread variables when we are locking threads.  NOTE: the
+ * initial-exec model keeps us from going recursive into malloc when a
+ * thread first touches them.
+ */
+#if LOCK_THREADS && defined(__GNUC__)
+#define THREAD_LOCAL	__thread __attribute__((tls_model("initial-exec")))
+#else
+#define THREAD_LOCAL
+#endif
+
+/* only the threaded library has a lock to profile */
+#if LOCK_THREADS && LOCK_PROFILE_TOP_LOG > 0
+#define LOCK_PROFILE	1
+#else
+#define LOCK_PROFILE	0
+#endif
+
+/* the live statistics are a mapped file */
+#if HAVE_MMAP && HAVE_GETPID && LIVE_STATS_INTERVAL > 0
+#define LIVE_STATS	1
+#else
+#define LIVE_STATS	0
+#endif
+
 #endif /* ! __DMALLOC_LOC_H__ */
@@ -45,6 +45,12 @@
 #  include TIME_INCLUDE
 # endif
 #endif
+#if HAVE_FORK
+# include <sys/wait.h>				/* for waitpid */
+#endif
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>				/* for mmap */
+#endif
 
 #include "dmalloc.h"
 #include "dmalloc_argv.h"
@@ -57,10 +63,16 @@
 #include "debug_tok.h"
 #include "error_val.h"
 #include "heap.h"				/* for external testing */
+#include "heap_dump.h"
+#include "live_stats.h"
+#include "symbol.h"
 
 #define INTER_CHAR		'i'
 #define DEFAULT_ITERATIONS	10000
 #define MAX_POINTERS		1024
+#define BATCH_SIZE		20
+#define LEAK_SIZE		10
+#define DUMP_PATH		"dmalloc_t.dump"
 #if HAVE_SBRK == 0 && HAVE_MMAP == 0
 /* if we have a small memory area then just take 1/10 of the internal space */
 #define MAX_ALLOC		(INTERNAL_MEMORY_SPACE / 10)
@@ -80,6 +92,11 @@ typedef struct pnt_info_st {
 
 static	pnt_info_t	*pointer_grid;
 
+#if LEAK_SCAN_STACK > 0 && defined(__linux__)
+/* allocations that the leak scan should reach through a static */
+static	char		**scan_chain = NULL;
+#endif
+
 /* argument variables */
 static	long		default_iter_n = DEFAULT_ITERATIONS; /* # of iters */
 static	char		*env_string = NULL;		/* env options */
@@ -173,6 +190,25 @@ static	DMALLOC_PNT	get_address(void)
   return pnt;
 }
 
+#if LEAK_SCAN_STACK > 0 && defined(__linux__)
+/*
+ * Allocate a number of pointers and lose them for the leak scan
+ */
+static	void	leak_pointers(const int pnt_n)
+{
+  char	*pnt;
+  int	pnt_c;
+  
+  for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+    pnt = dmalloc_malloc(__FILE__, __LINE__, 30 + pnt_c, DMALLOC_FUNC_MALLOC,
+			 0 /* no alignment */, 0 /* no xalloc messages */);
+    if (pnt != NULL) {
+      memset(pnt, 'l', 30 + pnt_c);
+    }
+  }
+}
+#endif
+
 /*
  * Free a slot from the used_p list and put it on the free list
  */
@@ -2492,6 +2528,76 @@ static	int	check_special(void)
   
   /********************/
   
+  /*
+   * Make sure that a realloc which cannot free the old pointer gives
+   * back the new one and leaves the old one in place.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    unsigned long	loc_mark, mem_count;
+    char		save_ch;
+    void		*pnt2;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    dmalloc_debug(DMALLOC_DEBUG_CHECK_FENCE);
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    
+    if (! silent_b) {
+      loc_printf("  Checking realloc of a pointer that cannot be freed\n");
+    }
+    
+    pnt = malloc(BUF_SIZE);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", BUF_SIZE);
+      }
+      return 0;
+    }
+    
+    /* overwrite the high fence post so the free of the old pointer fails */
+    save_ch = *((char *)pnt + BUF_SIZE);
+    *((char *)pnt + BUF_SIZE) = '\0';
+    
+    /* it has to move to grow this much */
+    loc_mark = dmalloc_mark();
+    pnt2 = realloc(pnt, BLOCK_SIZE * 2);
+    if (pnt2 != NULL || dmalloc_errno != DMALLOC_ERROR_OVER_FENCE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: realloc of overwritten pointer did not fail: %s\n",
+		   dmalloc_strerror(dmalloc_errno));
+      }
+      return 0;
+    }
+    
+    /* the new pointer should not have been left behind */
+    mem_count = dmalloc_count_changed(loc_mark, 1 /* not-freed */,
+				      0 /* no freed */);
+    if (mem_count != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: failed realloc left %lu bytes allocated.\n",
+		   mem_count);
+      }
+      return 0;
+    }
+    
+    /* the old pointer should still be ours to free */
+    *((char *)pnt + BUF_SIZE) = save_ch;
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    free(pnt);
+    if (dmalloc_errno != DMALLOC_ERROR_NONE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not free the old pointer: %s\n",
+		   dmalloc_strerror(dmalloc_errno));
+      }
+      return 0;
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
   /*
    * Make sure that the start after memory size allocated.
    */
@@ -3620,6 +3726,103 @@ static	int	check_special(void)
   
   /********************/
   
+  /*
+   * Check that the heap is committed contiguously from the reserved
+   * region and that its bounds stay tight.
+   */
+#if HEAP_RESERVED_REGION
+  {
+    char	*pnt2;
+    
+    if (! silent_b) {
+      loc_printf("  Checking reserved heap region\n");
+    }
+    
+    pnt = _dmalloc_heap_alloc(BLOCK_SIZE);
+    pnt2 = _dmalloc_heap_alloc(BLOCK_SIZE / 2);
+    if (pnt == NULL || pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not heap-alloc from reserved region.\n");
+      }
+      return 0;
+    }
+    if ((PNT_ARITH_TYPE)pnt % BLOCK_SIZE != 0
+	|| (PNT_ARITH_TYPE)pnt2 % BLOCK_SIZE != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: reserved heap-alloc was not block aligned.\n");
+      }
+      final = 0;
+    }
+    else if (pnt2 != (char *)pnt + BLOCK_SIZE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: reserved heap-allocs %p and %p not contiguous.\n",
+		   pnt, pnt2);
+      }
+      final = 0;
+    }
+    else if (! IS_IN_HEAP(pnt2 + BLOCK_SIZE - 1)
+	     || IS_IN_HEAP(pnt2 + BLOCK_SIZE)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap bounds not tight around %p.\n", pnt2);
+      }
+      final = 0;
+    }
+    else {
+      /* the committed memory should be usable */
+      memset(pnt, 'a', BLOCK_SIZE);
+      memset(pnt2, 'b', BLOCK_SIZE);
+    }
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check that the admin blocks are packed together.
+   */
+#if HEAP_HUGE_PAGES
+  {
+    char	*pnt2;
+    
+    if (! silent_b) {
+      loc_printf("  Checking admin block packing\n");
+    }
+    
+    pnt = _dmalloc_heap_admin_alloc();
+    pnt2 = _dmalloc_heap_admin_alloc();
+    if (pnt == NULL || pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not allocate admin blocks.\n");
+      }
+      return 0;
+    }
+    if ((PNT_ARITH_TYPE)pnt % BLOCK_SIZE != 0
+	|| (PNT_ARITH_TYPE)pnt2 % BLOCK_SIZE != 0
+	|| ! IS_IN_HEAP(pnt)
+	|| ! IS_IN_HEAP(pnt2)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: admin blocks %p and %p are not valid.\n",
+		   pnt, pnt2);
+      }
+      final = 0;
+    }
+    /* they should be next to each other unless we started a new region */
+    else if (pnt2 != (char *)pnt + BLOCK_SIZE
+#if HEAP_RESERVED_REGION
+	     && (PNT_ARITH_TYPE)pnt2 % HUGE_PAGE_SIZE != 0
+#endif
+	     ) {
+      if (! silent_b) {
+	loc_printf("   ERROR: admin blocks %p and %p are not packed.\n",
+		   pnt, pnt2);
+      }
+      final = 0;
+    }
+  }
+#endif
+  
+  /********************/
+  
   /*
    * Make sure free-blank doesn't imply alloc-blank
    */
@@ -3669,90 +3872,1349 @@ static	int	check_special(void)
   /********************/
   
   /*
-   * Check the dmalloc_get_stats function
+   * Make sure that the malloc and free paths follow the debug flags as
+   * they are changed.
    */
   {
-    unsigned long	current_allocated, current_pnt_n;
-    unsigned long	current_allocated2, current_pnt_n2;
-    int			amount;
+    int			errno_hold = dmalloc_errno;
+    unsigned int	old_flags = dmalloc_debug_current();
+    unsigned int	flag_sets[] = {
+      0,
+      DMALLOC_DEBUG_CHECK_FENCE,
+      DMALLOC_DEBUG_CHECK_FENCE | DMALLOC_DEBUG_FREE_BLANK
+      | DMALLOC_DEBUG_ALLOC_BLANK,
+      DMALLOC_DEBUG_CHECK_FENCE | DMALLOC_DEBUG_FREE_BLANK
+      | DMALLOC_DEBUG_ALLOC_BLANK | DMALLOC_DEBUG_CHECK_BLANK,
+      DMALLOC_DEBUG_ALLOC_BLANK | DMALLOC_DEBUG_NEVER_REUSE,
+    };
+    unsigned int	set_c, flags;
+    char		*byte_p, save_ch;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
     
     if (! silent_b) {
-      loc_printf("  Checking the dmalloc_get_stats function\n");
+      loc_printf("  Checking malloc and free paths as the flags change\n");
+    }
+    
+    for (set_c = 0; set_c < sizeof(flag_sets) / sizeof(flag_sets[0]);
+	 set_c++) {
+      flags = flag_sets[set_c];
+      dmalloc_debug((old_flags & ~(DMALLOC_DEBUG_CHECK_FENCE
+				   | DMALLOC_DEBUG_FREE_BLANK
+				   | DMALLOC_DEBUG_ALLOC_BLANK
+				   | DMALLOC_DEBUG_CHECK_BLANK
+				   | DMALLOC_DEBUG_NEVER_REUSE
+				   | DMALLOC_DEBUG_CHECK_HEAP)) | flags);
+      
+      pnt = malloc(10);
+      if (pnt == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not malloc 10 bytes with flags %#x.\n",
+		     flags);
+	}
+	return 0;
+      }
+      
+      /* the allocation should have been blanked if asked */
+      if (flags & DMALLOC_DEBUG_ALLOC_BLANK) {
+	for (byte_p = pnt; byte_p < (char *)pnt + 10; byte_p++) {
+	  if (*byte_p != ALLOC_BLANK_CHAR) {
+	    break;
+	  }
+	}
+	if (byte_p < (char *)pnt + 10) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: allocation not blanked with flags %#x.\n",
+		       flags);
+	  }
+	  final = 0;
+	}
+      }
+      
+      /* the fence post should be checked on free if asked */
+      if (flags & DMALLOC_DEBUG_CHECK_FENCE) {
+	save_ch = *((char *)pnt + 10);
+	*((char *)pnt + 10) = 'h';
+	dmalloc_errno = DMALLOC_ERROR_NONE;
+	if (dmalloc_free(__FILE__, __LINE__, pnt,
+			 DMALLOC_FUNC_FREE) != FREE_ERROR
+	    || dmalloc_errno != DMALLOC_ERROR_OVER_FENCE) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: fence overwrite not noticed with flags %#x.\n",
+		       flags);
+	  }
+	  final = 0;
+	}
+	*((char *)pnt + 10) = save_ch;
+      }
+      
+      if (dmalloc_free(__FILE__, __LINE__, pnt,
+		       DMALLOC_FUNC_FREE) != FREE_NOERROR) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: free failed with flags %#x: %s (err %d)\n",
+		     flags, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	}
+	final = 0;
+      }
     }
     
-    dmalloc_get_stats(NULL, NULL, NULL, NULL, &current_allocated,
-		      &current_pnt_n, NULL, NULL, NULL);
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Check that verifying and examining pointers give the same answers
+   * whether or not the readers can share the library lock and that
+   * problems are still reported.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    DMALLOC_SIZE	user_size;
+    unsigned int	old_flags = dmalloc_debug_current();
     
-    amount = 12;
-    pnt = malloc(amount);
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
     
-    dmalloc_get_stats(NULL, NULL, NULL, NULL, &current_allocated2,
-		      &current_pnt_n2, NULL, NULL, NULL);
+    if (! silent_b) {
+      loc_printf("  Checking pointer verification and examine\n");
+    }
     
-    if (current_allocated2 != current_allocated + amount) {
+    /* no heap checking so the readers can share the lock */
+    dmalloc_debug(old_flags & ~DMALLOC_DEBUG_CHECK_HEAP);
+    
+    pnt = malloc(20);
+    if (pnt == NULL) {
       if (! silent_b) {
-	loc_printf("   ERROR: dmalloc_get_stats did not count alloc of %d\n",
-		   amount);
+	loc_printf("   ERROR: could not malloc 20 bytes.\n");
+      }
+      return 0;
+    }
+    strcpy(pnt, "hello");
+    
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt, 1 /* exact */,
+			   20) != MALLOC_VERIFY_NOERROR
+	|| dmalloc_verify_pnt(__FILE__, __LINE__, "test", (char *)pnt + 2,
+			      0 /* not exact */, -1) != MALLOC_VERIFY_NOERROR
+	|| dmalloc_verify_pnt(__FILE__, __LINE__, "test", &user_size,
+			      0 /* not exact */, 0) != MALLOC_VERIFY_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verify of good pointer %p failed: %s (err %d)\n",
+		   pnt, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
       }
       final = 0;
     }
-    if (current_pnt_n2 != current_pnt_n + 1) {
+    
+    /* too big for the allocation should be reported */
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt, 1 /* exact */,
+			   21) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
       if (! silent_b) {
-	loc_printf("   ERROR: dmalloc_get_stats did not count pnt alloc\n");
+	loc_printf("   ERROR: verify of too large size not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
       }
       final = 0;
     }
     
-    free(pnt);
+    if (dmalloc_examine(pnt, &user_size, NULL, NULL, NULL, NULL, NULL,
+			NULL) != DMALLOC_NOERROR
+	|| user_size != 20) {
+      if (! silent_b) {
+	loc_printf("   ERROR: examine of %p failed: %s (err %d)\n",
+		   pnt, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
     
-    dmalloc_get_stats(NULL, NULL, NULL, NULL, &current_allocated2,
-		      &current_pnt_n2, NULL, NULL, NULL);
+    free(pnt);
     
-    if (current_allocated2 != current_allocated) {
+    /* a freed pointer should be reported by both */
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt, 1 /* exact */,
+			   0) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_NOT_FOUND) {
       if (! silent_b) {
-	loc_printf("   ERROR: dmalloc_get_stats did not count free of %d\n",
-		   amount);
+	loc_printf("   ERROR: verify of freed pointer not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
       }
       final = 0;
     }
-    if (current_pnt_n2 != current_pnt_n) {
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_examine(pnt, &user_size, NULL, NULL, NULL, NULL, NULL,
+			NULL) != DMALLOC_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_NOT_FOUND) {
       if (! silent_b) {
-	loc_printf("   ERROR: dmalloc_get_stats did not count pnt free\n");
+	loc_printf("   ERROR: examine of freed pointer not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
       }
       final = 0;
     }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
   }
   
   /********************/
   
-  if (! silent_b) {
-    loc_printf("  Checking append_string and friends\n");
-  }
-  
+  /*
+   * Check that the cached pointer checks follow frees and reallocs.
+   */
+#if PNT_CHECK_CACHE_SIZE > 0
   {
-    char buf[10];
-    char *max = buf + sizeof(buf);
-    char *buf_p = buf;
-    
-    buf_p = append_string(buf_p, max, "hello");
-    final = check_append_buf(buf, buf_p, "hello", 5, final, "append hello");
+    int		errno_hold = dmalloc_errno, check_c;
     
-    buf_p = append_long(buf_p, max, 1234, 10);
-    final = check_append_buf(buf, buf_p, "hello1234", 9, final, "append 1234");
+    if (! silent_b) {
+      loc_printf("  Checking pointer check cache\n");
+    }
     
-    /* initially this adds the 'h' at the end tha will become \0 below */
-    buf_p = append_string(buf_p, max, "hello");
-    final = check_append_buf(buf, buf_p, "hello1234h", 10, final, "append h");
+    pnt = malloc(40);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc 40 bytes.\n");
+      }
+      return 0;
+    }
     
-    /* this should add nothing */
-    buf_p = append_string(buf_p, max, "hello");
-    final = check_append_buf(buf, buf_p, "hello1234h", 10, final, "append no string");
+    /* the first check fills the cache and the rest should use it */
+    for (check_c = 0; check_c < 3; check_c++) {
+      if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", (char *)pnt + check_c,
+			     0 /* not exact */, 40 - check_c)
+	  != MALLOC_VERIFY_NOERROR) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: check %d of %p failed: %s (err %d)\n",
+		     check_c, pnt, dmalloc_strerror(dmalloc_errno),
+		     dmalloc_errno);
+	}
+	final = 0;
+      }
+    }
     
-    /* this should add nothing */
-    buf_p = append_long(buf_p, max, 100, 10);
-    final = check_append_buf(buf, buf_p, "hello1234h", 10, final, "append no int");
+    /* a cached allocation which is too small should still be reported */
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", (char *)pnt + 1,
+			   0 /* not exact */, 40) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: cached overwrite not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
     
-    buf_p = append_null(buf_p, max);
+    /* shrinking the allocation should drop it from the cache */
+    pnt = realloc(pnt, 20);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not realloc to 20 bytes.\n");
+      }
+      return 0;
+    }
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt, 1 /* exact */,
+			   30) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: check after realloc not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    /* as should freeing it */
+    (void)dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt, 1 /* exact */,
+			     20);
+    free(pnt);
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt, 1 /* exact */,
+			   0) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_NOT_FOUND) {
+      if (! silent_b) {
+	loc_printf("   ERROR: check after free not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check that the shadow map follows the user allocations.
+   */
+#if HEAP_SHADOW_MAP
+  {
+    int			errno_hold = dmalloc_errno;
+    unsigned char	*shadow_p;
+    void		*pnt2;
+    
+    if (! silent_b) {
+      loc_printf("  Checking heap shadow map\n");
+    }
+    
+    pnt = malloc(20);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc 20 bytes.\n");
+      }
+      return 0;
+    }
+    
+    /*
+     * With the 24 byte size class the next allocation can start right
+     * after this one so the byte after it may be a start instead of 0.
+     */
+    shadow_p = _dmalloc_heap_shadow(pnt);
+    if (shadow_p != NULL
+	&& (PNT_ARITH_TYPE)pnt % SHADOW_SCALE == 0
+	&& ((shadow_p[0] & ~SHADOW_FENCE) != (SHADOW_START | SHADOW_SCALE)
+	    || (shadow_p[1] & ~SHADOW_FENCE) != SHADOW_SCALE
+	    || (shadow_p[2] & ~SHADOW_FENCE) != 20 % SHADOW_SCALE
+	    || (shadow_p[3] != 0 && ! (shadow_p[3] & SHADOW_START)))) {
+      if (! silent_b) {
+	loc_printf("   ERROR: bad shadow of 20 byte allocation: %x %x %x %x\n",
+		   shadow_p[0], shadow_p[1], shadow_p[2], shadow_p[3]);
+      }
+      final = 0;
+    }
+    
+    /* a long range has its shadow checked a word at a time */
+    pnt2 = malloc(1000);
+    if (pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc 1000 bytes.\n");
+      }
+      return 0;
+    }
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", (char *)pnt2 + 3,
+			   0 /* not exact */, 997) != MALLOC_VERIFY_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verify of 997 bytes failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", (char *)pnt2 + 3,
+			   0 /* not exact */, 998) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verify of 998 bytes not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    /* strings that run off of the end should not pass */
+    memset(pnt2, 'a', 1000);
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt2, 1 /* exact */,
+			   -1) != MALLOC_VERIFY_ERROR
+	|| dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: unterminated string not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    ((char *)pnt2)[999] = '\0';
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "test", pnt2, 1 /* exact */,
+			   -1) != MALLOC_VERIFY_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verify of terminated string failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    free(pnt);
+    free(pnt2);
+    if (shadow_p != NULL && shadow_p[0] != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: shadow of freed allocation not cleared: %x\n",
+		   shadow_p[0]);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check the allocation budget of a scope.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    dmalloc_budget_t	budget;
+    unsigned long	allocs, bytes, frees;
+    void		*pnt2;
+    
+    if (! silent_b) {
+      loc_printf("  Checking allocation budgets\n");
+    }
+    
+    dmalloc_budget_start(&budget, 2, 100, 1);
+    pnt = malloc(10);
+    pnt2 = malloc(20);
+    if (pnt == NULL || pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc budget pointers.\n");
+      }
+      return 0;
+    }
+    free(pnt);
+    dmalloc_budget_used(&budget, &allocs, &bytes, &frees);
+    if (allocs != 2 || bytes != 30 || frees != 1) {
+      if (! silent_b) {
+	loc_printf("   ERROR: budget used %lu allocs, %lu bytes, %lu frees\n",
+		   allocs, bytes, frees);
+      }
+      final = 0;
+    }
+    if (! dmalloc_budget_end(__FILE__, __LINE__, &budget)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: scope within its budget was reported\n");
+      }
+      final = 0;
+    }
+    
+    /* one more allocation is over the budget */
+    pnt = malloc(10);
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_budget_end(__FILE__, __LINE__, &budget)
+	|| dmalloc_errno != DMALLOC_ERROR_OVER_BUDGET) {
+      if (! silent_b) {
+	loc_printf("   ERROR: over budget not reported: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    free(pnt);
+    free(pnt2);
+    
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Check the batch allocation and free.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    DMALLOC_SIZE	sizes[BATCH_SIZE], user_size;
+    DMALLOC_PNT		pnts[BATCH_SIZE];
+    int			pnt_c, free_n;
+    
+    if (! silent_b) {
+      loc_printf("  Checking batch malloc and free\n");
+    }
+    
+    for (pnt_c = 0; pnt_c < BATCH_SIZE; pnt_c++) {
+      sizes[pnt_c] = 1 + pnt_c * 7;
+    }
+    if (dmalloc_malloc_batch(__FILE__, __LINE__, sizes, pnts, BATCH_SIZE)
+	!= DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: batch malloc failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      return 0;
+    }
+    
+    for (pnt_c = 0; pnt_c < BATCH_SIZE; pnt_c++) {
+      if (dmalloc_examine(pnts[pnt_c], &user_size, NULL /* no total size */,
+			  NULL /* no file */, NULL /* no line */,
+			  NULL /* no return address */, NULL /* no mark */,
+			  NULL /* no seen */) != DMALLOC_NOERROR
+	  || user_size != sizes[pnt_c]) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: batch pointer %d is not %ld bytes\n",
+		     pnt_c, (long)sizes[pnt_c]);
+	}
+	final = 0;
+      }
+      memset(pnts[pnt_c], 'b', sizes[pnt_c]);
+    }
+    
+    /* the NULL should be skipped and the rest freed */
+    free(pnts[1]);
+    pnts[1] = NULL;
+    if (dmalloc_free_batch(__FILE__, __LINE__, pnts, BATCH_SIZE)
+	!= FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: batch free failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    /* none of the pointers should still be allocated */
+    free_n = 0;
+    for (pnt_c = 0; pnt_c < BATCH_SIZE; pnt_c++) {
+      if (pnts[pnt_c] != NULL
+	  && dmalloc_examine(pnts[pnt_c], NULL /* no user size */,
+			     NULL /* no total size */, NULL /* no file */,
+			     NULL /* no line */, NULL /* no return address */,
+			     NULL /* no mark */,
+			     NULL /* no seen */) == DMALLOC_NOERROR) {
+	free_n++;
+      }
+    }
+    if (free_n > 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: %d pointers were not freed by the batch\n",
+		   free_n);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+#if LEAK_SCAN_STACK > 0 && defined(__linux__)
+  /*
+   * Check that the leak scan finds the lost pointers but not the ones
+   * that can still be reached.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    unsigned long	before_n, after_n;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the leak scan\n");
+    }
+    
+    before_n = dmalloc_scan_leaks();
+    
+    /* reached from a static and then from the middle of the block */
+    scan_chain = malloc(sizeof(char *) * 4);
+    if (scan_chain == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not allocate the leak scan chain\n");
+      }
+      return 0;
+    }
+    memset(scan_chain, 0, sizeof(char *) * 4);
+    scan_chain[2] = malloc(100);
+    if (scan_chain[2] != NULL) {
+      scan_chain[2] += 50;
+    }
+    
+    /* some of the lost pointers may still be in registers or the stack */
+    leak_pointers(LEAK_SIZE);
+    after_n = dmalloc_scan_leaks();
+    if (after_n < before_n + 1 || after_n > before_n + LEAK_SIZE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: leak scan found %lu new pointers not 1 to %d\n",
+		   after_n - before_n, LEAK_SIZE);
+      }
+      final = 0;
+    }
+    
+    if (scan_chain[2] != NULL) {
+      free(scan_chain[2] - 50);
+    }
+    free(scan_chain);
+    scan_chain = NULL;
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+#if HAVE_FORK
+  /*
+   * Check that the heap snapshot runs in a child process.
+   */
+  {
+    int		errno_hold = dmalloc_errno, pid, status;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the heap snapshot\n");
+    }
+    
+    pid = dmalloc_snapshot_async(NULL /* to the logfile */);
+    if (pid < 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap snapshot could not fork\n");
+      }
+      final = 0;
+    }
+    else if (waitpid(pid, &status, 0) != pid) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not wait for heap snapshot %d\n", pid);
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+#if HAVE_MMAP
+  /*
+   * Check that the heap dump has our allocation in it.
+   */
+  {
+    int			errno_hold = dmalloc_errno, found_b = 0;
+    char		*pnt;
+    FILE		*dump_fp;
+    dump_header_t	header;
+    dump_rec_t		rec;
+    unsigned long	rec_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the heap dump\n");
+    }
+    
+    pnt = malloc(123);
+    if (dmalloc_dump_heap(DUMP_PATH, 0 /* no user bytes */)
+	!= DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not write the heap dump\n");
+      }
+      final = 0;
+    }
+    else {
+      dump_fp = fopen(DUMP_PATH, "r");
+      if (dump_fp == NULL
+	  || fread(&header, sizeof(header), 1, dump_fp) != 1
+	  || memcmp(header.dh_magic, DUMP_MAGIC, sizeof(header.dh_magic)) != 0
+	  || fseek(dump_fp, header.dh_rec_off, SEEK_SET) != 0) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: heap dump has a bad header\n");
+	}
+	final = 0;
+      }
+      else {
+	for (rec_c = 0; rec_c < header.dh_rec_n; rec_c++) {
+	  if (fread(&rec, sizeof(rec), 1, dump_fp) != 1) {
+	    break;
+	  }
+	  if (rec.dr_addr == (PNT_ARITH_TYPE)pnt && rec.dr_user_size == 123
+	      && (rec.dr_flags & DUMP_REC_USED)) {
+	    found_b = 1;
+	  }
+	}
+	if (! found_b) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: heap dump is missing pointer %p\n", pnt);
+	  }
+	  final = 0;
+	}
+      }
+      if (dump_fp != NULL) {
+	fclose(dump_fp);
+      }
+      (void)unlink(DUMP_PATH);
+    }
+    free(pnt);
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+#if SYMBOLIZE
+  /*
+   * Check that a return-address is named with its module and function.
+   */
+  {
+    int		errno_hold = dmalloc_errno;
+    const char	*desc;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the return-address symbols\n");
+    }
+    
+    desc = _dmalloc_symbol_desc((char *)get_address + 1);
+    if (desc == NULL || strstr(desc, "+0x") == NULL
+	|| strstr(desc, " get_address+0x1") == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: return-address was described as '%s'\n",
+		   (desc == NULL ? "NULL" : desc));
+      }
+      final = 0;
+    }
+    /* the second lookup comes from the cache */
+    else if (_dmalloc_symbol_desc((char *)get_address + 1) != desc) {
+      if (! silent_b) {
+	loc_printf("   ERROR: return-address was not cached\n");
+      }
+      final = 0;
+    }
+    
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check memalign below the block size with and without fence-posts
+   * and the size check of sized frees.
+   */
+  {
+    int			errno_hold = dmalloc_errno;
+    int			fence_c, align;
+    unsigned int	old_flags = dmalloc_debug_current();
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    
+    if (! silent_b) {
+      loc_printf("  Checking sub-block memalign and sized free\n");
+    }
+    
+    for (fence_c = 0; fence_c < 2; fence_c++) {
+      if (fence_c == 0) {
+	dmalloc_debug(old_flags & ~DMALLOC_DEBUG_CHECK_FENCE);
+      }
+      else {
+	dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
+      }
+      for (align = 16; align < BLOCK_SIZE; align *= 4) {
+	pnt = memalign(align, 40);
+	if (pnt == NULL) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: could not memalign 40 bytes to %d.\n", align);
+	  }
+	  return 0;
+	}
+	if ((PNT_ARITH_TYPE)pnt % align != 0) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: memalign to %d returned %p\n", align, pnt);
+	  }
+	  final = 0;
+	}
+	memset(pnt, 'a', 40);
+	if (dmalloc_verify(pnt) != DMALLOC_VERIFY_NOERROR) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: verify of %d aligned failed: %s (err %d)\n",
+		       align, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	  }
+	  final = 0;
+	}
+	
+	/* the wrong size should be reported and the pointer not freed */
+	dmalloc_errno = DMALLOC_ERROR_NONE;
+	if (dmalloc_free_size(__FILE__, __LINE__, pnt, 39,
+			      DMALLOC_FUNC_DELETE) != FREE_ERROR
+	    || dmalloc_errno != DMALLOC_ERROR_BAD_FREE_SIZE) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: bad free size not reported: %s (err %d)\n",
+		       dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	  }
+	  final = 0;
+	}
+	if (dmalloc_free_size(__FILE__, __LINE__, pnt, 40,
+			      DMALLOC_FUNC_DELETE) != FREE_NOERROR) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: sized free of %d aligned failed: %s (err %d)\n",
+		       align, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	  }
+	  final = 0;
+	}
+      }
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Check that the small allocations are given blocks from the size
+   * classes between the powers of two and not the next power.
+   */
+#if SIZE_CLASSES_PER_DOUBLING > 1
+  {
+    int			errno_hold = dmalloc_errno;
+    unsigned int	old_flags = dmalloc_debug_current();
+    DMALLOC_SIZE	size, total_size;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the size classes\n");
+    }
+    
+    dmalloc_debug(old_flags & ~DMALLOC_DEBUG_CHECK_FENCE);
+    for (size = 32; size <= BLOCK_SIZE / 2; size += 13) {
+      pnt = malloc(size);
+      if (pnt == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not malloc %lu bytes.\n",
+		     (unsigned long)size);
+	}
+	return 0;
+      }
+      if (dmalloc_examine(pnt, NULL /* no user size */, &total_size,
+			  NULL /* no file */, NULL /* no line */,
+			  NULL /* no return address */, NULL /* no mark */,
+			  NULL /* no seen */) != DMALLOC_NOERROR
+	  || total_size < size
+	  || total_size - size > size / SIZE_CLASSES_PER_DOUBLING
+	  + ALLOCATION_ALIGNMENT) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: %lu byte allocation got a %lu byte block\n",
+		     (unsigned long)size, (unsigned long)total_size);
+	}
+	final = 0;
+      }
+      free(pnt);
+    }
+    
+    dmalloc_debug(old_flags);
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check that the lock stats of each operation add up and that they
+   * are all 0 if the lock is not profiled.
+   */
+  {
+    dmalloc_lock_stats_t	lock_stats;
+    unsigned long		hist_c;
+    int				op_c, bucket_c, profiled_b;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the lock stats\n");
+    }
+    
+    for (op_c = 0; op_c < DMALLOC_LOCK_OP_N; op_c++) {
+      profiled_b = dmalloc_get_lock_stats(op_c, &lock_stats);
+      hist_c = 0;
+      for (bucket_c = 0; bucket_c < DMALLOC_LOCK_BUCKETS; bucket_c++) {
+	hist_c += lock_stats.dl_hold_hist[bucket_c];
+      }
+      if (hist_c != lock_stats.dl_lock_c
+	  || lock_stats.dl_wait_c > lock_stats.dl_lock_c
+	  || lock_stats.dl_hold_max_nsec > lock_stats.dl_hold_nsec
+	  || ((! profiled_b) && lock_stats.dl_lock_c != 0)) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: lock stats of op %d do not add up: %lu of %lu\n",
+		     op_c, hist_c, lock_stats.dl_lock_c);
+	}
+	final = 0;
+      }
+    }
+    
+    /* an unknown operation gives back no stats */
+    if (dmalloc_get_lock_stats(DMALLOC_LOCK_OP_N, &lock_stats) != 0
+	|| lock_stats.dl_lock_c != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: lock stats of an unknown op were returned\n");
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check that the total allocated, which is added up from the
+   * counter shards, counts every malloc and realloc.
+   */
+  {
+    unsigned long	start_total, total;
+    char		*pnt2;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the allocation total\n");
+    }
+    
+    start_total = dmalloc_memory_allocated();
+    pnt = malloc(100);
+    pnt2 = malloc(200);
+    if (pnt == NULL || pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc 100 and 200 bytes.\n");
+      }
+      return 0;
+    }
+    pnt2 = realloc(pnt2, 300);
+    if (pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not realloc 300 bytes.\n");
+      }
+      return 0;
+    }
+    total = dmalloc_memory_allocated() - start_total;
+    if (total != 600) {
+      if (! silent_b) {
+	loc_printf("   ERROR: allocated %lu bytes but total went up %lu\n",
+		   600UL, total);
+      }
+      final = 0;
+    }
+    free(pnt);
+    free(pnt2);
+  }
+  
+  /********************/
+  
+#if LIVE_STATS
+  /*
+   * Check that the live stats file is written with our allocation
+   * once enough transactions have gone by.
+   */
+  {
+    unsigned int	old_flags;
+    live_stats_t	live;
+    char		path[512];
+    FILE		*live_fp;
+    int			iter_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the live stats\n");
+    }
+    
+    old_flags = dmalloc_debug_current();
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_LIVE_STATS);
+    pnt = malloc(1000);
+    for (iter_c = 0; iter_c < LIVE_STATS_INTERVAL * 2; iter_c++) {
+      free(malloc(10));
+    }
+    dmalloc_debug(old_flags);
+    
+    (void)loc_snprintf(path, sizeof(path), LIVE_STATS_PATH, (long)getpid());
+    live_fp = fopen(path, "r");
+    if (live_fp == NULL
+	|| fread(&live, sizeof(live), 1, live_fp) != 1
+	|| memcmp(live.ls_magic, LIVE_MAGIC, sizeof(live.ls_magic)) != 0
+	|| live.ls_pid != (unsigned long)getpid()
+	|| live.ls_seq % 2 != 0
+	|| live.ls_cur_size < 1000
+	|| live.ls_counts[LIVE_MALLOC] < LIVE_STATS_INTERVAL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: live stats '%s' are missing or wrong\n", path);
+      }
+      final = 0;
+    }
+    if (live_fp != NULL) {
+      fclose(live_fp);
+    }
+    (void)unlink(path);
+    free(pnt);
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check that the debug policies fence-post only the allocations
+   * from a file-name and line or of a size and that a realloc follows
+   * the policy of the allocation.
+   */
+#if MAX_POLICIES > 0
+  {
+    int			errno_hold = dmalloc_errno;
+    char		setup[256], *pnts[3], *moved, ch_hold;
+    int			pnt_c, loc_line;
+    DMALLOC_SIZE	sizes[3] = { 3001, 2001, 51 }, total_size;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    
+    if (! silent_b) {
+      loc_printf("  Checking debug policies\n");
+    }
+    
+    /* NOTE: the line must point at the third malloc below */
+    loc_line = __LINE__ + 8;
+    (void)loc_snprintf(setup, sizeof(setup),
+		       "debug=0,policy=size:3000@check-fence,"
+		       "policy=dmalloc_t.c:%d@check-fence,"
+		       "policy=size:2001-2001@never-reuse", loc_line);
+    dmalloc_debug_setup(setup);
+    pnts[0] = malloc(sizes[0]);
+    pnts[1] = malloc(sizes[1]);
+    pnts[2] = malloc(sizes[2]);
+    
+    for (pnt_c = 0; pnt_c < 3; pnt_c++) {
+      if (pnts[pnt_c] == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not malloc %lu bytes.\n",
+		     (unsigned long)sizes[pnt_c]);
+	}
+	return 0;
+      }
+      
+      /* only the middle one is not fenced so needs room to overwrite */
+      if (dmalloc_examine(pnts[pnt_c], NULL /* no user size */, &total_size,
+			  NULL /* no file */, NULL /* no line */,
+			  NULL /* no return address */, NULL /* no mark */,
+			  NULL /* no seen */) != DMALLOC_NOERROR
+	  || total_size <= sizes[pnt_c]) {
+	continue;
+      }
+      
+      /* overwrite the byte after the allocation */
+      ch_hold = pnts[pnt_c][sizes[pnt_c]];
+      pnts[pnt_c][sizes[pnt_c]] = 'h';
+      dmalloc_errno = DMALLOC_ERROR_NONE;
+      if (pnt_c == 1) {
+	if (dmalloc_verify(pnts[pnt_c]) != DMALLOC_NOERROR) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: allocation without policy was fenced: %s (err %d)\n",
+		       dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	  }
+	  final = 0;
+	}
+      }
+      else if (dmalloc_verify(pnts[pnt_c]) == DMALLOC_NOERROR
+	       || dmalloc_errno != DMALLOC_ERROR_OVER_FENCE) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: policy %d fence overwrite not found: %s (err %d)\n",
+		     pnt_c, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	}
+	final = 0;
+      }
+      pnts[pnt_c][sizes[pnt_c]] = ch_hold;
+    }
+    
+    /* the never-reuse policy of the middle one has it move when shrunk */
+    moved = realloc(pnts[1], sizes[1] - 1);
+    if (moved == NULL || moved == pnts[1]) {
+      if (! silent_b) {
+	loc_printf("   ERROR: never-reuse policy realloc was not moved\n");
+      }
+      final = 0;
+    }
+    if (moved != NULL) {
+      pnts[1] = moved;
+    }
+    
+    /* the frees check the fences of the policy allocations */
+    for (pnt_c = 0; pnt_c < 3; pnt_c++) {
+      free(pnts[pnt_c]);
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check the large objects which are mapped outside of the heap.
+   */
+#if HEAP_LARGE_OBJECTS
+  {
+    int			errno_hold = dmalloc_errno;
+    unsigned long	size;
+    DMALLOC_SIZE	user_size;
+    char		ch_hold;
+    unsigned int	old_flags = dmalloc_debug_current();
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    
+    if (! silent_b) {
+      loc_printf("  Checking large-object allocations\n");
+    }
+    
+    /* make sure that we are fence-post checking */
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
+    
+    size = LARGE_OBJECT_SIZE * 2 + 1;
+    pnt = malloc(size);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %lu bytes.\n", size);
+      }
+      return 0;
+    }
+    
+    if (dmalloc_examine(pnt, &user_size, NULL /* no total size */,
+			NULL /* no file */, NULL /* no line */,
+			NULL /* no return address */, NULL /* no mark */,
+			NULL /* no seen */) != DMALLOC_NOERROR
+	|| user_size != size) {
+      if (! silent_b) {
+	loc_printf("   ERROR: examining large pointer %p failed.\n", pnt);
+      }
+      final = 0;
+    }
+    
+    /* fill it up and then run over the end into the top fence */
+    memset(pnt, 'x', size);
+    ch_hold = *((char *)pnt + size);
+    *((char *)pnt + size) = 'h';
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify(pnt) == DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: overwriting large-object fence not detected.\n");
+      }
+      final = 0;
+    }
+    else if (dmalloc_errno != DMALLOC_ERROR_OVER_FENCE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verify of large-object fence returned: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    *((char *)pnt + size) = ch_hold;
+    
+    /* growing it should move it to a new mapping */
+    pnt = realloc(pnt, size * 2);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not realloc %lu bytes.\n", size * 2);
+      }
+      return 0;
+    }
+    if (*((char *)pnt + size - 1) != 'x') {
+      if (! silent_b) {
+	loc_printf("   ERROR: realloc of large object lost its contents.\n");
+      }
+      final = 0;
+    }
+    
+    /* the memory is unmapped on free but we should still see it freed */
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) != FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: free of large object failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_free(__FILE__, __LINE__, pnt,
+		     DMALLOC_FUNC_FREE) == FREE_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 2nd free of large object should have failed.\n");
+      }
+      final = 0;
+    }
+    else if (dmalloc_errno != DMALLOC_ERROR_ALREADY_FREE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: 2nd free of large object should get DMALLOC_ERROR_ALREADY_FREE not: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    
+    /*
+     * Once someone else maps the region the pointer is not ours at
+     * all.  We can only ask the system for the address as a hint.
+     */
+    {
+      char	*region;
+      void	*map_p;
+      
+      region = (char *)pnt - (PNT_ARITH_TYPE)pnt % BLOCK_SIZE;
+      map_p = mmap(region, BLOCK_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANON, -1, 0);
+      if (map_p == region) {
+	dmalloc_errno = DMALLOC_ERROR_NONE;
+	if (dmalloc_free(__FILE__, __LINE__, pnt,
+			 DMALLOC_FUNC_FREE) == FREE_NOERROR
+	    || dmalloc_errno != DMALLOC_ERROR_NOT_FOUND) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: free in a region mapped again should get DMALLOC_ERROR_NOT_FOUND not: %s (err %d)\n",
+		       dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+	  }
+	  final = 0;
+	}
+      }
+      if (map_p != MAP_FAILED) {
+	(void)munmap(map_p, BLOCK_SIZE);
+      }
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check that free pages can be given back to the system and that
+   * the purged memory is still checked.  Purging is only supported
+   * on linux.
+   */
+#if defined(__linux__)
+  {
+    int			errno_hold = dmalloc_errno;
+    unsigned long	size, trim_size;
+    char		*pnt2;
+    int			iter_c;
+    unsigned int	old_flags = dmalloc_debug_current();
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    
+    if (! silent_b) {
+      loc_printf("  Checking free page purging\n");
+    }
+    
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_FREE_BLANK);
+    
+    size = BLOCK_SIZE * 4;
+    pnt = malloc(size);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %lu bytes.\n", size);
+      }
+      return 0;
+    }
+    free(pnt);
+    
+    /* push our pointer through the freed pointer delay */
+    for (iter_c = 0; iter_c <= FREED_POINTER_DELAY; iter_c++) {
+      pnt2 = malloc(10);
+      free(pnt2);
+    }
+    
+    trim_size = dmalloc_trim();
+    for (pnt2 = pnt; pnt2 < (char *)pnt + size; pnt2++) {
+      if (*pnt2 != '\0') {
+	break;
+      }
+    }
+    if (trim_size == 0 && pnt2 < (char *)pnt + size) {
+      if (! silent_b) {
+	loc_printf("   ERROR: free memory was not purged.\n");
+      }
+      final = 0;
+    }
+    else if (pnt2 < (char *)pnt + size) {
+      if (! silent_b) {
+	loc_printf("   ERROR: purged memory did not read back as zeros.\n");
+      }
+      final = 0;
+    }
+    else if (dmalloc_trim() != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: second trim should have purged nothing.\n");
+      }
+      final = 0;
+    }
+    else if (dmalloc_verify(NULL /* check all heap */) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verify of purged memory failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    else {
+      /* overwriting the purged memory should still be noticed */
+      *((char *)pnt + BLOCK_SIZE) = 'h';
+      dmalloc_errno = DMALLOC_ERROR_NONE;
+      if (dmalloc_verify(NULL /* check all heap */) == DMALLOC_NOERROR
+	  || dmalloc_errno != DMALLOC_ERROR_FREE_OVERWRITTEN) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: overwriting purged memory not detected.\n");
+	}
+	final = 0;
+      }
+      *((char *)pnt + BLOCK_SIZE) = '\0';
+    }
+    
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check the dmalloc_get_stats function
+   */
+  {
+    unsigned long	current_allocated, current_pnt_n;
+    unsigned long	current_allocated2, current_pnt_n2;
+    int			amount;
+    
+    if (! silent_b) {
+      loc_printf("  Checking the dmalloc_get_stats function\n");
+    }
+    
+    dmalloc_get_stats(NULL, NULL, NULL, NULL, &current_allocated,
+		      &current_pnt_n, NULL, NULL, NULL);
+    
+    amount = 12;
+    pnt = malloc(amount);
+    
+    dmalloc_get_stats(NULL, NULL, NULL, NULL, &current_allocated2,
+		      &current_pnt_n2, NULL, NULL, NULL);
+    
+    if (current_allocated2 != current_allocated + amount) {
+      if (! silent_b) {
+	loc_printf("   ERROR: dmalloc_get_stats did not count alloc of %d\n",
+		   amount);
+      }
+      final = 0;
+    }
+    if (current_pnt_n2 != current_pnt_n + 1) {
+      if (! silent_b) {
+	loc_printf("   ERROR: dmalloc_get_stats did not count pnt alloc\n");
+      }
+      final = 0;
+    }
+    
+    free(pnt);
+    
+    dmalloc_get_stats(NULL, NULL, NULL, NULL, &current_allocated2,
+		      &current_pnt_n2, NULL, NULL, NULL);
+    
+    if (current_allocated2 != current_allocated) {
+      if (! silent_b) {
+	loc_printf("   ERROR: dmalloc_get_stats did not count free of %d\n",
+		   amount);
+      }
+      final = 0;
+    }
+    if (current_pnt_n2 != current_pnt_n) {
+      if (! silent_b) {
+	loc_printf("   ERROR: dmalloc_get_stats did not count pnt free\n");
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  if (! silent_b) {
+    loc_printf("  Checking append_string and friends\n");
+  }
+  
+  {
+    char buf[10];
+    char *max = buf + sizeof(buf);
+    char *buf_p = buf;
+    
+    buf_p = append_string(buf_p, max, "hello");
+    final = check_append_buf(buf, buf_p, "hello", 5, final, "append hello");
+    
+    buf_p = append_long(buf_p, max, 1234, 10);
+    final = check_append_buf(buf, buf_p, "hello1234", 9, final, "append 1234");
+    
+    /* initially this adds the 'h' at the end tha will become \0 below */
+    buf_p = append_string(buf_p, max, "hello");
+    final = check_append_buf(buf, buf_p, "hello1234h", 10, final, "append h");
+    
+    /* this should add nothing */
+    buf_p = append_string(buf_p, max, "hello");
+    final = check_append_buf(buf, buf_p, "hello1234h", 10, final, "append no string");
+    
+    /* this should add nothing */
+    buf_p = append_long(buf_p, max, 100, 10);
+    final = check_append_buf(buf, buf_p, "hello1234h", 10, final, "append no int");
+    
+    buf_p = append_null(buf_p, max);
     final = check_append_buf(buf, buf_p, "hello1234", 10, final, "append null");
     
     /* check out the negative values */
@@ -4231,6 +5693,13 @@ static	void	track_alloc_trxn(const char *file, const unsigned int line,
   case DMALLOC_FUNC_DELETE_ARRAY:
     loc_printf("%s delete[] %p\n", file_line, old_addr);
     break;
+  case DMALLOC_FUNC_MALLOC_BATCH:
+    loc_printf("%s malloc batch %ld bytes got array %p\n",
+	       file_line, (long)byte_size, new_addr);
+    break;
+  case DMALLOC_FUNC_FREE_BATCH:
+    loc_printf("%s free batch array %p\n", file_line, old_addr);
+    break;
   default:
     loc_printf("%s unknown function %ld bytes, %ld alignment, %p old-addr "
 	       "%p new-addr\n",
@@ -34,10 +34,11 @@
 #endif
 
 #include "conf.h"
+#include "dmalloc.h"
+
 #include "append.h"
 #include "chunk.h"
 #include "compat.h"
-#include "dmalloc.h"
 #include "dmalloc_loc.h"
 
 #include "dmalloc_tab.h"
@@ -499,6 +500,126 @@ static	void	add_entry(mem_entry_t *total_p, const mem_entry_t *entry_p)
   total_p->me_in_use_c += entry_p->me_in_use_c;
 }
 
+#if LIFETIME_BUCKETS > 0
+/*
+ * static int life_bucket
+ *
+ * Find the histogram bucket of a lifetime.  0 goes in the first
+ * bucket and the others go in the bucket of their highest bit plus
+ * one with the last bucket taking everything longer.
+ *
+ * Returns the bucket number.
+ *
+ * ARGUMENTS:
+ *
+ * life -> Lifetime that we are counting.
+ */
+static	int	life_bucket(unsigned long life)
+{
+  int	bucket_c;
+  
+  for (bucket_c = 0; life > 0 && bucket_c < LIFETIME_BUCKETS - 1;
+       bucket_c++) {
+    life >>= 1;
+  }
+  
+  return bucket_c;
+}
+
+/*
+ * static void log_hist
+ *
+ * Log the buckets of a lifetime histogram that have counts in them.
+ *
+ * ARGUMENTS:
+ *
+ * label -> Label to start the line with.
+ *
+ * hist -> Histogram of LIFETIME_BUCKETS counts.
+ */
+static	void	log_hist(const char *label, const unsigned int *hist)
+{
+  char		line[LIFETIME_BUCKETS * 32 + 32], *line_p, *bounds_p;
+  int		bucket_c;
+  
+  line_p = line;
+  bounds_p = line + sizeof(line);
+  line_p += loc_snprintf(line_p, bounds_p - line_p, "%s", label);
+  
+  for (bucket_c = 0; bucket_c < LIFETIME_BUCKETS; bucket_c++) {
+    if (hist[bucket_c] == 0) {
+      continue;
+    }
+    if (bucket_c == 0) {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " 0:%u",
+			     hist[bucket_c]);
+    }
+    else if (bucket_c == LIFETIME_BUCKETS - 1) {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " %lu+:%u",
+			     1UL << (bucket_c - 1), hist[bucket_c]);
+    }
+    else if (bucket_c == 1) {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " 1:%u",
+			     hist[bucket_c]);
+    }
+    else {
+      line_p += loc_snprintf(line_p, bounds_p - line_p, " %lu-%lu:%u",
+			     1UL << (bucket_c - 1), (1UL << bucket_c) - 1,
+			     hist[bucket_c]);
+    }
+  }
+  
+  dmalloc_message("%s", line);
+}
+#endif /* if LIFETIME_BUCKETS > 0 */
+
+/*
+ * static int add_top
+ *
+ * Add an entry to a list of the top scoring entries if it scores
+ * high enough.  The reports keep a handful of entries this way
+ * instead of sorting the table.
+ *
+ * Returns the new number of entries in the list.
+ *
+ * ARGUMENTS:
+ *
+ * top <-> List of the top entries in order of score.
+ *
+ * scores <-> Scores of the entries in the list.
+ *
+ * top_n -> Number of entries in the list.
+ *
+ * top_max -> Most entries that the list can hold.
+ *
+ * entry_p -> Entry that we are adding.
+ *
+ * score -> Score of the entry.
+ */
+static	int	add_top(mem_entry_t **top, double *scores, int top_n,
+			const int top_max, mem_entry_t *entry_p,
+			const double score)
+{
+  int	top_c;
+  
+  if (top_max <= 0 || (top_n == top_max && score <= scores[top_n - 1])) {
+    return top_n;
+  }
+  if (top_n < top_max) {
+    top_n++;
+  }
+  
+  /* insert the entry in order of score */
+  for (top_c = top_n - 1; top_c > 0 && scores[top_c - 1] < score; top_c--) {
+    top[top_c] = top[top_c - 1];
+    scores[top_c] = scores[top_c - 1];
+  }
+  top[top_c] = entry_p;
+  scores[top_c] = score;
+  
+  return top_n;
+}
+
 /*
  * void _dmalloc_table_init
  *
@@ -569,6 +690,45 @@ static mem_entry_t	*table_find(mem_table_t *mem_table,
   return &mem_table->mt_other_pointers;
 }
 
+/*
+ * static mem_entry_t *remove_entry
+ *
+ * Take a pointer out of the in-use counts of its entry.
+ *
+ * Returns the entry that the pointer was counted in.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * old_file -> File name or return address of the allocation to
+ * delete.
+ *
+ * old_line -> Line number of the allocation to delete.
+ *
+ * size -> Size in bytes of the allocation.
+ */
+static mem_entry_t	*remove_entry(mem_table_t *mem_table,
+				      const char *old_file,
+				      const unsigned int old_line,
+				      const DMALLOC_SIZE size)
+{
+  mem_entry_t	*entry_p;
+  
+  entry_p = table_find(mem_table, old_file, old_line);
+  if (entry_p->me_file == NULL) {
+    /* if we didn't find it, account for it in the other_pointers?? */
+    entry_p = &mem_table->mt_other_pointers;
+  }
+  /* update our pointer info if we can */
+  if (entry_p->me_in_use_size >= size && entry_p->me_in_use_c > 0) {
+    entry_p->me_in_use_size -= size;
+    entry_p->me_in_use_c--;
+  }
+  
+  return entry_p;
+}
+
 /*
  * void _dmalloc_table_insert
  *
@@ -629,19 +789,223 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
 void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
 			      const unsigned int old_line,
 			      const DMALLOC_SIZE size)
+{
+  (void)remove_entry(mem_table, old_file, old_line, size);
+}
+
+/*
+ * void _dmalloc_table_free
+ *
+ * Remove a freed pointer from the table and count its lifetime in the
+ * histograms of the entry.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * old_file -> File name or return address of the allocation to
+ * delete.
+ *
+ * old_line -> Line number of the allocation to delete.
+ *
+ * size -> Size in bytes of the allocation.
+ *
+ * life_iter -> Number of iterations that the pointer was alive.
+ *
+ * life_nsec -> Number of nanoseconds that the pointer was alive or 0
+ * if they are not being recorded.
+ */
+void	_dmalloc_table_free(mem_table_t *mem_table, const char *old_file,
+			    const unsigned int old_line,
+			    const DMALLOC_SIZE size,
+			    const unsigned long life_iter,
+			    const unsigned long life_nsec)
 {
   mem_entry_t	*entry_p;
   
-  entry_p = table_find(mem_table, old_file, old_line);
+  entry_p = remove_entry(mem_table, old_file, old_line, size);
+  
+#if LIFETIME_BUCKETS > 0
+  entry_p->me_freed_c++;
+  if (life_iter < LIFETIME_SHORT_ITERS) {
+    entry_p->me_short_c++;
+  }
+  entry_p->me_life_iter += life_iter;
+  entry_p->me_life_hist[life_bucket(life_iter)]++;
+#if LIFETIME_NSEC
+  entry_p->me_life_nsec += life_nsec;
+  entry_p->me_nsec_hist[life_bucket(life_nsec / 1000)]++;
+#endif
+#endif
+}
+
+/*
+ * void _dmalloc_table_realloc
+ *
+ * Count a realloc in the entry of the site that called it.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the realloc.
+ *
+ * line -> Line number of the realloc.
+ *
+ * old_size -> Size in bytes of the allocation before the realloc.
+ *
+ * new_size -> Size in bytes of the allocation after the realloc.
+ *
+ * copied_size -> Bytes that were copied because the allocation moved
+ * or 0 if it was resized in place.
+ *
+ * realloc_c -> Number of times the allocation has been realloced
+ * including this one.
+ *
+ * new_buf_b -> Set to 1 if this is the first time that the site has
+ * resized the allocation.
+ */
+void	_dmalloc_table_realloc(mem_table_t *mem_table, const char *file,
+			       const unsigned int line,
+			       const unsigned long old_size,
+			       const unsigned long new_size,
+			       const unsigned long copied_size,
+			       const unsigned int realloc_c,
+			       const int new_buf_b)
+{
+#if REALLOC_TOP_LOG > 0
+  mem_entry_t	*entry_p;
+  int		bucket_c;
+  
+  /* the realloc has already inserted the new size at the site */
+  entry_p = table_find(mem_table, file, line);
   if (entry_p->me_file == NULL) {
-    /* if we didn't find it, account for it in the other_pointers?? */
     entry_p = &mem_table->mt_other_pointers;
   }
-  /* update our pointer info if we can */
-  if (entry_p->me_in_use_size >= size && entry_p->me_in_use_c > 0) {
-    entry_p->me_in_use_size -= size;
-    entry_p->me_in_use_c--;
+  
+  entry_p->me_realloc_c++;
+  if (new_buf_b) {
+    entry_p->me_realloc_buf_c++;
+  }
+  if (realloc_c > entry_p->me_realloc_max_c) {
+    entry_p->me_realloc_max_c = realloc_c;
+  }
+  entry_p->me_copied_size += copied_size;
+  
+  /* compare the sizes without dividing */
+  if (new_size < old_size) {
+    bucket_c = 0;
+  }
+  else if (new_size * 4 < old_size * 5) {
+    bucket_c = 1;
+  }
+  else if (new_size * 2 < old_size * 3) {
+    bucket_c = 2;
+  }
+  else if (new_size < old_size * 2) {
+    bucket_c = 3;
   }
+  else if (new_size < old_size * 4) {
+    bucket_c = 4;
+  }
+  else {
+    bucket_c = 5;
+  }
+  entry_p->me_growth_hist[bucket_c]++;
+#endif
+}
+
+/*
+ * void _dmalloc_table_realloc_final
+ *
+ * Count the final size of a realloced allocation which is being
+ * freed in the entry of the site that last resized it.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the last realloc.
+ *
+ * line -> Line number of the last realloc.
+ *
+ * size -> Size in bytes of the allocation.
+ */
+void	_dmalloc_table_realloc_final(mem_table_t *mem_table,
+				     const char *file,
+				     const unsigned int line,
+				     const unsigned long size)
+{
+#if REALLOC_TOP_LOG > 0
+  mem_entry_t	*entry_p;
+  
+  entry_p = table_find(mem_table, file, line);
+  if (entry_p->me_file == NULL) {
+    entry_p = &mem_table->mt_other_pointers;
+  }
+  
+  entry_p->me_final_size += size;
+  entry_p->me_final_c++;
+#endif
+}
+
+/*
+ * void _dmalloc_table_lock
+ *
+ * Add the time that a call waited for and held the library lock to
+ * the entry of the site that made the call.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the call or
+ * DMALLOC_DEFAULT_FILE if it is not known.
+ *
+ * line -> Line number of the call.
+ *
+ * wait_nsec -> Nanoseconds that the call waited for the lock or 0 if
+ * it was free.
+ *
+ * hold_nsec -> Nanoseconds that the call held the lock.
+ */
+void	_dmalloc_table_lock(mem_table_t *mem_table, const char *file,
+			    const unsigned int line,
+			    const unsigned long wait_nsec,
+			    const unsigned long hold_nsec)
+{
+#if LOCK_PROFILE_TOP_LOG > 0
+  mem_entry_t	*entry_p;
+  
+  if (file == DMALLOC_DEFAULT_FILE) {
+    entry_p = &mem_table->mt_other_pointers;
+  }
+  else {
+    entry_p = table_find(mem_table, file, line);
+    if (entry_p->me_file == NULL
+	&& mem_table->mt_in_use_c > mem_table->mt_entry_n / 2) {
+      /* too many sites in the table so put it in the other bucket */
+      entry_p = &mem_table->mt_other_pointers;
+    }
+    else if (entry_p->me_file == NULL
+	     && entry_p != &mem_table->mt_other_pointers) {
+      entry_p->me_file = file;
+      entry_p->me_line = line;
+      entry_p->me_entry_pos_p = entry_p;
+      mem_table->mt_in_use_c++;
+    }
+  }
+  
+  entry_p->me_lock_c++;
+  if (wait_nsec > 0) {
+    entry_p->me_lock_wait_c++;
+    entry_p->me_lock_wait_nsec += wait_nsec;
+  }
+  entry_p->me_lock_hold_nsec += hold_nsec;
+  if (hold_nsec > entry_p->me_lock_hold_max) {
+    entry_p->me_lock_hold_max = hold_nsec;
+  }
+#endif
 }
 
 /*
@@ -663,7 +1027,7 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
 {
   mem_entry_t	*entry_p, total;
   int		entry_c;
-  char		source[64];
+  char		source[MAX_FILE_LENGTH + 64];
   
   /* is the table empty */
   if (mem_table->mt_in_use_c == 0) {
@@ -694,8 +1058,8 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
       entry_c++;
       /* can we still print the pointer information? */
       if (log_n == 0 || entry_c < log_n) {
-	(void)_dmalloc_chunk_desc_pnt(source, sizeof(source),
-				      entry_p->me_file, entry_p->me_line);
+	(void)_dmalloc_chunk_desc_site(source, sizeof(source),
+				       entry_p->me_file, entry_p->me_line);
 	log_entry(entry_p, in_use_column_b, source);
       }
       add_entry(&total, entry_p);
@@ -736,3 +1100,257 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
     *entry_p = swap_entry;
   }
 }
+
+/*
+ * void _dmalloc_table_log_lifetimes
+ *
+ * Log the sites of the memory table which have the most short-lived
+ * allocations along with the histograms of their lifetimes.  These
+ * are the sites where an arena or object pool would pay off the most.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * log_n -> Number of sites to log to the file.
+ */
+void	_dmalloc_table_log_lifetimes(mem_table_t *mem_table, const int log_n)
+{
+#if LIFETIME_BUCKETS > 0
+  mem_entry_t	*entry_p, *top[TOP_MAX];
+  double	score, scores[TOP_MAX];
+  int		top_n, top_max, top_c;
+  char		source[MAX_FILE_LENGTH + 64];
+  
+  top_max = MIN(log_n, TOP_MAX);
+  
+  /*
+   * Pick out the top sites by the allocations they make times the
+   * fraction of them that are short-lived.
+   */
+  top_n = 0;
+  for (entry_p = mem_table->mt_entries;
+       entry_p < mem_table->mt_bounds_p;
+       entry_p++) {
+    if (entry_p->me_file == NULL || entry_p->me_short_c == 0) {
+      continue;
+    }
+    score = (double)entry_p->me_total_c * (double)entry_p->me_short_c
+      / (double)entry_p->me_freed_c;
+    top_n = add_top(top, scores, top_n, top_max, entry_p, score);
+  }
+  
+  if (top_n == 0) {
+    dmalloc_message(" no short-lived allocations");
+    return;
+  }
+  
+#if LIFETIME_NSEC
+  dmalloc_message("  count  freed short mean-iters  mean-usecs  source");
+#else
+  dmalloc_message("  count  freed short mean-iters  source");
+#endif
+  for (top_c = 0; top_c < top_n; top_c++) {
+    entry_p = top[top_c];
+    (void)_dmalloc_chunk_desc_site(source, sizeof(source),
+				   entry_p->me_file, entry_p->me_line);
+#if LIFETIME_NSEC
+    dmalloc_message("%7lu %6lu %4lu%% %10lu %11lu  %s",
+		    entry_p->me_total_c, entry_p->me_freed_c,
+		    (entry_p->me_short_c * 100) / entry_p->me_freed_c,
+		    entry_p->me_life_iter / entry_p->me_freed_c,
+		    entry_p->me_life_nsec / entry_p->me_freed_c / 1000,
+		    source);
+#else
+    dmalloc_message("%7lu %6lu %4lu%% %10lu  %s",
+		    entry_p->me_total_c, entry_p->me_freed_c,
+		    (entry_p->me_short_c * 100) / entry_p->me_freed_c,
+		    entry_p->me_life_iter / entry_p->me_freed_c, source);
+#endif
+    log_hist("    iters", entry_p->me_life_hist);
+#if LIFETIME_NSEC
+    log_hist("    usecs", entry_p->me_nsec_hist);
+#endif
+  }
+#else
+  dmalloc_message(" lifetimes are not recorded");
+#endif
+}
+
+/*
+ * void _dmalloc_table_log_reallocs
+ *
+ * Log the realloc sites of the memory table which copied the most
+ * bytes when their allocations moved along with how much the
+ * allocations grew.  These are the sites where reserving the size up
+ * front or a better growth policy would save the most copying.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * log_n -> Number of sites to log to the file.
+ */
+void	_dmalloc_table_log_reallocs(mem_table_t *mem_table, const int log_n)
+{
+#if REALLOC_TOP_LOG > 0
+  static const char	*growth_labels[REALLOC_GROWTH_BUCKETS] = {
+    "shrink", "1-1.25x", "1.25-1.5x", "1.5-2x", "2-4x", "4x+"
+  };
+  mem_entry_t	*entry_p, *top[TOP_MAX];
+  double	scores[TOP_MAX];
+  int		top_n, top_max, top_c, bucket_c;
+  char		source[MAX_FILE_LENGTH + 64];
+  char		hist[REALLOC_GROWTH_BUCKETS * 24 + 16], *hist_p, *bounds_p;
+  
+  top_max = MIN(log_n, TOP_MAX);
+  
+  /* pick out the top sites by the bytes that they copied */
+  top_n = 0;
+  for (entry_p = mem_table->mt_entries;
+       entry_p < mem_table->mt_bounds_p;
+       entry_p++) {
+    if (entry_p->me_file == NULL || entry_p->me_realloc_c == 0) {
+      continue;
+    }
+    top_n = add_top(top, scores, top_n, top_max, entry_p,
+		    (double)entry_p->me_copied_size);
+  }
+  
+  if (top_n == 0) {
+    dmalloc_message(" no reallocs");
+    return;
+  }
+  
+  dmalloc_message(" copied-size reallocs buffers most final-size  source");
+  for (top_c = 0; top_c < top_n; top_c++) {
+    entry_p = top[top_c];
+    (void)_dmalloc_chunk_desc_site(source, sizeof(source),
+				   entry_p->me_file, entry_p->me_line);
+    dmalloc_message("%12lu %8lu %7lu %4lu %10lu  %s",
+		    entry_p->me_copied_size, entry_p->me_realloc_c,
+		    entry_p->me_realloc_buf_c, entry_p->me_realloc_max_c,
+		    (entry_p->me_final_c == 0 ? 0 :
+		     entry_p->me_final_size / entry_p->me_final_c),
+		    source);
+    
+    hist_p = hist;
+    bounds_p = hist + sizeof(hist);
+    hist_p += loc_snprintf(hist_p, bounds_p - hist_p, "    growth");
+    for (bucket_c = 0; bucket_c < REALLOC_GROWTH_BUCKETS; bucket_c++) {
+      if (entry_p->me_growth_hist[bucket_c] > 0) {
+	hist_p += loc_snprintf(hist_p, bounds_p - hist_p, " %s:%u",
+			       growth_labels[bucket_c],
+			       entry_p->me_growth_hist[bucket_c]);
+      }
+    }
+    dmalloc_message("%s", hist);
+  }
+#else
+  dmalloc_message(" reallocs are not recorded");
+#endif
+}
+
+/*
+ * void _dmalloc_table_log_locks
+ *
+ * Log the sites of the memory table which held the library lock the
+ * longest along with how often and how long they had to wait for it.
+ * These are the calls that the other threads queue up behind.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * log_n -> Number of sites to log to the file.
+ */
+void	_dmalloc_table_log_locks(mem_table_t *mem_table, const int log_n)
+{
+#if LOCK_PROFILE_TOP_LOG > 0
+  mem_entry_t	*entry_p, *top[TOP_MAX + 1];
+  double	scores[TOP_MAX];
+  int		top_n, top_max, top_c;
+  char		source[MAX_FILE_LENGTH + 64];
+  
+  top_max = MIN(log_n, TOP_MAX);
+  
+  /* pick out the top sites by the time that they held the lock */
+  top_n = 0;
+  for (entry_p = mem_table->mt_entries;
+       entry_p < mem_table->mt_bounds_p;
+       entry_p++) {
+    if (entry_p->me_file == NULL || entry_p->me_lock_c == 0) {
+      continue;
+    }
+    top_n = add_top(top, scores, top_n, top_max, entry_p,
+		    (double)entry_p->me_lock_hold_nsec);
+  }
+  /* the calls without a site or that did not fit go at the end */
+  if (mem_table->mt_other_pointers.me_lock_c > 0) {
+    top[top_n++] = &mem_table->mt_other_pointers;
+  }
+  
+  if (top_n == 0) {
+    dmalloc_message(" no lock holds");
+    return;
+  }
+  
+  dmalloc_message("  calls waited wait-usecs hold-usecs max-hold  source");
+  for (top_c = 0; top_c < top_n; top_c++) {
+    entry_p = top[top_c];
+    if (entry_p == &mem_table->mt_other_pointers) {
+      strncpy(source, "Unknown or other sites", sizeof(source));
+      source[sizeof(source) - 1] = '\0';
+    }
+    else {
+      (void)_dmalloc_chunk_desc_site(source, sizeof(source),
+				     entry_p->me_file, entry_p->me_line);
+    }
+    dmalloc_message("%7lu %6lu %10lu %10lu %8lu  %s",
+		    entry_p->me_lock_c, entry_p->me_lock_wait_c,
+		    entry_p->me_lock_wait_nsec / 1000,
+		    entry_p->me_lock_hold_nsec / 1000,
+		    entry_p->me_lock_hold_max / 1000, source);
+  }
+#else
+  dmalloc_message(" the lock is not profiled");
+#endif
+}
+
+/*
+ * int _dmalloc_table_top
+ *
+ * Find the sites of the memory table with the most memory in use for
+ * the live statistics.  The table is not sorted so this can be called
+ * while the transactions go on.
+ *
+ * Returns the number of entries that were found.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * top <- List of the top entries which we fill in by bytes in use.
+ *
+ * top_max -> Most entries that the list can hold.
+ */
+int	_dmalloc_table_top(mem_table_t *mem_table, mem_entry_t **top,
+			   const int top_max)
+{
+  mem_entry_t	*entry_p;
+  double	scores[TOP_MAX];
+  int		top_n;
+  
+  top_n = 0;
+  for (entry_p = mem_table->mt_entries;
+       entry_p < mem_table->mt_bounds_p;
+       entry_p++) {
+    if (entry_p->me_file == NULL || entry_p->me_in_use_size == 0) {
+      continue;
+    }
+    top_n = add_top(top, scores, top_n, MIN(top_max, TOP_MAX), entry_p,
+		    (double)entry_p->me_in_use_size);
+  }
+  
+  return top_n;
+}
@@ -22,6 +22,12 @@
 #ifndef __DMALLOC_TAB_H__
 #define __DMALLOC_TAB_H__
 
+/*
+ * Buckets of the new size over the old size of reallocs: shrinking,
+ * less than 1.25, 1.5, 2, and 4 times, and 4 times or more.
+ */
+#define REALLOC_GROWTH_BUCKETS	6
+
 /* entry in a memory table */
 typedef struct mem_entry_st {
   const char		*me_file;		/* filename of alloc or ra */
@@ -30,6 +36,32 @@ typedef struct mem_entry_st {
   unsigned long		me_total_c;		/* total pointers allocated */
   unsigned long		me_in_use_size;		/* size currently alloced */
   unsigned long		me_in_use_c;		/* pointers currently in use */
+#if LIFETIME_BUCKETS > 0
+  unsigned long		me_freed_c;		/* pointers freed */
+  unsigned long		me_short_c;		/* freed soon after alloc */
+  unsigned long		me_life_iter;		/* total iterations alive */
+  unsigned int		me_life_hist[LIFETIME_BUCKETS]; /* log2 of iters */
+#if LIFETIME_NSEC
+  unsigned long		me_life_nsec;		/* total nanosecs alive */
+  unsigned int		me_nsec_hist[LIFETIME_BUCKETS]; /* log2 of usecs */
+#endif
+#endif
+#if REALLOC_TOP_LOG > 0
+  unsigned long		me_realloc_c;		/* reallocs at this site */
+  unsigned long		me_realloc_buf_c;	/* buffers resized here */
+  unsigned long		me_realloc_max_c;	/* most reallocs of a buffer */
+  unsigned long		me_copied_size;		/* bytes copied by moves */
+  unsigned long		me_final_size;		/* total size when freed */
+  unsigned long		me_final_c;		/* resized buffers freed */
+  unsigned int		me_growth_hist[REALLOC_GROWTH_BUCKETS]; /* ratios */
+#endif
+#if LOCK_PROFILE_TOP_LOG > 0
+  unsigned long		me_lock_c;		/* times it took the lock */
+  unsigned long		me_lock_wait_c;		/* times it had to wait */
+  unsigned long		me_lock_wait_nsec;	/* total nanosecs waiting */
+  unsigned long		me_lock_hold_nsec;	/* total nanosecs holding */
+  unsigned long		me_lock_hold_max;	/* longest hold */
+#endif
   /* we use this so we can easily un-sort the list */
   struct mem_entry_st	*me_entry_pos_p;	/* pos of entry in table */
 } mem_entry_t;
@@ -104,6 +136,118 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
 			      const unsigned int old_line,
 			      const DMALLOC_SIZE size);
 
+/*
+ * void _dmalloc_table_free
+ *
+ * Remove a freed pointer from the table and count its lifetime in the
+ * histograms of the entry.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * old_file -> File name or return address of the allocation to
+ * delete.
+ *
+ * old_line -> Line number of the allocation to delete.
+ *
+ * size -> Size in bytes of the allocation.
+ *
+ * life_iter -> Number of iterations that the pointer was alive.
+ *
+ * life_nsec -> Number of nanoseconds that the pointer was alive or 0
+ * if they are not being recorded.
+ */
+extern
+void	_dmalloc_table_free(mem_table_t *mem_table, const char *old_file,
+			    const unsigned int old_line,
+			    const DMALLOC_SIZE size,
+			    const unsigned long life_iter,
+			    const unsigned long life_nsec);
+
+/*
+ * void _dmalloc_table_realloc
+ *
+ * Count a realloc in the entry of the site that called it.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the realloc.
+ *
+ * line -> Line number of the realloc.
+ *
+ * old_size -> Size in bytes of the allocation before the realloc.
+ *
+ * new_size -> Size in bytes of the allocation after the realloc.
+ *
+ * copied_size -> Bytes that were copied because the allocation moved
+ * or 0 if it was resized in place.
+ *
+ * realloc_c -> Number of times the allocation has been realloced
+ * including this one.
+ *
+ * new_buf_b -> Set to 1 if this is the first time that the site has
+ * resized the allocation.
+ */
+extern
+void	_dmalloc_table_realloc(mem_table_t *mem_table, const char *file,
+			       const unsigned int line,
+			       const unsigned long old_size,
+			       const unsigned long new_size,
+			       const unsigned long copied_size,
+			       const unsigned int realloc_c,
+			       const int new_buf_b);
+
+/*
+ * void _dmalloc_table_realloc_final
+ *
+ * Count the final size of a realloced allocation which is being
+ * freed in the entry of the site that last resized it.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the last realloc.
+ *
+ * line -> Line number of the last realloc.
+ *
+ * size -> Size in bytes of the allocation.
+ */
+extern
+void	_dmalloc_table_realloc_final(mem_table_t *mem_table,
+				     const char *file,
+				     const unsigned int line,
+				     const unsigned long size);
+
+/*
+ * void _dmalloc_table_lock
+ *
+ * Add the time that a call waited for and held the library lock to
+ * the entry of the site that made the call.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the call or
+ * DMALLOC_DEFAULT_FILE if it is not known.
+ *
+ * line -> Line number of the call.
+ *
+ * wait_nsec -> Nanoseconds that the call waited for the lock or 0 if
+ * it was free.
+ *
+ * hold_nsec -> Nanoseconds that the call held the lock.
+ */
+extern
+void	_dmalloc_table_lock(mem_table_t *mem_table, const char *file,
+			    const unsigned int line,
+			    const unsigned long wait_nsec,
+			    const unsigned long hold_nsec);
+
 /*
  * void _dmalloc_table_log_info
  *
@@ -122,6 +266,76 @@ extern
 void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
 				const int in_use_column_b);
 
+/*
+ * void _dmalloc_table_log_lifetimes
+ *
+ * Log the sites of the memory table which have the most short-lived
+ * allocations along with the histograms of their lifetimes.  These
+ * are the sites where an arena or object pool would pay off the most.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * log_n -> Number of sites to log to the file.
+ */
+extern
+void	_dmalloc_table_log_lifetimes(mem_table_t *mem_table, const int log_n);
+
+/*
+ * void _dmalloc_table_log_reallocs
+ *
+ * Log the realloc sites of the memory table which copied the most
+ * bytes when their allocations moved along with how much the
+ * allocations grew.  These are the sites where reserving the size up
+ * front or a better growth policy would save the most copying.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * log_n -> Number of sites to log to the file.
+ */
+extern
+void	_dmalloc_table_log_reallocs(mem_table_t *mem_table, const int log_n);
+
+/*
+ * void _dmalloc_table_log_locks
+ *
+ * Log the sites of the memory table which held the library lock the
+ * longest along with how often and how long they had to wait for it.
+ * These are the calls that the other threads queue up behind.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * log_n -> Number of sites to log to the file.
+ */
+extern
+void	_dmalloc_table_log_locks(mem_table_t *mem_table, const int log_n);
+
+/*
+ * int _dmalloc_table_top
+ *
+ * Find the sites of the memory table with the most memory in use for
+ * the live statistics.  The table is not sorted so this can be called
+ * while the transactions go on.
+ *
+ * Returns the number of entries that were found.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * top <- List of the top entries which we fill in by bytes in use.
+ *
+ * top_max -> Most entries that the list can hold.
+ */
+extern
+int	_dmalloc_table_top(mem_table_t *mem_table, mem_entry_t **top,
+			   const int top_max);
+
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
 #endif /* ! __DMALLOC_TAB_H__ */
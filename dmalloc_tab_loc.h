@@ -38,6 +38,9 @@
  */
 #define MAX_QSORT_PARTITION	8
 
+/* most entries that the lifetime and realloc reports can list */
+#define TOP_MAX			64
+
 /* comparison function */
 typedef int	(*compare_t)(const void *element1_p, const void *element2_p);
 
@@ -0,0 +1,403 @@
+/*
+ * Test program for the thread locking of dmalloc
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#include <stdio.h>				/* for printf */
+
+#include "conf.h"
+#include "settings.h"
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for exit */
+#endif
+#if HAVE_STRING_H
+# include <string.h>				/* for memset */
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for usleep */
+#endif
+#if HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#if HAVE_PTHREADS_H
+# include <pthreads.h>
+#endif
+#if SIGNAL_OKAY
+# include <signal.h>				/* for raise */
+#endif
+
+#include "dmalloc.h"
+#include "dmalloc_argv.h"
+#include "debug_tok.h"
+#include "dmalloc_loc.h"			/* for CONTROL_ENVIRON */
+#include "error_val.h"
+
+/* number of threads that work on the heap at the same time */
+#define THREAD_N	8
+/* transactions that each thread makes */
+#define THREAD_ITERS	2000
+/* number of times that the control file is changed */
+#define CONTROL_CHANGES	20
+
+/* argument variables */
+static	int		silent_b = ARGV_FALSE;		/* silent flag */
+static	int		verbose_b = ARGV_FALSE;		/* verbose flag */
+
+static	argv_t		arg_list[] = {
+  { 's',	"silent",		ARGV_BOOL_INT,		&silent_b,
+    NULL,			"do not display messages" },
+  { 'v',	"verbose",		ARGV_BOOL_INT,		&verbose_b,
+    NULL,			"enables verbose messages" },
+  { ARGV_LAST }
+};
+
+/* control file that the library watches or NULL if none */
+static	const char	*control_path = NULL;
+
+/* the workers wait for this so they go into the library together */
+static	pthread_mutex_t	start_lock = PTHREAD_MUTEX_INITIALIZER;
+static	pthread_cond_t	start_cond = PTHREAD_COND_INITIALIZER;
+static	int		start_b = 0;
+
+/*
+ * Allocate, check, and free a number of pointers.
+ *
+ * Returns the number of failed checks.
+ */
+static	void	*heap_worker(void *arg)
+{
+  unsigned long	bad_c = 0;
+  char		*pnt;
+  int		iter_c;
+  
+  pthread_mutex_lock(&start_lock);
+  while (! start_b) {
+    pthread_cond_wait(&start_cond, &start_lock);
+  }
+  pthread_mutex_unlock(&start_lock);
+  
+  for (iter_c = 0; iter_c < THREAD_ITERS; iter_c++) {
+    pnt = malloc(iter_c % 200 + 1);
+    if (pnt == NULL) {
+      bad_c++;
+      continue;
+    }
+    memset(pnt, 'x', iter_c % 200 + 1);
+    if (dmalloc_verify_pnt(__FILE__, __LINE__, "heap_worker", pnt,
+			   1 /* exact */, iter_c % 200 + 1)
+	!= DMALLOC_VERIFY_NOERROR) {
+      bad_c++;
+    }
+    free(pnt);
+  }
+  
+  return (void *)bad_c;
+}
+
+/*
+ * Overwrite the top fence-post of a pointer and make sure that the
+ * pointer checks used by the checked functions still see it.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	check_fence(void)
+{
+  char		*pnt, save;
+  int		size = 20, ret, final = 1;
+  unsigned int	old_flags;
+  
+  old_flags = dmalloc_debug_current();
+  dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
+  
+  pnt = malloc(size);
+  if (pnt == NULL) {
+    dmalloc_debug(old_flags);
+    return 0;
+  }
+  save = pnt[size];
+  pnt[size] = 'x';
+  
+  dmalloc_errno = DMALLOC_ERROR_NONE;
+  ret = dmalloc_verify_pnt(__FILE__, __LINE__, "check_fence", pnt,
+			   1 /* exact */, size);
+  if (ret != DMALLOC_VERIFY_ERROR
+      || dmalloc_errno != DMALLOC_ERROR_OVER_FENCE) {
+    if (! silent_b) {
+      (void)printf("   ERROR: overwritten fence-post was not reported: %s\n",
+		   dmalloc_strerror(dmalloc_errno));
+    }
+    final = 0;
+  }
+  dmalloc_errno = DMALLOC_ERROR_NONE;
+  
+  pnt[size] = save;
+  free(pnt);
+  dmalloc_debug(old_flags);
+  return final;
+}
+
+/*
+ * Make sure that the pointer checks which share the lock are counted
+ * in the lock profile.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	check_shared_profile(void)
+{
+  dmalloc_lock_stats_t	before, after;
+  char			*pnt;
+  int			examine_c, final = 1;
+  
+  if (! dmalloc_get_lock_stats(DMALLOC_LOCK_VERIFY, &before)) {
+    /* the library was not built to profile its lock */
+    return 1;
+  }
+  
+  pnt = malloc(10);
+  if (pnt == NULL) {
+    return 0;
+  }
+  for (examine_c = 0; examine_c < 10; examine_c++) {
+    if (dmalloc_examine(pnt, NULL, NULL, NULL, NULL, NULL, NULL, NULL)
+	!= DMALLOC_NOERROR) {
+      final = 0;
+    }
+  }
+  free(pnt);
+  
+  (void)dmalloc_get_lock_stats(DMALLOC_LOCK_VERIFY, &after);
+  if (after.dl_lock_c < before.dl_lock_c + 10) {
+    if (! silent_b) {
+      (void)printf("   ERROR: verify lock count went from %lu to %lu\n",
+		   before.dl_lock_c, after.dl_lock_c);
+    }
+    final = 0;
+  }
+  
+  return final;
+}
+
+/*
+ * Write the options into the control file as the utility does.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	write_control(const char *options)
+{
+  char	tmp_path[1024];
+  FILE	*outfile;
+  
+  (void)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", control_path);
+  outfile = fopen(tmp_path, "w");
+  if (outfile == NULL) {
+    return 0;
+  }
+  (void)fprintf(outfile, "%s\n", options);
+  if (fclose(outfile) != 0 || rename(tmp_path, control_path) != 0) {
+    (void)remove(tmp_path);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Start the workers, apply any options from the control file, and
+ * then let the workers go and wait for them to finish.
+ *
+ * Returns the number of failed checks.
+ *
+ * ARGUMENTS:
+ *
+ * options -> Options to write to the control file or NULL for none.
+ */
+static	unsigned long	run_workers(const char *options)
+{
+  pthread_t	threads[THREAD_N];
+  void		*ret_p;
+  unsigned long	bad_c = 0;
+  int		thread_c, start_c;
+  
+  start_b = 0;
+  for (start_c = 0; start_c < THREAD_N; start_c++) {
+    if (pthread_create(&threads[start_c], NULL, heap_worker, NULL) != 0) {
+      if (! silent_b) {
+	(void)printf("   ERROR: could not create thread %d\n", start_c);
+      }
+      bad_c++;
+      break;
+    }
+  }
+  
+  if (options != NULL) {
+    if (write_control(options)) {
+      /* the signal has the library look at the file with our next call */
+#if SIGNAL_OKAY && defined(CONTROL_SIGNAL)
+      (void)raise(CONTROL_SIGNAL);
+#endif
+      free(malloc(10));
+    }
+    else {
+      if (! silent_b) {
+	(void)printf("   ERROR: could not write control file '%s'\n",
+		     control_path);
+      }
+      bad_c++;
+    }
+  }
+  
+  pthread_mutex_lock(&start_lock);
+  start_b = 1;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&start_lock);
+  
+  for (thread_c = 0; thread_c < start_c; thread_c++) {
+    (void)pthread_join(threads[thread_c], &ret_p);
+    bad_c += (unsigned long)ret_p;
+  }
+  
+  return bad_c;
+}
+
+/*
+ * Run the tests of the thread locking.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	do_tests(void)
+{
+  unsigned long	bad_c;
+  char		options[128];
+  int		change_c, final = 1;
+  
+  /********************/
+  
+  if (verbose_b) {
+    (void)printf("  Checking threads on the heap\n");
+  }
+  bad_c = run_workers(NULL);
+  if (bad_c > 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: %lu pointers failed the checks\n", bad_c);
+    }
+    final = 0;
+  }
+  
+  /********************/
+  
+  if (verbose_b) {
+    (void)printf("  Checking an overwritten fence-post\n");
+  }
+  if (! check_fence()) {
+    final = 0;
+  }
+  
+  /********************/
+  
+  if (verbose_b) {
+    (void)printf("  Checking the lock profile of the shared readers\n");
+  }
+  if (! check_shared_profile()) {
+    final = 0;
+  }
+  
+  /********************/
+  
+  /*
+   * Check that a control file that carries lock-on over from the
+   * environment does not turn off the locking.  If it did then the
+   * main thread would keep the lock after applying it and the workers
+   * would go into the library together.
+   */
+  if (control_path == NULL) {
+    if (verbose_b) {
+      (void)printf("  No %s so not checking control files\n",
+		   CONTROL_ENVIRON);
+    }
+    return final;
+  }
+  
+  if (verbose_b) {
+    (void)printf("  Checking control file changes under threads\n");
+  }
+  
+  for (change_c = 0; change_c < CONTROL_CHANGES; change_c++) {
+    /* the different lengths make each version of the file look changed */
+    (void)snprintf(options, sizeof(options), "lockon=100000,inter=%d",
+		   (change_c % 2 == 0 ? 1000 : 10000));
+    bad_c = run_workers(options);
+    if (bad_c > 0) {
+      if (! silent_b) {
+	(void)printf("   ERROR: %lu pointers failed the checks after change %d\n",
+		     bad_c, change_c);
+      }
+      final = 0;
+      break;
+    }
+  }
+  (void)remove(control_path);
+  
+  return final;
+}
+
+int	main(int argc, char **argv)
+{
+  int	ret, final = 0;
+  
+  argv_process(arg_list, argc, argv);
+  control_path = getenv(CONTROL_ENVIRON);
+  
+  if (silent_b && verbose_b) {
+    silent_b = ARGV_FALSE;
+  }
+  
+  if (! silent_b) {
+    (void)printf("Running thread tests...\n");
+  }
+  (void)fflush(stdout);
+  
+  if (do_tests()) {
+    if (! silent_b) {
+      (void)printf("  Succeeded.\n");
+    }
+  }
+  else {
+    (void)printf("ERROR: Thread tests failed.  Last dmalloc error: %s (err %d)\n",
+		 dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    final = 1;
+  }
+  
+  argv_cleanup(arg_list);
+  
+  /* last thing is to verify the heap */
+  ret = dmalloc_verify(NULL /* check all heap */);
+  if (ret != DMALLOC_NOERROR) {
+    (void)printf("Final dmalloc_verify returned failure: %s (err %d)\n",
+		 dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    final = 1;
+  }
+  
+  /* you will need this if you can't auto-shutdown */
+#if HAVE_ATEXIT == 0 && HAVE_ON_EXIT == 0 && FINI_DMALLOC == 0
+  /* shutdown the alloc routines */
+  dmalloc_shutdown();
+#endif
+  
+  exit(final);
+}
@@ -40,6 +40,15 @@ extern "C" {
 #include "return.h"
 }
 
+#include <new>
+
+/* the exception specification that <new> uses for the no-throw operators */
+#if __cplusplus >= 201103L
+#define DMALLOC_NOEXCEPT	noexcept
+#else
+#define DMALLOC_NOEXCEPT	throw()
+#endif
+
 /*
  * An overload function for the C++ new.
  */
@@ -85,3 +94,216 @@ operator delete[](void *pnt)
   GET_RET_ADDR(file);
   dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
 }
+
+/*
+ * An overload function for the C++ nothrow new.  Our new already
+ * returns 0L on failure.
+ */
+void *
+operator new(size_t size, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW,
+			0 /* no alignment */, 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++ nothrow new[].
+ */
+void *
+operator new[](size_t size, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW_ARRAY,
+			0 /* no alignment */, 0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++ nothrow delete which is called if
+ * a constructor throws after a nothrow new.
+ */
+void
+operator delete(void *pnt, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++ nothrow delete[].
+ */
+void
+operator delete[](void *pnt, const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+#ifdef __cpp_sized_deallocation
+
+/*
+ * An overload function for the C++14 sized delete.  The size is
+ * checked against the allocation.
+ */
+void
+operator delete(void *pnt, size_t size) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_size(file, 0, pnt, size, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++14 sized delete[].
+ */
+void
+operator delete[](void *pnt, size_t size) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_size(file, 0, pnt, size, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+#endif /* ifdef __cpp_sized_deallocation */
+
+#ifdef __cpp_aligned_new
+
+/*
+ * An overload function for the C++17 aligned new.  An alignment
+ * that the library cannot give throws instead of being shorted.
+ */
+void *
+operator new(size_t size, std::align_val_t align)
+{
+  char	*file;
+  void	*pnt;
+  GET_RET_ADDR(file);
+  pnt = dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW,
+		       static_cast<DMALLOC_SIZE>(align),
+		       0 /* no xalloc messages */);
+  if (pnt == NULL) {
+    throw std::bad_alloc();
+  }
+  return pnt;
+}
+
+/*
+ * An overload function for the C++17 aligned new[].  An alignment
+ * that the library cannot give throws instead of being shorted.
+ */
+void *
+operator new[](size_t size, std::align_val_t align)
+{
+  char	*file;
+  void	*pnt;
+  GET_RET_ADDR(file);
+  pnt = dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW_ARRAY,
+		       static_cast<DMALLOC_SIZE>(align),
+		       0 /* no xalloc messages */);
+  if (pnt == NULL) {
+    throw std::bad_alloc();
+  }
+  return pnt;
+}
+
+/*
+ * An overload function for the C++17 aligned nothrow new.
+ */
+void *
+operator new(size_t size, std::align_val_t align,
+	     const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW,
+			static_cast<DMALLOC_SIZE>(align),
+			0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++17 aligned nothrow new[].
+ */
+void *
+operator new[](size_t size, std::align_val_t align,
+	       const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  return dmalloc_malloc(file, 0, size, DMALLOC_FUNC_NEW_ARRAY,
+			static_cast<DMALLOC_SIZE>(align),
+			0 /* no xalloc messages */);
+}
+
+/*
+ * An overload function for the C++17 aligned delete.
+ */
+void
+operator delete(void *pnt, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++17 aligned delete[].
+ */
+void
+operator delete[](void *pnt, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+/*
+ * An overload function for the C++17 aligned nothrow delete.
+ */
+void
+operator delete(void *pnt, std::align_val_t,
+		const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++17 aligned nothrow delete[].
+ */
+void
+operator delete[](void *pnt, std::align_val_t,
+		  const std::nothrow_t &) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free(file, 0, pnt, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+/*
+ * An overload function for the C++17 sized and aligned delete.
+ */
+void
+operator delete(void *pnt, size_t size, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_size(file, 0, pnt, size, DMALLOC_FUNC_DELETE);
+}
+
+/*
+ * An overload function for the C++17 sized and aligned delete[].
+ */
+void
+operator delete[](void *pnt, size_t size, std::align_val_t) DMALLOC_NOEXCEPT
+{
+  char	*file;
+  GET_RET_ADDR(file);
+  dmalloc_free_size(file, 0, pnt, size, DMALLOC_FUNC_DELETE_ARRAY);
+}
+
+#endif /* ifdef __cpp_aligned_new */
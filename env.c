@@ -59,12 +59,23 @@
 #define LOGFILE_LABEL		"log"
 #define START_LABEL		"start"
 #define LIMIT_LABEL		"limit"
+#define POLICY_LABEL		"policy"
+#define CLASSES_LABEL		"classes"
 
 #define ASSIGNMENT_CHAR		'='
 
+/* policy syntax: <match>@<flags> */
+#define POLICY_FLAGS_CHAR	'@'
+#define POLICY_TOKEN_CHAR	'+'
+#define POLICY_RANGE_CHAR	'-'
+#define POLICY_RA_PREFIX	"ra:"
+#define POLICY_SIZE_PREFIX	"size:"
+
 /* local variables */
 static	char		log_path[512]	= { '\0' }; /* storage for env path */
 static	char		start_file[512] = { '\0' }; /* file to start at */
+static	char		policies[1024]	= { '\0' }; /* POLICY_SEP_CHAR list */
+static	char		classes[512]	= { '\0' }; /* CLASS_SEP_CHAR list */
 
 /****************************** local utilities ******************************/
 
@@ -194,6 +205,123 @@ void	_dmalloc_start_break(char *start_all, char **start_file_p,
   }
 }
 
+/*
+ * Break up RANGE_STR, up to END_P, of the form LOW-HIGH into LOW_P
+ * and HIGH_P.  If HIGH is missing then the range has no top.  Returns
+ * 1 on success or 0 on a bad range.
+ */
+static	int	range_break(const char *range_str, const char *end_p,
+			    const int hex_b, unsigned long *low_p,
+			    unsigned long *high_p)
+{
+  const char	*high_p_str;
+  
+  if (range_str >= end_p || *range_str == POLICY_RANGE_CHAR) {
+    return 0;
+  }
+  
+  if (hex_b) {
+    *low_p = (unsigned long)hex_to_address(range_str);
+  }
+  else {
+    *low_p = loc_atoul(range_str);
+  }
+  
+  for (high_p_str = range_str;
+       high_p_str < end_p && *high_p_str != POLICY_RANGE_CHAR;
+       high_p_str++) {
+  }
+  if (high_p_str + 1 >= end_p) {
+    *high_p = (unsigned long)-1;
+  }
+  else if (hex_b) {
+    *high_p = (unsigned long)hex_to_address(high_p_str + 1);
+  }
+  else {
+    *high_p = loc_atoul(high_p_str + 1);
+  }
+  
+  return (*low_p <= *high_p);
+}
+
+/*
+ * Break up POLICY_STR into POLICY_P.  Returns 1 on success or 0 if
+ * the string is not a valid policy.
+ */
+int	_dmalloc_policy_break(const char *policy_str, policy_t *policy_p)
+{
+  const char	*flags_p, *tok_p, *end_p, *line_p;
+  attr_t	*attr_p;
+  int		len;
+  
+  memset(policy_p, 0, sizeof(*policy_p));
+  
+  flags_p = strrchr(policy_str, POLICY_FLAGS_CHAR);
+  if (flags_p == NULL || flags_p == policy_str || *(flags_p + 1) == '\0') {
+    return 0;
+  }
+  
+  /* the flags are either in hex or debug tokens joined with + */
+  if (*(flags_p + 1) == '0'
+      && (*(flags_p + 2) == 'x' || *(flags_p + 2) == 'X')) {
+    policy_p->po_flags = hex_to_uint(flags_p + 1);
+  }
+  else {
+    for (tok_p = flags_p + 1; *tok_p != '\0'; tok_p = end_p) {
+      for (end_p = tok_p; *end_p != '\0' && *end_p != POLICY_TOKEN_CHAR;
+	   end_p++) {
+      }
+      len = end_p - tok_p;
+      for (attr_p = attributes; attr_p->at_string != NULL; attr_p++) {
+	if (strncmp(tok_p, attr_p->at_string, len) == 0
+	    && attr_p->at_string[len] == '\0') {
+	  break;
+	}
+      }
+      if (attr_p->at_string == NULL) {
+	return 0;
+      }
+      policy_p->po_flags |= attr_p->at_value;
+      if (*end_p == POLICY_TOKEN_CHAR) {
+	end_p++;
+      }
+    }
+  }
+  if (policy_p->po_flags == 0) {
+    return 0;
+  }
+  
+  len = strlen(POLICY_SIZE_PREFIX);
+  if (strncmp(policy_str, POLICY_SIZE_PREFIX, len) == 0) {
+    policy_p->po_match = POLICY_MATCH_SIZE;
+    return range_break(policy_str + len, flags_p, 0 /* decimal */,
+		       &policy_p->po_low, &policy_p->po_high);
+  }
+  
+  len = strlen(POLICY_RA_PREFIX);
+  if (strncmp(policy_str, POLICY_RA_PREFIX, len) == 0) {
+    policy_p->po_match = POLICY_MATCH_RA;
+    return range_break(policy_str + len, flags_p, 1 /* hex */,
+		       &policy_p->po_low, &policy_p->po_high);
+  }
+  
+  /* otherwise it is a file with an optional line number */
+  policy_p->po_match = POLICY_MATCH_FILE;
+  for (line_p = policy_str; line_p < flags_p && *line_p != ':'; line_p++) {
+  }
+  len = line_p - policy_str;
+  if (len >= (int)sizeof(policy_p->po_file)) {
+    return 0;
+  }
+  (void)memcpy(policy_p->po_file, policy_str, len);
+  policy_p->po_file[len] = '\0';
+  if (line_p < flags_p) {
+    policy_p->po_line = atoi(line_p + 1);
+  }
+  
+  return 1;
+}
+
 /*
  * Process the values of dmalloc environ variable(s) from ENVIRON
  * string.
@@ -206,7 +334,8 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
 				 int *start_line_p,
 				 unsigned long *start_iter_p,
 				 unsigned long *start_size_p,
-				 unsigned long *limit_p)
+				 unsigned long *limit_p, char **policies_p,
+				 char **classes_p)
 {
   char		*env_p, *this_p;
   char		buf[1024];
@@ -225,6 +354,9 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
   SET_POINTER(start_iter_p, 0);
   SET_POINTER(start_size_p, 0);
   SET_POINTER(limit_p, 0);
+  SET_POINTER(policies_p, NULL);
+  policies[0] = '\0';
+  SET_POINTER(classes_p, NULL);
   
   /* make a copy */
   (void)strncpy(buf, env_str, sizeof(buf));
@@ -317,6 +449,32 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
       continue;
     }
     
+    /* collect the debug policies, they can be repeated */
+    len = strlen(POLICY_LABEL);
+    if (strncmp(this_p, POLICY_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      this_p += len + 1;
+      len = strlen(policies);
+      if (len > 0 && len < (int)sizeof(policies) - 1) {
+	policies[len++] = POLICY_SEP_CHAR;
+      }
+      (void)loc_snprintf(policies + len, sizeof(policies) - len, "%s",
+			 this_p);
+      SET_POINTER(policies_p, policies);
+      continue;
+    }
+    
+    /* the size classes of the small allocations */
+    len = strlen(CLASSES_LABEL);
+    if (strncmp(this_p, CLASSES_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      this_p += len + 1;
+      (void)strncpy(classes, this_p, sizeof(classes));
+      classes[sizeof(classes) - 1] = '\0';
+      SET_POINTER(classes_p, classes);
+      continue;
+    }
+    
     /* need to check the short/long debug options */
     for (attr_p = attributes; attr_p->at_string != NULL; attr_p++) {
       if (strcmp(this_p, attr_p->at_string) == 0) {
@@ -354,9 +512,11 @@ void	_dmalloc_environ_set(char *buf, const int buf_size,
 			     const int start_line,
 			     const unsigned long start_iter,
 			     const unsigned long start_size,
-			     const unsigned long limit_val)
+			     const unsigned long limit_val,
+			     const char *policies, const char *classes_str)
 {
-  char	*buf_p = buf, *bounds_p = buf + buf_size;
+  char		*buf_p = buf, *bounds_p = buf + buf_size;
+  const char	*pol_p, *end_p;
   
   if (debug > 0) {
     if (long_tokens_b) {
@@ -421,6 +581,23 @@ void	_dmalloc_environ_set(char *buf, const int buf_size,
     buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%lu,",
 			  LIMIT_LABEL, ASSIGNMENT_CHAR, limit_val);
   }
+  if (policies != NULL) {
+    for (pol_p = policies; *pol_p != '\0'; pol_p = end_p) {
+      for (end_p = pol_p; *end_p != '\0' && *end_p != POLICY_SEP_CHAR;
+	   end_p++) {
+      }
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%.*s,",
+			    POLICY_LABEL, ASSIGNMENT_CHAR,
+			    (int)(end_p - pol_p), pol_p);
+      if (*end_p == POLICY_SEP_CHAR) {
+	end_p++;
+      }
+    }
+  }
+  if (classes_str != NULL) {
+    buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			  CLASSES_LABEL, ASSIGNMENT_CHAR, classes_str);
+  }
   
   /* cut off the last comma */
   if (buf_p > buf) {
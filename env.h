@@ -22,6 +22,33 @@
 #ifndef __ENV_H__
 #define __ENV_H__
 
+/* how the allocations are matched by a debug policy */
+#define POLICY_MATCH_FILE	1		/* file[:line] of the caller */
+#define POLICY_MATCH_RA		2		/* return-address range */
+#define POLICY_MATCH_SIZE	3		/* user-size range */
+
+/* separates the policies which are handed back from the environ */
+#define POLICY_SEP_CHAR		';'
+
+/* separates the sizes of the classes option */
+#define CLASS_SEP_CHAR		':'
+
+/* size of the policy file-name buffer */
+#define POLICY_FILE_SIZE	128
+
+/*
+ * Debug flags which are turned on only for the allocations which
+ * match a policy.
+ */
+typedef struct {
+  int		po_match;			/* POLICY_MATCH_* type */
+  unsigned int	po_flags;			/* flags to add */
+  char		po_file[POLICY_FILE_SIZE];	/* file to match */
+  unsigned int	po_line;			/* line to match or 0 */
+  unsigned long	po_low;				/* low end of range */
+  unsigned long	po_high;			/* high end of range */
+} policy_t;
+
 /*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
 
 /*
@@ -39,6 +66,13 @@ void	_dmalloc_start_break(char *start_all, char **start_file_p,
 			     int *start_line_p, unsigned long *start_iter_p,
 			     unsigned long *start_size_p);
 
+/*
+ * Break up POLICY_STR into POLICY_P.  Returns 1 on success or 0 if
+ * the string is not a valid policy.
+ */
+extern
+int	_dmalloc_policy_break(const char *policy_str, policy_t *policy_p);
+
 /*
  * Process the values of dmalloc environ variable(s) from ENVIRON
  * string.
@@ -52,7 +86,8 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
 				 int *start_line_p,
 				 unsigned long *start_iter_p,
 				 unsigned long *start_size_p,
-				 unsigned long *limit_p);
+				 unsigned long *limit_p, char **policies_p,
+				 char **classes_p);
 
 /*
  * Set dmalloc environ variable(s) with the values (maybe SHORT debug
@@ -69,7 +104,8 @@ void	_dmalloc_environ_set(char *buf, const int buf_size,
 			     const int start_line,
 			     const unsigned long start_iter,
 			     const unsigned long start_size,
-			     const unsigned long limit_val);
+			     const unsigned long limit_val,
+			     const char *policies, const char *classes_str);
 
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
@@ -55,13 +55,14 @@
 #define DMALLOC_ERROR_TOO_BIG		41	/* allocation too large */
 /* 42 unused */
 #define DMALLOC_ERROR_ALLOC_FAILED	43	/* could not get more space */
-/* 44 unused */
+#define DMALLOC_ERROR_OVER_BUDGET	44	/* over scope budget */
 #define DMALLOC_ERROR_OVER_LIMIT	45	/* over allocation limit */
 
 /* free errors */
 #define DMALLOC_ERROR_NOT_ON_BLOCK	60	/* not on block boundary */
 #define DMALLOC_ERROR_ALREADY_FREE	61	/* already in free list */
-/* 62-66 unused */
+#define DMALLOC_ERROR_BAD_FREE_SIZE	62	/* sized free mismatch */
+/* 63-66 unused */
 #define DMALLOC_ERROR_FREE_OVERWRITTEN	67	/* free space overwritten */
 
 /* administrative errors */
@@ -106,11 +107,13 @@ __attribute__ ((unused))
   { DMALLOC_ERROR_BAD_SIZE,		"invalid allocation size" },
   { DMALLOC_ERROR_TOO_BIG,		"largest maximum allocation size exceeded" },
   { DMALLOC_ERROR_ALLOC_FAILED,		"could not grow heap by allocating memory" },
+  { DMALLOC_ERROR_OVER_BUDGET,		"over allocation budget of the scope" },
   { DMALLOC_ERROR_OVER_LIMIT,		"over user specified allocation limit" },
   
   /* free errors */
   { DMALLOC_ERROR_NOT_ON_BLOCK,		"pointer is not on block boundary" },
   { DMALLOC_ERROR_ALREADY_FREE,		"tried to free previously freed pointer" },
+  { DMALLOC_ERROR_BAD_FREE_SIZE,	"size passed to free does not match allocation" },
   { DMALLOC_ERROR_FREE_OVERWRITTEN,	"free space has been overwritten" },
   
   /* administrative errors */
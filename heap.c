@@ -24,6 +24,9 @@
  * heap as well as reporting the current position of the heap.
  */
 
+#if HAVE_STRING_H
+# include <string.h>				/* for memset */
+#endif
 #if HAVE_UNISTD_H
 # include <unistd.h>				/* for write */
 #endif
@@ -33,6 +36,14 @@
 #if HAVE_SYS_MMAN_H
 #  include <sys/mman.h>				/* for mmap stuff */
 #endif
+#if defined(__linux__)
+#  include <fcntl.h>				/* for O_RDONLY, etc. */
+#  include <sys/ioctl.h>			/* for ioctl */
+#  include <sys/syscall.h>			/* for __NR_userfaultfd */
+#  ifdef __NR_userfaultfd
+#    include <linux/userfaultfd.h>		/* for UFFDIO_REGISTER */
+#  endif
+#endif
 
 #define DMALLOC_DISABLE
 
@@ -50,12 +61,148 @@
 
 #define SBRK_ERROR	((char *)-1)		/* sbrk error code */
 
+/* alignment of the reserved heap region */
+#if HEAP_HUGE_PAGES
+#define RESERVE_ALIGN	HUGE_PAGE_SIZE
+#else
+#define RESERVE_ALIGN	BLOCK_SIZE
+#endif
+
 /* exported variables */
 void		*_dmalloc_heap_low = NULL;	/* base of our heap */
 void		*_dmalloc_heap_high = NULL;	/* end of our heap */
 
+#if HEAP_RESERVED_REGION
+/* reserved region of address space which we commit in batches */
+static	char		*reserve_start = NULL;	/* start of reserved region */
+static	char		*reserve_bounds = NULL;	/* end of reserved region */
+static	char		*reserve_committed = NULL; /* end of committed space */
+static	char		*reserve_next = NULL;	/* next space to hand out */
+static	unsigned long	commit_block_n = HEAP_COMMIT_MIN; /* next batch */
+#endif
+
+#if HEAP_SHADOW_MAP
+/* byte per SHADOW_SCALE bytes of the reserved region or NULL if none */
+static	unsigned char	*shadow_map = NULL;
+#endif
+
+#if HEAP_SOFT_DIRTY
+/* soft-dirty bit in the /proc/self/pagemap entries */
+#define PAGEMAP_SOFT_DIRTY	((unsigned long long)1 << 55)
+/* number of pagemap entries that we read at once */
+#define PAGEMAP_ENTRIES		512
+
+/*
+ * Linux 6.7 and later can track the written pages of a range with
+ * asynchronous userfaultfd write-protection and then read and
+ * protect them again in one PAGEMAP_SCAN ioctl.  The kernel headers
+ * may be older than the kernel so we carry the parts that we need.
+ */
+#if defined(__NR_userfaultfd) && defined(UFFDIO_REGISTER_MODE_WP)
+#define DIRTY_SCAN		1
+#else
+#define DIRTY_SCAN		0
+#endif
+
+#if DIRTY_SCAN
+#define SCAN_FEATURE_WP_UNPOPULATED	((unsigned long long)1 << 13)
+#define SCAN_FEATURE_WP_ASYNC		((unsigned long long)1 << 15)
+#define SCAN_PAGE_IS_WRITTEN		((unsigned long long)1 << 1)
+#define SCAN_WP_MATCHING		((unsigned long long)1 << 0)
+#define SCAN_CHECK_WPASYNC		((unsigned long long)1 << 1)
+/* number of written page ranges that we read at once */
+#define SCAN_REGIONS			256
+
+/* struct page_region from linux/fs.h */
+typedef struct {
+  unsigned long long	sr_start;		/* start of written pages */
+  unsigned long long	sr_end;			/* end of written pages */
+  unsigned long long	sr_categories;		/* PAGE_IS_ flags */
+} scan_region_t;
+
+/* struct pm_scan_arg from linux/fs.h */
+typedef struct {
+  unsigned long long	sa_size;		/* size of this struct */
+  unsigned long long	sa_flags;		/* PM_SCAN_ flags */
+  unsigned long long	sa_start;		/* start of the range */
+  unsigned long long	sa_end;			/* end of the range */
+  unsigned long long	sa_walk_end;		/* where the scan stopped */
+  unsigned long long	sa_vec;			/* scan_region_t array */
+  unsigned long long	sa_vec_len;		/* entries in the array */
+  unsigned long long	sa_max_pages;		/* 0 for no limit */
+  unsigned long long	sa_category_inverted;
+  unsigned long long	sa_category_mask;
+  unsigned long long	sa_category_anyof_mask;
+  unsigned long long	sa_return_mask;
+} scan_arg_t;
+
+#define SCAN_PAGEMAP		_IOWR('f', 16, scan_arg_t)
+#endif /* if DIRTY_SCAN */
+
+/* how we find the pages that were written since the last check */
+#define DIRTY_MODE_NONE		0	/* check the whole heap */
+#define DIRTY_MODE_SCAN		1	/* write-protect and PAGEMAP_SCAN */
+#define DIRTY_MODE_CLEAR_REFS	2	/* soft-dirty and clear_refs */
+
+static	int		dirty_probed_b = 0;	/* tested kernel support */
+static	int		dirty_mode = DIRTY_MODE_NONE; /* DIRTY_MODE_ */
+static	int		dirty_armed_b = 0;	/* last check went through */
+static	unsigned long	dirty_loaded_c = 0;	/* soft-dirty checks in a row */
+static	unsigned char	*dirty_map = NULL;	/* bit per dirty heap block */
+static	unsigned long	dirty_map_size = 0;	/* bytes in the dirty map */
+static	char		*dirty_low = NULL;	/* start of mapped range */
+static	char		*dirty_high = NULL;	/* end of mapped range */
+#if DIRTY_SCAN
+static	int		scan_uffd = -1;		/* write-protect tracking */
+static	char		*scan_low = NULL;	/* start of registered range */
+static	char		*scan_high = NULL;	/* end of registered range */
+#endif
+#endif
+
+#if HEAP_HUGE_PAGES
+/* dedicated region which we pack the admin entry blocks into */
+static	char		*admin_next = NULL;	/* next admin block */
+static	char		*admin_bounds = NULL;	/* end of admin region */
+#endif
+
 /****************************** local functions ******************************/
 
+#if HEAP_HUGE_PAGES
+/*
+ * static void advise_huge
+ *
+ * Ask the system to back the huge-page aligned part of a region with
+ * huge pages.  This is only a hint so failures are ignored and the
+ * region is simply backed with normal pages.
+ *
+ * ARGUMENTS:
+ *
+ * mem -> Start of the region.
+ *
+ * size -> Size of the region.
+ */
+static	void	advise_huge(void *mem, const unsigned long size)
+{
+#ifdef MADV_HUGEPAGE
+  char	*start_p, *end_p;
+  
+  start_p = (char *)mem + (HUGE_PAGE_SIZE -
+			   (PNT_ARITH_TYPE)mem % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+  end_p = (char *)mem + size;
+  end_p -= (PNT_ARITH_TYPE)end_p % HUGE_PAGE_SIZE;
+  if (start_p >= end_p) {
+    return;
+  }
+  
+  if (madvise(start_p, end_p - start_p, MADV_HUGEPAGE) != 0
+      && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("huge pages not available for %p, size %lu",
+		    start_p, (unsigned long)(end_p - start_p));
+  }
+#endif
+}
+#endif /* if HEAP_HUGE_PAGES */
+
 /*
  * static void *heap_extend
  *
@@ -65,7 +212,7 @@ void		*_dmalloc_heap_high = NULL;	/* end of our heap */
  *
  * incr -> Number of bytes we need.
  */
-static	void	*heap_extend(const int incr)
+static	void	*heap_extend(const unsigned long incr)
 {
   void	*ret = SBRK_ERROR;
   char	*high;
@@ -107,7 +254,7 @@ static	void	*heap_extend(const int incr)
       char	str[128];
       int	len;
       len = loc_snprintf(str, sizeof(str),
-			 "\r\ndmalloc: critical error: could not extend heap %u more bytes\r\n", incr);
+			 "\r\ndmalloc: critical error: could not extend heap %lu more bytes\r\n", incr);
       (void)write(STDERR, str, len);
       _dmalloc_die(0);
     }
@@ -115,6 +262,12 @@ static	void	*heap_extend(const int incr)
     dmalloc_error("heap_extend");
   }
   
+#if HEAP_HUGE_PAGES
+  if (ret != SBRK_ERROR) {
+    advise_huge(ret, incr);
+  }
+#endif
+  
   if (_dmalloc_heap_low == NULL || (char *)ret < (char *)_dmalloc_heap_low) {
     _dmalloc_heap_low = ret;
   }
@@ -124,7 +277,7 @@ static	void	*heap_extend(const int incr)
   }
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
-    dmalloc_message("extended heap space by %d bytes returned %p [%p, %p]",
+    dmalloc_message("extended heap space by %lu bytes returned %p [%p, %p]",
 		    incr, ret, _dmalloc_heap_low, _dmalloc_heap_high);
   }
   
@@ -141,7 +294,7 @@ static	void	*heap_extend(const int incr)
  * addr -> Previously used memory.
  * size -> Size of memory.
  */
-static	void	heap_release(void *addr, const int size)
+static	void	heap_release(void *addr, const unsigned long size)
 {
 #if INTERNAL_MEMORY_SPACE
   /* no-op */
@@ -149,10 +302,10 @@ static	void	heap_release(void *addr, const int size)
 #if HAVE_MUNMAP && USE_MMAP
   if (munmap(addr, size) == 0) {
     if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
-      dmalloc_message("releasing heap memory %p, size %d", addr, size);
+      dmalloc_message("releasing heap memory %p, size %lu", addr, size);
     }
   } else {
-    dmalloc_message("munmap failed to release heap memory %p, size %d",
+    dmalloc_message("munmap failed to release heap memory %p, size %lu",
 		    addr, size);
   }
 #else
@@ -161,6 +314,185 @@ static	void	heap_release(void *addr, const int size)
 #endif /* if not INTERNAL_MEMORY_SPACE */
 }
 
+#if HEAP_LARGE_OBJECTS || HEAP_RESERVED_REGION || HEAP_SOFT_DIRTY
+/*
+ * static void *map_aligned
+ *
+ * Map an aligned region directly from the system.
+ *
+ * Returns a valid pointer on success or MAP_FAILED on failure.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes to map.  Should be a multiple of BLOCK_SIZE.
+ *
+ * align -> Alignment of the region.  Should be a multiple of
+ * BLOCK_SIZE.
+ *
+ * prot -> Memory protection of the region.
+ *
+ * flags -> Any mmap flags in addition to MAP_PRIVATE and MAP_ANON.
+ */
+static	void	*map_aligned(const unsigned long size,
+			     const unsigned long align, const int prot,
+			     const int flags)
+{
+  void		*mem;
+  char		*aligned_p;
+  unsigned long	lead_size;
+  
+  mem = mmap(0L, size, prot, MAP_PRIVATE | MAP_ANON | flags,
+	     -1 /* no fd */, 0 /* no offset */);
+  if (mem != MAP_FAILED && (PNT_ARITH_TYPE)mem % align != 0) {
+    /*
+     * The system page is smaller than our alignment so map an extra
+     * alignment's worth and trim the slop from both ends.
+     */
+    heap_release(mem, size);
+    mem = mmap(0L, size + align, prot, MAP_PRIVATE | MAP_ANON | flags,
+	       -1 /* no fd */, 0 /* no offset */);
+    if (mem != MAP_FAILED) {
+      aligned_p = (char *)mem + align - (PNT_ARITH_TYPE)mem % align;
+      lead_size = aligned_p - (char *)mem;
+      heap_release(mem, lead_size);
+      heap_release(aligned_p + size, align - lead_size);
+      mem = aligned_p;
+    }
+  }
+  
+  return mem;
+}
+#endif /* if HEAP_LARGE_OBJECTS || HEAP_RESERVED_REGION || HEAP_SOFT_DIRTY */
+
+#if HEAP_SHADOW_MAP
+/*
+ * static int commit_shadow
+ *
+ * Commit the pages of the shadow map for a new piece of the reserved
+ * region and the byte past its end.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Start of the new piece of the region.
+ *
+ * size -> Size of the new piece.
+ */
+static	int	commit_shadow(const char *addr, const unsigned long size)
+{
+  unsigned char	*start_p, *end_p;
+  
+  start_p = shadow_map + (addr - reserve_start) / SHADOW_SCALE;
+  end_p = shadow_map + (addr + size - reserve_start) / SHADOW_SCALE + 1;
+  start_p -= (PNT_ARITH_TYPE)start_p % BLOCK_SIZE;
+  end_p += (BLOCK_SIZE - (PNT_ARITH_TYPE)end_p % BLOCK_SIZE) % BLOCK_SIZE;
+  
+  if (mprotect(start_p, end_p - start_p, PROT_READ | PROT_WRITE) != 0) {
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+      dmalloc_message("could not commit shadow map at %p, disabling it",
+		      start_p);
+    }
+    return 0;
+  }
+  
+  return 1;
+}
+#endif /* if HEAP_SHADOW_MAP */
+
+#if HEAP_RESERVED_REGION
+/*
+ * static void *reserve_alloc
+ *
+ * Hand out the next aligned piece of the reserved region, committing
+ * more of it if necessary.  Each commit is twice as large as the one
+ * before it up to HEAP_COMMIT_MAX blocks so a growing heap needs few
+ * system calls.
+ *
+ * Returns a valid pointer on success or SBRK_ERROR if the reserved
+ * region could not satisfy the request.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes we need.
+ *
+ * align -> Alignment of the piece.  Should be a multiple of
+ * BLOCK_SIZE.  Any space skipped to align the piece is never used.
+ */
+static	void	*reserve_alloc(const unsigned long size,
+			       const unsigned long align)
+{
+  unsigned long	need_size, commit_size;
+  char		*ret;
+  int		prot;
+  
+  ret = reserve_next + (align - (PNT_ARITH_TYPE)reserve_next % align) % align;
+  
+  /* round up so the next piece stays block aligned */
+  need_size = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+  if (need_size < size
+      || ret > reserve_bounds
+      || need_size > (unsigned long)(reserve_bounds - ret)) {
+    return SBRK_ERROR;
+  }
+  
+  if (ret + need_size > reserve_committed) {
+    commit_size = commit_block_n * BLOCK_SIZE;
+    if (commit_size < ret + need_size - reserve_committed) {
+      commit_size = ret + need_size - reserve_committed;
+    }
+#if HEAP_HUGE_PAGES
+    /* end the commit on a huge page so the pages can all be huge */
+    commit_size += (HUGE_PAGE_SIZE -
+		    (PNT_ARITH_TYPE)(reserve_committed + commit_size)
+		    % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+#endif
+    if (commit_size > (unsigned long)(reserve_bounds - reserve_committed)) {
+      commit_size = reserve_bounds - reserve_committed;
+    }
+    
+#if HEAP_SHADOW_MAP
+    /*
+     * Commit the shadow of the new space first since the readers do
+     * not lock.  We go a byte past the end so the scans always have a
+     * 0 to stop on.
+     */
+    if (shadow_map != NULL
+	&& (! commit_shadow(reserve_committed, commit_size))) {
+      shadow_map = NULL;
+    }
+#endif
+    
+    prot = PROT_READ | PROT_WRITE;
+#ifdef PROT_EXEC
+    prot |= PROT_EXEC;
+#endif
+    if (mprotect(reserve_committed, commit_size, prot) != 0) {
+      dmalloc_message("mprotect failed to commit heap memory %p, size %lu",
+		      reserve_committed, commit_size);
+      return SBRK_ERROR;
+    }
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+      dmalloc_message("committed %lu bytes of reserved heap at %p",
+		      commit_size, reserve_committed);
+    }
+    reserve_committed += commit_size;
+    
+    if (commit_block_n < HEAP_COMMIT_MAX) {
+      commit_block_n *= 2;
+    }
+  }
+  
+  reserve_next = ret + need_size;
+  
+  if ((char *)_dmalloc_heap_high < reserve_next) {
+    _dmalloc_heap_high = reserve_next;
+  }
+  
+  return ret;
+}
+#endif /* if HEAP_RESERVED_REGION */
+
 /**************************** exported functions *****************************/
 
 /*
@@ -172,6 +504,58 @@ static	void	heap_release(void *addr, const int size)
  */
 int	_dmalloc_heap_startup(void)
 {
+#if HEAP_RESERVED_REGION
+  void	*mem;
+  int	flags = 0;
+  
+  if (reserve_start != NULL) {
+    return 1;
+  }
+  
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  mem = map_aligned(HEAP_RESERVE_SIZE, RESERVE_ALIGN, PROT_NONE, flags);
+  if (mem == MAP_FAILED) {
+    /* not fatal, we just extend the heap the old way */
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+      dmalloc_message("could not reserve %lu bytes of heap, extending instead",
+		      HEAP_RESERVE_SIZE);
+    }
+    return 1;
+  }
+  
+  reserve_start = mem;
+  reserve_bounds = reserve_start + HEAP_RESERVE_SIZE;
+  reserve_committed = reserve_start;
+  reserve_next = reserve_start;
+  
+#if HEAP_SHADOW_MAP
+  /* the extra block holds the shadow byte past the end of the region */
+  mem = map_aligned(HEAP_RESERVE_SIZE / SHADOW_SCALE + BLOCK_SIZE,
+		    BLOCK_SIZE, PROT_NONE, flags);
+  if (mem != MAP_FAILED) {
+    shadow_map = mem;
+  }
+  else if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("could not reserve the heap shadow map");
+  }
+#endif
+  
+  /* the heap starts out empty at the front of the region */
+  _dmalloc_heap_low = reserve_start;
+  _dmalloc_heap_high = reserve_start;
+  
+#if HEAP_HUGE_PAGES
+  advise_huge(reserve_start, HEAP_RESERVE_SIZE);
+#endif
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("reserved %lu bytes of heap at %p",
+		    HEAP_RESERVE_SIZE, reserve_start);
+  }
+#endif
+  
   return 1;
 }
 
@@ -186,7 +570,7 @@ int	_dmalloc_heap_startup(void)
  *
  * size -> Number of bytes we need.
  */
-void	*_dmalloc_heap_alloc(const unsigned int size)
+void	*_dmalloc_heap_alloc(const unsigned long size)
 {
   void	*heap_new, *heap_diff;
   long	diff_size;
@@ -197,6 +581,16 @@ void	*_dmalloc_heap_alloc(const unsigned int size)
     return HEAP_ALLOC_ERROR;
   }
   
+#if HEAP_RESERVED_REGION
+  /* use our reserved region until it is used up */
+  if (reserve_start != NULL) {
+    heap_new = reserve_alloc(size, BLOCK_SIZE);
+    if (heap_new != SBRK_ERROR) {
+      return heap_new;
+    }
+  }
+#endif
+  
   /* extend the heap by our size */
   heap_new = heap_extend(size);
   if (heap_new == SBRK_ERROR) {
@@ -237,19 +631,683 @@ void	*_dmalloc_heap_alloc(const unsigned int size)
   heap_release(heap_new, size);
   heap_release(heap_diff, diff_size);
   
-  int new_size = size + BLOCK_SIZE;
+  unsigned long new_size = size + BLOCK_SIZE;
   heap_new = heap_extend(new_size);
   if (heap_new == SBRK_ERROR) {
     return HEAP_ALLOC_ERROR;
   }
   
-  dmalloc_message("WARNING: had to extend heap by %d more bytes to get page aligned %p",
+  dmalloc_message("WARNING: had to extend heap by %lu more bytes to get page aligned %p",
 		  new_size, heap_new);
   
   diff_size = (PNT_ARITH_TYPE)heap_new % BLOCK_SIZE;
   if (diff_size == 0) {
     return heap_new;
   } else {
-    return heap_new + diff_size;
+    return (char *)heap_new + BLOCK_SIZE - diff_size;
   }
 }
+
+/*
+ * void *_dmalloc_heap_admin_alloc
+ *
+ * Function to get a block for the admin entry structures.  With huge
+ * pages, the blocks are packed into dedicated regions so the admin
+ * structures share as few pages as possible with the user memory.
+ *
+ * Returns a valid pointer to BLOCK_SIZE bytes on success or NULL on
+ * failure.
+ */
+void	*_dmalloc_heap_admin_alloc(void)
+{
+#if HEAP_HUGE_PAGES
+  char	*mem = SBRK_ERROR;
+  
+  if (admin_next >= admin_bounds) {
+#if HEAP_RESERVED_REGION
+    if (reserve_start != NULL) {
+      mem = reserve_alloc(HEAP_ADMIN_REGION_SIZE, HUGE_PAGE_SIZE);
+    }
+#endif
+    if (mem == SBRK_ERROR) {
+      mem = _dmalloc_heap_alloc(HEAP_ADMIN_REGION_SIZE);
+      if (mem == HEAP_ALLOC_ERROR) {
+	/* error code set in _dmalloc_heap_alloc */
+	return HEAP_ALLOC_ERROR;
+      }
+    }
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+      dmalloc_message("new admin region of %lu bytes at %p",
+		      HEAP_ADMIN_REGION_SIZE, mem);
+    }
+    admin_next = mem;
+    admin_bounds = mem + HEAP_ADMIN_REGION_SIZE;
+  }
+  
+  mem = admin_next;
+  admin_next += BLOCK_SIZE;
+  return mem;
+#else
+  return _dmalloc_heap_alloc(BLOCK_SIZE);
+#endif
+}
+
+/*
+ * int _dmalloc_heap_purge
+ *
+ * Give the pages of a region of free heap memory back to the system.
+ * The address space stays in the heap and reads back as zeros.
+ *
+ * Returns 1 on success or 0 if not supported or on failure.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Start of the region.  Should be block aligned.
+ *
+ * size -> Size of the region.  Should be a multiple of BLOCK_SIZE.
+ */
+int	_dmalloc_heap_purge(void *addr, const unsigned long size)
+{
+  /*
+   * NOTE: only linux promises that private pages read back as zeros
+   * after MADV_DONTNEED.  MADV_FREE may leave the old contents which
+   * would make the purged blocks impossible to check.
+   */
+#if HAVE_MMAP && INTERNAL_MEMORY_SPACE == 0 && defined(MADV_DONTNEED) \
+  && defined(__linux__)
+  if (madvise(addr, size, MADV_DONTNEED) != 0) {
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+      dmalloc_message("could not purge %lu bytes at %p", size, addr);
+    }
+    return 0;
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * unsigned char *_dmalloc_heap_shadow
+ *
+ * Find the shadow byte of a heap address.  The shadow byte after the
+ * end of the committed heap can always be read and is always 0.
+ *
+ * Returns a pointer to the shadow byte or NULL if there is no shadow
+ * map or the address is not in the committed reserved region.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Heap address that we are looking up.
+ */
+unsigned char	*_dmalloc_heap_shadow(const void *addr)
+{
+#if HEAP_SHADOW_MAP
+  unsigned char	*map_p = shadow_map;
+  
+  if (map_p == NULL
+      || (char *)addr < reserve_start
+      || (char *)addr >= reserve_committed) {
+    return NULL;
+  }
+  return map_p + ((char *)addr - reserve_start) / SHADOW_SCALE;
+#else
+  return NULL;
+#endif
+}
+
+#if HEAP_SOFT_DIRTY
+
+/*
+ * static void mark_dirty
+ *
+ * Set the bits in the dirty map of the heap blocks of a range of
+ * written pages.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the written pages.
+ *
+ * end -> End of the written pages.
+ */
+static	void	mark_dirty(PNT_ARITH_TYPE start, PNT_ARITH_TYPE end)
+{
+  unsigned long	block_c, block_n;
+  
+  if (start < (PNT_ARITH_TYPE)dirty_low) {
+    start = (PNT_ARITH_TYPE)dirty_low;
+  }
+  if (end > (PNT_ARITH_TYPE)dirty_high) {
+    end = (PNT_ARITH_TYPE)dirty_high;
+  }
+  if (start >= end) {
+    return;
+  }
+  
+  block_c = (start - (PNT_ARITH_TYPE)dirty_low) / BLOCK_SIZE;
+  block_n = (end - 1 - (PNT_ARITH_TYPE)dirty_low) / BLOCK_SIZE;
+  for (; block_c <= block_n; block_c++) {
+    dirty_map[block_c / 8] |= 1 << (block_c % 8);
+  }
+}
+
+#if DIRTY_SCAN
+
+/*
+ * static void scan_close
+ *
+ * Stop tracking the written pages with write-protection.
+ */
+static	void	scan_close(void)
+{
+  /* closing the descriptor unregisters the heap */
+  if (scan_uffd >= 0) {
+    (void)close(scan_uffd);
+    scan_uffd = -1;
+  }
+  scan_low = NULL;
+  scan_high = NULL;
+}
+
+/*
+ * static int scan_open
+ *
+ * Open a userfaultfd with the asynchronous write-protection that
+ * PAGEMAP_SCAN uses to track the written pages.
+ *
+ * Returns 1 if the kernel supports it else 0.
+ */
+static	int	scan_open(void)
+{
+  struct uffdio_api	api;
+  
+#ifdef UFFD_USER_MODE_ONLY
+  scan_uffd = syscall(__NR_userfaultfd,
+		      O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+#else
+  scan_uffd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+#endif
+  if (scan_uffd < 0) {
+    scan_uffd = -1;
+    return 0;
+  }
+  
+  /* kernels without PAGEMAP_SCAN do not know the async feature */
+  memset(&api, 0, sizeof(api));
+  api.api = UFFD_API;
+  api.features = SCAN_FEATURE_WP_ASYNC | SCAN_FEATURE_WP_UNPOPULATED;
+  if (ioctl(scan_uffd, UFFDIO_API, &api) != 0) {
+    scan_close();
+    return 0;
+  }
+  
+  return 1;
+}
+
+/*
+ * static int scan_register
+ *
+ * Register a range of the heap for the write-protection tracking.
+ * Pages which were already there show up as written in the next scan
+ * so nothing written before now is missed.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * low -> Start of the range.  Should be block aligned.
+ *
+ * high -> End of the range.  Should be block aligned.
+ */
+static	int	scan_register(char *low, char *high)
+{
+  struct uffdio_register	reg;
+  
+  /* registering the part that we already have again is fine */
+  memset(&reg, 0, sizeof(reg));
+  reg.range.start = (PNT_ARITH_TYPE)low;
+  reg.range.len = high - low;
+  reg.mode = UFFDIO_REGISTER_MODE_WP;
+  if (ioctl(scan_uffd, UFFDIO_REGISTER, &reg) != 0) {
+    return 0;
+  }
+  
+  scan_low = low;
+  scan_high = high;
+  return 1;
+}
+
+/*
+ * static int scan_written
+ *
+ * Find the pages of the registered range which were written since
+ * the last scan and write-protect them again in the same ioctl so
+ * that no write in between is lost.  Sets a bit in the dirty map for
+ * each block that has a written page.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	scan_written(void)
+{
+  scan_region_t		regions[SCAN_REGIONS];
+  scan_arg_t		arg;
+  unsigned long long	start;
+  int			fd, ret, region_c;
+  
+  fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  
+  /* the scan stops early when the regions are full */
+  for (start = (PNT_ARITH_TYPE)scan_low;
+       start < (PNT_ARITH_TYPE)scan_high;
+       start = arg.sa_walk_end) {
+    memset(&arg, 0, sizeof(arg));
+    arg.sa_size = sizeof(arg);
+    arg.sa_flags = SCAN_WP_MATCHING | SCAN_CHECK_WPASYNC;
+    arg.sa_start = start;
+    arg.sa_end = (PNT_ARITH_TYPE)scan_high;
+    arg.sa_vec = (PNT_ARITH_TYPE)regions;
+    arg.sa_vec_len = SCAN_REGIONS;
+    arg.sa_category_mask = SCAN_PAGE_IS_WRITTEN;
+    arg.sa_return_mask = SCAN_PAGE_IS_WRITTEN;
+    ret = ioctl(fd, SCAN_PAGEMAP, &arg);
+    if (ret < 0 || arg.sa_walk_end <= start) {
+      (void)close(fd);
+      return 0;
+    }
+    for (region_c = 0; region_c < ret; region_c++) {
+      mark_dirty((PNT_ARITH_TYPE)regions[region_c].sr_start,
+		 (PNT_ARITH_TYPE)regions[region_c].sr_end);
+    }
+  }
+  
+  (void)close(fd);
+  return 1;
+}
+
+#endif /* if DIRTY_SCAN */
+
+/*
+ * static int clear_soft_dirty
+ *
+ * Clear the soft-dirty bits of all of the pages of the process.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	clear_soft_dirty(void)
+{
+  int	fd, ret;
+  
+  fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  ret = write(fd, "4", 1);
+  (void)close(fd);
+  
+  return (ret == 1);
+}
+
+/*
+ * static int read_soft_dirty
+ *
+ * Read the soft-dirty bits of a range of pages from /proc/self/pagemap
+ * and set a bit in the dirty map for each block that has a dirty page.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * low -> Start of the range.  Should be block aligned.
+ *
+ * high -> End of the range.
+ */
+static	int	read_soft_dirty(const char *low, const char *high)
+{
+  unsigned long long	entries[PAGEMAP_ENTRIES];
+  unsigned long		page_size, page_n, entry_n, entry_c;
+  PNT_ARITH_TYPE	page, addr;
+  int			fd, ret;
+  
+  page_size = getpagesize();
+  fd = open("/proc/self/pagemap", O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  
+  page = (PNT_ARITH_TYPE)low / page_size;
+  page_n = ((PNT_ARITH_TYPE)high + page_size - 1) / page_size;
+  for (; page < page_n; page += entry_n) {
+    entry_n = page_n - page;
+    if (entry_n > PAGEMAP_ENTRIES) {
+      entry_n = PAGEMAP_ENTRIES;
+    }
+    ret = pread(fd, entries, entry_n * sizeof(entries[0]),
+		(off_t)page * sizeof(entries[0]));
+    if (ret != (int)(entry_n * sizeof(entries[0]))) {
+      (void)close(fd);
+      return 0;
+    }
+    for (entry_c = 0; entry_c < entry_n; entry_c++) {
+      if (entries[entry_c] & PAGEMAP_SOFT_DIRTY) {
+	addr = (page + entry_c) * page_size;
+	mark_dirty(addr, addr + page_size);
+      }
+    }
+  }
+  
+  (void)close(fd);
+  return 1;
+}
+
+/*
+ * static int probe_soft_dirty
+ *
+ * See if the kernel tracks the soft-dirty bits by clearing them and
+ * then writing into one of our own pages.
+ *
+ * Returns 1 if supported else 0.
+ */
+static	int	probe_soft_dirty(void)
+{
+  if (! clear_soft_dirty()) {
+    return 0;
+  }
+  
+  /* clearing the first block of the dirty map writes to our test page */
+  memset(dirty_map, 0, BLOCK_SIZE);
+  dirty_low = (char *)dirty_map;
+  dirty_high = (char *)dirty_map + BLOCK_SIZE;
+  if (! read_soft_dirty(dirty_low, dirty_high)) {
+    return 0;
+  }
+  
+  /* dirty_map[0] bit 0 is set if our page was seen as written */
+  return (dirty_map[0] & 1);
+}
+
+/*
+ * static int probe_dirty
+ *
+ * Pick the best way that the kernel gives us to find the written
+ * pages.  The write-protection scan is atomic and only touches our
+ * heap.  The soft-dirty bits are cleared for the whole process and
+ * there is a gap between reading and clearing them so we only use
+ * them if SOFT_DIRTY_CLEAR_REFS allows it.
+ *
+ * Returns the DIRTY_MODE_ that we are using.
+ */
+static	int	probe_dirty(void)
+{
+#if DIRTY_SCAN
+  if (scan_open()) {
+    return DIRTY_MODE_SCAN;
+  }
+#endif
+#if SOFT_DIRTY_CLEAR_REFS
+  if (probe_soft_dirty()) {
+    return DIRTY_MODE_CLEAR_REFS;
+  }
+#endif
+  return DIRTY_MODE_NONE;
+}
+
+/*
+ * int _dmalloc_heap_dirty_start
+ *
+ * Start a heap check by loading which heap pages were written since
+ * the last check and then resetting the tracking.  The pages are only
+ * loaded if the last heap check ran all the way through.
+ *
+ * Returns 1 if _dmalloc_heap_is_dirty can be used to skip the clean
+ * pages or 0 if the whole heap needs to be checked.
+ */
+int	_dmalloc_heap_dirty_start(void)
+{
+  unsigned long	heap_size, map_size;
+  void		*mem;
+  int		loaded_b = 0;
+  
+  if (dirty_probed_b && dirty_mode == DIRTY_MODE_NONE) {
+    return 0;
+  }
+  
+  heap_size = (char *)_dmalloc_heap_high - (char *)_dmalloc_heap_low;
+  if (heap_size < SOFT_DIRTY_MIN_SIZE) {
+    dirty_armed_b = 0;
+    return 0;
+  }
+  
+  /* we need a bit for each block in the heap plus one if not aligned */
+  map_size = (heap_size / BLOCK_SIZE + 1 + 7) / 8;
+  map_size = (map_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+  if (map_size > dirty_map_size) {
+    if (dirty_map != NULL) {
+      heap_release(dirty_map, dirty_map_size);
+      dirty_map = NULL;
+      dirty_map_size = 0;
+      dirty_armed_b = 0;
+    }
+    mem = map_aligned(map_size, BLOCK_SIZE, PROT_READ | PROT_WRITE,
+		      0 /* no flags */);
+    if (mem == MAP_FAILED) {
+      return 0;
+    }
+    dirty_map = mem;
+    dirty_map_size = map_size;
+  }
+  
+  if (! dirty_probed_b) {
+    dirty_probed_b = 1;
+    dirty_mode = probe_dirty();
+    if (dirty_mode == DIRTY_MODE_NONE) {
+      if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+	dmalloc_message("written pages not tracked, checking whole heap");
+      }
+      heap_release(dirty_map, dirty_map_size);
+      dirty_map = NULL;
+      dirty_map_size = 0;
+      return 0;
+    }
+  }
+  
+  memset(dirty_map, 0, map_size);
+  dirty_low = _dmalloc_heap_low;
+  dirty_high = _dmalloc_heap_high;
+  
+#if DIRTY_SCAN
+  if (dirty_mode == DIRTY_MODE_SCAN) {
+    /*
+     * The heap only grows and the new pages show up as written so we
+     * stay armed.  If the heap has holes we cannot register it.
+     */
+    if ((scan_low != dirty_low || scan_high != dirty_high)
+	&& (! scan_register(dirty_low, dirty_high))) {
+      scan_close();
+      dirty_mode = DIRTY_MODE_NONE;
+#if SOFT_DIRTY_CLEAR_REFS
+      if (probe_soft_dirty()) {
+	dirty_mode = DIRTY_MODE_CLEAR_REFS;
+      }
+#endif
+      if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+	dmalloc_message("could not write-protect the heap, %s",
+			(dirty_mode == DIRTY_MODE_NONE
+			 ? "checking whole heap" : "using soft-dirty bits"));
+      }
+      dirty_armed_b = 0;
+      return 0;
+    }
+    
+    /* this also protects the pages again so we always do it */
+    loaded_b = scan_written() && dirty_armed_b;
+    dirty_armed_b = 0;
+    return loaded_b;
+  }
+#endif
+  
+  /*
+   * Writes between reading and clearing the soft-dirty bits are not
+   * seen so every SOFT_DIRTY_FULL_CHECK checks we look at everything.
+   */
+  if (dirty_armed_b && dirty_loaded_c < SOFT_DIRTY_FULL_CHECK) {
+    loaded_b = read_soft_dirty(dirty_low, dirty_high);
+  }
+  if (loaded_b) {
+    dirty_loaded_c++;
+  }
+  else {
+    dirty_loaded_c = 0;
+  }
+  dirty_armed_b = 0;
+  
+  /* anything written from here on will be seen by the next check */
+  if (! clear_soft_dirty()) {
+    return 0;
+  }
+  
+  return loaded_b;
+}
+
+/*
+ * void _dmalloc_heap_dirty_done
+ *
+ * Mark that a heap check ran all the way through without finding any
+ * problems so the next check only needs to look at dirty pages.
+ */
+void	_dmalloc_heap_dirty_done(void)
+{
+  if (dirty_map != NULL && dirty_mode != DIRTY_MODE_NONE) {
+    dirty_armed_b = 1;
+  }
+}
+
+/*
+ * int _dmalloc_heap_is_dirty
+ *
+ * Have any of the pages of a region been written since the previous
+ * heap check?
+ *
+ * Returns 1 if the region is dirty or we do not know otherwise 0.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Start of the region.
+ *
+ * size -> Size of the region.
+ */
+int	_dmalloc_heap_is_dirty(const void *addr, const unsigned long size)
+{
+  unsigned long	block_c, block_n;
+  
+  /* we know nothing about memory outside of the loaded range */
+  if ((char *)addr < dirty_low
+      || size > (unsigned long)(dirty_high - (char *)addr)) {
+    return 1;
+  }
+  
+  block_c = ((char *)addr - dirty_low) / BLOCK_SIZE;
+  block_n = ((char *)addr + size - 1 - dirty_low) / BLOCK_SIZE;
+  for (; block_c <= block_n; block_c++) {
+    if (dirty_map[block_c / 8] & (1 << (block_c % 8))) {
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+#endif /* if HEAP_SOFT_DIRTY */
+
+#if HEAP_LARGE_OBJECTS
+
+/*
+ * void *_dmalloc_heap_map
+ *
+ * Map a large-object region directly from the system.  Unlike
+ * _dmalloc_heap_alloc, this does not move the heap bounds because the
+ * region is handed back with _dmalloc_heap_unmap as soon as it is
+ * freed.
+ *
+ * Returns a valid block-aligned pointer on success or
+ * HEAP_ALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes we need.  Should be a multiple of BLOCK_SIZE.
+ */
+void	*_dmalloc_heap_map(const unsigned long size)
+{
+  void		*mem;
+  
+  if (size == 0) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    dmalloc_error("_dmalloc_heap_map");
+    return HEAP_ALLOC_ERROR;
+  }
+  
+  mem = map_aligned(size, BLOCK_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+		    0 /* no flags */);
+  if (mem == MAP_FAILED) {
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CATCH_NULL)) {
+      char	str[128];
+      int	len;
+      len = loc_snprintf(str, sizeof(str),
+			 "\r\ndmalloc: critical error: could not map large object of %lu bytes\r\n", size);
+      (void)write(STDERR, str, len);
+      _dmalloc_die(0);
+    }
+    dmalloc_errno = DMALLOC_ERROR_ALLOC_FAILED;
+    dmalloc_error("_dmalloc_heap_map");
+    return HEAP_ALLOC_ERROR;
+  }
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("mapped large object of %lu bytes at %p", size, mem);
+  }
+  
+  return mem;
+}
+
+/*
+ * void _dmalloc_heap_unmap
+ *
+ * Hand a large-object region from _dmalloc_heap_map back to the
+ * system.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Region returned by _dmalloc_heap_map.
+ *
+ * size -> Size of the region that was mapped.
+ */
+void	_dmalloc_heap_unmap(void *addr, const unsigned long size)
+{
+  heap_release(addr, size);
+}
+
+/*
+ * int _dmalloc_heap_mapped
+ *
+ * See if the page which holds an address is mapped.  The system can
+ * hand the region of a freed large object to someone else.
+ *
+ * Returns 1 if it is mapped or 0 if not.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Address that we are checking.
+ */
+int	_dmalloc_heap_mapped(const void *addr)
+{
+  unsigned long	page_size;
+  
+  /* msync of an aligned page only fails if nothing is mapped there */
+  page_size = getpagesize();
+  return (msync((char *)((PNT_ARITH_TYPE)addr / page_size * page_size),
+		page_size, MS_ASYNC) == 0);
+}
+
+#endif /* if HEAP_LARGE_OBJECTS */
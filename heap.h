@@ -34,6 +34,76 @@
   ((char *)(pnt) >= (char *)_dmalloc_heap_low \
    && (char *)(pnt) < (char *)_dmalloc_heap_high)
 
+/*
+ * Large objects are mapped and unmapped directly so we need real mmap
+ * and munmap support to have a large-object space.
+ */
+#if LARGE_OBJECT_SIZE > 0 && HAVE_MMAP && USE_MMAP && HAVE_MUNMAP \
+  && INTERNAL_MEMORY_SPACE == 0
+#define HEAP_LARGE_OBJECTS	1
+#else
+#define HEAP_LARGE_OBJECTS	0
+#endif
+
+/*
+ * Do we reserve a region of address space for the heap up front and
+ * commit it in batches?
+ */
+#if HEAP_RESERVE_SIZE > 0 && HAVE_MMAP && USE_MMAP && PROTECT_ALLOWED \
+  && INTERNAL_MEMORY_SPACE == 0
+#define HEAP_RESERVED_REGION	1
+#else
+#define HEAP_RESERVED_REGION	0
+#endif
+
+/*
+ * Do we ask for huge pages for the heap and pack the admin blocks into
+ * their own huge-page regions?
+ */
+#if USE_HUGE_PAGES && HUGE_PAGE_SIZE > 0 && HAVE_MMAP \
+  && INTERNAL_MEMORY_SPACE == 0
+#define HEAP_HUGE_PAGES		1
+#else
+#define HEAP_HUGE_PAGES		0
+#endif
+
+/*
+ * Can we track the written pages to only check the pages which have
+ * been written since the last heap check?
+ */
+#if USE_SOFT_DIRTY && HAVE_MMAP && INTERNAL_MEMORY_SPACE == 0 \
+  && defined(__linux__)
+#define HEAP_SOFT_DIRTY		1
+#else
+#define HEAP_SOFT_DIRTY		0
+#endif
+
+/*
+ * Do we keep a shadow map of the user allocations in the reserved
+ * heap region?
+ */
+#if USE_SHADOW_MAP && HEAP_RESERVED_REGION
+#define HEAP_SHADOW_MAP		1
+#else
+#define HEAP_SHADOW_MAP		0
+#endif
+
+/*
+ * Heap bytes covered by each shadow byte.  The shadow byte holds how
+ * many of them from the start are addressable user memory, the
+ * SHADOW_START bit if a user allocation starts there, and the
+ * SHADOW_FENCE bit if the allocation has fence-posts which only the
+ * full check looks at.
+ */
+#define SHADOW_SCALE		8
+#define SHADOW_START		0x80
+#define SHADOW_FENCE		0x40
+
+/* size of the regions that the admin blocks are packed into */
+#if HEAP_HUGE_PAGES
+#define HEAP_ADMIN_REGION_SIZE	HUGE_PAGE_SIZE
+#endif
+
 /*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
 
 extern
@@ -64,7 +134,148 @@ int	_dmalloc_heap_startup(void);
  * size -> Number of bytes we need.
  */
 extern
-void	*_dmalloc_heap_alloc(const unsigned int size);
+void	*_dmalloc_heap_alloc(const unsigned long size);
+
+/*
+ * void *_dmalloc_heap_admin_alloc
+ *
+ * Function to get a block for the admin entry structures.  With huge
+ * pages, the blocks are packed into dedicated regions so the admin
+ * structures share as few pages as possible with the user memory.
+ *
+ * Returns a valid pointer to BLOCK_SIZE bytes on success or NULL on
+ * failure.
+ */
+extern
+void	*_dmalloc_heap_admin_alloc(void);
+
+/*
+ * int _dmalloc_heap_purge
+ *
+ * Give the pages of a region of free heap memory back to the system.
+ * The address space stays in the heap and reads back as zeros.
+ *
+ * Returns 1 on success or 0 if not supported or on failure.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Start of the region.  Should be block aligned.
+ *
+ * size -> Size of the region.  Should be a multiple of BLOCK_SIZE.
+ */
+extern
+int	_dmalloc_heap_purge(void *addr, const unsigned long size);
+
+/*
+ * unsigned char *_dmalloc_heap_shadow
+ *
+ * Find the shadow byte of a heap address.  The shadow byte after the
+ * end of the committed heap can always be read and is always 0.
+ *
+ * Returns a pointer to the shadow byte or NULL if there is no shadow
+ * map or the address is not in the committed reserved region.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Heap address that we are looking up.
+ */
+extern
+unsigned char	*_dmalloc_heap_shadow(const void *addr);
+
+#if HEAP_SOFT_DIRTY
+
+/*
+ * int _dmalloc_heap_dirty_start
+ *
+ * Start a heap check by loading which heap pages were written since
+ * the last check and then resetting the tracking.  The pages are only
+ * loaded if the last heap check ran all the way through.
+ *
+ * Returns 1 if _dmalloc_heap_is_dirty can be used to skip the clean
+ * pages or 0 if the whole heap needs to be checked.
+ */
+extern
+int	_dmalloc_heap_dirty_start(void);
+
+/*
+ * void _dmalloc_heap_dirty_done
+ *
+ * Mark that a heap check ran all the way through without finding any
+ * problems so the next check only needs to look at dirty pages.
+ */
+extern
+void	_dmalloc_heap_dirty_done(void);
+
+/*
+ * int _dmalloc_heap_is_dirty
+ *
+ * Have any of the pages of a region been written since the previous
+ * heap check?
+ *
+ * Returns 1 if the region is dirty or we do not know otherwise 0.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Start of the region.
+ *
+ * size -> Size of the region.
+ */
+extern
+int	_dmalloc_heap_is_dirty(const void *addr, const unsigned long size);
+
+#endif /* if HEAP_SOFT_DIRTY */
+
+#if HEAP_LARGE_OBJECTS
+
+/*
+ * void *_dmalloc_heap_map
+ *
+ * Map a large-object region directly from the system.  Unlike
+ * _dmalloc_heap_alloc, this does not move the heap bounds because the
+ * region is handed back with _dmalloc_heap_unmap as soon as it is
+ * freed.
+ *
+ * Returns a valid block-aligned pointer on success or
+ * HEAP_ALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes we need.  Should be a multiple of BLOCK_SIZE.
+ */
+extern
+void	*_dmalloc_heap_map(const unsigned long size);
+
+/*
+ * void _dmalloc_heap_unmap
+ *
+ * Hand a large-object region from _dmalloc_heap_map back to the
+ * system.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Region returned by _dmalloc_heap_map.
+ *
+ * size -> Size of the region that was mapped.
+ */
+extern
+void	_dmalloc_heap_unmap(void *addr, const unsigned long size);
+
+/*
+ * int _dmalloc_heap_mapped
+ *
+ * See if the page which holds an address is mapped.  The system can
+ * hand the region of a freed large object to someone else.
+ *
+ * Returns 1 if it is mapped or 0 if not.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Address that we are checking.
+ */
+extern
+int	_dmalloc_heap_mapped(const void *addr);
+
+#endif /* if HEAP_LARGE_OBJECTS */
 
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
@@ -0,0 +1,93 @@
+/*
+ * Format of the heap dump files written by dmalloc_dump_heap
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __HEAP_DUMP_H__
+#define __HEAP_DUMP_H__
+
+/*
+ * A dump is written in the byte order and word size of the program so
+ * that it can be mapped and read in place.  It starts with the header
+ * and then has the records, the user bytes if they were asked for,
+ * the sites, the strings, and the heap ranges at the offsets that the
+ * header gives.  Each section starts on a DUMP_ALIGN boundary.
+ */
+#define DUMP_MAGIC		"DMHEAP1"	/* 8 bytes with the null */
+#define DUMP_VERSION		1
+#define DUMP_ALIGN		8
+
+/* dh_flags of the header */
+#define DUMP_HAS_DATA		0x1		/* user bytes are in the dump */
+
+/* dr_flags of the records */
+#define DUMP_REC_USED		0x1		/* allocated by the user */
+#define DUMP_REC_FREE		0x2		/* free memory */
+#define DUMP_REC_LARGE		0x4		/* mapped large object */
+#define DUMP_REC_FENCE		0x8		/* has fence-post areas */
+#define DUMP_REC_PURGED		0x10		/* free pages given back */
+
+/* ds_name of a site which is a return-address or unknown */
+#define DUMP_NO_NAME		((unsigned long)-1)
+
+/* header at the front of a dump */
+typedef struct {
+  char			dh_magic[8];		/* DUMP_MAGIC */
+  unsigned int		dh_version;		/* DUMP_VERSION */
+  unsigned int		dh_long_size;		/* sizeof(unsigned long) */
+  unsigned long		dh_flags;		/* DUMP_HAS_DATA */
+  unsigned long		dh_pid;			/* process that was dumped */
+  unsigned long		dh_iter;		/* library iteration count */
+  unsigned long		dh_rec_n;		/* number of records */
+  unsigned long		dh_rec_off;		/* offset of the records */
+  unsigned long		dh_data_off;		/* offset of the user bytes */
+  unsigned long		dh_site_n;		/* number of sites */
+  unsigned long		dh_site_off;		/* offset of the sites */
+  unsigned long		dh_str_size;		/* bytes of strings */
+  unsigned long		dh_str_off;		/* offset of the strings */
+  unsigned long		dh_range_n;		/* number of heap ranges */
+  unsigned long		dh_range_off;		/* offset of the ranges */
+} dump_header_t;
+
+/* allocation or free block of the heap */
+typedef struct {
+  unsigned long		dr_addr;		/* user or block address */
+  unsigned long		dr_user_size;		/* size the user asked for */
+  unsigned long		dr_total_size;		/* size of the whole block */
+  unsigned long		dr_use_iter;		/* iteration when last used */
+  unsigned long		dr_data;		/* offset of bytes from data */
+  unsigned int		dr_site;		/* index of the site */
+  unsigned int		dr_flags;		/* DUMP_REC_ flags */
+} dump_rec_t;
+
+/* file and line or return-address where allocations were made */
+typedef struct {
+  unsigned long		ds_name;		/* offset of the file-name */
+  unsigned long		ds_ra;			/* return-address or 0 */
+  unsigned int		ds_line;		/* line number */
+  unsigned int		ds_pad;			/* keeps records aligned */
+} dump_site_t;
+
+/* range of addresses that the heap covers */
+typedef struct {
+  unsigned long		dg_low;			/* start of the range */
+  unsigned long		dg_high;		/* end of the range */
+} dump_range_t;
+
+#endif /* ! __HEAP_DUMP_H__ */
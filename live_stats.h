@@ -0,0 +1,105 @@
+/*
+ * Format of the live statistics that the library publishes
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __LIVE_STATS_H__
+#define __LIVE_STATS_H__
+
+/*
+ * With the live-stats token the library maps LIVE_STATS_PATH shared
+ * and rewrites the statistics in it in place.  The dmalloc utility
+ * maps the same file to read them without going near the process.
+ * The writer makes ls_seq odd while it changes the statistics so a
+ * reader copies them until it sees the same even ls_seq before and
+ * after.  The segment is in the byte order and word size of the
+ * program.
+ */
+#define LIVE_MAGIC		"DMLIVE1"	/* 8 bytes with the null */
+#define LIVE_VERSION		1
+#define LIVE_SITE_N		16		/* top sites that are kept */
+#define LIVE_DESC_SIZE		96		/* size of the site names */
+
+/* orders the writes of the segment with the changes of ls_seq */
+#ifdef __GNUC__
+#define LIVE_BARRIER()		__sync_synchronize()
+#else
+#define LIVE_BARRIER()
+#endif
+
+/* ls_flags of the segment */
+#define LIVE_EXITED		0x1		/* the program has shut down */
+
+/* ls_counts of the calls in the order of the library's counters */
+#define LIVE_MALLOC		0
+#define LIVE_CALLOC		1
+#define LIVE_REALLOC		2
+#define LIVE_RECALLOC		3
+#define LIVE_MEMALIGN		4
+#define LIVE_VALLOC		5
+#define LIVE_NEW		6
+#define LIVE_FREE		7
+#define LIVE_DELETE		8
+#define LIVE_COUNT_N		9
+
+/* allocation site with the most memory in use */
+typedef struct {
+  unsigned long		lt_in_use_size;		/* bytes in use */
+  unsigned long		lt_in_use_c;		/* pointers in use */
+  unsigned long		lt_total_size;		/* bytes ever allocated */
+  unsigned long		lt_total_c;		/* pointers ever allocated */
+  char			lt_desc[LIVE_DESC_SIZE]; /* file:line or ra= */
+} live_site_t;
+
+/* the shared segment */
+typedef struct {
+  char			ls_magic[8];		/* LIVE_MAGIC */
+  unsigned int		ls_version;		/* LIVE_VERSION */
+  unsigned int		ls_long_size;		/* sizeof(unsigned long) */
+  unsigned long		ls_size;		/* sizeof(live_stats_t) */
+  unsigned long		ls_pid;			/* process that writes it */
+  volatile unsigned long ls_seq;		/* odd while being written */
+  unsigned long		ls_flags;		/* LIVE_EXITED */
+  unsigned long		ls_update_c;		/* times it was written */
+  unsigned long		ls_time;		/* seconds when written */
+  unsigned long		ls_iter;		/* library iteration count */
+  /* pointers and bytes */
+  unsigned long		ls_cur_size;		/* bytes in use */
+  unsigned long		ls_cur_pnts;		/* pointers in use */
+  unsigned long		ls_max_size;		/* most bytes in use */
+  unsigned long		ls_max_pnts;		/* most pointers in use */
+  unsigned long		ls_max_one;		/* largest allocation */
+  unsigned long		ls_total_size;		/* bytes ever allocated */
+  unsigned long		ls_total_pnts;		/* pointers ever allocated */
+  unsigned long		ls_counts[LIVE_COUNT_N]; /* calls of each function */
+  /* the heap */
+  unsigned long		ls_user_block_c;	/* blocks of user memory */
+  unsigned long		ls_admin_block_c;	/* blocks of admin memory */
+  unsigned long		ls_large_c;		/* large objects */
+  unsigned long		ls_large_size;		/* bytes of large objects */
+  unsigned long		ls_user_space;		/* user bytes with free */
+  unsigned long		ls_admin_space;		/* bytes of admin blocks */
+  unsigned long		ls_total_space;		/* bytes the heap holds */
+  unsigned long		ls_purged_size;		/* free bytes given back */
+  unsigned long		ls_heap_check_c;	/* heap checks */
+  unsigned long		ls_site_n;		/* sites in ls_sites */
+  live_site_t		ls_sites[LIVE_SITE_N];	/* most memory in use */
+} live_stats_t;
+
+#endif /* ! __LIVE_STATS_H__ */
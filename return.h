@@ -103,16 +103,18 @@
 
 /*************************************/
 
-/* for x86-64 machines with GCC */
-/* this doesn't seem to work for: __x86_64__ && __GNUC__ > 1 */
-#if 0
+/* for x86-64 and arm64 machines with GCC */
+/*
+ * The frame-pointer version below does not work when the frame-pointer
+ * is omitted so let the compiler find the return-address:
+ *
+ * asm("movq 8(%%rbp),%%rax ; movq %%rax,%0" : "=g" (file) : : "rax")
+ */
+#if (__x86_64__ || __aarch64__) && __GNUC__ > 1
 
-#define GET_RET_ADDR(file)	asm("movq 8(%%rbp),%%rax ; movq %%rax,%0" : \
-				    "=g" (file) : \
-				    /* no inputs */  : \
-				    "rax")
+#define GET_RET_ADDR(file)	file = (char *)__builtin_return_address(0)
 
-#endif /* __x86_64__ */
+#endif /* __x86_64__ || __aarch64__ */
 
 /*************************************/
 
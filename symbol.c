@@ -0,0 +1,749 @@
+/*
+ * Return-address symbol routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+/*
+ * This file turns the return-addresses of the allocations made
+ * without the dmalloc.h macros into a module, offset, and function
+ * when they are reported.  The executable mappings are found in
+ * /proc/self/maps and the symbol table of each module is read out of
+ * its mapped ELF file the first time one of its addresses is looked
+ * up.  The module offset is what addr2line wants so the logs can
+ * still be resolved to lines offline whatever the load addresses.
+ * NOTE: nothing here allocates memory from the heap since we are
+ * called with the library locked.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#if HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+#include "dmalloc.h"
+
+#include "append.h"
+#include "dmalloc_loc.h"
+#include "symbol.h"
+
+#if SYMBOLIZE
+# include <elf.h>
+# include <link.h>				/* for ElfW */
+
+#if __SIZEOF_POINTER__ == 8
+# define SYMBOL_ELF_CLASS	ELFCLASS64
+#else
+# define SYMBOL_ELF_CLASS	ELFCLASS32
+#endif
+
+/* executable mappings of the modules */
+static	symbol_module_t	*modules = NULL;
+static	int		module_n = 0;
+
+/* return-addresses which have been looked up */
+static	symbol_cache_t	*cache = NULL;
+static	unsigned long	cache_size = 0;
+static	unsigned long	cache_n = 0;
+
+/*
+ * static void *symbol_map
+ *
+ * Map some zeroed memory for the modules, symbols, or cache.
+ *
+ * Returns the memory or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * size -> Number of bytes to map.
+ */
+static	void	*symbol_map(const unsigned long size)
+{
+  void	*mem;
+  
+  mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+	     -1 /* no fd */, 0 /* no offset */);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+  return mem;
+}
+
+/*
+ * static void unload_module
+ *
+ * Release the mapped file and symbols of a module.
+ *
+ * ARGUMENTS:
+ *
+ * module_p -> Module we are unloading.
+ */
+static	void	unload_module(symbol_module_t *module_p)
+{
+  if (module_p->sm_file != NULL) {
+    (void)munmap(module_p->sm_file, module_p->sm_file_size);
+  }
+  if (module_p->sm_syms != NULL) {
+    (void)munmap(module_p->sm_syms, module_p->sm_syms_size);
+  }
+  memset(module_p, 0, sizeof(*module_p));
+}
+
+/*
+ * static void add_module
+ *
+ * Add an executable mapping to the modules unless we know it already.
+ * A module that was unloaded and had its addresses reused is replaced.
+ *
+ * ARGUMENTS:
+ *
+ * low -> Start of the mapping.
+ *
+ * high -> End of the mapping.
+ *
+ * offset -> Offset in the file of the start of the mapping.
+ *
+ * path -> Path of the module.
+ */
+static	void	add_module(char *low, char *high, const unsigned long offset,
+			   const char *path)
+{
+  symbol_module_t	*module_p, *free_p = NULL;
+  
+  for (module_p = modules; module_p < modules + module_n; module_p++) {
+    if (module_p->sm_low == NULL) {
+      if (free_p == NULL) {
+	free_p = module_p;
+      }
+      continue;
+    }
+    if (module_p->sm_high <= low || module_p->sm_low >= high) {
+      continue;
+    }
+    if (module_p->sm_low == low && module_p->sm_high == high
+	&& module_p->sm_offset == offset
+	&& strcmp(module_p->sm_path, path) == 0) {
+      return;
+    }
+    unload_module(module_p);
+    if (free_p == NULL) {
+      free_p = module_p;
+    }
+  }
+  
+  if (free_p == NULL) {
+    if (module_n >= SYMBOL_MODULE_MAX) {
+      return;
+    }
+    free_p = modules + module_n;
+    module_n++;
+  }
+  free_p->sm_low = low;
+  free_p->sm_high = high;
+  free_p->sm_offset = offset;
+  (void)loc_snprintf(free_p->sm_path, sizeof(free_p->sm_path), "%s", path);
+}
+
+/*
+ * static PNT_ARITH_TYPE hex_value
+ *
+ * Read a hexadecimal number from a string.
+ *
+ * Returns the value.
+ *
+ * ARGUMENTS:
+ *
+ * str_p <-> Pointer to the string which is left after the digits.
+ */
+static	PNT_ARITH_TYPE	hex_value(char **str_p)
+{
+  PNT_ARITH_TYPE	val = 0;
+  char			*str = *str_p;
+  
+  for (;; str++) {
+    if (*str >= '0' && *str <= '9') {
+      val = val * 16 + (*str - '0');
+    }
+    else if (*str >= 'a' && *str <= 'f') {
+      val = val * 16 + (*str - 'a' + 10);
+    }
+    else {
+      break;
+    }
+  }
+  
+  *str_p = str;
+  return val;
+}
+
+/*
+ * static void maps_line
+ *
+ * Add the mapping of a line of /proc/self/maps to the modules if it
+ * is executable and comes from a file.
+ *
+ * ARGUMENTS:
+ *
+ * line -> Line from the maps file.
+ */
+static	void	maps_line(char *line)
+{
+  char			*line_p = line, *low, *high, *path;
+  PNT_ARITH_TYPE	offset;
+  int			len, field_c;
+  
+  /* low-high perms offset dev inode path */
+  low = (char *)hex_value(&line_p);
+  if (*line_p != '-') {
+    return;
+  }
+  line_p++;
+  high = (char *)hex_value(&line_p);
+  if (*line_p != ' ' || strlen(line_p) < 6 || line_p[3] != 'x') {
+    return;
+  }
+  line_p += 6;
+  offset = hex_value(&line_p);
+  
+  /* skip the device and inode to the path */
+  for (field_c = 0; field_c < 2; field_c++) {
+    while (*line_p == ' ') {
+      line_p++;
+    }
+    while (*line_p != ' ' && *line_p != '\0') {
+      line_p++;
+    }
+  }
+  while (*line_p == ' ') {
+    line_p++;
+  }
+  path = line_p;
+  len = strlen(path);
+  if (*path != '/' || len >= SYMBOL_PATH_SIZE
+      || (len > 10 && strcmp(path + len - 10, " (deleted)") == 0)) {
+    return;
+  }
+  
+  add_module(low, high, offset, path);
+}
+
+/*
+ * static int read_modules
+ *
+ * Find the executable mappings of the modules in /proc/self/maps.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	read_modules(void)
+{
+  char		buf[4096], *line_p, *end_p;
+  int		fd, len = 0, ret;
+  
+  if (modules == NULL) {
+    modules = symbol_map(SYMBOL_MODULE_MAX * sizeof(symbol_module_t));
+    if (modules == NULL) {
+      return 0;
+    }
+  }
+  
+  fd = open("/proc/self/maps", O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  
+  while (1) {
+    ret = read(fd, buf + len, sizeof(buf) - 1 - len);
+    if (ret <= 0) {
+      break;
+    }
+    len += ret;
+    buf[len] = '\0';
+    
+    for (line_p = buf; (end_p = strchr(line_p, '\n')) != NULL;
+	 line_p = end_p + 1) {
+      *end_p = '\0';
+      maps_line(line_p);
+    }
+    
+    /* save the partial line for the next read unless it is too long */
+    len = buf + len - line_p;
+    if (len >= (int)sizeof(buf) - 1) {
+      len = 0;
+    }
+    memmove(buf, line_p, len);
+  }
+  
+  (void)close(fd);
+  return 1;
+}
+
+/*
+ * static symbol_module_t *find_module
+ *
+ * Find the module that an address is in.
+ *
+ * Returns the module or NULL if none.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Address we are looking for.
+ */
+static	symbol_module_t	*find_module(const char *addr)
+{
+  symbol_module_t	*module_p;
+  
+  for (module_p = modules; module_p < modules + module_n; module_p++) {
+    if (addr >= module_p->sm_low && addr < module_p->sm_high) {
+      return module_p;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * static void sift_down
+ *
+ * Move an entry down the heap of the heap-sort of the symbols.
+ *
+ * ARGUMENTS:
+ *
+ * syms -> Symbols we are sorting.
+ *
+ * root -> Index of the entry we are moving.
+ *
+ * sym_n -> Number of symbols in the heap.
+ */
+static	void	sift_down(symbol_entry_t *syms, unsigned long root,
+			  const unsigned long sym_n)
+{
+  symbol_entry_t	hold;
+  unsigned long		child;
+  
+  for (; (child = root * 2 + 1) < sym_n; root = child) {
+    if (child + 1 < sym_n
+	&& syms[child + 1].se_value > syms[child].se_value) {
+      child++;
+    }
+    if (syms[root].se_value >= syms[child].se_value) {
+      break;
+    }
+    hold = syms[root];
+    syms[root] = syms[child];
+    syms[child] = hold;
+  }
+}
+
+/*
+ * static void sort_symbols
+ *
+ * Sort the symbols of a module by value.  This is a heap-sort since
+ * qsort may allocate memory.
+ *
+ * ARGUMENTS:
+ *
+ * syms -> Symbols we are sorting.
+ *
+ * sym_n -> Number of symbols.
+ */
+static	void	sort_symbols(symbol_entry_t *syms, const unsigned long sym_n)
+{
+  symbol_entry_t	hold;
+  unsigned long		sym_c;
+  
+  if (sym_n < 2) {
+    return;
+  }
+  for (sym_c = sym_n / 2; sym_c > 0; sym_c--) {
+    sift_down(syms, sym_c - 1, sym_n);
+  }
+  for (sym_c = sym_n - 1; sym_c > 0; sym_c--) {
+    hold = syms[0];
+    syms[0] = syms[sym_c];
+    syms[sym_c] = hold;
+    sift_down(syms, 0, sym_c);
+  }
+}
+
+/*
+ * static void find_bias
+ *
+ * Work out the load bias of a module from the loadable segment which
+ * was mapped at the start of its executable mapping.
+ *
+ * ARGUMENTS:
+ *
+ * module_p -> Module whose ELF file has been mapped.
+ */
+static	void	find_bias(symbol_module_t *module_p)
+{
+  const ElfW(Ehdr)	*ehdr_p = module_p->sm_file;
+  const ElfW(Phdr)	*phdr_p;
+  unsigned long		page_mask = getpagesize() - 1;
+  int			ph_c;
+  
+  /* this is right for the usual layouts if we find no segment */
+  module_p->sm_bias = (PNT_ARITH_TYPE)module_p->sm_low - module_p->sm_offset;
+  
+  if (ehdr_p->e_phentsize != sizeof(ElfW(Phdr))
+      || ehdr_p->e_phoff > module_p->sm_file_size
+      || ehdr_p->e_phnum > (module_p->sm_file_size - ehdr_p->e_phoff)
+      / sizeof(ElfW(Phdr))) {
+    return;
+  }
+  
+  phdr_p = (ElfW(Phdr) *)((char *)module_p->sm_file + ehdr_p->e_phoff);
+  for (ph_c = 0; ph_c < ehdr_p->e_phnum; ph_c++, phdr_p++) {
+    if (phdr_p->p_type == PT_LOAD
+	&& (phdr_p->p_offset & ~page_mask) == module_p->sm_offset) {
+      module_p->sm_bias = (PNT_ARITH_TYPE)module_p->sm_low
+	- (phdr_p->p_vaddr & ~page_mask);
+      return;
+    }
+  }
+}
+
+/*
+ * static void load_module
+ *
+ * Map the ELF file of a module and sort the function symbols from its
+ * symbol table or, if it was stripped, its dynamic symbol table.
+ *
+ * ARGUMENTS:
+ *
+ * module_p -> Module we are loading.
+ */
+static	void	load_module(symbol_module_t *module_p)
+{
+  const ElfW(Ehdr)	*ehdr_p;
+  const ElfW(Shdr)	*shdrs, *sym_p = NULL, *str_p;
+  const ElfW(Sym)	*elf_p, *bounds_p;
+  const char		*strs;
+  symbol_entry_t	*syms;
+  struct stat		statbuf;
+  unsigned long		sym_n;
+  int			fd, sh_c, type;
+  void			*file;
+  
+  module_p->sm_loaded_b = 1;
+  
+  fd = open(module_p->sm_path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  if (fstat(fd, &statbuf) != 0 || statbuf.st_size < sizeof(ElfW(Ehdr))) {
+    (void)close(fd);
+    return;
+  }
+  file = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  (void)close(fd);
+  if (file == MAP_FAILED) {
+    return;
+  }
+  module_p->sm_file = file;
+  module_p->sm_file_size = statbuf.st_size;
+  
+  ehdr_p = file;
+  if (memcmp(ehdr_p->e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr_p->e_ident[EI_CLASS] != SYMBOL_ELF_CLASS) {
+    (void)munmap(file, module_p->sm_file_size);
+    module_p->sm_file = NULL;
+    return;
+  }
+  find_bias(module_p);
+  
+  if (ehdr_p->e_shentsize != sizeof(ElfW(Shdr))
+      || ehdr_p->e_shoff > module_p->sm_file_size
+      || ehdr_p->e_shnum > (module_p->sm_file_size - ehdr_p->e_shoff)
+      / sizeof(ElfW(Shdr))) {
+    return;
+  }
+  shdrs = (ElfW(Shdr) *)((char *)file + ehdr_p->e_shoff);
+  
+  /* the full symbol table has the static functions as well */
+  for (sh_c = 0; sh_c < ehdr_p->e_shnum; sh_c++) {
+    if (shdrs[sh_c].sh_type == SHT_SYMTAB) {
+      sym_p = shdrs + sh_c;
+      break;
+    }
+    if (shdrs[sh_c].sh_type == SHT_DYNSYM) {
+      sym_p = shdrs + sh_c;
+    }
+  }
+  if (sym_p == NULL || sym_p->sh_link >= ehdr_p->e_shnum) {
+    return;
+  }
+  str_p = shdrs + sym_p->sh_link;
+  if (sym_p->sh_offset > module_p->sm_file_size
+      || sym_p->sh_size > module_p->sm_file_size - sym_p->sh_offset
+      || str_p->sh_offset > module_p->sm_file_size
+      || str_p->sh_size > module_p->sm_file_size - str_p->sh_offset
+      || str_p->sh_size == 0) {
+    return;
+  }
+  
+  sym_n = sym_p->sh_size / sizeof(ElfW(Sym));
+  if (sym_n == 0) {
+    return;
+  }
+  syms = symbol_map(sym_n * sizeof(symbol_entry_t));
+  if (syms == NULL) {
+    return;
+  }
+  module_p->sm_syms = syms;
+  module_p->sm_syms_size = sym_n * sizeof(symbol_entry_t);
+  
+  strs = (char *)file + str_p->sh_offset;
+  elf_p = (ElfW(Sym) *)((char *)file + sym_p->sh_offset);
+  bounds_p = elf_p + sym_n;
+  sym_n = 0;
+  for (; elf_p < bounds_p; elf_p++) {
+    type = ELF32_ST_TYPE(elf_p->st_info);
+    if ((type != STT_FUNC
+#ifdef STT_GNU_IFUNC
+	 && type != STT_GNU_IFUNC
+#endif
+	 )
+	|| elf_p->st_shndx == SHN_UNDEF || elf_p->st_value == 0
+	|| elf_p->st_name == 0 || elf_p->st_name >= str_p->sh_size) {
+      continue;
+    }
+    /* the string table is null terminated so the names are safe */
+    syms[sym_n].se_value = elf_p->st_value;
+    syms[sym_n].se_size = elf_p->st_size;
+    syms[sym_n].se_name = strs + elf_p->st_name;
+    sym_n++;
+  }
+  if (strs[str_p->sh_size - 1] != '\0') {
+    sym_n = 0;
+  }
+  
+  sort_symbols(syms, sym_n);
+  module_p->sm_sym_n = sym_n;
+}
+
+/*
+ * static const symbol_entry_t *find_symbol
+ *
+ * Find the function that a module address is in.
+ *
+ * Returns the symbol or NULL if none.
+ *
+ * ARGUMENTS:
+ *
+ * module_p -> Module the address is in.
+ *
+ * value -> Address in the module.
+ */
+static	const symbol_entry_t	*find_symbol(const symbol_module_t *module_p,
+					     const unsigned long value)
+{
+  const symbol_entry_t	*sym_p;
+  unsigned long		low = 0, high = module_p->sm_sym_n, mid;
+  
+  /* find the last symbol at or below the value */
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    if (module_p->sm_syms[mid].se_value <= value) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  if (low == 0) {
+    return NULL;
+  }
+  
+  sym_p = module_p->sm_syms + low - 1;
+  if (sym_p->se_size > 0 && value >= sym_p->se_value + sym_p->se_size) {
+    return NULL;
+  }
+  return sym_p;
+}
+
+/*
+ * static symbol_cache_t *cache_find
+ *
+ * Find the cache entry of an address adding an empty one if it is not
+ * there.  The cache is doubled when it gets half full.
+ *
+ * Returns the entry or NULL if the cache could not grow.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Address we are looking for.
+ */
+static	symbol_cache_t	*cache_find(const void *addr)
+{
+  symbol_cache_t	*entry_p, *old_cache, *old_p;
+  unsigned long		hash, old_size;
+  
+  if (cache_n * 2 >= cache_size) {
+    old_cache = cache;
+    old_size = cache_size;
+    if (old_size == 0) {
+      cache_size = SYMBOL_CACHE_START;
+    }
+    else {
+      cache_size = old_size * 2;
+    }
+    cache = symbol_map(cache_size * sizeof(symbol_cache_t));
+    if (cache == NULL) {
+      cache = old_cache;
+      cache_size = old_size;
+      return NULL;
+    }
+    cache_n = 0;
+    for (old_p = old_cache; old_p < old_cache + old_size; old_p++) {
+      if (old_p->sc_addr != NULL) {
+	entry_p = cache_find(old_p->sc_addr);
+	memcpy(entry_p->sc_desc, old_p->sc_desc, sizeof(entry_p->sc_desc));
+      }
+    }
+    if (old_cache != NULL) {
+      (void)munmap(old_cache, old_size * sizeof(symbol_cache_t));
+    }
+  }
+  
+  hash = (PNT_ARITH_TYPE)addr;
+  hash ^= hash >> 17;
+  for (entry_p = cache + (hash & (cache_size - 1));
+       entry_p->sc_addr != NULL;) {
+    if (entry_p->sc_addr == addr) {
+      return entry_p;
+    }
+    entry_p++;
+    if (entry_p == cache + cache_size) {
+      entry_p = cache;
+    }
+  }
+  
+  entry_p->sc_addr = addr;
+  entry_p->sc_desc[0] = '\0';
+  cache_n++;
+  return entry_p;
+}
+
+/*
+ * static void describe
+ *
+ * Write the description of an address into its cache entry.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Cache entry of the address.
+ */
+static	void	describe(symbol_cache_t *entry_p)
+{
+  symbol_module_t	*module_p;
+  const symbol_entry_t	*sym_p;
+  const char		*name;
+  unsigned long		value;
+  
+  /* look again for modules loaded since the last time */
+  module_p = find_module(entry_p->sc_addr);
+  if (module_p == NULL) {
+    if (! read_modules()) {
+      return;
+    }
+    module_p = find_module(entry_p->sc_addr);
+    if (module_p == NULL) {
+      return;
+    }
+  }
+  if (! module_p->sm_loaded_b) {
+    load_module(module_p);
+  }
+  
+  name = strrchr(module_p->sm_path, '/');
+  if (name == NULL) {
+    name = module_p->sm_path;
+  }
+  else {
+    name++;
+  }
+  
+  value = (PNT_ARITH_TYPE)entry_p->sc_addr - module_p->sm_bias;
+  sym_p = find_symbol(module_p, value);
+  if (sym_p == NULL) {
+    (void)loc_snprintf(entry_p->sc_desc, sizeof(entry_p->sc_desc),
+		       "%s+%#lx", name, value);
+  }
+  else {
+    (void)loc_snprintf(entry_p->sc_desc, sizeof(entry_p->sc_desc),
+		       "%s+%#lx %s+%#lx", name, value, sym_p->se_name,
+		       value - sym_p->se_value);
+  }
+}
+
+#endif /* if SYMBOLIZE */
+
+/*
+ * const char *_dmalloc_symbol_desc
+ *
+ * Describe a return-address with the module it is in, its offset in
+ * the module, and the function and offset if the module has symbols.
+ * Each address is looked up once and the description is cached.  This
+ * should only be called when reporting since the first address from a
+ * module maps the module's file and sorts its symbols.
+ *
+ * Returns the description or NULL if the address is not in a module.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Return-address we are describing.
+ */
+const char	*_dmalloc_symbol_desc(const void *addr)
+{
+#if SYMBOLIZE
+  symbol_cache_t	*entry_p;
+  unsigned long		old_n = cache_n;
+  
+  if (addr == NULL) {
+    return NULL;
+  }
+  entry_p = cache_find(addr);
+  if (entry_p == NULL) {
+    return NULL;
+  }
+  if (cache_n != old_n) {
+    describe(entry_p);
+  }
+  
+  if (entry_p->sc_desc[0] == '\0') {
+    return NULL;
+  }
+  return entry_p->sc_desc;
+#else
+  return NULL;
+#endif
+}
@@ -0,0 +1,94 @@
+/*
+ * Defines for the return-address symbol routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://dmalloc.com/
+ */
+
+#ifndef __SYMBOL_H__
+#define __SYMBOL_H__
+
+/* the modules are found in /proc/self/maps and read as ELF files */
+#if SYMBOLIZE_RETURN_ADDRS && defined(__linux__) && HAVE_MMAP
+#define SYMBOLIZE		1
+#else
+#define SYMBOLIZE		0
+#endif
+
+#define SYMBOL_MODULE_MAX	256		/* executable mappings */
+#define SYMBOL_PATH_SIZE	256		/* size of the module paths */
+#define SYMBOL_DESC_SIZE	128		/* size of the descriptions */
+#define SYMBOL_CACHE_START	256		/* first size of address cache */
+
+/*
+ * Function symbol of a module.
+ */
+typedef struct {
+  unsigned long		se_value;		/* address in the module */
+  unsigned long		se_size;		/* size of the function */
+  const char		*se_name;		/* name in the mapped file */
+} symbol_entry_t;
+
+/*
+ * Executable mapping of a module and its symbols which are read in
+ * the first time that they are needed.
+ */
+typedef struct {
+  char			*sm_low;		/* start of the mapping */
+  char			*sm_high;		/* end of the mapping */
+  unsigned long		sm_offset;		/* file offset of the start */
+  unsigned long		sm_bias;		/* load address minus vaddr */
+  int			sm_loaded_b;		/* symbols have been read */
+  void			*sm_file;		/* mapped ELF file */
+  unsigned long		sm_file_size;		/* size of the mapped file */
+  symbol_entry_t	*sm_syms;		/* symbols sorted by value */
+  unsigned long		sm_syms_size;		/* bytes of mapped symbols */
+  unsigned long		sm_sym_n;		/* number of symbols */
+  char			sm_path[SYMBOL_PATH_SIZE]; /* path of the module */
+} symbol_module_t;
+
+/*
+ * Return-address which has been looked up.
+ */
+typedef struct {
+  const void		*sc_addr;		/* address or NULL if empty */
+  char			sc_desc[SYMBOL_DESC_SIZE]; /* description or "" */
+} symbol_cache_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * const char *_dmalloc_symbol_desc
+ *
+ * Describe a return-address with the module it is in, its offset in
+ * the module, and the function and offset if the module has symbols.
+ * Each address is looked up once and the description is cached.  This
+ * should only be called when reporting since the first address from a
+ * module maps the module's file and sorts its symbols.
+ *
+ * Returns the description or NULL if the address is not in a module.
+ *
+ * ARGUMENTS:
+ *
+ * addr -> Return-address we are describing.
+ */
+extern
+const char	*_dmalloc_symbol_desc(const void *addr);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __SYMBOL_H__ */
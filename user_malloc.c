@@ -77,10 +77,31 @@
 #endif
 #endif
 
+/* for the lock profile clock */
+#if LOCK_THREADS && LOCK_PROFILE_TOP_LOG > 0
+#include <time.h>
+#endif
+
 #if SIGNAL_OKAY && HAVE_SIGNAL_H
 #include <signal.h>
 #endif
 
+#if CONTROL_FILE
+#include <fcntl.h>				/* for O_RDONLY */
+#include <sys/stat.h>
+#endif
+
+/*
+ * The pointer readers can only share the lock if we have pthread
+ * read/write locks which we detect with their initializer.
+ */
+#if LOCK_THREADS && LOCK_SHARED_READERS && HAVE_PTHREAD_MUTEX_LOCK \
+	&& defined(PTHREAD_RWLOCK_INITIALIZER) && defined(__GNUC__)
+#define LOCK_SHARED	1
+#else
+#define LOCK_SHARED	0
+#endif
+
 #define DMALLOC_DISABLE
 
 #include "dmalloc.h"
@@ -129,6 +150,24 @@ static	unsigned long	start_iter = 0;		/* start after X iterations */
 static	unsigned long	start_size = 0;		/* start after X bytes */
 static	int		thread_lock_c = 0;	/* lock counter */
 
+#if CONTROL_FILE
+static	char		control_path[512] = "";	/* live options file */
+static	struct stat	control_stat;		/* version of it we have seen */
+static	unsigned long	control_next_iter = 0;	/* next look or 0 for none */
+#if SIGNAL_OKAY && defined(CONTROL_SIGNAL)
+static	volatile sig_atomic_t	control_signal_b = 0; /* look at it now */
+#endif
+#endif
+
+#if LIVE_STATS
+static	unsigned long	live_next_iter = 0;	/* next live stats update */
+#endif
+
+/* this thread's transactions for the allocation budgets */
+static	THREAD_LOCAL unsigned long	thread_alloc_c = 0;
+static	THREAD_LOCAL unsigned long	thread_byte_c = 0;
+static	THREAD_LOCAL unsigned long	thread_free_c = 0;
+
 /****************************** thread locking *******************************/
 
 #if LOCK_THREADS
@@ -148,6 +187,31 @@ static THREAD_MUTEX_T dmalloc_mutex;
 #else
 #error We need to have THREAD_MUTEX_T defined by the configure script
 #endif
+#if LOCK_SHARED
+/*
+ * With shared readers the memory transactions write-lock this instead
+ * of the mutex and the pointer checking routines read-lock it.
+ */
+static pthread_rwlock_t dmalloc_rwlock;
+#endif
+#endif
+
+#if LOCK_PROFILE
+/* the call holding the lock and when it got it */
+static	int		lock_hold_op = DMALLOC_LOCK_OTHER;
+static	const char	*lock_hold_file = NULL;
+static	int		lock_hold_line = 0;
+static	unsigned long	lock_wait_nsec = 0;	/* how long it waited */
+static	unsigned long	lock_start_nsec = 0;	/* when it got the lock */
+#if LOCK_SHARED
+/* each of the shared readers times its own hold of the lock */
+static	THREAD_LOCAL const char		*shared_hold_file = NULL;
+static	THREAD_LOCAL int		shared_hold_line = 0;
+static	THREAD_LOCAL unsigned long	shared_wait_nsec = 0;
+static	THREAD_LOCAL unsigned long	shared_start_nsec = 0;
+/* the shared readers record their holds one at a time */
+static	pthread_mutex_t	shared_record_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 #endif
 
 /*
@@ -185,17 +249,81 @@ static THREAD_MUTEX_T dmalloc_mutex;
  * present an alternative default, please let me know.
  */
 
+#if LOCK_PROFILE
+/*
+ * static unsigned long lock_nsec
+ *
+ * Read the monotonic clock for the lock profile.
+ *
+ * Returns the clock in nanoseconds.
+ */
+static	unsigned long	lock_nsec(void)
+{
+  struct timespec	now;
+  
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+    return 0;
+  }
+  return (unsigned long)now.tv_sec * 1000000000UL
+    + (unsigned long)now.tv_nsec;
+}
+#endif
+
 #if LOCK_THREADS
 /*
  * mutex lock the malloc library
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation that is taking the lock.
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
  */
-static	void	lock_thread(void)
+static	void	lock_thread(const int op, const char *file, const int line)
 {
+#if LOCK_PROFILE
+  unsigned long	wait_start = 0;
+#endif
+  
   /* we only lock if the lock-on counter has reached 0 */
   if (thread_lock_c == 0) {
+#if LOCK_PROFILE
+    /* we only read the clock for the wait if the lock is busy */
+#if LOCK_SHARED
+    if (pthread_rwlock_trywrlock(&dmalloc_rwlock) != 0) {
+      wait_start = lock_nsec();
+      pthread_rwlock_wrlock(&dmalloc_rwlock);
+    }
+#else
+#if HAVE_PTHREAD_MUTEX_LOCK
+    if (pthread_mutex_trylock(&dmalloc_mutex) != 0) {
+      wait_start = lock_nsec();
+      pthread_mutex_lock(&dmalloc_mutex);
+    }
+#endif
+#endif
+    lock_start_nsec = lock_nsec();
+    if (wait_start == 0) {
+      lock_wait_nsec = 0;
+    }
+    else {
+      /* a busy lock always counts as a wait */
+      lock_wait_nsec = MAX(lock_start_nsec - wait_start, 1);
+    }
+    lock_hold_op = op;
+    lock_hold_file = file;
+    lock_hold_line = line;
+#else /* ! LOCK_PROFILE */
+#if LOCK_SHARED
+    pthread_rwlock_wrlock(&dmalloc_rwlock);
+#else
 #if HAVE_PTHREAD_MUTEX_LOCK
     pthread_mutex_lock(&dmalloc_mutex);
 #endif
+#endif
+#endif /* ! LOCK_PROFILE */
   }
 }
 
@@ -226,12 +354,23 @@ static	void	unlock_thread(void)
        * call to pthread_mute_init.
        */
       pthread_mutex_init(&dmalloc_mutex, THREAD_LOCK_INIT_VAL);
+#endif
+#if LOCK_SHARED
+      pthread_rwlock_init(&dmalloc_rwlock, NULL);
 #endif
     }
   }
   else if (thread_lock_c == 0) {
+#if LOCK_PROFILE
+    _dmalloc_chunk_lock_record(lock_hold_op, lock_hold_file, lock_hold_line,
+			       lock_wait_nsec, lock_nsec() - lock_start_nsec);
+#endif
+#if LOCK_SHARED
+    pthread_rwlock_unlock(&dmalloc_rwlock);
+#else
 #if HAVE_PTHREAD_MUTEX_UNLOCK
     pthread_mutex_unlock(&dmalloc_mutex);
+#endif
 #endif
   }
 }
@@ -266,13 +405,27 @@ static	void	check_pnt(const char *file, const int line, const void *pnt,
   }
 }
 
-static	void	process_environ(const char *option_str)
+/*
+ * static void process_environ
+ *
+ * Process the options from the environment or a later setup call.
+ *
+ * ARGUMENTS:
+ *
+ * option_str -> Options string to process.
+ *
+ * startup_b -> Set to 1 if the library is starting up.  Otherwise we
+ * are called with the lock held and leave the lock-on count alone
+ * since changing it would keep the lock held or have threads skip it.
+ */
+static	void	process_environ(const char *option_str, const int startup_b)
 {
   /*
    * we have a static here so we can store the string without getting
    * into problems
    */
   static char	options[1024];
+  int		lock_on = _dmalloc_lock_on;
   
   /* process the options flag */
   if (option_str == NULL) {
@@ -284,17 +437,31 @@ static	void	process_environ(const char *option_str)
   }
   
   char *previous_logpath = dmalloc_logpath;
+  char *policy_str, *classes_str;
   _dmalloc_environ_process(options, &_dmalloc_address,
 			   (unsigned long *)&_dmalloc_address_seen_n, &_dmalloc_flags,
 			   &_dmalloc_check_interval, &_dmalloc_lock_on,
 			   &dmalloc_logpath, &start_file, &start_line,
-			   &start_iter, &start_size, &_dmalloc_memory_limit);
-  thread_lock_c = _dmalloc_lock_on;
+			   &start_iter, &start_size, &_dmalloc_memory_limit,
+			   &policy_str, &classes_str);
+  if (startup_b) {
+    thread_lock_c = _dmalloc_lock_on;
+  }
+  else {
+    if (_dmalloc_lock_on != 0 && _dmalloc_lock_on != lock_on) {
+      dmalloc_message("ignoring lock-on %d which is only read at startup",
+		      _dmalloc_lock_on);
+    }
+    _dmalloc_lock_on = lock_on;
+  }
+  _dmalloc_chunk_policies(policy_str);
+  _dmalloc_chunk_size_classes(classes_str);
   
   /* if we set the start stuff, then check-heap comes on later */
   if (start_iter > 0 || start_size > 0) {
     BIT_CLEAR(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP);
   }
+  _dmalloc_chunk_flags_changed();
   
   /* indicate that we should reopen the logfile if we need to */
   if (previous_logpath == 0L || dmalloc_logpath == 0L
@@ -311,6 +478,108 @@ static	void	process_environ(const char *option_str)
 #endif
 }
 
+#if CONTROL_FILE
+/* polling the control file is off if the interval is 0 */
+#define CONTROL_NEXT_ITER()	\
+	(control_next_iter = (CONTROL_CHECK_INTERVAL > 0 ?		\
+			      _dmalloc_iter_c + CONTROL_CHECK_INTERVAL : 0))
+
+#if SIGNAL_OKAY && defined(CONTROL_SIGNAL)
+/*
+ * Control file signal catcher.  We just note it and look at the file
+ * at the next memory transaction.
+ */
+static	RETSIGTYPE	control_signal_handler(const int sig)
+{
+  control_signal_b = 1;
+}
+#endif
+
+/*
+ * static void control_startup
+ *
+ * Get the control file from the environment, remember the version of
+ * it that is there now, and set up the signal to look at it.
+ */
+static	void	control_startup(void)
+{
+  const char	*path;
+  char		env_buf[512];
+  
+  path = loc_getenv(CONTROL_ENVIRON, env_buf, sizeof(env_buf),
+		    1 /* stay safe */);
+  if (path == NULL || *path == '\0') {
+    return;
+  }
+  (void)strncpy(control_path, path, sizeof(control_path));
+  control_path[sizeof(control_path) - 1] = '\0';
+  
+  /* the options that are already in the file came from the environment */
+  if (stat(control_path, &control_stat) != 0) {
+    memset(&control_stat, 0, sizeof(control_stat));
+  }
+  CONTROL_NEXT_ITER();
+  
+#if SIGNAL_OKAY && defined(CONTROL_SIGNAL)
+  (void)signal(CONTROL_SIGNAL, control_signal_handler);
+#endif
+}
+
+/*
+ * static void control_check
+ *
+ * If it is time, see if the control file has changed and apply the
+ * options in it.  Called with the lock held.
+ */
+static	void	control_check(void)
+{
+  struct stat	stat_buf;
+  char		options[1024];
+  int		fd, len;
+  
+#if SIGNAL_OKAY && defined(CONTROL_SIGNAL)
+  /* the signal has us look right away */
+  if (control_signal_b) {
+    control_signal_b = 0;
+    control_next_iter = _dmalloc_iter_c;
+  }
+#endif
+  if (control_next_iter == 0 || _dmalloc_iter_c < control_next_iter) {
+    return;
+  }
+  CONTROL_NEXT_ITER();
+  
+  if (stat(control_path, &stat_buf) != 0
+      || (stat_buf.st_mtime == control_stat.st_mtime
+	  && stat_buf.st_size == control_stat.st_size
+	  && stat_buf.st_ino == control_stat.st_ino)) {
+    return;
+  }
+  control_stat = stat_buf;
+  
+  fd = open(control_path, O_RDONLY, 0);
+  if (fd < 0) {
+    return;
+  }
+  len = read(fd, options, sizeof(options) - 1);
+  (void)close(fd);
+  if (len < 0) {
+    return;
+  }
+  
+  /* trim the line-feed that the utility writes */
+  while (len > 0 && (options[len - 1] == '\n' || options[len - 1] == '\r'
+		     || options[len - 1] == ' ' || options[len - 1] == '\t')) {
+    len--;
+  }
+  options[len] = '\0';
+  
+  dmalloc_message("applying options '%s' from control file '%s'",
+		  options, control_path);
+  process_environ(options, 0 /* not startup */);
+}
+#endif /* if CONTROL_FILE */
+
 /************************** startup/shutdown calls ***************************/
 
 #if SIGNAL_OKAY
@@ -364,7 +633,11 @@ static	int	dmalloc_startup(const char *debug_str)
       env_str = debug_str;
     }
     /* process the environmental variable(s) */
-    process_environ(env_str);
+    process_environ(env_str, 1 /* startup */);
+    
+#if CONTROL_FILE
+    control_startup();
+#endif
     
     /*
      * Tune the environment here.  If we have a start-file,
@@ -463,9 +736,11 @@ static	int	dmalloc_startup(const char *debug_str)
  * check_heap_b -> Set to 1 if it is okay to check the heap.  If set
  * to 0 then the caller will check it itself or it is a non-invasive
  * call.
+ *
+ * op -> DMALLOC_LOCK_ operation of the call for the lock profile.
  */
 static	int	dmalloc_in(const char *file, const int line,
-			   const int check_heap_b)
+			   const int check_heap_b, const int op)
 {
   if (_dmalloc_aborting_b) {
     return 0;
@@ -483,7 +758,7 @@ static	int	dmalloc_in(const char *file, const int line,
   }
   
 #if LOCK_THREADS
-  lock_thread();
+  lock_thread(op, file, line);
 #endif
   
   if (in_alloc_b) {
@@ -499,6 +774,22 @@ static	int	dmalloc_in(const char *file, const int line,
   /* increment our interval */
   _dmalloc_iter_c++;
   
+#if CONTROL_FILE
+  /* a safe point to look for new options */
+  if (control_path[0] != '\0') {
+    control_check();
+  }
+#endif
+  
+#if LIVE_STATS
+  /* the shared readers count as well so we may step past the mark */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LIVE_STATS)
+      && _dmalloc_iter_c >= live_next_iter) {
+    live_next_iter = _dmalloc_iter_c + LIVE_STATS_INTERVAL;
+    _dmalloc_chunk_live_stats(0 /* not exiting */);
+  }
+#endif
+  
   /* check start file/line specifications */
   if ((! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP))
       && start_file != NULL
@@ -525,7 +816,7 @@ static	int	dmalloc_in(const char *file, const int line,
     }
   }
   
-  else if (start_size > 0 && start_size >= _dmalloc_alloc_total) {
+  else if (start_size > 0 && start_size >= _dmalloc_chunk_alloc_total()) {
     BIT_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP);
     start_size = 0;
     /* disable this check so the interval can go on/off */
@@ -543,6 +834,10 @@ static	int	dmalloc_in(const char *file, const int line,
   
   /* after all that, do we need to check the heap? */
   if (check_heap_b && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP)) {
+#if LOCK_PROFILE
+    /* the heap check is what makes the others wait */
+    lock_hold_op = DMALLOC_LOCK_HEAP_CHECK;
+#endif
     (void)_dmalloc_chunk_heap_check();
   }
   
@@ -565,6 +860,112 @@ static	void	dmalloc_out(void)
   }
 }
 
+#if LOCK_SHARED
+/*
+ * static int shared_okay
+ *
+ * Do the settings let a read-only pointer routine run without the
+ * exclusive lock?  Checking the heap, logging the transaction, or any
+ * of the start and interval settings all need dmalloc_in.
+ *
+ * Returns 1 if they do or 0 if not.
+ */
+static	int	shared_okay(void)
+{
+  /* we need to be started and past the lock-on counter */
+  if ((! enabled_b) || _dmalloc_aborting_b || thread_lock_c > 0) {
+    return 0;
+  }
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP)
+      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)
+      || start_file != NULL
+      || start_iter > 0
+      || start_size > 0
+      || _dmalloc_check_interval > 0
+      || do_shutdown_b) {
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * static int dmalloc_in_shared
+ *
+ * Call to one of the read-only pointer routines has been made.  If
+ * nothing in dmalloc_in would need to change the library state then
+ * read-lock the library so other readers can run beside us.
+ *
+ * Returns 1 if we hold the lock shared or 0 if the caller should go
+ * through dmalloc_in and dmalloc_out instead.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ */
+static	int	dmalloc_in_shared(const char *file, const int line)
+{
+#if LOCK_PROFILE
+  unsigned long	wait_start = 0;
+#endif
+  
+  if (! shared_okay()) {
+    return 0;
+  }
+  
+#if LOCK_PROFILE
+  /* we only read the clock for the wait if a writer has the lock */
+  if (pthread_rwlock_tryrdlock(&dmalloc_rwlock) != 0) {
+    wait_start = lock_nsec();
+    if (pthread_rwlock_rdlock(&dmalloc_rwlock) != 0) {
+      return 0;
+    }
+  }
+  shared_start_nsec = lock_nsec();
+  if (wait_start == 0) {
+    shared_wait_nsec = 0;
+  }
+  else {
+    shared_wait_nsec = MAX(shared_start_nsec - wait_start, 1);
+  }
+  shared_hold_file = file;
+  shared_hold_line = line;
+#else
+  if (pthread_rwlock_rdlock(&dmalloc_rwlock) != 0) {
+    return 0;
+  }
+#endif
+  
+  /* the settings may have changed while we waited for the lock */
+  if (! shared_okay()) {
+    pthread_rwlock_unlock(&dmalloc_rwlock);
+    return 0;
+  }
+  
+  /* other readers may be counting as well */
+  (void)__sync_fetch_and_add(&_dmalloc_iter_c, 1);
+  
+  return 1;
+}
+
+/*
+ * Going out of the read-only pointer routines back to user space.
+ */
+static	void	dmalloc_out_shared(void)
+{
+#if LOCK_PROFILE
+  /* the writers are kept out by our read-lock and the readers by this */
+  pthread_mutex_lock(&shared_record_mutex);
+  _dmalloc_chunk_lock_record(DMALLOC_LOCK_VERIFY, shared_hold_file,
+			     shared_hold_line, shared_wait_nsec,
+			     lock_nsec() - shared_start_nsec);
+  pthread_mutex_unlock(&shared_record_mutex);
+#endif
+  pthread_rwlock_unlock(&dmalloc_rwlock);
+}
+#endif
+
 /***************************** exported routines *****************************/
 
 /*
@@ -594,7 +995,7 @@ void	dmalloc_shutdown(void)
   }
   
 #if LOCK_THREADS
-  lock_thread();
+  lock_thread(DMALLOC_LOCK_LOG, DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE);
 #endif
   
   /* we do it again in case the lock synced the flag to true now */
@@ -634,6 +1035,13 @@ void	dmalloc_shutdown(void)
 		       );
   }
   
+#if LIVE_STATS
+  /* leave the final numbers for the utility */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LIVE_STATS)) {
+    _dmalloc_chunk_live_stats(1 /* exiting */);
+  }
+#endif
+  
 #if LOG_PNT_TIMEVAL
   {
     TIMEVAL_TYPE	now;
@@ -723,7 +1131,7 @@ DMALLOC_PNT	dmalloc_malloc(const char *file, const int line,
   }
 #endif
   
-  if (! dmalloc_in(file, line, 1)) {
+  if (! dmalloc_in(file, line, 1, DMALLOC_LOCK_MALLOC)) {
     if (tracking_func != NULL) {
       tracking_func(file, line, func_id, size, alignment, NULL, NULL);
     }
@@ -738,25 +1146,43 @@ DMALLOC_PNT	dmalloc_malloc(const char *file, const int line,
       align = 0;
     }
   }
-  else if (alignment >= BLOCK_SIZE) {
-    align = BLOCK_SIZE;
+  else if (alignment <= ALLOCATION_ALIGNMENT) {
+    /* all of our allocations are already aligned this much */
+    align = 0;
+  }
+  else if ((alignment & (alignment - 1)) == 0 || alignment > BLOCK_SIZE) {
+    /*
+     * Divided slots are aligned to their size so the chunk code can
+     * pad.  Larger alignments are found inside of a larger slot and
+     * those which it cannot give are refused below.
+     */
+    align = alignment;
   }
   else {
     /*
-     * NOTE: Currently, there is no support in the library for
-     * memalign on less than block boundaries.  It will be non-trivial
-     * to support valloc with fence-post checking and the lack of the
-     * flag width for dblock allocations.
+     * NOTE: alignments which are not a power of two are not
+     * supported by the library.
      */
     if (! memalign_warn_b) {
       dmalloc_message("WARNING: memalign called without library support");
       memalign_warn_b = 1;
     }
     align = 0;
-    /* align = alignment */
   }
   
-  new_p = _dmalloc_chunk_malloc(file, line, size, func_id, align);
+  if (align > BLOCK_SIZE
+      && ((align & (align - 1)) != 0 || (unsigned int)align != align)) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    dmalloc_error("memalign");
+    new_p = MALLOC_ERROR;
+  }
+  else {
+    new_p = _dmalloc_chunk_malloc(file, line, size, func_id, align);
+  }
+  if (new_p != NULL) {
+    thread_alloc_c++;
+    thread_byte_c += size;
+  }
   
   check_pnt(file, line, new_p, "malloc");
   
@@ -821,7 +1247,7 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
   }
 #endif
   
-  if (! dmalloc_in(file, line, 1)) {
+  if (! dmalloc_in(file, line, 1, DMALLOC_LOCK_REALLOC)) {
     if (tracking_func != NULL) {
       tracking_func(file, line, func_id, new_size, 0, old_pnt, NULL);
     }
@@ -851,7 +1277,9 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
        * Froehlich for patiently pointing that the realloc in just
        * about every Unix has this functionality.
        */
-      (void)_dmalloc_chunk_free(file, line, old_pnt, func_id);
+      if (_dmalloc_chunk_free(file, line, old_pnt, func_id) == FREE_NOERROR) {
+	thread_free_c++;
+      }
       new_p = NULL;
     }
     else
@@ -860,6 +1288,12 @@ DMALLOC_PNT	dmalloc_realloc(const char *file, const int line,
   
   if (new_p != NULL) {
     check_pnt(file, line, new_p, "realloc-out");
+    /* a realloc counts as an allocation and a free of the old pointer */
+    thread_alloc_c++;
+    thread_byte_c += new_size;
+    if (old_pnt != NULL) {
+      thread_free_c++;
+    }
   }
   
   dmalloc_out();
@@ -907,7 +1341,7 @@ int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
 {
   int		ret;
   
-  if (! dmalloc_in(file, line, 1)) {
+  if (! dmalloc_in(file, line, 1, DMALLOC_LOCK_FREE)) {
     if (tracking_func != NULL) {
       tracking_func(file, line, func_id, 0, 0, pnt, NULL);
     }
@@ -917,6 +1351,9 @@ int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
   check_pnt(file, line, pnt, "free");
   
   ret = _dmalloc_chunk_free(file, line, pnt, func_id);
+  if (ret == FREE_NOERROR && pnt != NULL) {
+    thread_free_c++;
+  }
   
   dmalloc_out();
   
@@ -927,6 +1364,195 @@ int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
   return ret;
 }
 
+/*
+ * int dmalloc_free_size
+ *
+ * Release a pointer back into the heap after checking that the size
+ * passed in matches the allocation.  This is used by C++'s sized
+ * delete.  On a mismatch the pointer is not freed.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt -> Existing pointer we are freeing.
+ *
+ * size -> Number of bytes the caller believes were allocated.
+ *
+ * func_id -> Function-id to identify the type of call.  See
+ * dmalloc.h.
+ */
+int	dmalloc_free_size(const char *file, const int line, DMALLOC_PNT pnt,
+			  const DMALLOC_SIZE size, const int func_id)
+{
+  int		ret;
+  
+  if (! dmalloc_in(file, line, 1, DMALLOC_LOCK_FREE)) {
+    if (tracking_func != NULL) {
+      tracking_func(file, line, func_id, size, 0, pnt, NULL);
+    }
+    return FREE_ERROR;
+  }
+  
+  check_pnt(file, line, pnt, "free");
+  
+  if (pnt != NULL
+      && (! _dmalloc_chunk_size_check(file, line, pnt, size, "free"))) {
+    ret = FREE_ERROR;
+  }
+  else {
+    ret = _dmalloc_chunk_free(file, line, pnt, func_id);
+    if (ret == FREE_NOERROR && pnt != NULL) {
+      thread_free_c++;
+    }
+  }
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    tracking_func(file, line, func_id, size, 0, pnt, NULL);
+  }
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_malloc_batch
+ *
+ * Allocate a number of pointers for one caller while going into the
+ * library once.  The heap check, locking, and tracking function call
+ * are done once for the batch instead of for each pointer.  The
+ * pointers are freed with free or dmalloc_free_batch.
+ *
+ * Returns DMALLOC_NOERROR on success else DMALLOC_ERROR in which case
+ * none of the pointers are allocated and all of PNTS are set to NULL.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * sizes -> Array of PNT_N numbers of bytes to allocate.
+ *
+ * pnts <- Array of PNT_N pointers which are allocated.
+ *
+ * pnt_n -> Number of pointers to allocate.
+ */
+int	dmalloc_malloc_batch(const char *file, const int line,
+			     const DMALLOC_SIZE *sizes, DMALLOC_PNT *pnts,
+			     const int pnt_n)
+{
+  DMALLOC_SIZE	total = 0;
+  int		pnt_c, ret;
+  
+  if (pnt_n < 0 || (pnt_n > 0 && (sizes == NULL || pnts == NULL))) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    dmalloc_error("dmalloc_malloc_batch");
+    return DMALLOC_ERROR;
+  }
+  for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+#if DMALLOC_SIZE_UNSIGNED == 0
+    if (sizes[pnt_c] < 0) {
+      dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+      dmalloc_error("dmalloc_malloc_batch");
+      return DMALLOC_ERROR;
+    }
+#endif
+    total += sizes[pnt_c];
+  }
+  
+  if (! dmalloc_in(file, line, 1, DMALLOC_LOCK_MALLOC)) {
+    if (tracking_func != NULL) {
+      tracking_func(file, line, DMALLOC_FUNC_MALLOC_BATCH, total, 0, NULL,
+		    NULL);
+    }
+    return DMALLOC_ERROR;
+  }
+  
+  if (_dmalloc_chunk_malloc_batch(file, line, sizes, pnts, pnt_n)) {
+    for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+      check_pnt(file, line, pnts[pnt_c], "malloc");
+    }
+    thread_alloc_c += pnt_n;
+    thread_byte_c += total;
+    ret = DMALLOC_NOERROR;
+  }
+  else {
+    ret = DMALLOC_ERROR;
+  }
+  
+  dmalloc_out();
+  
+  /* one call for the batch with the pointer array as the address */
+  if (tracking_func != NULL) {
+    tracking_func(file, line, DMALLOC_FUNC_MALLOC_BATCH, total, 0, NULL,
+		  (ret == DMALLOC_NOERROR ? (DMALLOC_PNT)pnts : NULL));
+  }
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_free_batch
+ *
+ * Release a number of pointers back into the heap while going into
+ * the library once.  NULL pointers in the array are skipped.  If one
+ * of the pointers cannot be freed, the error is reported and the rest
+ * are still freed.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnts -> Array of PNT_N pointers we are freeing.
+ *
+ * pnt_n -> Number of pointers in the array.
+ */
+int	dmalloc_free_batch(const char *file, const int line,
+			   DMALLOC_PNT const *pnts, const int pnt_n)
+{
+  int		pnt_c, free_n, ret;
+  
+  if (pnt_n < 0 || (pnt_n > 0 && pnts == NULL)) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    dmalloc_error("dmalloc_free_batch");
+    return FREE_ERROR;
+  }
+  
+  if (! dmalloc_in(file, line, 1, DMALLOC_LOCK_FREE)) {
+    if (tracking_func != NULL) {
+      tracking_func(file, line, DMALLOC_FUNC_FREE_BATCH, 0, 0,
+		    (DMALLOC_PNT)pnts, NULL);
+    }
+    return FREE_ERROR;
+  }
+  
+  for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+    check_pnt(file, line, pnts[pnt_c], "free");
+  }
+  
+  ret = _dmalloc_chunk_free_batch(file, line, pnts, pnt_n, &free_n);
+  thread_free_c += free_n;
+  
+  dmalloc_out();
+  
+  if (tracking_func != NULL) {
+    tracking_func(file, line, DMALLOC_FUNC_FREE_BATCH, 0, 0,
+		  (DMALLOC_PNT)pnts, NULL);
+  }
+  
+  return ret;
+}
+
 /*
  * DMALLOC_PNT dmalloc_strndup
  *
@@ -1313,7 +1939,9 @@ int	dmalloc_verify(const DMALLOC_PNT pnt)
 {
   int	ret;
   
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0)) {
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0,
+		   (pnt == NULL ? DMALLOC_LOCK_HEAP_CHECK
+		    : DMALLOC_LOCK_VERIFY))) {
     return MALLOC_VERIFY_NOERROR;
   }
   
@@ -1325,7 +1953,7 @@ int	dmalloc_verify(const DMALLOC_PNT pnt)
   else {
     ret = _dmalloc_chunk_pnt_check("dmalloc_verify", pnt,
 				   1 /* exact pointer */, 0 /* no strlen */,
-				   0 /* no min size */);
+				   0 /* no min size */, 0 /* not shared */);
   }
   
   dmalloc_out();
@@ -1394,12 +2022,36 @@ int	dmalloc_verify_pnt_strsize(const char *file, const int line,
 {
   int	ret;
   
-  if (! dmalloc_in(file, line, 0)) {
+#if LOCK_SHARED
+  /*
+   * The shadow map can pass most pointers without any locking.  It
+   * leaves fenced pointers to the full check.
+   */
+  if (shared_okay()
+      && _dmalloc_chunk_shadow_check(pnt, exact_b, strlen_b, min_size)) {
+    /* other readers may be counting as well */
+    (void)__sync_fetch_and_add(&_dmalloc_iter_c, 1);
+    return MALLOC_VERIFY_NOERROR;
+  }
+  
+  if (dmalloc_in_shared(file, line)) {
+    ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size,
+				   1 /* shared */);
+    dmalloc_out_shared();
+    if (ret) {
+      return MALLOC_VERIFY_NOERROR;
+    }
+    /* fall through and check it again exclusively to report the error */
+  }
+#endif
+  
+  if (! dmalloc_in(file, line, 0, DMALLOC_LOCK_VERIFY)) {
     return MALLOC_VERIFY_NOERROR;
   }
   
   /* call the pnt checking chunk code */
-  ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size);
+  ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size,
+				 0 /* not shared */);
   dmalloc_out();
   
   if (ret) {
@@ -1481,6 +2133,7 @@ unsigned int	dmalloc_debug(const unsigned int flags)
   
   /* add the new flags */
   _dmalloc_flags = flags;
+  _dmalloc_chunk_flags_changed();
   
   return old_flags;
 }
@@ -1547,11 +2200,11 @@ void	dmalloc_debug_setup(const char *options_str)
   
   /* we need to lock */
   if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
-		   0 /* don't-check-heap */)) {
+		   0 /* don't-check-heap */, DMALLOC_LOCK_OTHER)) {
     return;
   }
   
-  process_environ(options_str);
+  process_environ(options_str, 0 /* not startup */);
   dmalloc_out();
 }
 
@@ -1600,25 +2253,42 @@ int	dmalloc_examine(const DMALLOC_PNT pnt, DMALLOC_SIZE *user_size_p,
 			unsigned long *used_mark_p, unsigned long *seen_p)
 {
   int		ret;
-  unsigned int	user_size_map, tot_size_map;
+  unsigned long	user_size_map, tot_size_map;
   unsigned long	*loc_seen_p;
   
   /*
-   * NOTE: we use the size maps because we use a unsigned int size
+   * NOTE: we use the size maps because we use a unsigned long size
    * type internally but may use some size_t externally.
    */
   
-  /* need to check the heap here since we are geting info from it below */
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
-    return DMALLOC_ERROR;
+  ret = 0;
+#if LOCK_SHARED
+  /* NOTE: we are only shared if we would not be checking the heap */
+  if (dmalloc_in_shared(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE)) {
+    ret = _dmalloc_chunk_read_info(pnt, "dmalloc_examine", &user_size_map,
+				   &tot_size_map, file_p, line_p, ret_attr_p,
+				   &loc_seen_p, used_mark_p, NULL, NULL,
+				   1 /* shared */);
+    dmalloc_out_shared();
   }
+#endif
   
-  /* NOTE: we do not need the alloc-size info */
-  ret = _dmalloc_chunk_read_info(pnt, "dmalloc_examine", &user_size_map,
-				 &tot_size_map, file_p, line_p, ret_attr_p,
-				 &loc_seen_p, used_mark_p, NULL, NULL);
-  
-  dmalloc_out();
+  /* if the shared read failed then run it again to report the error */
+  if (! ret) {
+    /* need to check the heap here since we are geting info from it below */
+    if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		     DMALLOC_LOCK_VERIFY)) {
+      return DMALLOC_ERROR;
+    }
+    
+    /* NOTE: we do not need the alloc-size info */
+    ret = _dmalloc_chunk_read_info(pnt, "dmalloc_examine", &user_size_map,
+				   &tot_size_map, file_p, line_p, ret_attr_p,
+				   &loc_seen_p, used_mark_p, NULL, NULL,
+				   0 /* not shared */);
+    
+    dmalloc_out();
+  }
   
   if (ret) {
     SET_POINTER(user_size_p, user_size_map);
@@ -1672,6 +2342,118 @@ unsigned long	dmalloc_mark(void)
   return _dmalloc_iter_c;
 }
 
+/*
+ * void dmalloc_budget_start
+ *
+ * Start counting the allocations, bytes, and frees that the current
+ * thread makes so they can be checked against a budget with
+ * dmalloc_budget_end.  This is cheap and does not walk the heap.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget structure that we are filling in.
+ *
+ * max_allocs -> Most allocations that the scope may make or
+ * DMALLOC_BUDGET_UNLIMITED.  A realloc counts as an allocation.
+ *
+ * max_bytes -> Most bytes that the scope may allocate or
+ * DMALLOC_BUDGET_UNLIMITED.
+ *
+ * max_frees -> Most frees that the scope may make or
+ * DMALLOC_BUDGET_UNLIMITED.
+ */
+void	dmalloc_budget_start(dmalloc_budget_t *budget_p,
+			     const unsigned long max_allocs,
+			     const unsigned long max_bytes,
+			     const unsigned long max_frees)
+{
+  budget_p->db_max_allocs = max_allocs;
+  budget_p->db_max_bytes = max_bytes;
+  budget_p->db_max_frees = max_frees;
+  budget_p->db_allocs = thread_alloc_c;
+  budget_p->db_bytes = thread_byte_c;
+  budget_p->db_frees = thread_free_c;
+}
+
+/*
+ * void dmalloc_budget_used
+ *
+ * Get the allocations, bytes, and frees that the current thread has
+ * made since dmalloc_budget_start.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget structure from dmalloc_budget_start.
+ *
+ * allocs_p <- Pointer to an unsigned long which, if not NULL, will be
+ * set to the number of allocations.
+ *
+ * bytes_p <- Pointer to an unsigned long which, if not NULL, will be
+ * set to the number of bytes allocated.
+ *
+ * frees_p <- Pointer to an unsigned long which, if not NULL, will be
+ * set to the number of frees.
+ */
+void	dmalloc_budget_used(const dmalloc_budget_t *budget_p,
+			    unsigned long *allocs_p, unsigned long *bytes_p,
+			    unsigned long *frees_p)
+{
+  SET_POINTER(allocs_p, thread_alloc_c - budget_p->db_allocs);
+  SET_POINTER(bytes_p, thread_byte_c - budget_p->db_bytes);
+  SET_POINTER(frees_p, thread_free_c - budget_p->db_frees);
+}
+
+/*
+ * int dmalloc_budget_end
+ *
+ * Check the current thread's allocations since dmalloc_budget_start
+ * against the budget.  If it has been exceeded then the usage is
+ * logged and the error is raised which will abort the program if
+ * the error-abort token is enabled.
+ *
+ * Returns 1 if the scope was within its budget else 0.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the end of the scope.
+ *
+ * line -> Line-number of the end of the scope.
+ *
+ * budget_p -> Budget structure from dmalloc_budget_start.
+ */
+int	dmalloc_budget_end(const char *file, const int line,
+			   const dmalloc_budget_t *budget_p)
+{
+  unsigned long	allocs, bytes, frees;
+  char		where_buf[MAX_FILE_LENGTH + 64];
+  
+  dmalloc_budget_used(budget_p, &allocs, &bytes, &frees);
+  if (allocs <= budget_p->db_max_allocs
+      && bytes <= budget_p->db_max_bytes
+      && frees <= budget_p->db_max_frees) {
+    return 1;
+  }
+  
+  if (! dmalloc_in(file, line, 0, DMALLOC_LOCK_OTHER)) {
+    return 0;
+  }
+  
+  /* unlimited maximums show up as -1 */
+  dmalloc_message("allocation budget exceeded at '%s': %lu allocs (max %ld), "
+		  "%lu bytes (max %ld), %lu frees (max %ld)",
+		  _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					  file, line),
+		  allocs, (long)budget_p->db_max_allocs,
+		  bytes, (long)budget_p->db_max_bytes,
+		  frees, (long)budget_p->db_max_frees);
+  dmalloc_errno = DMALLOC_ERROR_OVER_BUDGET;
+  dmalloc_error("dmalloc_budget_end");
+  
+  dmalloc_out();
+  
+  return 0;
+}
+
 /*
  * unsigned long dmalloc_memory_allocated
  *
@@ -1683,7 +2465,7 @@ unsigned long	dmalloc_memory_allocated(void)
     (void)dmalloc_startup(NULL /* no options string */);
   }
   
-  return _dmalloc_alloc_total;
+  return _dmalloc_chunk_alloc_total();
 }
 
 /*
@@ -1723,7 +2505,8 @@ unsigned long	dmalloc_count_changed(const unsigned long mark,
 {
   unsigned long	mem_count;
   
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_OTHER)) {
     return 0;
   }
   
@@ -1745,7 +2528,8 @@ unsigned long	dmalloc_count_changed(const unsigned long mark,
  */
 void	dmalloc_log_stats(void)
 {
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_LOG)) {
     return;
   }
   
@@ -1761,7 +2545,8 @@ void	dmalloc_log_stats(void)
  */
 void	dmalloc_log_unfreed(void)
 {
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_LOG)) {
     return;
   }
   
@@ -1806,7 +2591,8 @@ void	dmalloc_log_unfreed(void)
 void	dmalloc_log_changed(const unsigned long mark, const int not_freed_b,
 			    const int free_b, const int details_b)
 {
-  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_LOG)) {
     return;
   }
   _dmalloc_chunk_log_changed(mark, not_freed_b, free_b, details_b);
@@ -1814,6 +2600,159 @@ void	dmalloc_log_changed(const unsigned long mark, const int not_freed_b,
   dmalloc_out();
 }
 
+/*
+ * unsigned long dmalloc_scan_leaks
+ *
+ * Look for the allocations that the program can no longer reach.
+ * The stacks, the registers of the calling thread, and the data, bss
+ * and other writable memory of the program are conservatively scanned
+ * for words pointing into the allocations which are scanned in turn.
+ * The allocations that are not reached are logged and summarized by
+ * where they were allocated.
+ *
+ * Returns the number of unreachable allocations.
+ */
+unsigned long	dmalloc_scan_leaks(void)
+{
+  unsigned long	leak_n;
+  
+  /* the mark threads have to be started outside of the lock */
+  if (! _dmalloc_chunk_scan_start()) {
+    return 0;
+  }
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_LOG)) {
+    _dmalloc_chunk_scan_finish();
+    return 0;
+  }
+  
+  leak_n = _dmalloc_chunk_scan_leaks();
+  
+  dmalloc_out();
+  _dmalloc_chunk_scan_finish();
+  
+  return leak_n;
+}
+
+/*
+ * int dmalloc_snapshot_async
+ *
+ * Fork a child process which checks its copy of the heap and logs
+ * the statistics, the not-freed memory, and the unreachable memory.
+ * The library is locked only for the fork so the program goes on
+ * while the child works.  The caller should reap the child with
+ * waitpid.
+ *
+ * Returns the process-id of the child or -1 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * report_path -> Path of the file the child logs the report to or
+ * NULL to use the logfile.  A %p in the path is replaced with the
+ * process-id of the child.
+ */
+int	dmalloc_snapshot_async(const char *report_path)
+{
+#if HAVE_FORK
+  int	pid;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0,
+		   DMALLOC_LOCK_LOG)) {
+    return -1;
+  }
+  
+  pid = fork();
+  if (pid == 0) {
+    /* the child holds the lock of the forking thread from here on */
+    if (report_path != NULL) {
+      dmalloc_logpath = (char *)report_path;
+      _dmalloc_reopen_log();
+    }
+#if HAVE_GETPID
+    dmalloc_message("heap snapshot of process %ld", (long)getppid());
+#endif
+    _dmalloc_chunk_snapshot();
+    /* NOTE: this should not be exit() because the atexit would run */
+    _exit(0);
+  }
+  
+  if (pid < 0) {
+    dmalloc_message("could not fork the heap snapshot");
+  }
+  else if (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    dmalloc_message("heap snapshot in process %d", pid);
+  }
+  
+  dmalloc_out();
+  
+  return pid;
+#else
+  dmalloc_message("heap snapshots not supported without fork");
+  return -1;
+#endif
+}
+
+/*
+ * int dmalloc_dump_heap
+ *
+ * Write the used and free blocks of the heap to a binary dump file.
+ * The file records the address, sizes, and allocation site of each
+ * block along with the heap ranges and can be analyzed later with the
+ * dump options of the dmalloc utility.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the dump file.
+ *
+ * data_b -> Set to 1 to also write the bytes of each allocation.
+ */
+int	dmalloc_dump_heap(const char *path, const int data_b)
+{
+  int	ret;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_LOG)) {
+    return DMALLOC_ERROR;
+  }
+  
+  if (_dmalloc_chunk_dump_heap(path, data_b)) {
+    ret = DMALLOC_NOERROR;
+  }
+  else {
+    ret = DMALLOC_ERROR;
+  }
+  
+  dmalloc_out();
+  
+  return ret;
+}
+
+/*
+ * unsigned long dmalloc_trim
+ *
+ * Give the physical pages of the free heap blocks back to the system.
+ * The blocks stay in the heap and are reused as normal.
+ *
+ * Returns the number of bytes given back.
+ */
+unsigned long	dmalloc_trim(void)
+{
+  unsigned long	trim_size;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1,
+		   DMALLOC_LOCK_OTHER)) {
+    return 0;
+  }
+  
+  trim_size = _dmalloc_chunk_trim();
+  
+  dmalloc_out();
+  
+  return trim_size;
+}
+
 /*
  * void dmalloc_vmessage
  *
@@ -1907,6 +2846,39 @@ void	dmalloc_get_stats(DMALLOC_PNT *heap_low_p,
 			   max_allocated_p, max_pnt_np, max_one_p);
 }
 
+/*
+ * int dmalloc_get_lock_stats
+ *
+ * Get how long the calls of an operation have waited for and held
+ * the lock of the threaded library.  The lock is only profiled if the
+ * library was built with LOCK_PROFILE_TOP_LOG set.
+ *
+ * Returns 1 if the lock is profiled or 0 if it is not or the
+ * operation is not known in which case the stats are all 0.
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation whose stats we are getting.
+ *
+ * stats_p <- Pointer to the stats which we fill in.
+ */
+int	dmalloc_get_lock_stats(const int op, dmalloc_lock_stats_t *stats_p)
+{
+  int	ret;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0,
+		   DMALLOC_LOCK_OTHER)) {
+    memset(stats_p, 0, sizeof(*stats_p));
+    return 0;
+  }
+  
+  ret = _dmalloc_chunk_get_lock_stats(op, stats_p);
+  
+  dmalloc_out();
+  
+  return ret;
+}
+
 /*
  * const char *dmalloc_strerror
  *
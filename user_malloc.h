@@ -120,6 +120,84 @@ extern
 int	dmalloc_free(const char *file, const int line, DMALLOC_PNT pnt,
 		     const int func_id);
 
+/*
+ * int dmalloc_free_size
+ *
+ * Release a pointer back into the heap after checking that the size
+ * passed in matches the allocation.  This is used by C++'s sized
+ * delete.  On a mismatch the pointer is not freed.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnt -> Existing pointer we are freeing.
+ *
+ * size -> Number of bytes the caller believes were allocated.
+ *
+ * func_id -> Function-id to identify the type of call.  See
+ * dmalloc.h.
+ */
+extern
+int	dmalloc_free_size(const char *file, const int line, DMALLOC_PNT pnt,
+			  const DMALLOC_SIZE size, const int func_id);
+
+/*
+ * int dmalloc_malloc_batch
+ *
+ * Allocate a number of pointers for one caller while going into the
+ * library once.  The heap check, locking, and tracking function call
+ * are done once for the batch instead of for each pointer.  The
+ * pointers are freed with free or dmalloc_free_batch.
+ *
+ * Returns DMALLOC_NOERROR on success else DMALLOC_ERROR in which case
+ * none of the pointers are allocated and all of PNTS are set to NULL.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * sizes -> Array of PNT_N numbers of bytes to allocate.
+ *
+ * pnts <- Array of PNT_N pointers which are allocated.
+ *
+ * pnt_n -> Number of pointers to allocate.
+ */
+extern
+int	dmalloc_malloc_batch(const char *file, const int line,
+			     const DMALLOC_SIZE *sizes, DMALLOC_PNT *pnts,
+			     const int pnt_n);
+
+/*
+ * int dmalloc_free_batch
+ *
+ * Release a number of pointers back into the heap while going into
+ * the library once.  NULL pointers in the array are skipped.  If one
+ * of the pointers cannot be freed, the error is reported and the rest
+ * are still freed.
+ *
+ * Returns FREE_NOERROR on success or FREE_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * pnts -> Array of PNT_N pointers we are freeing.
+ *
+ * pnt_n -> Number of pointers in the array.
+ */
+extern
+int	dmalloc_free_batch(const char *file, const int line,
+			   DMALLOC_PNT const *pnts, const int pnt_n);
+
 /*
  * DMALLOC_PNT dmalloc_strndup
  *
@@ -553,6 +631,78 @@ void	dmalloc_track(const dmalloc_track_t track_func);
 extern
 unsigned long	dmalloc_mark(void);
 
+/*
+ * void dmalloc_budget_start
+ *
+ * Start counting the allocations, bytes, and frees that the current
+ * thread makes so they can be checked against a budget with
+ * dmalloc_budget_end.  This is cheap and does not walk the heap.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget structure that we are filling in.
+ *
+ * max_allocs -> Most allocations that the scope may make or
+ * DMALLOC_BUDGET_UNLIMITED.  A realloc counts as an allocation.
+ *
+ * max_bytes -> Most bytes that the scope may allocate or
+ * DMALLOC_BUDGET_UNLIMITED.
+ *
+ * max_frees -> Most frees that the scope may make or
+ * DMALLOC_BUDGET_UNLIMITED.
+ */
+extern
+void	dmalloc_budget_start(dmalloc_budget_t *budget_p,
+			     const unsigned long max_allocs,
+			     const unsigned long max_bytes,
+			     const unsigned long max_frees);
+
+/*
+ * void dmalloc_budget_used
+ *
+ * Get the allocations, bytes, and frees that the current thread has
+ * made since dmalloc_budget_start.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget structure from dmalloc_budget_start.
+ *
+ * allocs_p <- Pointer to an unsigned long which, if not NULL, will be
+ * set to the number of allocations.
+ *
+ * bytes_p <- Pointer to an unsigned long which, if not NULL, will be
+ * set to the number of bytes allocated.
+ *
+ * frees_p <- Pointer to an unsigned long which, if not NULL, will be
+ * set to the number of frees.
+ */
+extern
+void	dmalloc_budget_used(const dmalloc_budget_t *budget_p,
+			    unsigned long *allocs_p, unsigned long *bytes_p,
+			    unsigned long *frees_p);
+
+/*
+ * int dmalloc_budget_end
+ *
+ * Check the current thread's allocations since dmalloc_budget_start
+ * against the budget.  If it has been exceeded then the usage is
+ * logged and the error is raised which will abort the program if
+ * the error-abort token is enabled.
+ *
+ * Returns 1 if the scope was within its budget else 0.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the end of the scope.
+ *
+ * line -> Line-number of the end of the scope.
+ *
+ * budget_p -> Budget structure from dmalloc_budget_start.
+ */
+extern
+int	dmalloc_budget_end(const char *file, const int line,
+			   const dmalloc_budget_t *budget_p);
+
 /*
  * unsigned long dmalloc_memory_allocated
  *
@@ -630,6 +780,71 @@ extern
 void	dmalloc_log_changed(const unsigned long mark, const int not_freed_b,
 			    const int free_b, const int details_b);
 
+/*
+ * unsigned long dmalloc_scan_leaks
+ *
+ * Look for the allocations that the program can no longer reach.
+ * The stacks, the registers of the calling thread, and the data, bss
+ * and other writable memory of the program are conservatively scanned
+ * for words pointing into the allocations which are scanned in turn.
+ * The allocations that are not reached are logged and summarized by
+ * where they were allocated.
+ *
+ * Returns the number of unreachable allocations.
+ */
+extern
+unsigned long	dmalloc_scan_leaks(void);
+
+/*
+ * int dmalloc_snapshot_async
+ *
+ * Fork a child process which checks its copy of the heap and logs
+ * the statistics, the not-freed memory, and the unreachable memory.
+ * The library is locked only for the fork so the program goes on
+ * while the child works.  The caller should reap the child with
+ * waitpid.
+ *
+ * Returns the process-id of the child or -1 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * report_path -> Path of the file the child logs the report to or
+ * NULL to use the logfile.  A %p in the path is replaced with the
+ * process-id of the child.
+ */
+extern
+int	dmalloc_snapshot_async(const char *report_path);
+
+/*
+ * int dmalloc_dump_heap
+ *
+ * Write the used and free blocks of the heap to a binary dump file.
+ * The file records the address, sizes, and allocation site of each
+ * block along with the heap ranges and can be analyzed later with the
+ * dump options of the dmalloc utility.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the dump file.
+ *
+ * data_b -> Set to 1 to also write the bytes of each allocation.
+ */
+extern
+int	dmalloc_dump_heap(const char *path, const int data_b);
+
+/*
+ * unsigned long dmalloc_trim
+ *
+ * Give the physical pages of the free heap blocks back to the system.
+ * The blocks stay in the heap and are reused as normal.
+ *
+ * Returns the number of bytes given back.
+ */
+extern
+unsigned long	dmalloc_trim(void);
+
 /*
  * void dmalloc_vmessage
  *
@@ -714,6 +929,25 @@ void	dmalloc_get_stats(DMALLOC_PNT *heap_low_p,
 			  unsigned long *max_pnt_np,
 			  unsigned long *max_one_p);
 
+/*
+ * int dmalloc_get_lock_stats
+ *
+ * Get how long the calls of an operation have waited for and held
+ * the lock of the threaded library.  The lock is only profiled if the
+ * library was built with LOCK_PROFILE_TOP_LOG set.
+ *
+ * Returns 1 if the lock is profiled or 0 if it is not or the
+ * operation is not known in which case the stats are all 0.
+ *
+ * ARGUMENTS:
+ *
+ * op -> DMALLOC_LOCK_ operation whose stats we are getting.
+ *
+ * stats_p <- Pointer to the stats which we fill in.
+ */
+extern
+int	dmalloc_get_lock_stats(const int op, dmalloc_lock_stats_t *stats_p);
+
 /*
  * const char *dmalloc_strerror
  *